@@ -8,6 +8,7 @@
 #include <iomanip>
 #include <algorithm>  // for std::sort
 #include <set>
+#include "../include/commitlog.h"
 
 using namespace std;
 // =====================================================================
@@ -27,6 +28,8 @@ int32_t  MDR= 0;           // Memory data register
 
 uint64_t clockCycle = 0;   // Cycle counter
 
+CommitLogWriter commitLog; // --commit-log=FILE (optional second argument)
+
 // =====================================================================
 // Instruction Memory (< 0x10000000)
 // =====================================================================
@@ -387,6 +390,14 @@ int main(int argc, char* argv[]) {
     if (!parseInputMC(inputFile)) {
         return 1;
     }
+    std::string commitLogFile;
+    for (int i = 2; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg.compare(0, 13, "--commit-log=") == 0) commitLogFile = arg.substr(13);
+    }
+    if (!commitLogFile.empty() && !commitLog.open(commitLogFile)) {
+        return 1;
+    }
 
     // Before cycle 0, dump initial contents to:
     //   instruction.mc, data.mc, stack.mc
@@ -772,6 +783,7 @@ int main(int argc, char* argv[]) {
         }
 
         // Writeback
+        bool wroteRd = false;
         switch (d.opcode) {
             case 0x33: // R-type
             case 0x13: // I-type ALU
@@ -780,6 +792,7 @@ int main(int argc, char* argv[]) {
             case 0x03: // LOAD
             case 0x6F: // JAL
             case 0x67: // JALR
+                wroteRd = true;
                 if (d.rd != 0) {
                     R[d.rd] = RY;
                     std::cout << "[WB] R[" << d.rd << "] => " << R[d.rd] << "\n";
@@ -791,6 +804,11 @@ int main(int argc, char* argv[]) {
         }
 
         R[0] = 0; // x0 always 0
+        if (commitLog.isOpen()) {
+            uint8_t storeBytes = (d.opcode == 0x23 && d.funct3 <= 2) ? 1u << d.funct3 : 0;
+            commitLog.append(PC, IR, wroteRd ? d.rd : COMMIT_NO_RD, static_cast<uint32_t>(RY),
+                             static_cast<uint32_t>(RA + d.imm), storeBytes, static_cast<uint32_t>(RM));
+        }
         PC = nextPC;
 
         printRegisters();
@@ -816,5 +834,9 @@ int main(int argc, char* argv[]) {
     }
 
     std::cout << "Simulation finished after " << clockCycle << " cycles.\n";
+    if (commitLog.isOpen()) {
+        commitLog.close();
+        std::cout << "Commit log written to " << commitLogFile << "\n";
+    }
     return 0;
 }
@@ -0,0 +1,15 @@
+#ifndef CTYPE_H
+#define CTYPE_H
+
+#include <cstdint>
+#include <string>
+#include "opcodes.h"
+
+// Compressed (C extension) form of a base instruction with the given
+// fields. Returns false if the operands have no 16-bit encoding.
+bool encodeCType(InstrId id, int rd, int rs1, int rs2, int32_t imm, uint16_t &code);
+// Same, starting from the 32-bit encoding of the instruction.
+bool compressInstruction(uint32_t machineCode, uint16_t &code);
+std::string buildBitCommentC(uint16_t code);
+
+#endif // CTYPE_H
@@ -20,6 +20,7 @@ struct InstructionLine {
     std::string mnemonic;
     std::vector<std::string> operands;   // e.g. x1, x2, x3 or x5, x6, 10
     std::string originalLine;
+    uint32_t size = 4;                   // 2 if emitted as a compressed instruction
 };
 
 #endif // INSTRUCTION_H
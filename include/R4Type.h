@@ -0,0 +1,13 @@
+#ifndef R4TYPE_H
+#define R4TYPE_H
+
+#include <cstdint>
+#include <string>
+
+// Fused multiply-add: rs3 in bits 31:27, fmt in bits 26:25, rm in funct3
+uint32_t encodeR4Type(uint8_t opcode, uint8_t rm, uint8_t fmt,
+                      int rd, int rs1, int rs2, int rs3);
+std::string buildBitCommentR4(uint8_t opcode, uint8_t rm, uint8_t fmt,
+                              int rd, int rs1, int rs2, int rs3);
+
+#endif // R4TYPE_H
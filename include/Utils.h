@@ -8,10 +8,14 @@
 std::string trim(const std::string &s);
 std::vector<std::string> splitTokens(const std::string &line);
 int getRegisterNumber(const std::string &reg);
+int getCSRNumber(const std::string &csr);
+int getRoundingMode(const std::string &rm);
 int32_t parseImmediate(const std::string &immStr);
+bool isImmediate(const std::string &immStr);
 uint32_t setBits(uint32_t value, unsigned offset, unsigned numBits, uint32_t field);
 std::string toBinary(uint32_t val, int width);
 std::string toHex32(uint32_t val);
+std::string toHex16(uint16_t val);
 std::string toUpper(const std::string &s);
 
 #endif // UTILS_H
@@ -21,6 +21,7 @@ private:
     uint32_t currentTextAddr;
     uint32_t currentDataAddr;
     int currentSection; // Use Section enum values (UNDEF, TEXT, DATA)
+    bool autoCompress = false; // .option rvc: emit 16-bit forms where operands fit
 
     void pass1();
     void pass2();
@@ -0,0 +1,165 @@
+#ifndef BRANCHPROFILE_H
+#define BRANCHPROFILE_H
+
+#include <cstdint>
+#include <cstdio>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include "elf_loader.h"
+
+// =====================================================================
+// Per-branch analytics (pipelined model, --branch-report)
+//   - One record per conditional branch PC, updated when the branch
+//     resolves: a hash lookup and a few increments
+//   - The outcome is also counted under the branch's local history (its
+//     last BRANCH_HISTORY_BITS outcomes). From those counts come the
+//     conditional entropy of the branch and the mispredictions of an
+//     ideal local-history predictor; the gap to the active predictor's
+//     mispredictions is what a better predictor could fix.
+//   - Classes: biased (one direction >= 95%), loop (the minority
+//     direction never repeats back to back), patterned (predictable from
+//     local history), data-dependent (everything else)
+// =====================================================================
+static const int BRANCH_HISTORY_BITS = 6;
+static const int BRANCH_PATTERNS = 1 << BRANCH_HISTORY_BITS;
+
+class BranchProfiler {
+public:
+    bool enabled = false;
+
+    void record(uint64_t pc, bool taken, bool mispredicted) {
+        BranchCounters &b = branches[pc];
+        if (b.executed > 0) {
+            if (taken != b.lastTaken) b.transitions++;
+            else if (taken) b.takenRepeats++;
+            else b.notTakenRepeats++;
+        }
+        b.executed++;
+        b.taken += taken;
+        b.mispredicts += mispredicted;
+        b.outcomes[b.history][taken]++;
+        b.history = static_cast<uint8_t>(((b.history << 1) | taken) & (BRANCH_PATTERNS - 1));
+        b.lastTaken = taken;
+    }
+
+    // Report sorted by mispredictions; text holds assembly per PC (.mc input)
+    bool writeReport(const std::string &filename, const std::map<uint64_t, std::string> &text,
+                     const std::vector<ElfSymbol> &symbols) const {
+        std::ofstream fout(filename);
+        if (!fout.is_open()) {
+            std::cerr << "ERROR: Could not open/create " << filename << "\n";
+            return false;
+        }
+        std::vector<Row> rows;
+        for (const auto &e : branches) rows.push_back(analyze(e.first, e.second));
+        std::stable_sort(rows.begin(), rows.end(), [](const Row &a, const Row &b) {
+            return a.mispredicts != b.mispredicts ? a.mispredicts > b.mispredicts : a.pc < b.pc;
+        });
+
+        fout << "# Branch report: " << rows.size() << " static branches, local history of " << BRANCH_HISTORY_BITS
+             << " outcomes\n"
+             << "# flips: direction changes; entropy: bits per outcome given the local history;\n"
+             << "# hist: mispredictions of an ideal local-history predictor; fixable: mispr - hist\n"
+             << std::left << std::setw(12) << "# pc" << std::right << std::setw(10) << "execs" << std::setw(8)
+             << "taken%" << std::setw(8) << "flips%" << std::setw(9) << "entropy" << std::setw(8) << "mispr"
+             << std::setw(8) << "hist" << std::setw(9) << "fixable" << "  " << std::left << std::setw(16) << "class"
+             << "instruction\n" << std::right;
+        ClassTotals totals[CLASSES];
+        for (const Row &r : rows) {
+            char pcText[24];
+            std::snprintf(pcText, sizeof(pcText), "0x%llx", static_cast<unsigned long long>(r.pc));
+            fout << std::left << std::setw(12) << pcText << std::right << std::setw(10) << r.executed << std::fixed
+                 << std::setprecision(1) << std::setw(8) << 100.0 * r.takenRate << std::setw(8)
+                 << 100.0 * r.flipRate << std::setprecision(3) << std::setw(9) << r.entropy << std::setw(8)
+                 << r.mispredicts << std::setw(8) << r.historyMispredicts << std::setw(9) << r.fixable() << "  ";
+            auto it = text.find(r.pc);
+            std::string instruction = (it != text.end()) ? it->second : "";
+            std::string where = symbolize(symbols, r.pc);
+            if (!where.empty()) instruction += (instruction.empty() ? "<" : "  <") + where + ">";
+            if (instruction.empty()) fout << className(r.cls) << "\n";
+            else fout << std::left << std::setw(16) << className(r.cls) << std::right << instruction << "\n";
+            ClassTotals &t = totals[r.cls];
+            t.branches++;
+            t.executed += r.executed;
+            t.mispredicts += r.mispredicts;
+            t.fixable += r.fixable();
+        }
+
+        fout << "#\n# " << std::left << std::setw(16) << "class" << std::right << std::setw(10) << "branches"
+             << std::setw(12) << "execs" << std::setw(10) << "mispr" << std::setw(10) << "fixable" << "\n";
+        for (int c = 0; c < CLASSES; c++) {
+            const ClassTotals &t = totals[c];
+            fout << "# " << std::left << std::setw(16) << className(c) << std::right << std::setw(10) << t.branches
+                 << std::setw(12) << t.executed << std::setw(10) << t.mispredicts << std::setw(10) << t.fixable
+                 << "\n";
+        }
+        return true;
+    }
+
+private:
+    enum BranchClass { BIASED, LOOP, PATTERNED, DATA_DEPENDENT, CLASSES };
+    static const char *className(int c) {
+        static const char *const names[CLASSES] = {"biased", "loop", "patterned", "data-dependent"};
+        return names[c];
+    }
+
+    struct BranchCounters {
+        uint64_t executed = 0;
+        uint64_t taken = 0;
+        uint64_t transitions = 0;
+        uint64_t takenRepeats = 0;    // Taken right after taken
+        uint64_t notTakenRepeats = 0; // Not taken right after not taken
+        uint64_t mispredicts = 0;
+        uint32_t outcomes[BRANCH_PATTERNS][2] = {}; // [local history][taken]
+        uint8_t history = 0;
+        bool lastTaken = false;
+    };
+
+    struct Row {
+        uint64_t pc, executed, mispredicts, historyMispredicts;
+        double takenRate, flipRate, entropy;
+        BranchClass cls;
+        uint64_t fixable() const { return mispredicts > historyMispredicts ? mispredicts - historyMispredicts : 0; }
+    };
+
+    struct ClassTotals {
+        uint64_t branches = 0, executed = 0, mispredicts = 0, fixable = 0;
+    };
+
+    std::unordered_map<uint64_t, BranchCounters> branches;
+
+    static Row analyze(uint64_t pc, const BranchCounters &b) {
+        Row r;
+        r.pc = pc;
+        r.executed = b.executed;
+        r.mispredicts = b.mispredicts;
+        r.takenRate = static_cast<double>(b.taken) / b.executed;
+        r.flipRate = b.executed > 1 ? static_cast<double>(b.transitions) / (b.executed - 1) : 0.0;
+        r.historyMispredicts = 0;
+        r.entropy = 0.0;
+        for (int h = 0; h < BRANCH_PATTERNS; h++) {
+            uint64_t n0 = b.outcomes[h][0], n1 = b.outcomes[h][1];
+            if (n0 + n1 == 0) continue;
+            r.historyMispredicts += std::min(n0, n1);
+            double p = static_cast<double>(n1) / (n0 + n1);
+            double bits = (p > 0.0 && p < 1.0) ? -(p * std::log2(p) + (1 - p) * std::log2(1 - p)) : 0.0;
+            r.entropy += bits * (n0 + n1) / b.executed;
+        }
+        bool minorityTaken = b.taken * 2 < b.executed;
+        uint64_t minorityRepeats = minorityTaken ? b.takenRepeats : b.notTakenRepeats;
+        if (r.takenRate >= 0.95 || r.takenRate <= 0.05) r.cls = BIASED;
+        else if (b.transitions >= 2 && minorityRepeats == 0) r.cls = LOOP;
+        else if (r.entropy <= 0.25) r.cls = PATTERNED;
+        else r.cls = DATA_DEPENDENT;
+        return r;
+    }
+};
+
+#endif // BRANCHPROFILE_H
@@ -0,0 +1,202 @@
+#ifndef COMMITLOG_H
+#define COMMITLOG_H
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <iostream>
+#include <iomanip>
+
+// =====================================================================
+// Binary commit log (--commit-log)
+//   - One fixed-size record per retired instruction: PC, instruction,
+//     the register written and its new value, and the address, width
+//     and data of a store
+//   - Written by every simulator model; two logs of the same program
+//     must match record for record
+//   - compareCommitLogs() streams two logs and stops at the first
+//     record that differs (--check-commits=A,B)
+// =====================================================================
+static const uint32_t COMMIT_MAGIC   = 0x4C435652; // "RVCL"
+static const uint32_t COMMIT_VERSION = 1;
+static const uint8_t COMMIT_NO_RD = 0xFF;
+
+struct CommitHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t count;    // Number of records following the header
+};
+
+struct CommitRecord {
+    uint64_t pc;
+    uint64_t value;    // New value of rd (0 without rd)
+    uint64_t memAddr;  // Store address (0 without a store)
+    uint64_t memData;  // Stored bytes, zero-extended
+    uint32_t ir;       // Instruction, compressed ones expanded
+    uint8_t rd;        // 0-31 x registers, 32-63 f registers, COMMIT_NO_RD
+    uint8_t memBytes;  // Store width; 0 = no store
+    uint16_t reserved;
+};
+
+// =====================================================================
+// CommitLogWriter: buffers records and writes them in large blocks.
+// The record count in the header is patched in on close().
+// =====================================================================
+class CommitLogWriter {
+public:
+    ~CommitLogWriter() { close(); }
+
+    bool open(const std::string &filename) {
+        fout = std::fopen(filename.c_str(), "wb");
+        if (!fout) {
+            std::cerr << "ERROR: Could not open/create " << filename << "\n";
+            return false;
+        }
+        CommitHeader header = {COMMIT_MAGIC, COMMIT_VERSION, 0};
+        std::fwrite(&header, sizeof(header), 1, fout);
+        buffer.reserve(BUFFER_RECORDS);
+        count = 0;
+        return true;
+    }
+
+    bool isOpen() const { return fout != nullptr; }
+
+    // rd == 0 is logged as no write; memBytes == 0 means no store
+    void append(uint64_t pc, uint32_t ir, uint8_t rd, uint64_t value, uint64_t memAddr, uint8_t memBytes,
+                uint64_t memData) {
+        CommitRecord r;
+        r.pc = pc;
+        r.ir = ir;
+        r.rd = (rd == 0) ? COMMIT_NO_RD : rd;
+        r.value = (r.rd == COMMIT_NO_RD) ? 0 : value;
+        r.memBytes = memBytes;
+        r.memAddr = memBytes ? memAddr : 0;
+        r.memData = (memBytes == 0) ? 0 : (memBytes >= 8) ? memData : memData & ((1ull << (8 * memBytes)) - 1);
+        r.reserved = 0;
+        buffer.push_back(r);
+        if (buffer.size() == BUFFER_RECORDS) flush();
+    }
+
+    void close() {
+        if (!fout) return;
+        flush();
+        CommitHeader header = {COMMIT_MAGIC, COMMIT_VERSION, count};
+        std::fseek(fout, 0, SEEK_SET);
+        std::fwrite(&header, sizeof(header), 1, fout);
+        std::fclose(fout);
+        fout = nullptr;
+    }
+
+private:
+    static const size_t BUFFER_RECORDS = 1 << 14;
+    std::FILE *fout = nullptr;
+    std::vector<CommitRecord> buffer;
+    uint64_t count = 0;
+
+    void flush() {
+        if (buffer.empty()) return;
+        std::fwrite(buffer.data(), sizeof(CommitRecord), buffer.size(), fout);
+        count += buffer.size();
+        buffer.clear();
+    }
+};
+
+// =====================================================================
+// CommitLogReader: streams records in blocks
+// =====================================================================
+class CommitLogReader {
+public:
+    ~CommitLogReader() {
+        if (fin) std::fclose(fin);
+    }
+
+    bool open(const std::string &filename) {
+        fin = std::fopen(filename.c_str(), "rb");
+        if (!fin) {
+            std::cerr << "ERROR: Could not open " << filename << "\n";
+            return false;
+        }
+        CommitHeader header;
+        if (std::fread(&header, sizeof(header), 1, fin) != 1 || header.magic != COMMIT_MAGIC ||
+            header.version != COMMIT_VERSION) {
+            std::cerr << "ERROR: " << filename << " is not a commit log\n";
+            return false;
+        }
+        return true;
+    }
+
+    bool next(CommitRecord &r) {
+        if (pos == block.size()) {
+            block.resize(BLOCK_RECORDS);
+            block.resize(std::fread(block.data(), sizeof(CommitRecord), BLOCK_RECORDS, fin));
+            pos = 0;
+            if (block.empty()) return false;
+        }
+        r = block[pos++];
+        return true;
+    }
+
+private:
+    static const size_t BLOCK_RECORDS = 1 << 14;
+    std::FILE *fin = nullptr;
+    std::vector<CommitRecord> block;
+    size_t pos = 0;
+};
+
+inline std::string formatCommitRecord(const CommitRecord &r) {
+    char text[160];
+    int n = std::snprintf(text, sizeof(text), "pc=0x%08llx ir=0x%08x", static_cast<unsigned long long>(r.pc), r.ir);
+    if (r.rd != COMMIT_NO_RD)
+        n += std::snprintf(text + n, sizeof(text) - n, "  %c%u=0x%llx", r.rd >= 32 ? 'f' : 'x', r.rd & 31,
+                           static_cast<unsigned long long>(r.value));
+    if (r.memBytes)
+        std::snprintf(text + n, sizeof(text) - n, "  st%u [0x%llx]=0x%llx", r.memBytes,
+                      static_cast<unsigned long long>(r.memAddr), static_cast<unsigned long long>(r.memData));
+    return text;
+}
+
+// =====================================================================
+// compareCommitLogs: 0 if the logs match, 1 at the first divergence
+// (printed with the last few matching records), 2 if a log is unreadable
+// =====================================================================
+inline int compareCommitLogs(const std::string &fileA, const std::string &fileB, std::ostream &out) {
+    const size_t CONTEXT = 8;
+    CommitLogReader a, b;
+    if (!a.open(fileA) || !b.open(fileB)) return 2;
+
+    std::vector<CommitRecord> recent(CONTEXT); // Ring of the last matching records
+    uint64_t index = 0;
+    CommitRecord ra, rb;
+    for (;; index++) {
+        bool hasA = a.next(ra), hasB = b.next(rb);
+        if (!hasA && !hasB) {
+            out << "Commit logs match: " << index << " instructions\n";
+            return 0;
+        }
+        if (hasA && hasB && ra.pc == rb.pc && ra.ir == rb.ir && ra.rd == rb.rd && ra.value == rb.value &&
+            ra.memBytes == rb.memBytes && ra.memAddr == rb.memAddr && ra.memData == rb.memData) {
+            recent[index % CONTEXT] = ra;
+            continue;
+        }
+
+        out << "Commit logs diverge at instruction " << index << "\n";
+        for (uint64_t i = (index > CONTEXT ? index - CONTEXT : 0); i < index; i++)
+            out << "  " << std::setw(10) << i << "  " << formatCommitRecord(recent[i % CONTEXT]) << "\n";
+        out << "  " << fileA << ": " << (hasA ? formatCommitRecord(ra) : "(ends)") << "\n";
+        out << "  " << fileB << ": " << (hasB ? formatCommitRecord(rb) : "(ends)") << "\n";
+        if (hasA && hasB) {
+            out << "  differs in:";
+            if (ra.pc != rb.pc) out << " pc";
+            if (ra.ir != rb.ir) out << " instruction";
+            if (ra.rd != rb.rd) out << " destination";
+            else if (ra.value != rb.value) out << " value";
+            if (ra.memBytes != rb.memBytes || ra.memAddr != rb.memAddr) out << " store address";
+            else if (ra.memData != rb.memData) out << " store data";
+            out << "\n";
+        }
+        return 1;
+    }
+}
+
+#endif // COMMITLOG_H
@@ -5,7 +5,8 @@
 
 static const uint32_t TEXT_START = 0x00000000;      // Starting address for .text
 static const uint32_t DATA_START = 0x10000000;        // Starting address for .data
-static const uint32_t CODE_STEP  = 4;                 // Each instruction is 4 bytes
+static const uint32_t INSTR_BYTES = 4;                // Base instruction size
+static const uint32_t COMPRESSED_INSTR_BYTES = 2;     // C extension instruction size
 
 enum Section {
     UNDEF,
@@ -0,0 +1,221 @@
+#ifndef CSR_H
+#define CSR_H
+
+#include <cstdint>
+#include "vector.h"
+
+// =====================================================================
+// Control and status registers (Zicsr) shared by both simulators
+// =====================================================================
+enum CSRAddress : uint32_t {
+    CSR_FFLAGS     = 0x001,
+    CSR_FRM        = 0x002,
+    CSR_FCSR       = 0x003,
+    CSR_VSTART     = 0x008,
+    CSR_SATP       = 0x180,
+    CSR_MSTATUS    = 0x300,
+    CSR_MISA       = 0x301,
+    CSR_MIE        = 0x304,
+    CSR_MTVEC      = 0x305,
+    CSR_MSCRATCH   = 0x340,
+    CSR_MEPC       = 0x341,
+    CSR_MCAUSE     = 0x342,
+    CSR_MTVAL      = 0x343,
+    CSR_MIP        = 0x344,
+    CSR_MCYCLE     = 0xB00,
+    CSR_MINSTRET   = 0xB02,
+    CSR_MCYCLEH    = 0xB80,
+    CSR_MINSTRETH  = 0xB82,
+    CSR_CYCLE      = 0xC00,
+    CSR_TIME       = 0xC01,
+    CSR_INSTRET    = 0xC02,
+    CSR_HPMCOUNTER3 = 0xC03,
+    CSR_CYCLEH     = 0xC80,
+    CSR_TIMEH      = 0xC81,
+    CSR_INSTRETH   = 0xC82,
+    CSR_HPMCOUNTER3H = 0xC83,
+    CSR_VL         = 0xC20,
+    CSR_VTYPE      = 0xC21,
+    CSR_VLENB      = 0xC22,
+    CSR_MHARTID    = 0xF14
+};
+
+// Trap causes (mcause values)
+enum TrapCause : uint32_t {
+    CAUSE_MISALIGNED_FETCH = 0,
+    CAUSE_ILLEGAL_INSTRUCTION = 2,
+    CAUSE_BREAKPOINT = 3,
+    CAUSE_MISALIGNED_LOAD = 4,
+    CAUSE_MISALIGNED_STORE = 6,
+    CAUSE_ECALL_M = 11,
+    CAUSE_FETCH_PAGE_FAULT = 12,
+    CAUSE_LOAD_PAGE_FAULT = 13,
+    CAUSE_STORE_PAGE_FAULT = 15
+};
+
+// Interrupts: mcause has bit 31 set and the mip/mie bit number below
+static const uint32_t CAUSE_INTERRUPT = 1u << 31;
+static const uint32_t IRQ_M_SOFT  = 3;
+static const uint32_t IRQ_M_TIMER = 7;
+static const uint32_t IRQ_M_EXT   = 11;
+static const uint32_t MIP_MSIP = 1u << IRQ_M_SOFT;
+static const uint32_t MIP_MTIP = 1u << IRQ_M_TIMER;
+static const uint32_t MIP_MEIP = 1u << IRQ_M_EXT;
+
+static const uint32_t MSTATUS_MIE  = 1u << 3;
+static const uint32_t MSTATUS_MPIE = 1u << 7;
+static const uint32_t MSTATUS_MPP  = 3u << 11;
+
+// Number of hpmcounters (hpmcounter3 upwards) backed by simulator statistics
+static const int NUM_HPM_COUNTERS = 5;
+
+// =====================================================================
+// CSRFile: machine-mode trap registers plus read-only counters.
+// The counters point at the owning simulator's statistics so reads
+// always see live values; unbound counters read as zero. satp exists
+// only when the simulator binds its translation register.
+// =====================================================================
+class CSRFile {
+public:
+    uint32_t mstatus = MSTATUS_MPP; // Always machine mode
+    uint32_t mie = 0;
+    uint32_t mip = 0;
+    uint32_t mtvec = 0;
+    uint32_t mscratch = 0;
+    uint32_t mepc = 0;
+    uint32_t mcause = 0;
+    uint32_t mtval = 0;
+    uint32_t fflags = 0; // Accrued FP exception flags (NV DZ OF UF NX)
+    uint32_t frm = 0;    // Dynamic rounding mode
+    uint32_t vl = 0;     // Set by vsetvli only
+    uint32_t vtype = VTYPE_VILL;
+
+    const uint64_t *cycle = nullptr;
+    const uint64_t *instret = nullptr;
+    const uint64_t *hpm[NUM_HPM_COUNTERS] = {};
+    uint32_t *satp = nullptr;
+
+    // Returns false if the CSR does not exist
+    bool read(uint32_t addr, uint32_t &value) const {
+        switch (addr) {
+            case CSR_MSTATUS:  value = mstatus; return true;
+            case CSR_MISA:     value = (1u << 30) | (1u << 8) | (1u << 12) | (1u << 5) | (1u << 3) | (1u << 21); return true; // RV32IMFDV
+            case CSR_FFLAGS:   value = fflags; return true;
+            case CSR_FRM:      value = frm; return true;
+            case CSR_FCSR:     value = (frm << 5) | fflags; return true;
+            case CSR_VSTART:   value = 0; return true; // Vector instructions always run to completion
+            case CSR_VL:       value = vl; return true;
+            case CSR_VTYPE:    value = vtype; return true;
+            case CSR_VLENB:    value = VLENB; return true;
+            case CSR_MIE:      value = mie; return true;
+            case CSR_MIP:      value = mip; return true;
+            case CSR_MTVEC:    value = mtvec; return true;
+            case CSR_MSCRATCH: value = mscratch; return true;
+            case CSR_MEPC:     value = mepc; return true;
+            case CSR_MCAUSE:   value = mcause; return true;
+            case CSR_MTVAL:    value = mtval; return true;
+            case CSR_MHARTID:  value = 0; return true;
+            case CSR_SATP:
+                if (!satp) return false;
+                value = *satp; return true;
+            case CSR_CYCLE: case CSR_TIME: case CSR_MCYCLE:
+                value = static_cast<uint32_t>(counter(cycle)); return true;
+            case CSR_CYCLEH: case CSR_TIMEH: case CSR_MCYCLEH:
+                value = static_cast<uint32_t>(counter(cycle) >> 32); return true;
+            case CSR_INSTRET: case CSR_MINSTRET:
+                value = static_cast<uint32_t>(counter(instret)); return true;
+            case CSR_INSTRETH: case CSR_MINSTRETH:
+                value = static_cast<uint32_t>(counter(instret) >> 32); return true;
+            default: break;
+        }
+        if (addr >= CSR_HPMCOUNTER3 && addr < CSR_HPMCOUNTER3 + NUM_HPM_COUNTERS) {
+            value = static_cast<uint32_t>(counter(hpm[addr - CSR_HPMCOUNTER3]));
+            return true;
+        }
+        if (addr >= CSR_HPMCOUNTER3H && addr < CSR_HPMCOUNTER3H + NUM_HPM_COUNTERS) {
+            value = static_cast<uint32_t>(counter(hpm[addr - CSR_HPMCOUNTER3H]) >> 32);
+            return true;
+        }
+        return false;
+    }
+
+    // Returns false if the CSR does not exist or is read-only
+    bool write(uint32_t addr, uint32_t value) {
+        if ((addr >> 10) == 0x3) return false; // 0xC00-0xFFF: read-only space
+        switch (addr) {
+            case CSR_MSTATUS:  mstatus = (value & (MSTATUS_MIE | MSTATUS_MPIE)) | MSTATUS_MPP; return true;
+            case CSR_MISA:     return true; // WARL, not writable
+            case CSR_FFLAGS:   fflags = value & 0x1F; return true;
+            case CSR_FRM:      frm = value & 0x7; return true;
+            case CSR_FCSR:     fflags = value & 0x1F; frm = (value >> 5) & 0x7; return true;
+            case CSR_VSTART:   return true;
+            case CSR_MIE:      mie = value; return true;
+            case CSR_MIP:      return true; // Pending bits are set by devices only
+            case CSR_SATP:
+                if (!satp) return false;
+                *satp = value; return true;
+            case CSR_MTVEC:    mtvec = value & ~2u; return true; // Direct or vectored mode
+            case CSR_MSCRATCH: mscratch = value; return true;
+            case CSR_MEPC:     mepc = value & ~1u; return true;
+            case CSR_MCAUSE:   mcause = value; return true;
+            case CSR_MTVAL:    mtval = value; return true;
+            case CSR_MCYCLE: case CSR_MCYCLEH:
+            case CSR_MINSTRET: case CSR_MINSTRETH:
+                return true; // Counters follow the simulator statistics
+            default: return false;
+        }
+    }
+
+    // Trap entry: returns the handler address, or 0 if none is installed.
+    // In vectored mode (mtvec bit 0) interrupts go to base + 4 * cause.
+    uint32_t enterTrap(uint32_t cause, uint32_t epc, uint32_t tval) {
+        mepc = epc;
+        mcause = cause;
+        mtval = tval;
+        mstatus = (mstatus & MSTATUS_MIE) ? (mstatus | MSTATUS_MPIE) : (mstatus & ~MSTATUS_MPIE);
+        mstatus &= ~MSTATUS_MIE;
+        uint32_t base = mtvec & ~3u;
+        if (base != 0 && (mtvec & 1) && (cause & CAUSE_INTERRUPT)) return base + 4 * (cause & ~CAUSE_INTERRUPT);
+        return base;
+    }
+
+    // Interrupt to take now (mcause value), or 0: pending, enabled in mie,
+    // mstatus.MIE set, and a handler installed. Priority MEI > MSI > MTI.
+    uint32_t pendingInterrupt() const {
+        uint32_t ready = mip & mie;
+        if (!ready || !(mstatus & MSTATUS_MIE) || (mtvec & ~3u) == 0) return 0;
+        if (ready & MIP_MEIP) return CAUSE_INTERRUPT | IRQ_M_EXT;
+        if (ready & MIP_MSIP) return CAUSE_INTERRUPT | IRQ_M_SOFT;
+        if (ready & MIP_MTIP) return CAUSE_INTERRUPT | IRQ_M_TIMER;
+        return 0;
+    }
+
+    // MRET: returns the address to resume at
+    uint32_t returnFromTrap() {
+        mstatus = (mstatus & MSTATUS_MPIE) ? (mstatus | MSTATUS_MIE) : (mstatus & ~MSTATUS_MIE);
+        mstatus |= MSTATUS_MPIE;
+        return mepc;
+    }
+
+private:
+    static uint64_t counter(const uint64_t *source) { return source ? *source : 0; }
+};
+
+// =====================================================================
+// executeCSROp: the read-modify-write of csrrw/csrrs/csrrc and their
+// immediate forms. Returns false if the access must raise an illegal
+// instruction trap; oldValue is what the instruction writes to rd.
+// =====================================================================
+inline bool executeCSROp(CSRFile &csrs, uint32_t funct3, uint32_t csrAddr,
+                         uint32_t rs1Field, uint32_t rs1Value, uint32_t &oldValue) {
+    if (!csrs.read(csrAddr, oldValue)) return false;
+    uint32_t src = (funct3 & 0x4) ? rs1Field : rs1Value; // csrr*i use the rs1 field as uimm
+    switch (funct3 & 0x3) {
+        case 0x1: return csrs.write(csrAddr, src); // CSRRW always writes
+        case 0x2: return rs1Field == 0 || csrs.write(csrAddr, oldValue | src);  // CSRRS
+        case 0x3: return rs1Field == 0 || csrs.write(csrAddr, oldValue & ~src); // CSRRC
+        default: return false;
+    }
+}
+
+#endif // CSR_H
@@ -0,0 +1,264 @@
+#ifndef DATAFLOW_H
+#define DATAFLOW_H
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include "elf_loader.h"
+
+// =====================================================================
+// Dataflow critical-path analysis (--dataflow, on a --replay trace)
+//   - Each retired instruction is a node that starts when its last
+//     producer finishes and takes its class latency: register RAW through
+//     rs1/rs2/rs3 -> rd, memory RAW from a store to a later load of an
+//     overlapping 8-byte word. No structural, control or WAR/WAW limits
+//     (perfect prediction and renaming, unbounded width).
+//   - The longest path is the dataflow limit: CPI = path / instructions,
+//     ILP = instructions / path
+//   - One 16-byte node per instruction is kept to walk the critical path
+//     back at the end; it is summarized per PC and per producer ->
+//     consumer edge (the recurring links of the critical chains)
+// =====================================================================
+enum DataflowClass {
+    DF_ALU, DF_MUL, DF_DIV, DF_LOAD, DF_STORE, DF_BRANCH,
+    DF_FP_ADD, DF_FP_MUL, DF_FP_DIV, DF_FP_CVT, DF_VECTOR, DF_CLASSES
+};
+
+static const uint32_t DF_REGS = 64;      // x0-x31, then f0-f31
+static const uint8_t DF_VIA_NONE = 0xFF; // Node without producer
+static const uint8_t DF_VIA_MEM = 0xFE;  // Depends on a store
+
+class DataflowAnalyzer {
+public:
+    bool enabled = false;
+
+    // "class:cycles,..." e.g. "load:2,mul:3"; classes without an entry keep
+    // the latency the pipelined model gives the instruction
+    bool setLatencies(const std::string &spec) {
+        size_t pos = 0;
+        while (pos < spec.size()) {
+            size_t comma = spec.find(',', pos);
+            std::string item = spec.substr(pos, comma == std::string::npos ? std::string::npos : comma - pos);
+            pos = (comma == std::string::npos) ? spec.size() : comma + 1;
+            size_t colon = item.find(':');
+            int cls = (colon == std::string::npos) ? -1 : classIndex(item.substr(0, colon));
+            if (cls < 0) return false;
+            override[cls] = static_cast<uint32_t>(std::strtoul(item.c_str() + colon + 1, nullptr, 0));
+        }
+        return true;
+    }
+
+    // sources: register numbers (0 = unused), dest: 0 = none. memBytes: 0
+    // unless a scalar load or store. modelCycles: the pipelined model's
+    // latency for this instruction, used unless its class is overridden.
+    void instruction(uint64_t pc, const uint32_t (&sources)[3], uint32_t dest, DataflowClass cls,
+                     uint64_t memAddr, uint32_t memBytes, uint32_t modelCycles) {
+        uint64_t start = 0, pred = 0;
+        uint8_t via = DF_VIA_NONE;
+        for (uint32_t src : sources) {
+            if (src == 0 || src >= DF_REGS || regFinish[src] <= start) continue;
+            start = regFinish[src];
+            pred = regNode[src];
+            via = static_cast<uint8_t>(src);
+        }
+        bool isStore = (cls == DF_STORE);
+        uint64_t firstWord = memAddr >> 3, lastWord = (memAddr + memBytes - 1) >> 3;
+        if (memBytes && !isStore) {
+            for (uint64_t w = firstWord; w <= lastWord; w++) {
+                auto it = memory.find(w);
+                if (it == memory.end() || it->second.finish <= start) continue;
+                start = it->second.finish;
+                pred = it->second.node;
+                via = DF_VIA_MEM;
+            }
+        }
+        uint32_t latency = override[cls] ? override[cls] : std::max<uint32_t>(modelCycles, 1);
+        uint64_t finish = start + latency;
+        uint64_t id = nodes.size() + 1; // 0 = no node
+        nodes.push_back({pcIndex(pc), static_cast<uint16_t>(std::min<uint32_t>(latency, 0xFFFF)), via, pred});
+        if (dest != 0 && dest < DF_REGS) {
+            regFinish[dest] = finish;
+            regNode[dest] = id;
+        }
+        if (memBytes && isStore)
+            for (uint64_t w = firstWord; w <= lastWord; w++) memory[w] = {finish, id};
+        if (finish > pathLength) {
+            pathLength = finish;
+            pathEnd = id;
+        }
+    }
+
+    // Summary on stdout; measuredCycles: the timing model's cycles for the same instructions
+    void printSummary(std::ostream &out, uint64_t measuredCycles) const {
+        uint64_t n = nodes.size();
+        out << "Dataflow limit: " << n << " instructions, critical path " << pathLength << " cycles";
+        if (n == 0 || pathLength == 0) {
+            out << "\n";
+            return;
+        }
+        std::ios::fmtflags flags = out.flags();
+        std::streamsize precision = out.precision();
+        out << std::fixed << std::setprecision(2) << ": CPI " << static_cast<double>(pathLength) / n << ", ILP "
+            << static_cast<double>(n) / pathLength << "\n";
+        if (measuredCycles > 0)
+            out << "  Pipelined model: " << measuredCycles << " cycles, CPI "
+                << static_cast<double>(measuredCycles) / n << " (" << std::setprecision(1)
+                << 100.0 * (measuredCycles > pathLength ? measuredCycles - pathLength : 0) / measuredCycles
+                << "% of cycles above the dataflow limit)\n";
+        out.flags(flags);
+        out.precision(precision);
+    }
+
+    // Report: critical path per PC and per edge, plus its last instructions
+    bool writeReport(const std::string &filename, const std::map<uint64_t, std::string> &text,
+                     const std::vector<ElfSymbol> &symbols) const {
+        std::ofstream fout(filename);
+        if (!fout.is_open()) {
+            std::cerr << "ERROR: Could not open/create " << filename << "\n";
+            return false;
+        }
+        std::vector<uint64_t> path; // Node ids, last first
+        for (uint64_t id = pathEnd; id != 0; id = nodes[id - 1].pred) path.push_back(id);
+
+        std::vector<Share> perPc(pcs.size());
+        std::unordered_map<uint64_t, Share> perEdge; // (producer pc index, consumer pc index, via)
+        for (uint64_t id : path) {
+            const Node &node = nodes[id - 1];
+            perPc[node.pc].count++;
+            perPc[node.pc].cycles += node.latency;
+            perPc[node.pc].key = node.pc;
+            if (node.pred == 0) continue;
+            uint64_t key = (static_cast<uint64_t>(nodes[node.pred - 1].pc) << 36) |
+                           (static_cast<uint64_t>(node.pc) << 8) | node.via;
+            Share &e = perEdge[key];
+            e.key = key;
+            e.count++;
+            e.cycles += node.latency;
+        }
+
+        fout << "# Dataflow critical path: " << pathLength << " cycles through " << path.size() << " of "
+             << nodes.size() << " instructions\n# Latencies:";
+        for (int c = 0; c < DF_CLASSES; c++)
+            fout << " " << className(c) << "=" << (override[c] ? std::to_string(override[c]) : "model");
+        fout << "\n#\n# Instructions on the critical path\n" << std::left << std::setw(12) << "# pc" << std::right
+             << std::setw(10) << "count" << std::setw(10) << "cycles" << std::setw(8) << "share" << "  instruction\n"
+             << std::fixed << std::setprecision(1);
+        std::vector<Share> rows;
+        for (const Share &s : perPc)
+            if (s.count) rows.push_back(s);
+        sortShares(rows);
+        for (size_t i = 0; i < rows.size() && i < TOP_ROWS; i++)
+            fout << std::left << std::setw(12) << hex(pcs[rows[i].key]) << std::right << std::setw(10)
+                 << rows[i].count << std::setw(10) << rows[i].cycles << std::setw(7)
+                 << 100.0 * rows[i].cycles / pathLength << "%" << describe(pcs[rows[i].key], text, symbols) << "\n";
+
+        fout << "#\n# Critical links (producer -> consumer)\n" << std::left << std::setw(26) << "# producer -> consumer"
+             << std::setw(6) << "via" << std::right << std::setw(10) << "count" << std::setw(10) << "cycles"
+             << "  consumer\n";
+        rows.clear();
+        for (const auto &e : perEdge) rows.push_back(e.second);
+        sortShares(rows);
+        for (size_t i = 0; i < rows.size() && i < TOP_ROWS; i++) {
+            uint64_t producer = pcs[rows[i].key >> 36], consumer = pcs[(rows[i].key >> 8) & 0xFFFFFFF];
+            fout << std::left << std::setw(26) << (hex(producer) + " -> " + hex(consumer)) << std::setw(6)
+                 << viaName(static_cast<uint8_t>(rows[i].key & 0xFF)) << std::right << std::setw(10) << rows[i].count
+                 << std::setw(10) << rows[i].cycles << describe(consumer, text, symbols) << "\n";
+        }
+
+        fout << "#\n# Last " << std::min<size_t>(path.size(), TAIL_ROWS) << " instructions of the critical path\n"
+             << std::left << std::setw(12) << "# pc" << std::setw(6) << "via" << std::right << std::setw(8)
+             << "cycles" << "  instruction\n";
+        for (size_t i = std::min<size_t>(path.size(), TAIL_ROWS); i-- > 0;) {
+            const Node &node = nodes[path[i] - 1];
+            fout << std::left << std::setw(12) << hex(pcs[node.pc]) << std::setw(6) << viaName(node.via)
+                 << std::right << std::setw(8) << node.latency << describe(pcs[node.pc], text, symbols) << "\n";
+        }
+        return true;
+    }
+
+private:
+    static const size_t TOP_ROWS = 15;
+    static const size_t TAIL_ROWS = 24;
+
+    struct Node {
+        uint32_t pc;      // Index into pcs
+        uint16_t latency;
+        uint8_t via;      // Register that carried the critical input, DF_VIA_MEM or DF_VIA_NONE
+        uint64_t pred;    // Node id of the critical producer; 0 = none
+    };
+    struct StoreInfo {
+        uint64_t finish;
+        uint64_t node;
+    };
+    struct Share {
+        uint64_t key = 0;
+        uint64_t count = 0;
+        uint64_t cycles = 0;
+    };
+
+    uint32_t override[DF_CLASSES] = {};
+    uint64_t regFinish[DF_REGS] = {};
+    uint64_t regNode[DF_REGS] = {};
+    std::unordered_map<uint64_t, StoreInfo> memory; // Keyed by 8-byte word
+    std::vector<Node> nodes;
+    std::vector<uint64_t> pcs;                     // Static PCs in first-seen order
+    std::unordered_map<uint64_t, uint32_t> pcIndices;
+    uint64_t pathLength = 0;
+    uint64_t pathEnd = 0;
+
+    uint32_t pcIndex(uint64_t pc) {
+        auto it = pcIndices.find(pc);
+        if (it != pcIndices.end()) return it->second;
+        pcs.push_back(pc);
+        return pcIndices[pc] = static_cast<uint32_t>(pcs.size() - 1);
+    }
+
+    static const char *className(int c) {
+        static const char *const names[DF_CLASSES] = {"alu", "mul", "div", "load", "store", "branch",
+                                                      "fp-add", "fp-mul", "fp-div", "fp-cvt", "vector"};
+        return names[c];
+    }
+    static int classIndex(const std::string &name) {
+        for (int c = 0; c < DF_CLASSES; c++)
+            if (name == className(c)) return c;
+        return -1;
+    }
+
+    static std::string viaName(uint8_t via) {
+        if (via == DF_VIA_NONE) return "-";
+        if (via == DF_VIA_MEM) return "mem";
+        return (via >= 32 ? "f" : "x") + std::to_string(via & 31);
+    }
+
+    static std::string hex(uint64_t value) {
+        char text[24];
+        std::snprintf(text, sizeof(text), "0x%llx", static_cast<unsigned long long>(value));
+        return text;
+    }
+
+    // Assembly text and symbol of pc, after two spaces; empty if neither is known
+    static std::string describe(uint64_t pc, const std::map<uint64_t, std::string> &text,
+                                const std::vector<ElfSymbol> &symbols) {
+        auto it = text.find(pc);
+        std::string s = (it != text.end()) ? "  " + it->second : "";
+        std::string where = symbolize(symbols, pc);
+        if (!where.empty()) s += "  <" + where + ">";
+        return s;
+    }
+
+    static void sortShares(std::vector<Share> &rows) {
+        std::stable_sort(rows.begin(), rows.end(), [](const Share &a, const Share &b) {
+            return a.cycles != b.cycles ? a.cycles > b.cycles : a.key < b.key;
+        });
+    }
+};
+
+#endif // DATAFLOW_H
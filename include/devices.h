@@ -0,0 +1,327 @@
+#ifndef DEVICES_H
+#define DEVICES_H
+
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <queue>
+#include <string>
+#include <vector>
+#include "csr.h"
+#include "syscalls.h" // BufferedWriter
+
+// =====================================================================
+// Memory-mapped devices
+//   The MMIO window sits just below the data region. Loads and stores
+//   there reach the device registers instead of memory:
+//
+//   CLINT 0x0F000000  msip +0x0, mtimecmp +0x4000, mtime +0xBFF8
+//                     (mtime is the cycle counter)
+//   UART  0x0F010000  data +0x0, status +0x4, control +0x8
+//   DMA   0x0F020000  src +0x0, dst +0x4, len +0x8, control +0xC,
+//                     status +0x10
+//
+//   Devices raise mip bits (MSIP, MTIP; MEIP for UART and DMA). Timed
+//   work goes through EventScheduler, so an idle device costs nothing.
+// =====================================================================
+static const uint64_t MMIO_BASE  = 0x0F000000;
+static const uint64_t MMIO_END   = 0x10000000;
+static const uint64_t CLINT_BASE = 0x0F000000;
+static const uint64_t UART_BASE  = 0x0F010000;
+static const uint64_t DMA_BASE   = 0x0F020000;
+
+static const uint32_t UART_RX_READY = 1u << 0; // status: a byte is waiting in the RX FIFO
+static const uint32_t UART_TX_FULL  = 1u << 1; // status: TX FIFO full, stores are dropped
+static const uint32_t UART_TX_IDLE  = 1u << 2; // status: TX FIFO empty and the shifter idle
+static const uint32_t UART_RX_IRQ   = 1u << 0; // control: interrupt while RX_READY
+static const uint32_t UART_TX_IRQ   = 1u << 1; // control: interrupt while TX_IDLE
+
+static const uint32_t DMA_START = 1u << 0;     // control: start a copy
+static const uint32_t DMA_IRQ   = 1u << 1;     // control: interrupt while DONE
+static const uint32_t DMA_BUSY  = 1u << 0;     // status
+static const uint32_t DMA_DONE  = 1u << 1;     // status: any store to status clears it
+
+// =====================================================================
+// EventScheduler: actions ordered by due cycle (then by scheduling
+// order). run() is called once per cycle and only looks at the top.
+// =====================================================================
+class EventScheduler {
+public:
+    void schedule(uint64_t cycle, std::function<void()> action) {
+        events.push(Event{cycle, nextSeq++, std::move(action)});
+    }
+
+    void run(uint64_t now) {
+        while (!events.empty() && events.top().cycle <= now) {
+            std::function<void()> action = events.top().action;
+            events.pop();
+            processed++;
+            action();
+        }
+    }
+
+    size_t pending() const { return events.size(); }
+    uint64_t processed = 0;
+
+private:
+    struct Event {
+        uint64_t cycle;
+        uint64_t seq;
+        std::function<void()> action;
+    };
+    struct Later {
+        bool operator()(const Event &a, const Event &b) const {
+            return a.cycle != b.cycle ? a.cycle > b.cycle : a.seq > b.seq;
+        }
+    };
+    std::priority_queue<Event, std::vector<Event>, Later> events;
+    uint64_t nextSeq = 0;
+};
+
+// =====================================================================
+// DeviceBus: the CLINT, UART and DMA models behind the MMIO window
+// =====================================================================
+class DeviceBus {
+public:
+    // Timing knobs
+    uint32_t uartTxCycles = 100;     // Cycles to shift out one byte
+    uint32_t uartRxCycles = 200;     // Cycles between bytes arriving from --uart-in
+    uint32_t uartFifoDepth = 16;
+    uint32_t dmaBytesPerCycle = 4;
+    std::string uartInputFile;       // Bytes the UART receives; empty = none
+
+    // Physical memory for the DMA engine; false = bad address
+    std::function<bool(uint64_t, uint8_t &)> readMemory;
+    std::function<bool(uint64_t, uint8_t)> writeMemory;
+
+    // Statistics
+    uint64_t accesses = 0;
+    uint64_t uartTxBytes = 0, uartRxBytes = 0, uartOverruns = 0;
+    uint64_t dmaTransfers = 0, dmaBytes = 0, dmaErrors = 0;
+    uint64_t timerFires = 0;
+
+    static bool contains(uint64_t addr) { return addr >= MMIO_BASE && addr < MMIO_END; }
+
+    // mip receives the interrupt lines; mtime reads the cycle counter
+    bool attach(uint32_t *mipReg, const uint64_t *cycleCounter) {
+        mip = mipReg;
+        cycle = cycleCounter;
+        if (uartInputFile.empty()) return true;
+        std::FILE *in = std::fopen(uartInputFile.c_str(), "rb");
+        if (!in) {
+            std::cerr << "ERROR: Could not open UART input " << uartInputFile << "\n";
+            return false;
+        }
+        int c;
+        while ((c = std::fgetc(in)) != EOF) rxPending.push_back(static_cast<uint8_t>(c));
+        std::fclose(in);
+        if (!rxPending.empty()) scheduler.schedule(*cycle + uartRxCycles, [this] { uartReceive(); });
+        return true;
+    }
+
+    // Runs the device events due this cycle
+    void tick(uint64_t now) { scheduler.run(now); }
+
+    uint64_t load(uint64_t addr, unsigned size) {
+        accesses++;
+        uint64_t off = addr - CLINT_BASE;
+        if (off < 0x10000) {
+            if (off < 4) return slice(msip, off, size);
+            if (off >= 0x4000 && off < 0x4008) return slice(mtimecmp, off - 0x4000, size);
+            if (off >= 0xBFF8 && off < 0xC000) return slice(*cycle, off - 0xBFF8, size);
+            return 0;
+        }
+        off = addr - UART_BASE;
+        if (off < 0x100) {
+            if (off == 0) {
+                if (rxFifo.empty()) return 0;
+                uint8_t b = rxFifo.front();
+                rxFifo.pop_front();
+                updateInterrupts();
+                return b;
+            }
+            if (off == 4) return uartStatus();
+            if (off == 8) return uartControl;
+            return 0;
+        }
+        off = addr - DMA_BASE;
+        if (off < 0x100) {
+            switch (off) {
+                case 0x0: return dmaSrc;
+                case 0x4: return dmaDst;
+                case 0x8: return dmaLen;
+                case 0xC: return dmaControl;
+                case 0x10: return dmaStatus;
+                default: return 0;
+            }
+        }
+        return 0;
+    }
+
+    void store(uint64_t addr, unsigned size, uint64_t value) {
+        accesses++;
+        uint64_t off = addr - CLINT_BASE;
+        if (off < 0x10000) {
+            if (off < 4) {
+                msip = merge(msip, off, size, value) & 1;
+                setPending(MIP_MSIP, msip != 0);
+            } else if (off >= 0x4000 && off < 0x4008) {
+                mtimecmp = merge(mtimecmp, off - 0x4000, size, value);
+                armTimer();
+            } // mtime follows the cycle counter and ignores stores
+            return;
+        }
+        off = addr - UART_BASE;
+        if (off < 0x100) {
+            if (off == 0) uartTransmit(static_cast<uint8_t>(value));
+            else if (off == 8) uartControl = static_cast<uint32_t>(value) & (UART_RX_IRQ | UART_TX_IRQ);
+            updateInterrupts();
+            return;
+        }
+        off = addr - DMA_BASE;
+        if (off < 0x100) {
+            uint32_t v = static_cast<uint32_t>(value);
+            switch (off) {
+                case 0x0: dmaSrc = v; break;
+                case 0x4: dmaDst = v; break;
+                case 0x8: dmaLen = v; break;
+                case 0xC:
+                    dmaControl = v & DMA_IRQ;
+                    if ((v & DMA_START) && !(dmaStatus & DMA_BUSY)) dmaStart();
+                    break;
+                case 0x10: dmaStatus &= ~DMA_DONE; break;
+                default: break;
+            }
+            updateInterrupts();
+        }
+    }
+
+    void flush() { uartOut.flush(); }
+
+    void printStatistics() const {
+        if (accesses == 0 && scheduler.processed == 0) return;
+        std::cout << "Devices: " << std::dec << accesses << " MMIO accesses, " << scheduler.processed
+                  << " events; UART tx " << uartTxBytes << " bytes, rx " << uartRxBytes << " bytes ("
+                  << uartOverruns << " overruns); DMA " << dmaTransfers << " transfers, " << dmaBytes
+                  << " bytes (" << dmaErrors << " errors); timer fired " << timerFires << " times\n";
+    }
+
+private:
+    EventScheduler scheduler;
+    uint32_t *mip = nullptr;
+    const uint64_t *cycle = nullptr;
+
+    // CLINT
+    uint64_t msip = 0;
+    uint64_t mtimecmp = UINT64_MAX;
+    uint64_t timerGeneration = 0; // Invalidates timer events after mtimecmp changes
+
+    // UART
+    std::deque<uint8_t> txFifo, rxFifo;
+    std::deque<uint8_t> rxPending; // Input not yet arrived
+    bool txBusy = false;
+    uint32_t uartControl = 0;
+    BufferedWriter uartOut{stdout};
+
+    // DMA
+    uint32_t dmaSrc = 0, dmaDst = 0, dmaLen = 0, dmaControl = 0, dmaStatus = 0;
+
+    // size bytes of value starting at byte offset off
+    static uint64_t slice(uint64_t value, uint64_t off, unsigned size) {
+        value >>= 8 * off;
+        return size >= 8 ? value : value & ((1ULL << (8 * size)) - 1);
+    }
+    static uint64_t merge(uint64_t old, uint64_t off, unsigned size, uint64_t value) {
+        uint64_t mask = (size >= 8) ? ~0ULL : ((1ULL << (8 * size)) - 1);
+        return (old & ~(mask << (8 * off))) | ((value & mask) << (8 * off));
+    }
+
+    void setPending(uint32_t bit, bool on) {
+        if (on) *mip |= bit;
+        else *mip &= ~bit;
+    }
+
+    uint32_t uartStatus() const {
+        return (rxFifo.empty() ? 0 : UART_RX_READY) | (txFifo.size() >= uartFifoDepth ? UART_TX_FULL : 0) |
+               (txFifo.empty() && !txBusy ? UART_TX_IDLE : 0);
+    }
+
+    void updateInterrupts() {
+        uint32_t status = uartStatus();
+        bool uart = ((uartControl & UART_RX_IRQ) && (status & UART_RX_READY)) ||
+                    ((uartControl & UART_TX_IRQ) && (status & UART_TX_IDLE));
+        bool dma = (dmaControl & DMA_IRQ) && (dmaStatus & DMA_DONE);
+        setPending(MIP_MEIP, uart || dma);
+    }
+
+    // MTIP follows mtime >= mtimecmp; a future compare value is one event
+    void armTimer() {
+        uint64_t generation = ++timerGeneration;
+        setPending(MIP_MTIP, *cycle >= mtimecmp);
+        if (*cycle < mtimecmp && mtimecmp != UINT64_MAX) {
+            scheduler.schedule(mtimecmp, [this, generation] {
+                if (generation != timerGeneration) return; // mtimecmp was rewritten
+                timerFires++;
+                setPending(MIP_MTIP, true);
+            });
+        }
+    }
+
+    void uartTransmit(uint8_t b) {
+        if (txFifo.size() >= uartFifoDepth) {
+            uartOverruns++;
+            return;
+        }
+        txFifo.push_back(b);
+        if (!txBusy) {
+            txBusy = true;
+            scheduler.schedule(*cycle + uartTxCycles, [this] { uartShiftOut(); });
+        }
+    }
+
+    void uartShiftOut() {
+        char c = static_cast<char>(txFifo.front());
+        txFifo.pop_front();
+        uartOut.write(&c, 1);
+        uartTxBytes++;
+        if (txFifo.empty()) txBusy = false;
+        else scheduler.schedule(*cycle + uartTxCycles, [this] { uartShiftOut(); });
+        updateInterrupts();
+    }
+
+    void uartReceive() {
+        if (rxFifo.size() >= uartFifoDepth) uartOverruns++;
+        else {
+            rxFifo.push_back(rxPending.front());
+            uartRxBytes++;
+        }
+        rxPending.pop_front();
+        if (!rxPending.empty()) scheduler.schedule(*cycle + uartRxCycles, [this] { uartReceive(); });
+        updateInterrupts();
+    }
+
+    // The copy lands when the transfer time has passed
+    void dmaStart() {
+        dmaStatus = DMA_BUSY;
+        uint32_t bytesPerCycle = dmaBytesPerCycle ? dmaBytesPerCycle : 1;
+        uint64_t duration = (dmaLen + bytesPerCycle - 1) / bytesPerCycle;
+        uint32_t src = dmaSrc, dst = dmaDst, len = dmaLen;
+        scheduler.schedule(*cycle + (duration ? duration : 1), [this, src, dst, len] {
+            for (uint32_t i = 0; i < len; i++) {
+                uint8_t b = 0;
+                if (!readMemory(src + i, b) || !writeMemory(dst + i, b)) {
+                    dmaErrors++;
+                    break;
+                }
+                dmaBytes++;
+            }
+            dmaTransfers++;
+            dmaStatus = DMA_DONE;
+            updateInterrupts();
+        });
+    }
+};
+
+#endif // DEVICES_H
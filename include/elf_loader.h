@@ -0,0 +1,242 @@
+#ifndef ELF_LOADER_H
+#define ELF_LOADER_H
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <iostream>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// =====================================================================
+// ELF executable reader
+//   - ELF32 for the RV32 build, ELF64 for the RV64 build (little endian,
+//     EM_RISCV, ET_EXEC)
+//   - The file is mapped read-only; segments point into the mapping
+//   - Only the fields the simulators use are decoded, so no <elf.h>
+// =====================================================================
+static const uint16_t ELF_EM_RISCV = 243;
+static const uint16_t ELF_ET_EXEC  = 2;
+static const uint32_t ELF_PT_LOAD  = 1;
+static const uint32_t ELF_SHT_SYMTAB = 2;
+static const uint32_t ELF_PF_X = 1;
+static const uint32_t ELF_PF_W = 2;
+
+struct ElfSegment {
+    uint64_t vaddr;
+    const uint8_t *data; // fileSize bytes; the rest up to memSize is zero (.bss)
+    uint64_t fileSize;
+    uint64_t memSize;
+    uint32_t flags;      // ELF_PF_*
+};
+
+struct ElfSymbol {
+    uint64_t addr;
+    uint64_t size;       // 0 for plain assembler labels
+    std::string name;
+    bool function;
+};
+
+// True if the file starts with the ELF magic
+inline bool isElfFile(const std::string &filename) {
+    std::FILE *fin = std::fopen(filename.c_str(), "rb");
+    if (!fin) return false;
+    unsigned char magic[4] = {0, 0, 0, 0};
+    size_t n = std::fread(magic, 1, 4, fin);
+    std::fclose(fin);
+    return n == 4 && magic[0] == 0x7F && magic[1] == 'E' && magic[2] == 'L' && magic[3] == 'F';
+}
+
+class ElfFile {
+public:
+    ~ElfFile() { close(); }
+
+    // xlen selects the accepted class (32 or 64)
+    bool open(const std::string &filename, int xlen) {
+        if (!map(filename)) return false;
+        const uint8_t ELF_MAGIC[4] = {0x7F, 'E', 'L', 'F'};
+        if (mappedSize < 52 || std::memcmp(base, ELF_MAGIC, 4) != 0) return fail(filename, "is not an ELF file");
+        is64 = (base[4] == 2);
+        if (base[4] != (xlen == 64 ? 2 : 1))
+            return fail(filename, xlen == 64 ? "is not ELF64 (RV64 build)" : "is not ELF32 (RV32 build)");
+        if (is64 && mappedSize < 64) return fail(filename, "has a truncated header");
+        if (base[5] != 1) return fail(filename, "is not little endian");
+        if (u16(18) != ELF_EM_RISCV) return fail(filename, "is not a RISC-V executable");
+        if (u16(16) != ELF_ET_EXEC) return fail(filename, "is not a static executable (ET_EXEC)");
+
+        entryAddr = word(24);
+        uint64_t phoff = word(is64 ? 32 : 28);
+        uint64_t shoff = word(is64 ? 40 : 32);
+        uint16_t phentsize = u16(is64 ? 54 : 42), phnum = u16(is64 ? 56 : 44);
+        uint16_t shentsize = u16(is64 ? 58 : 46), shnum = u16(is64 ? 60 : 48);
+
+        for (uint16_t i = 0; i < phnum; i++) {
+            uint64_t ph = phoff + static_cast<uint64_t>(i) * phentsize;
+            if (!inFile(ph, is64 ? 56 : 32)) return fail(filename, "has a truncated program header");
+            if (u32(ph) != ELF_PT_LOAD) continue;
+            ElfSegment seg;
+            uint64_t offset = word(ph + (is64 ? 8 : 4));
+            seg.vaddr    = word(ph + (is64 ? 16 : 8));
+            seg.fileSize = word(ph + (is64 ? 32 : 16));
+            seg.memSize  = word(ph + (is64 ? 40 : 20));
+            seg.flags    = u32(ph + (is64 ? 4 : 24));
+            if (!inFile(offset, seg.fileSize) || seg.fileSize > seg.memSize)
+                return fail(filename, "has a segment outside the file");
+            seg.data = base + offset;
+            loadSegments.push_back(seg);
+        }
+
+        // Symbols are optional (stripped binaries have none)
+        for (uint16_t i = 0; i < shnum; i++) {
+            uint64_t sh = shoff + static_cast<uint64_t>(i) * shentsize;
+            if (!inFile(sh, is64 ? 64 : 40) || u32(sh + 4) != ELF_SHT_SYMTAB) continue;
+            uint64_t symOff = word(sh + (is64 ? 24 : 16));
+            uint64_t symSize = word(sh + (is64 ? 32 : 20));
+            uint64_t entSize = word(sh + (is64 ? 56 : 36));
+            uint32_t link = u32(sh + (is64 ? 40 : 24));
+            uint64_t str = shoff + static_cast<uint64_t>(link) * shentsize;
+            // Each entry must hold a whole symbol record (Elf64_Sym / Elf32_Sym)
+            if (link >= shnum || !inFile(str, is64 ? 64 : 40) || entSize < (is64 ? 24u : 16u)) continue;
+            uint64_t strOff = word(str + (is64 ? 24 : 16));
+            uint64_t strSize = word(str + (is64 ? 32 : 20));
+            if (!inFile(symOff, symSize) || !inFile(strOff, strSize)) continue;
+            readSymbols(symOff, symSize / entSize, entSize, strOff, strSize);
+        }
+        std::sort(symbolTable.begin(), symbolTable.end(),
+                  [](const ElfSymbol &a, const ElfSymbol &b) { return a.addr < b.addr; });
+        return true;
+    }
+
+    uint64_t entry() const { return entryAddr; }
+    const std::vector<ElfSegment> &segments() const { return loadSegments; }
+    const std::vector<ElfSymbol> &symbols() const { return symbolTable; } // Sorted by address
+
+    void close() {
+#ifndef _WIN32
+        if (base) munmap(const_cast<uint8_t *>(base), mappedSize);
+#else
+        owned.clear();
+#endif
+        base = nullptr;
+        mappedSize = 0;
+        loadSegments.clear();
+    }
+
+private:
+    const uint8_t *base = nullptr;
+    size_t mappedSize = 0;
+    bool is64 = false;
+    uint64_t entryAddr = 0;
+    std::vector<ElfSegment> loadSegments;
+    std::vector<ElfSymbol> symbolTable;
+#ifdef _WIN32
+    std::vector<uint8_t> owned;
+#endif
+
+    bool map(const std::string &filename) {
+#ifndef _WIN32
+        int fd = ::open(filename.c_str(), O_RDONLY);
+        if (fd < 0) {
+            std::cerr << "ERROR: Could not open " << filename << "\n";
+            return false;
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size == 0) {
+            std::cerr << "ERROR: " << filename << " is empty\n";
+            ::close(fd);
+            return false;
+        }
+        mappedSize = static_cast<size_t>(st.st_size);
+        void *p = mmap(nullptr, mappedSize, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (p == MAP_FAILED) {
+            std::cerr << "ERROR: Could not map " << filename << "\n";
+            mappedSize = 0;
+            return false;
+        }
+        base = static_cast<const uint8_t *>(p);
+#else
+        // No mmap: fall back to reading the whole file
+        std::FILE *fin = std::fopen(filename.c_str(), "rb");
+        if (!fin) {
+            std::cerr << "ERROR: Could not open " << filename << "\n";
+            return false;
+        }
+        std::fseek(fin, 0, SEEK_END);
+        owned.resize(static_cast<size_t>(std::ftell(fin)));
+        std::fseek(fin, 0, SEEK_SET);
+        if (std::fread(owned.data(), 1, owned.size(), fin) != owned.size()) owned.clear();
+        std::fclose(fin);
+        mappedSize = owned.size();
+        base = owned.data();
+#endif
+        return true;
+    }
+
+    bool fail(const std::string &filename, const char *why) {
+        std::cerr << "ERROR: " << filename << " " << why << "\n";
+        close();
+        return false;
+    }
+
+    bool inFile(uint64_t offset, uint64_t size) const {
+        return offset <= mappedSize && size <= mappedSize - offset;
+    }
+
+    // Little-endian field readers; callers check the bounds
+    uint16_t u16(uint64_t off) const { return static_cast<uint16_t>(base[off] | (base[off + 1] << 8)); }
+    uint32_t u32(uint64_t off) const { return u16(off) | (static_cast<uint32_t>(u16(off + 2)) << 16); }
+    uint64_t u64(uint64_t off) const { return u32(off) | (static_cast<uint64_t>(u32(off + 4)) << 32); }
+    uint64_t word(uint64_t off) const { return is64 ? u64(off) : u32(off); } // Address-sized field
+
+    // Keeps defined functions, objects and labels; drops section and file symbols
+    void readSymbols(uint64_t symOff, uint64_t count, uint64_t entSize, uint64_t strOff, uint64_t strSize) {
+        for (uint64_t i = 1; i < count; i++) { // Entry 0 is reserved
+            uint64_t sym = symOff + i * entSize;
+            uint32_t nameOff = u32(sym);
+            uint8_t info   = base[sym + (is64 ? 4 : 12)];
+            uint16_t shndx = u16(sym + (is64 ? 6 : 14));
+            uint8_t type   = info & 0xF;
+            if (shndx == 0 || type > 2 || nameOff == 0 || nameOff >= strSize) continue;
+            const char *name = reinterpret_cast<const char *>(base + strOff + nameOff);
+            size_t len = strnlen(name, static_cast<size_t>(strSize - nameOff));
+            ElfSymbol s;
+            s.addr = word(sym + (is64 ? 8 : 4));
+            s.size = is64 ? u64(sym + 16) : u32(sym + 8);
+            s.name.assign(name, len);
+            s.function = (type == 2);
+            symbolTable.push_back(s);
+        }
+    }
+};
+
+// Symbol covering addr: the closest one at or below it, if addr is
+// inside its size (labels without a size cover up to the next symbol)
+inline const ElfSymbol *findSymbol(const std::vector<ElfSymbol> &symbols, uint64_t addr) {
+    auto it = std::upper_bound(symbols.begin(), symbols.end(), addr,
+                               [](uint64_t a, const ElfSymbol &s) { return a < s.addr; });
+    if (it == symbols.begin()) return nullptr;
+    --it;
+    if (it->size != 0 && addr - it->addr >= it->size) return nullptr;
+    return &*it;
+}
+
+// "name+0xoff" for reports, or an empty string without symbols
+inline std::string symbolize(const std::vector<ElfSymbol> &symbols, uint64_t addr) {
+    const ElfSymbol *s = findSymbol(symbols, addr);
+    if (!s) return "";
+    if (addr == s->addr) return s->name;
+    char off[24];
+    std::snprintf(off, sizeof(off), "+0x%llx", static_cast<unsigned long long>(addr - s->addr));
+    return s->name + off;
+}
+
+#endif // ELF_LOADER_H
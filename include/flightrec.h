@@ -0,0 +1,210 @@
+#ifndef FLIGHTREC_H
+#define FLIGHTREC_H
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <csignal>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// =====================================================================
+// Flight recorder: always-on ring of the last N retired instructions
+// and pipeline events
+//   - Recording is a handful of stores into a preallocated ring
+//   - dump() writes the ring as text, oldest first. It formats into a
+//     stack buffer and uses write(2) only, so it is safe to call from
+//     the SIGINT/SIGSEGV handler that installSignalHandlers() sets up.
+//   - Dumped on halt, on fetch and memory-access errors, and on signals
+// =====================================================================
+enum FlightKind : uint8_t {
+    FLIGHT_RETIRE,      // value: rd result, addr: load/store address
+    FLIGHT_TRAP,        // value: mcause, addr: mtval
+    FLIGHT_INTERRUPT,   // value: mcause
+    FLIGHT_MISPREDICT,  // addr: corrected PC
+    FLIGHT_JUMP_FLUSH,  // addr: jump target
+    FLIGHT_FENCE_I,
+    FLIGHT_SYSCALL,     // value: a7
+    FLIGHT_MEM_FAULT,   // addr: address outside every segment
+    FLIGHT_FETCH_FAULT, // No instruction at pc
+    FLIGHT_KINDS
+};
+
+static const uint8_t FLIGHT_NO_RD = 0xFF;
+
+struct FlightRecord {
+    uint64_t cycle;
+    uint64_t pc;
+    uint64_t value;
+    uint64_t addr;
+    uint32_t ir;
+    uint8_t kind;
+    uint8_t rd;         // 0-31 x registers, 32-63 f registers, FLIGHT_NO_RD
+};
+
+class FlightRecorder {
+public:
+    // entries is rounded up to a power of two; 0 turns recording off
+    void configure(uint32_t entries, const std::string &file) {
+        uint32_t size = 1;
+        while (size < entries) size <<= 1;
+        ring.assign(entries ? size : 0, FlightRecord());
+        mask = entries ? size - 1 : 0;
+        head = 0;
+        setFile(file);
+    }
+
+    // An empty name keeps recording but never dumps
+    void setFile(const std::string &file) {
+        std::snprintf(path, sizeof(path), "%s", file.c_str());
+    }
+
+    bool enabled() const { return !ring.empty(); }
+
+    void retire(uint64_t cycle, uint64_t pc, uint32_t ir, uint8_t rd, uint64_t value, uint64_t addr) {
+        if (ring.empty()) return;
+        FlightRecord &r = ring[head++ & mask];
+        r.cycle = cycle;
+        r.pc = pc;
+        r.value = value;
+        r.addr = addr;
+        r.ir = ir;
+        r.kind = FLIGHT_RETIRE;
+        r.rd = rd;
+    }
+
+    void event(uint64_t cycle, FlightKind kind, uint64_t pc, uint64_t value = 0, uint64_t addr = 0) {
+        if (ring.empty()) return;
+        FlightRecord &r = ring[head++ & mask];
+        r.cycle = cycle;
+        r.pc = pc;
+        r.value = value;
+        r.addr = addr;
+        r.ir = 0;
+        r.kind = kind;
+        r.rd = FLIGHT_NO_RD;
+    }
+
+    // Writes the ring to the dump file; reason ends up in the header line
+    void dump(const char *reason, uint64_t cycle) const {
+        if (ring.empty() || path[0] == '\0') return;
+        Sink out;
+        if (!out.open(path)) return;
+        uint64_t count = head < ring.size() ? head : ring.size();
+        Line l;
+        l.str("# Flight recorder: last ").dec(count).str(" of ").dec(head).str(" records, dumped on ").str(reason)
+         .str(" at cycle ").dec(cycle).str("\n#    cycle  event       pc          detail\n");
+        out.write(l);
+        for (uint64_t i = head - count; i < head; i++) {
+            const FlightRecord &r = ring[i & mask];
+            l.clear();
+            l.pad(r.cycle, 10).str("  ").str(kindName(r.kind)).hex(r.pc).str("  ");
+            if (r.kind == FLIGHT_RETIRE) {
+                l.hex(r.ir);
+                if (r.rd != FLIGHT_NO_RD) l.str("  ").str(r.rd >= 32 ? "f" : "x").dec(r.rd & 31).str("=").hex(r.value);
+                if (r.addr) l.str("  mem=").hex(r.addr);
+            } else if (r.kind == FLIGHT_TRAP) {
+                l.str("cause=").dec(r.value).str(" tval=").hex(r.addr);
+            } else if (r.kind == FLIGHT_INTERRUPT) {
+                l.str("cause=").hex(r.value);
+            } else if (r.kind == FLIGHT_SYSCALL) {
+                l.str("a7=").dec(r.value);
+            } else if (r.kind == FLIGHT_MEM_FAULT) {
+                l.str("addr=").hex(r.addr);
+            } else if (r.kind == FLIGHT_MISPREDICT || r.kind == FLIGHT_JUMP_FLUSH) {
+                l.str("to=").hex(r.addr);
+            }
+            l.str("\n");
+            out.write(l);
+        }
+    }
+
+    // Dumps the active recorder on SIGINT/SIGSEGV, then dies of the signal
+    void installSignalHandlers(const uint64_t *cycleCounter) {
+        active() = this;
+        activeCycle() = cycleCounter;
+        std::signal(SIGINT, onSignal);
+        std::signal(SIGSEGV, onSignal);
+    }
+
+private:
+    std::vector<FlightRecord> ring;
+    uint64_t mask = 0;
+    uint64_t head = 0;  // Records written so far; the next goes to head & mask
+    char path[4096] = "";
+
+    static const char *kindName(uint8_t kind) {
+        static const char *const names[FLIGHT_KINDS] = {"retire      ", "trap        ", "interrupt   ",
+                                                        "mispredict  ", "jump-flush  ", "fence.i     ",
+                                                        "syscall     ", "mem-fault   ", "fetch-fault "};
+        return kind < FLIGHT_KINDS ? names[kind] : "?           ";
+    }
+
+    static FlightRecorder *&active() {
+        static FlightRecorder *recorder = nullptr;
+        return recorder;
+    }
+    static const uint64_t *&activeCycle() {
+        static const uint64_t *cycle = nullptr;
+        return cycle;
+    }
+
+    static void onSignal(int sig) {
+        if (FlightRecorder *r = active())
+            r->dump(sig == SIGINT ? "SIGINT" : "SIGSEGV", activeCycle() ? *activeCycle() : 0);
+        std::signal(sig, SIG_DFL);
+        std::raise(sig);
+    }
+
+    // Fixed-size line builder: no allocation, so usable in a signal handler
+    struct Line {
+        char buf[256];
+        size_t len = 0;
+        void clear() { len = 0; }
+        Line &str(const char *s) {
+            while (*s && len < sizeof(buf)) buf[len++] = *s++;
+            return *this;
+        }
+        Line &dec(uint64_t v) { return pad(v, 0); }
+        Line &pad(uint64_t v, int width) {
+            char digits[24];
+            int n = 0;
+            do {
+                digits[n++] = static_cast<char>('0' + v % 10);
+                v /= 10;
+            } while (v);
+            for (int i = n; i < width && len < sizeof(buf); i++) buf[len++] = ' ';
+            while (n > 0 && len < sizeof(buf)) buf[len++] = digits[--n];
+            return *this;
+        }
+        Line &hex(uint64_t v) {
+            static const char HEX[] = "0123456789abcdef";
+            int digits = (v >> 32) ? 16 : 8;
+            str("0x");
+            for (int i = digits - 1; i >= 0 && len < sizeof(buf); i--) buf[len++] = HEX[(v >> (4 * i)) & 0xF];
+            return *this;
+        }
+    };
+
+    // Unbuffered output: write(2) where available
+    struct Sink {
+#ifndef _WIN32
+        int fd = -1;
+        bool open(const char *file) { return (fd = ::open(file, O_WRONLY | O_CREAT | O_TRUNC, 0644)) >= 0; }
+        void write(const Line &l) { ssize_t n = ::write(fd, l.buf, l.len); (void)n; }
+        ~Sink() { if (fd >= 0) ::close(fd); }
+#else
+        std::FILE *f = nullptr;
+        bool open(const char *file) { return (f = std::fopen(file, "wb")) != nullptr; }
+        void write(const Line &l) { std::fwrite(l.buf, 1, l.len, f); }
+        ~Sink() { if (f) std::fclose(f); }
+#endif
+    };
+};
+
+#endif // FLIGHTREC_H
@@ -0,0 +1,288 @@
+#ifndef FPU_H
+#define FPU_H
+
+#include <cfenv>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include "opcodes.h"
+
+// =====================================================================
+// F/D extension execution shared by both simulators. FP registers are
+// 64 bits wide; single-precision values are NaN-boxed (upper 32 bits
+// all ones). Arithmetic runs on the host FPU under the instruction's
+// rounding mode and the host exception flags are accrued into fflags.
+// =====================================================================
+enum FPRoundingMode : uint32_t {
+    RM_RNE = 0, // Nearest, ties to even
+    RM_RTZ = 1, // Towards zero
+    RM_RDN = 2, // Down
+    RM_RUP = 3, // Up
+    RM_RMM = 4, // Nearest, ties to max magnitude
+    RM_DYN = 7  // Use frm
+};
+
+enum FPFlag : uint32_t {
+    FFLAG_NX = 1 << 0, // Inexact
+    FFLAG_UF = 1 << 1, // Underflow
+    FFLAG_OF = 1 << 2, // Overflow
+    FFLAG_DZ = 1 << 3, // Divide by zero
+    FFLAG_NV = 1 << 4  // Invalid operation
+};
+
+// Execution unit of an FP instruction; selects its EX latency
+enum FPUnit { FPU_NONE, FPU_ADD, FPU_MUL, FPU_FMA, FPU_DIV, FPU_SQRT, FPU_CVT, FPU_MISC };
+
+static const uint64_t FP_BOX_MASK = 0xFFFFFFFF00000000ull;
+static const uint32_t FP_CANONICAL_NAN_S = 0x7FC00000u;
+static const uint64_t FP_CANONICAL_NAN_D = 0x7FF8000000000000ull;
+
+inline bool isFPOpcode(uint32_t opcode) {
+    return opcode == 0x07 || opcode == 0x27 || opcode == 0x43 || opcode == 0x47 ||
+           opcode == 0x4B || opcode == 0x4F || opcode == 0x53;
+}
+
+// Only meaningful for F/D instructions (see isFPOpcode)
+inline FPUnit fpUnitFor(InstrId id) {
+    switch (id) {
+        case INSTR_FADD_S: case INSTR_FSUB_S: case INSTR_FADD_D: case INSTR_FSUB_D:
+            return FPU_ADD;
+        case INSTR_FMUL_S: case INSTR_FMUL_D:
+            return FPU_MUL;
+        case INSTR_FMADD_S: case INSTR_FMSUB_S: case INSTR_FNMSUB_S: case INSTR_FNMADD_S:
+        case INSTR_FMADD_D: case INSTR_FMSUB_D: case INSTR_FNMSUB_D: case INSTR_FNMADD_D:
+            return FPU_FMA;
+        case INSTR_FDIV_S: case INSTR_FDIV_D:
+            return FPU_DIV;
+        case INSTR_FSQRT_S: case INSTR_FSQRT_D:
+            return FPU_SQRT;
+        case INSTR_FCVT_W_S: case INSTR_FCVT_WU_S: case INSTR_FCVT_S_W: case INSTR_FCVT_S_WU:
+        case INSTR_FCVT_W_D: case INSTR_FCVT_WU_D: case INSTR_FCVT_D_W: case INSTR_FCVT_D_WU:
+        case INSTR_FCVT_S_D: case INSTR_FCVT_D_S:
+        case INSTR_FCVT_L_S: case INSTR_FCVT_LU_S: case INSTR_FCVT_S_L: case INSTR_FCVT_S_LU:
+        case INSTR_FCVT_L_D: case INSTR_FCVT_LU_D: case INSTR_FCVT_D_L: case INSTR_FCVT_D_LU:
+            return FPU_CVT;
+        case INSTR_FLW: case INSTR_FSW: case INSTR_FLD: case INSTR_FSD: case INSTR_INVALID:
+            return FPU_NONE; // Memory instructions use the load/store path
+        default:
+            return FPU_MISC; // Sign injection, min/max, compare, move, class
+    }
+}
+
+// NaN-boxing: an improperly boxed single reads as the canonical NaN
+inline uint64_t boxSingle(uint32_t bits) { return FP_BOX_MASK | bits; }
+inline uint32_t unboxSingle(uint64_t reg) {
+    return ((reg & FP_BOX_MASK) == FP_BOX_MASK) ? static_cast<uint32_t>(reg) : FP_CANONICAL_NAN_S;
+}
+
+inline float bitsToFloat(uint32_t bits) { float f; std::memcpy(&f, &bits, 4); return f; }
+inline uint32_t floatToBits(float f) { uint32_t b; std::memcpy(&b, &f, 4); return b; }
+inline double bitsToDouble(uint64_t bits) { double d; std::memcpy(&d, &bits, 8); return d; }
+inline uint64_t doubleToBits(double d) { uint64_t b; std::memcpy(&b, &d, 8); return b; }
+
+// Arithmetic results: NaNs are replaced by the canonical NaN
+inline uint64_t fromSingle(float f) { return boxSingle(std::isnan(f) ? FP_CANONICAL_NAN_S : floatToBits(f)); }
+inline uint64_t fromDouble(double d) { return std::isnan(d) ? FP_CANONICAL_NAN_D : doubleToBits(d); }
+
+inline bool isSignalingNaN(float f) {
+    return std::isnan(f) && !(floatToBits(f) & 0x00400000u);
+}
+inline bool isSignalingNaN(double d) {
+    return std::isnan(d) && !(doubleToBits(d) & 0x0008000000000000ull);
+}
+
+// Round-trips a value through memory so the compiler cannot move the
+// surrounding arithmetic across the fesetround/fetestexcept calls
+template <typename T>
+inline T fpBarrier(T value) {
+    volatile T v = value;
+    return v;
+}
+
+inline int hostRoundingMode(uint32_t rm) {
+    switch (rm) {
+        case RM_RTZ: return FE_TOWARDZERO;
+        case RM_RDN: return FE_DOWNWARD;
+        case RM_RUP: return FE_UPWARD;
+        default:     return FE_TONEAREST; // RNE; RMM has no host mode and only differs on exact ties
+    }
+}
+
+inline uint32_t hostFlagsToFFlags(int host) {
+    uint32_t flags = 0;
+    if (host & FE_INEXACT)   flags |= FFLAG_NX;
+    if (host & FE_UNDERFLOW) flags |= FFLAG_UF;
+    if (host & FE_OVERFLOW)  flags |= FFLAG_OF;
+    if (host & FE_DIVBYZERO) flags |= FFLAG_DZ;
+    if (host & FE_INVALID)   flags |= FFLAG_NV;
+    return flags;
+}
+
+// fmin/fmax: a single NaN operand yields the other one, -0 < +0
+template <typename T>
+inline T fpMinMax(T x, T y, bool isMax, uint32_t &flags) {
+    if (isSignalingNaN(x) || isSignalingNaN(y)) flags |= FFLAG_NV;
+    if (std::isnan(x) && std::isnan(y)) return std::numeric_limits<T>::quiet_NaN();
+    if (std::isnan(x)) return y;
+    if (std::isnan(y)) return x;
+    if (x == y) return (std::signbit(x) != isMax) ? x : y;
+    return ((x > y) == isMax) ? x : y;
+}
+
+// feq is a quiet comparison; flt/fle signal on any NaN
+template <typename T>
+inline uint64_t fpCompare(InstrId id, T x, T y, bool quiet, uint32_t &flags) {
+    if (std::isnan(x) || std::isnan(y)) {
+        if (!quiet || isSignalingNaN(x) || isSignalingNaN(y)) flags |= FFLAG_NV;
+        return 0;
+    }
+    switch (id) {
+        case INSTR_FEQ_S: case INSTR_FEQ_D: return x == y;
+        case INSTR_FLT_S: case INSTR_FLT_D: return x < y;
+        default:                            return x <= y;
+    }
+}
+
+// fclass: one-hot category mask
+template <typename T>
+inline uint64_t fpClassify(T x) {
+    bool neg = std::signbit(x);
+    switch (std::fpclassify(x)) {
+        case FP_INFINITE:  return neg ? 1u << 0 : 1u << 7;
+        case FP_NORMAL:    return neg ? 1u << 1 : 1u << 6;
+        case FP_SUBNORMAL: return neg ? 1u << 2 : 1u << 5;
+        case FP_ZERO:      return neg ? 1u << 3 : 1u << 4;
+        default:           return isSignalingNaN(x) ? 1u << 8 : 1u << 9;
+    }
+}
+
+// Float to integer conversion with the RISC-V saturating results: NaN
+// and too-large values give the maximum, too-small values the minimum,
+// and both raise only NV. The result is sign-extended to 64 bits.
+template <typename T>
+inline uint64_t fpToInt(T x, bool isUnsigned, int bits, uint32_t &flags) {
+    T r = fpBarrier(std::nearbyint(fpBarrier(x)));
+    T limit = std::ldexp(static_cast<T>(1), isUnsigned ? bits : bits - 1);
+    bool tooLarge = std::isnan(x) || r >= limit;
+    bool tooSmall = isUnsigned ? (r < 0) : (r < -limit);
+    if (tooLarge || tooSmall) {
+        flags |= FFLAG_NV;
+        uint64_t maxVal = isUnsigned ? (bits == 64 ? ~0ull : (1ull << bits) - 1) : (1ull << (bits - 1)) - 1;
+        uint64_t minVal = isUnsigned ? 0 : ~maxVal;
+        uint64_t v = tooLarge ? maxVal : minVal;
+        return (bits == 32) ? static_cast<uint64_t>(static_cast<int64_t>(static_cast<int32_t>(v))) : v;
+    }
+    if (r != x) flags |= FFLAG_NX;
+    uint64_t v = isUnsigned ? static_cast<uint64_t>(r) : static_cast<uint64_t>(static_cast<int64_t>(r));
+    return (bits == 32) ? static_cast<uint64_t>(static_cast<int64_t>(static_cast<int32_t>(v))) : v;
+}
+
+// =====================================================================
+// executeFP: one F/D computational instruction (not loads/stores).
+//   rmField  funct3 of an INSTR_FLAG_RM instruction (7 = use frm)
+//   a, b, c  rs1/rs2/rs3: raw FP register contents, or the integer
+//            register value for integer sources
+//   result   raw FP register contents, or the integer result
+//            sign-extended to 64 bits
+// Returns false for an invalid rounding mode (illegal instruction).
+// =====================================================================
+inline bool executeFP(InstrId id, uint32_t rmField, uint32_t frm,
+                      uint64_t a, uint64_t b, uint64_t c, uint64_t &result, uint32_t &fflags) {
+    uint32_t rm = (rmField == RM_DYN) ? frm : rmField;
+    if (rm > RM_RMM) return false;
+
+    const float sa = bitsToFloat(unboxSingle(a)), sb = bitsToFloat(unboxSingle(b)), sc = bitsToFloat(unboxSingle(c));
+    const double da = bitsToDouble(a), db = bitsToDouble(b), dc = bitsToDouble(c);
+    const int64_t ia = static_cast<int64_t>(a);
+    uint32_t flags = 0;
+    bool hostFlags = true; // Take NX/UF/OF/DZ/NV from the host FPU
+
+    const int savedRounding = std::fegetround();
+    std::fesetround(hostRoundingMode(rm));
+    std::feclearexcept(FE_ALL_EXCEPT);
+
+    switch (id) {
+        case INSTR_FADD_S:   result = fromSingle(fpBarrier(fpBarrier(sa) + sb)); break;
+        case INSTR_FSUB_S:   result = fromSingle(fpBarrier(fpBarrier(sa) - sb)); break;
+        case INSTR_FMUL_S:   result = fromSingle(fpBarrier(fpBarrier(sa) * sb)); break;
+        case INSTR_FDIV_S:   result = fromSingle(fpBarrier(fpBarrier(sa) / sb)); break;
+        case INSTR_FSQRT_S:  result = fromSingle(fpBarrier(std::sqrt(fpBarrier(sa)))); break;
+        case INSTR_FMADD_S:  result = fromSingle(fpBarrier(std::fma(fpBarrier(sa), sb, sc))); break;
+        case INSTR_FMSUB_S:  result = fromSingle(fpBarrier(std::fma(fpBarrier(sa), sb, -sc))); break;
+        case INSTR_FNMSUB_S: result = fromSingle(fpBarrier(std::fma(-fpBarrier(sa), sb, sc))); break;
+        case INSTR_FNMADD_S: result = fromSingle(fpBarrier(std::fma(-fpBarrier(sa), sb, -sc))); break;
+        case INSTR_FADD_D:   result = fromDouble(fpBarrier(fpBarrier(da) + db)); break;
+        case INSTR_FSUB_D:   result = fromDouble(fpBarrier(fpBarrier(da) - db)); break;
+        case INSTR_FMUL_D:   result = fromDouble(fpBarrier(fpBarrier(da) * db)); break;
+        case INSTR_FDIV_D:   result = fromDouble(fpBarrier(fpBarrier(da) / db)); break;
+        case INSTR_FSQRT_D:  result = fromDouble(fpBarrier(std::sqrt(fpBarrier(da)))); break;
+        case INSTR_FMADD_D:  result = fromDouble(fpBarrier(std::fma(fpBarrier(da), db, dc))); break;
+        case INSTR_FMSUB_D:  result = fromDouble(fpBarrier(std::fma(fpBarrier(da), db, -dc))); break;
+        case INSTR_FNMSUB_D: result = fromDouble(fpBarrier(std::fma(-fpBarrier(da), db, dc))); break;
+        case INSTR_FNMADD_D: result = fromDouble(fpBarrier(std::fma(-fpBarrier(da), db, -dc))); break;
+
+        // Sign injection works on the raw bits and never signals
+        case INSTR_FSGNJ_S: case INSTR_FSGNJN_S: case INSTR_FSGNJX_S: {
+            uint32_t x = unboxSingle(a), y = unboxSingle(b), sign = y & 0x80000000u;
+            if (id == INSTR_FSGNJN_S) sign ^= 0x80000000u;
+            if (id == INSTR_FSGNJX_S) sign = (x ^ y) & 0x80000000u;
+            result = boxSingle((x & 0x7FFFFFFFu) | sign);
+            hostFlags = false;
+        } break;
+        case INSTR_FSGNJ_D: case INSTR_FSGNJN_D: case INSTR_FSGNJX_D: {
+            const uint64_t signBit = 1ull << 63;
+            uint64_t sign = b & signBit;
+            if (id == INSTR_FSGNJN_D) sign ^= signBit;
+            if (id == INSTR_FSGNJX_D) sign = (a ^ b) & signBit;
+            result = (a & ~signBit) | sign;
+            hostFlags = false;
+        } break;
+
+        case INSTR_FMIN_S: case INSTR_FMAX_S:
+            result = fromSingle(fpMinMax(sa, sb, id == INSTR_FMAX_S, flags)); hostFlags = false; break;
+        case INSTR_FMIN_D: case INSTR_FMAX_D:
+            result = fromDouble(fpMinMax(da, db, id == INSTR_FMAX_D, flags)); hostFlags = false; break;
+        case INSTR_FEQ_S: case INSTR_FLT_S: case INSTR_FLE_S:
+            result = fpCompare(id, sa, sb, id == INSTR_FEQ_S, flags); hostFlags = false; break;
+        case INSTR_FEQ_D: case INSTR_FLT_D: case INSTR_FLE_D:
+            result = fpCompare(id, da, db, id == INSTR_FEQ_D, flags); hostFlags = false; break;
+        case INSTR_FCLASS_S: result = fpClassify(sa); hostFlags = false; break;
+        case INSTR_FCLASS_D: result = fpClassify(da); hostFlags = false; break;
+
+        // Moves copy bits without unboxing or canonicalising
+        case INSTR_FMV_X_W: result = static_cast<uint64_t>(static_cast<int64_t>(static_cast<int32_t>(a))); hostFlags = false; break;
+        case INSTR_FMV_W_X: result = boxSingle(static_cast<uint32_t>(a)); hostFlags = false; break;
+        case INSTR_FMV_X_D: case INSTR_FMV_D_X: result = a; hostFlags = false; break;
+
+        case INSTR_FCVT_W_S:  result = fpToInt(sa, false, 32, flags); hostFlags = false; break;
+        case INSTR_FCVT_WU_S: result = fpToInt(sa, true, 32, flags);  hostFlags = false; break;
+        case INSTR_FCVT_L_S:  result = fpToInt(sa, false, 64, flags); hostFlags = false; break;
+        case INSTR_FCVT_LU_S: result = fpToInt(sa, true, 64, flags);  hostFlags = false; break;
+        case INSTR_FCVT_W_D:  result = fpToInt(da, false, 32, flags); hostFlags = false; break;
+        case INSTR_FCVT_WU_D: result = fpToInt(da, true, 32, flags);  hostFlags = false; break;
+        case INSTR_FCVT_L_D:  result = fpToInt(da, false, 64, flags); hostFlags = false; break;
+        case INSTR_FCVT_LU_D: result = fpToInt(da, true, 64, flags);  hostFlags = false; break;
+        case INSTR_FCVT_S_W:  result = fromSingle(fpBarrier(static_cast<float>(fpBarrier(static_cast<int32_t>(ia))))); break;
+        case INSTR_FCVT_S_WU: result = fromSingle(fpBarrier(static_cast<float>(fpBarrier(static_cast<uint32_t>(ia))))); break;
+        case INSTR_FCVT_S_L:  result = fromSingle(fpBarrier(static_cast<float>(fpBarrier(ia)))); break;
+        case INSTR_FCVT_S_LU: result = fromSingle(fpBarrier(static_cast<float>(fpBarrier(a)))); break;
+        case INSTR_FCVT_D_W:  result = fromDouble(fpBarrier(static_cast<double>(fpBarrier(static_cast<int32_t>(ia))))); break;
+        case INSTR_FCVT_D_WU: result = fromDouble(fpBarrier(static_cast<double>(fpBarrier(static_cast<uint32_t>(ia))))); break;
+        case INSTR_FCVT_D_L:  result = fromDouble(fpBarrier(static_cast<double>(fpBarrier(ia)))); break;
+        case INSTR_FCVT_D_LU: result = fromDouble(fpBarrier(static_cast<double>(fpBarrier(a)))); break;
+        case INSTR_FCVT_S_D:  result = fromSingle(fpBarrier(static_cast<float>(fpBarrier(da)))); break;
+        case INSTR_FCVT_D_S:  result = fromDouble(fpBarrier(static_cast<double>(fpBarrier(sa)))); break;
+
+        default:
+            std::fesetround(savedRounding);
+            return false;
+    }
+
+    if (hostFlags) flags |= hostFlagsToFFlags(std::fetestexcept(FE_ALL_EXCEPT));
+    std::fesetround(savedRounding);
+    fflags |= flags;
+    return true;
+}
+
+#endif // FPU_H
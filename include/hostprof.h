@@ -0,0 +1,202 @@
+#ifndef HOSTPROF_H
+#define HOSTPROF_H
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <chrono>
+#include <string>
+#include <iostream>
+#include <iomanip>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// =====================================================================
+// Host-side self-profiling: how fast the simulator itself runs
+//   - --host-profile: wall time per phase (program load, main loop,
+//     .mc dumps, register/buffer/statistics printing) and simulated
+//     instructions and cycles per host second
+//   - --host-counters: also host instructions, cycles, cache misses and
+//     branch misses of the main loop through perf_event_open (Linux)
+//   - --progress=SECONDS: a progress line on stderr while running
+// Time is charged to one phase at a time: a dump inside the main loop
+// counts as dump time, not loop time.
+// =====================================================================
+enum HostPhase { HOST_OTHER, HOST_LOAD, HOST_RUN, HOST_DUMP, HOST_PRINT, HOST_PHASES };
+
+class HostProfiler {
+public:
+    bool enabled = false;         // --host-profile
+    bool counters = false;        // --host-counters
+    double progressSeconds = 0;   // --progress; 0 = off
+
+    HostProfiler() : start(Clock::now()), last(start) {}
+    ~HostProfiler() {
+#if defined(__linux__)
+        for (int fd : fds)
+            if (fd >= 0) close(fd);
+#endif
+    }
+
+    // Makes phase current and returns the previous one
+    HostPhase enter(HostPhase phase) {
+        HostPhase previous = current;
+        if (!enabled || phase == current) return previous;
+        charge();
+        current = phase;
+        return previous;
+    }
+
+    // The main loop: host counters and the instruction rate cover it
+    void beginRun() {
+        runPrevious = enter(HOST_RUN);
+        runStart = lastProgress = Clock::now();
+        if (counters) startCounters();
+    }
+    void endRun(uint64_t instructions, uint64_t cycles) {
+        if (counters) stopCounters();
+        runSeconds += std::chrono::duration<double>(Clock::now() - runStart).count();
+        runInstructions += instructions;
+        runCycles += cycles;
+        enter(runPrevious);
+    }
+
+    // Called once per simulated cycle; looks at the clock every 4096 calls
+    void progress(uint64_t cycle, uint64_t instructions) {
+        if (progressSeconds <= 0 || (++progressTicks & 0xFFF)) return;
+        Clock::time_point now = Clock::now();
+        double interval = std::chrono::duration<double>(now - lastProgress).count();
+        if (interval < progressSeconds) return;
+        double elapsed = std::chrono::duration<double>(now - runStart).count();
+        char line[160];
+        std::snprintf(line, sizeof(line), "[Progress] %.1f s: cycle %llu, %llu instructions, %.2f MIPS\n", elapsed,
+                      static_cast<unsigned long long>(cycle), static_cast<unsigned long long>(instructions),
+                      (instructions - progressInstructions) / interval / 1e6);
+        std::cerr << line;
+        lastProgress = now;
+        progressInstructions = instructions;
+    }
+
+    void printReport(std::ostream &out) {
+        if (!enabled) return;
+        charge();
+        std::ios::fmtflags flags = out.flags();
+        std::streamsize precision = out.precision();
+        static const char *const names[HOST_PHASES] = {"other", "load", "main loop", "dumps", "printing"};
+        double total = std::chrono::duration<double>(last - start).count();
+        out << "================ Host Profile ================\n"
+            << "Host time = " << std::fixed << std::setprecision(3) << total << " s\n";
+        for (int p = 0; p < HOST_PHASES; p++)
+            out << "  " << std::left << std::setw(10) << names[p] << std::right << std::setw(10) << seconds[p]
+                << " s" << std::setprecision(1) << std::setw(7) << (total > 0 ? 100.0 * seconds[p] / total : 0.0)
+                << "%\n" << std::setprecision(3);
+        out << "Simulated " << runInstructions << " instructions, " << runCycles << " cycles in " << runSeconds
+            << " s of main loop: " << std::setprecision(3) << perSecond(runInstructions) / 1e6 << " MIPS, "
+            << perSecond(runCycles) / 1e6 << " M cycles/s\n";
+        if (counters) printCounters(out);
+        out << "==============================================\n";
+        out.flags(flags);
+        out.precision(precision);
+    }
+
+private:
+    typedef std::chrono::steady_clock Clock;
+    Clock::time_point start, last, runStart, lastProgress;
+    HostPhase current = HOST_OTHER;
+    HostPhase runPrevious = HOST_OTHER;
+    double seconds[HOST_PHASES] = {};
+    double runSeconds = 0;
+    uint64_t runInstructions = 0, runCycles = 0;
+    uint64_t progressTicks = 0, progressInstructions = 0;
+
+    void charge() {
+        Clock::time_point now = Clock::now();
+        seconds[current] += std::chrono::duration<double>(now - last).count();
+        last = now;
+    }
+
+    double perSecond(uint64_t n) const { return runSeconds > 0 ? n / runSeconds : 0.0; }
+
+    // perf_event_open counters: host instructions, cycles, cache misses, branch misses
+    enum { HW_INSTRUCTIONS, HW_CYCLES, HW_CACHE_MISSES, HW_BRANCH_MISSES, HW_COUNTERS };
+    int fds[HW_COUNTERS] = {-1, -1, -1, -1};
+    uint64_t values[HW_COUNTERS] = {};
+    std::string counterError;
+
+    void startCounters() {
+#if defined(__linux__)
+        static const uint64_t configs[HW_COUNTERS] = {PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CPU_CYCLES,
+                                                      PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES};
+        for (int c = 0; c < HW_COUNTERS; c++) {
+            if (fds[c] < 0) {
+                perf_event_attr attr;
+                std::memset(&attr, 0, sizeof(attr));
+                attr.size = sizeof(attr);
+                attr.type = PERF_TYPE_HARDWARE;
+                attr.config = configs[c];
+                attr.disabled = 1;
+                attr.exclude_kernel = 1;
+                attr.exclude_hv = 1;
+                fds[c] = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+                if (fds[c] < 0) {
+                    counterError = std::string("perf_event_open: ") + std::strerror(errno);
+                    continue;
+                }
+            }
+            ioctl(fds[c], PERF_EVENT_IOC_ENABLE, 0);
+        }
+#else
+        counterError = "needs Linux perf_event_open";
+#endif
+    }
+
+    void stopCounters() {
+#if defined(__linux__)
+        for (int c = 0; c < HW_COUNTERS; c++) {
+            if (fds[c] < 0) continue;
+            ioctl(fds[c], PERF_EVENT_IOC_DISABLE, 0);
+            uint64_t v = 0;
+            if (read(fds[c], &v, sizeof(v)) == static_cast<ssize_t>(sizeof(v))) values[c] = v; // Accumulates
+        }
+#endif
+    }
+
+    void printCounters(std::ostream &out) const {
+        if (fds[HW_INSTRUCTIONS] < 0 || fds[HW_CYCLES] < 0) {
+            out << "Host counters unavailable (" << counterError << ")\n";
+            return;
+        }
+        double kilo = values[HW_INSTRUCTIONS] ? values[HW_INSTRUCTIONS] / 1000.0 : 1.0;
+        out << "Host counters (main loop): " << values[HW_INSTRUCTIONS] << " instructions, " << values[HW_CYCLES]
+            << " cycles, IPC " << std::setprecision(2)
+            << (values[HW_CYCLES] ? static_cast<double>(values[HW_INSTRUCTIONS]) / values[HW_CYCLES] : 0.0) << "\n";
+        if (fds[HW_CACHE_MISSES] >= 0)
+            out << "  cache misses  = " << values[HW_CACHE_MISSES] << " (" << values[HW_CACHE_MISSES] / kilo
+                << " per 1000 host instructions)\n";
+        if (fds[HW_BRANCH_MISSES] >= 0)
+            out << "  branch misses = " << values[HW_BRANCH_MISSES] << " (" << values[HW_BRANCH_MISSES] / kilo
+                << " per 1000 host instructions)\n";
+        if (runInstructions > 0)
+            out << "  host instructions per simulated instruction = " << std::setprecision(0)
+                << static_cast<double>(values[HW_INSTRUCTIONS]) / runInstructions << "\n";
+    }
+};
+
+// Charges the enclosing scope to a phase
+class HostPhaseScope {
+public:
+    HostPhaseScope(HostProfiler &profiler, HostPhase phase) : profiler(profiler), previous(profiler.enter(phase)) {}
+    ~HostPhaseScope() { profiler.enter(previous); }
+
+private:
+    HostProfiler &profiler;
+    HostPhase previous;
+};
+
+#endif // HOSTPROF_H
@@ -0,0 +1,234 @@
+#ifndef MEMPROFILE_H
+#define MEMPROFILE_H
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <iostream>
+#include <iomanip>
+
+// =====================================================================
+// Data-access profiler (--mem-profile), fed by the scalar load/store
+// interfaces of both simulators
+//   - Reads and writes per 64-byte line; page counts are summed from the
+//     lines when the profile is written
+//   - Strides per load/store PC: the few most frequent address deltas
+//     are kept with space-saving counters
+//   - Reuse intervals: accesses since the last access to the same line,
+//     in power-of-two buckets
+//   - Output: a binary file (header, then page, line and stride records,
+//     each sorted by address) and a text summary on stdout
+// =====================================================================
+static const uint32_t MEMPROF_MAGIC   = 0x504D5652; // "RVMP"
+static const uint32_t MEMPROF_VERSION = 1;
+static const uint32_t MEMPROF_LINE_BYTES = 64;
+static const uint32_t MEMPROF_PAGE_BYTES = 4096;
+static const int MEMPROF_REUSE_BUCKETS = 40; // Bucket b: interval in [2^b, 2^(b+1))
+static const int MEMPROF_STRIDE_SLOTS = 4;
+
+struct MemProfileHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t lineBytes;
+    uint32_t pageBytes;
+    uint64_t pages;          // Number of MemProfileBlock page records
+    uint64_t lines;          // Number of MemProfileBlock line records that follow the pages
+    uint64_t pcs;            // Number of MemProfileStride records that follow the lines
+    uint64_t reads;
+    uint64_t writes;
+    uint64_t coldAccesses;   // First access to a line (no reuse interval)
+    uint64_t reuse[MEMPROF_REUSE_BUCKETS];
+};
+
+struct MemProfileBlock {
+    uint64_t addr;           // Page or line base address
+    uint64_t reads;
+    uint64_t writes;
+};
+
+struct MemProfileStride {
+    uint64_t pc;
+    uint64_t loads;
+    uint64_t stores;
+    int64_t stride;          // Most frequent address delta between accesses of this PC
+    uint64_t strideCount;    // Accesses that followed it (space-saving estimate)
+};
+
+class MemoryProfiler {
+public:
+    bool enabled = false;
+
+    void access(uint64_t pc, uint64_t addr, bool write) {
+        uint64_t now = ++accesses;
+        LineCounters &line = lines[addr / MEMPROF_LINE_BYTES];
+        if (line.lastAccess == 0) coldAccesses++;
+        else reuse[bucket(now - line.lastAccess)]++;
+        line.lastAccess = now;
+        (write ? line.writes : line.reads)++;
+
+        PcCounters &p = pcs[pc];
+        if (p.loads + p.stores > 0) countStride(p, static_cast<int64_t>(addr - p.lastAddr));
+        (write ? p.stores : p.loads)++;
+        p.lastAddr = addr;
+    }
+
+    bool writeBinary(const std::string &filename) const {
+        std::FILE *fout = std::fopen(filename.c_str(), "wb");
+        if (!fout) {
+            std::cerr << "ERROR: Could not open/create " << filename << "\n";
+            return false;
+        }
+        std::vector<MemProfileBlock> pageRecords = pageBlocks(), lineRecords = lineBlocks();
+        std::vector<MemProfileStride> strideRecords = strides();
+        MemProfileHeader header = {MEMPROF_MAGIC, MEMPROF_VERSION, MEMPROF_LINE_BYTES, MEMPROF_PAGE_BYTES,
+                                   pageRecords.size(), lineRecords.size(), strideRecords.size(),
+                                   0, 0, coldAccesses, {}};
+        for (const MemProfileBlock &b : lineRecords) header.reads += b.reads, header.writes += b.writes;
+        std::copy(reuse, reuse + MEMPROF_REUSE_BUCKETS, header.reuse);
+        std::fwrite(&header, sizeof(header), 1, fout);
+        std::fwrite(pageRecords.data(), sizeof(MemProfileBlock), pageRecords.size(), fout);
+        std::fwrite(lineRecords.data(), sizeof(MemProfileBlock), lineRecords.size(), fout);
+        std::fwrite(strideRecords.data(), sizeof(MemProfileStride), strideRecords.size(), fout);
+        bool ok = !std::ferror(fout);
+        std::fclose(fout);
+        if (!ok) std::cerr << "ERROR: Could not write " << filename << "\n";
+        return ok;
+    }
+
+    void printSummary(std::ostream &out) const {
+        std::vector<MemProfileBlock> pageRecords = pageBlocks(), lineRecords = lineBlocks();
+        std::vector<MemProfileStride> strideRecords = strides();
+        uint64_t reads = 0, writes = 0;
+        for (const MemProfileBlock &b : lineRecords) reads += b.reads, writes += b.writes;
+        out << "Memory profile: " << accesses << " accesses (" << reads << " reads, " << writes << " writes), "
+            << lineRecords.size() << " lines of " << MEMPROF_LINE_BYTES << " bytes, " << pageRecords.size()
+            << " pages of " << MEMPROF_PAGE_BYTES << " bytes\n";
+        if (accesses == 0) return;
+
+        printHottest(out, "Hottest pages", pageRecords, 5);
+        printHottest(out, "Hottest lines", lineRecords, 8);
+
+        std::stable_sort(strideRecords.begin(), strideRecords.end(), [](const MemProfileStride &a,
+                         const MemProfileStride &b) { return a.loads + a.stores > b.loads + b.stores; });
+        out << "  Strides (busiest load/store PCs):\n";
+        for (size_t i = 0; i < strideRecords.size() && i < 8; i++) {
+            const MemProfileStride &s = strideRecords[i];
+            uint64_t n = s.loads + s.stores;
+            double share = n > 1 ? static_cast<double>(s.strideCount) / (n - 1) : 0.0;
+            out << "    " << hex(s.pc) << std::setw(10) << n << (s.stores ? " st" : " ld");
+            if (n < 2) {
+                out << "  single access\n";
+                continue;
+            }
+            out << "  stride " << std::setw(6) << s.stride << std::fixed << std::setprecision(1) << std::setw(7)
+                << 100.0 * share << "%  "
+                << (share < 0.75 ? "irregular" : s.stride == 0 ? "same address" : "constant stride") << "\n";
+        }
+
+        out << "  Reuse intervals (accesses between uses of a line): cold " << coldAccesses << "\n";
+        uint64_t peak = *std::max_element(reuse, reuse + MEMPROF_REUSE_BUCKETS);
+        int last = MEMPROF_REUSE_BUCKETS - 1;
+        while (last > 0 && reuse[last] == 0) last--;
+        for (int b = 0; b <= last && peak > 0; b++) {
+            std::string range = std::to_string(1ull << b);
+            if (b > 0) range += "-" + std::to_string((2ull << b) - 1);
+            out << "    " << std::left << std::setw(16) << range << std::right << std::setw(10) << reuse[b] << "  "
+                << std::string(static_cast<size_t>(reuse[b] * 40 / peak), '#') << "\n";
+        }
+    }
+
+private:
+    struct LineCounters {
+        uint64_t reads = 0;
+        uint64_t writes = 0;
+        uint64_t lastAccess = 0; // Access number; 0 = never
+    };
+    struct PcCounters {
+        uint64_t loads = 0;
+        uint64_t stores = 0;
+        uint64_t lastAddr = 0;
+        int64_t stride[MEMPROF_STRIDE_SLOTS] = {0, 0, 0, 0};
+        uint64_t count[MEMPROF_STRIDE_SLOTS] = {0, 0, 0, 0};
+    };
+
+    uint64_t accesses = 0;
+    uint64_t coldAccesses = 0;
+    uint64_t reuse[MEMPROF_REUSE_BUCKETS] = {};
+    std::unordered_map<uint64_t, LineCounters> lines; // Keyed by line number
+    std::unordered_map<uint64_t, PcCounters> pcs;
+
+    static int bucket(uint64_t interval) {
+        int b = 0;
+        while (interval > 1 && b < MEMPROF_REUSE_BUCKETS - 1) interval >>= 1, b++;
+        return b;
+    }
+
+    // Space-saving: a new stride takes over the least counted slot
+    static void countStride(PcCounters &p, int64_t stride) {
+        int victim = 0;
+        for (int i = 0; i < MEMPROF_STRIDE_SLOTS; i++) {
+            if (p.count[i] != 0 && p.stride[i] == stride) {
+                p.count[i]++;
+                return;
+            }
+            if (p.count[i] < p.count[victim]) victim = i;
+        }
+        p.stride[victim] = stride;
+        p.count[victim]++;
+    }
+
+    std::vector<MemProfileBlock> lineBlocks() const {
+        std::vector<MemProfileBlock> out;
+        out.reserve(lines.size());
+        for (const auto &l : lines) out.push_back({l.first * MEMPROF_LINE_BYTES, l.second.reads, l.second.writes});
+        std::sort(out.begin(), out.end(), [](const MemProfileBlock &a, const MemProfileBlock &b) { return a.addr < b.addr; });
+        return out;
+    }
+
+    std::vector<MemProfileBlock> pageBlocks() const {
+        std::vector<MemProfileBlock> out;
+        for (const MemProfileBlock &l : lineBlocks()) {
+            uint64_t page = l.addr & ~static_cast<uint64_t>(MEMPROF_PAGE_BYTES - 1);
+            if (out.empty() || out.back().addr != page) out.push_back({page, 0, 0});
+            out.back().reads += l.reads;
+            out.back().writes += l.writes;
+        }
+        return out;
+    }
+
+    std::vector<MemProfileStride> strides() const {
+        std::vector<MemProfileStride> out;
+        out.reserve(pcs.size());
+        for (const auto &e : pcs) {
+            const PcCounters &p = e.second;
+            int best = 0;
+            for (int i = 1; i < MEMPROF_STRIDE_SLOTS; i++)
+                if (p.count[i] > p.count[best]) best = i;
+            out.push_back({e.first, p.loads, p.stores, p.stride[best], p.count[best]});
+        }
+        std::sort(out.begin(), out.end(), [](const MemProfileStride &a, const MemProfileStride &b) { return a.pc < b.pc; });
+        return out;
+    }
+
+    static std::string hex(uint64_t value) {
+        char text[24];
+        std::snprintf(text, sizeof(text), "0x%-10llx", static_cast<unsigned long long>(value));
+        return text;
+    }
+
+    static void printHottest(std::ostream &out, const char *title, std::vector<MemProfileBlock> blocks, size_t n) {
+        std::stable_sort(blocks.begin(), blocks.end(), [](const MemProfileBlock &a, const MemProfileBlock &b) {
+            return a.reads + a.writes > b.reads + b.writes;
+        });
+        out << "  " << title << " (reads/writes):";
+        for (size_t i = 0; i < blocks.size() && i < n; i++)
+            out << (i % 4 == 0 ? "\n    " : "    ") << hex(blocks[i].addr) << std::setw(6) << blocks[i].reads << "/"
+                << blocks[i].writes;
+        out << "\n";
+    }
+};
+
+#endif // MEMPROFILE_H
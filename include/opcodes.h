@@ -0,0 +1,433 @@
+#ifndef OPCODES_H
+#define OPCODES_H
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+// =====================================================================
+// Instruction table shared by the assembler (encode) and the
+// simulators (decode). One row per instruction: the assembler looks
+// rows up by mnemonic, the simulators by the fields of the word.
+// =====================================================================
+enum InstrFormat {
+    FMT_R,        // rd, rs1, rs2
+    FMT_I,        // rd, rs1, imm12
+    FMT_I_SHIFT,  // rd, rs1, shamt (funct7 in imm[11:5])
+    FMT_LOAD,     // rd, imm(rs1)
+    FMT_JALR,     // rd, imm(rs1)
+    FMT_S,        // rs2, imm(rs1)
+    FMT_SB,       // rs1, rs2, label
+    FMT_U,        // rd, imm20
+    FMT_UJ,       // rd, label
+    FMT_CSR,      // rd, csr, rs1
+    FMT_CSRI,     // rd, csr, uimm5
+    FMT_SYSTEM,   // no operands; funct12 selects the instruction
+    FMT_FENCE,    // fence (all orderings)
+    FMT_SFENCE,   // sfence.vma [rs1[, rs2]]
+    FMT_R4,       // rd, rs1, rs2, rs3[, rm] (fused multiply-add; funct7 holds fmt)
+    FMT_FP_UNARY, // rd, rs1[, rm] (funct12 holds funct7:rs2)
+    FMT_I_UNARY,  // rd, rs1 (funct12 holds the fixed imm[11:0]: clz, rev8, ...)
+    FMT_VSETVLI,  // rd, rs1, vtypei
+    FMT_VLOAD,    // vd, (rs1)[, rs2][, v0.t] (funct7 holds mop: 0 unit-stride, 2 strided)
+    FMT_VSTORE,   // vs3, (rs1)[, rs2][, v0.t]
+    FMT_V_ARITH,  // vd, vs2, vs1/rs1/simm5[, v0.t] (funct7 holds funct6, funct3 the operand kind)
+    FMT_V_MOVE,   // vd, vs1/rs1/simm5 (unmasked, vs2 = 0)
+    FMT_V_TO_X    // rd, vs2 (unmasked, vs1 = 0)
+};
+
+enum InstrId {
+    INSTR_INVALID,
+    // RV32I
+    INSTR_LUI, INSTR_AUIPC, INSTR_JAL, INSTR_JALR,
+    INSTR_BEQ, INSTR_BNE, INSTR_BLT, INSTR_BGE, INSTR_BLTU, INSTR_BGEU,
+    INSTR_LB, INSTR_LH, INSTR_LW, INSTR_LBU, INSTR_LHU,
+    INSTR_SB, INSTR_SH, INSTR_SW,
+    INSTR_ADDI, INSTR_SLTI, INSTR_SLTIU, INSTR_XORI, INSTR_ORI, INSTR_ANDI,
+    INSTR_SLLI, INSTR_SRLI, INSTR_SRAI,
+    INSTR_ADD, INSTR_SUB, INSTR_SLL, INSTR_SLT, INSTR_SLTU, INSTR_XOR,
+    INSTR_SRL, INSTR_SRA, INSTR_OR, INSTR_AND,
+    INSTR_FENCE, INSTR_ECALL, INSTR_EBREAK,
+    // RV32M
+    INSTR_MUL, INSTR_MULH, INSTR_MULHSU, INSTR_MULHU,
+    INSTR_DIV, INSTR_DIVU, INSTR_REM, INSTR_REMU,
+    // Zicsr and privileged
+    INSTR_CSRRW, INSTR_CSRRS, INSTR_CSRRC, INSTR_CSRRWI, INSTR_CSRRSI, INSTR_CSRRCI,
+    INSTR_MRET, INSTR_WFI, INSTR_SFENCE_VMA,
+    // Zifencei
+    INSTR_FENCE_I,
+    // RV64I
+    INSTR_LWU, INSTR_LD, INSTR_SD,
+    INSTR_ADDIW, INSTR_SLLIW, INSTR_SRLIW, INSTR_SRAIW,
+    INSTR_ADDW, INSTR_SUBW, INSTR_SLLW, INSTR_SRLW, INSTR_SRAW,
+    // RV64M
+    INSTR_MULW, INSTR_DIVW, INSTR_DIVUW, INSTR_REMW, INSTR_REMUW,
+    // RV32F
+    INSTR_FLW, INSTR_FSW,
+    INSTR_FMADD_S, INSTR_FMSUB_S, INSTR_FNMSUB_S, INSTR_FNMADD_S,
+    INSTR_FADD_S, INSTR_FSUB_S, INSTR_FMUL_S, INSTR_FDIV_S, INSTR_FSQRT_S,
+    INSTR_FSGNJ_S, INSTR_FSGNJN_S, INSTR_FSGNJX_S, INSTR_FMIN_S, INSTR_FMAX_S,
+    INSTR_FCVT_W_S, INSTR_FCVT_WU_S, INSTR_FMV_X_W, INSTR_FEQ_S, INSTR_FLT_S, INSTR_FLE_S,
+    INSTR_FCLASS_S, INSTR_FCVT_S_W, INSTR_FCVT_S_WU, INSTR_FMV_W_X,
+    // RV32D
+    INSTR_FLD, INSTR_FSD,
+    INSTR_FMADD_D, INSTR_FMSUB_D, INSTR_FNMSUB_D, INSTR_FNMADD_D,
+    INSTR_FADD_D, INSTR_FSUB_D, INSTR_FMUL_D, INSTR_FDIV_D, INSTR_FSQRT_D,
+    INSTR_FSGNJ_D, INSTR_FSGNJN_D, INSTR_FSGNJX_D, INSTR_FMIN_D, INSTR_FMAX_D,
+    INSTR_FCVT_S_D, INSTR_FCVT_D_S, INSTR_FEQ_D, INSTR_FLT_D, INSTR_FLE_D, INSTR_FCLASS_D,
+    INSTR_FCVT_W_D, INSTR_FCVT_WU_D, INSTR_FCVT_D_W, INSTR_FCVT_D_WU,
+    // RV64F/RV64D
+    INSTR_FCVT_L_S, INSTR_FCVT_LU_S, INSTR_FCVT_S_L, INSTR_FCVT_S_LU,
+    INSTR_FCVT_L_D, INSTR_FCVT_LU_D, INSTR_FMV_X_D, INSTR_FCVT_D_L, INSTR_FCVT_D_LU, INSTR_FMV_D_X,
+    // Zba/Zbb
+    INSTR_SH1ADD, INSTR_SH2ADD, INSTR_SH3ADD,
+    INSTR_ANDN, INSTR_ORN, INSTR_XNOR, INSTR_MIN, INSTR_MINU, INSTR_MAX, INSTR_MAXU,
+    INSTR_ROL, INSTR_ROR, INSTR_RORI,
+    INSTR_CLZ, INSTR_CTZ, INSTR_CPOP, INSTR_SEXT_B, INSTR_SEXT_H, INSTR_REV8, INSTR_ORC_B,
+    // RV64 Zbb
+    INSTR_ROLW, INSTR_RORW, INSTR_RORIW, INSTR_CLZW, INSTR_CTZW, INSTR_CPOPW,
+    // V subset
+    INSTR_VSETVLI,
+    INSTR_VLE8_V, INSTR_VLE16_V, INSTR_VLE32_V, INSTR_VLSE8_V, INSTR_VLSE16_V, INSTR_VLSE32_V,
+    INSTR_VSE8_V, INSTR_VSE16_V, INSTR_VSE32_V, INSTR_VSSE8_V, INSTR_VSSE16_V, INSTR_VSSE32_V,
+    INSTR_VADD_VV, INSTR_VADD_VX, INSTR_VADD_VI, INSTR_VSUB_VV, INSTR_VSUB_VX,
+    INSTR_VAND_VV, INSTR_VAND_VX, INSTR_VAND_VI, INSTR_VOR_VV, INSTR_VOR_VX, INSTR_VOR_VI,
+    INSTR_VXOR_VV, INSTR_VXOR_VX, INSTR_VXOR_VI, INSTR_VMUL_VV, INSTR_VMUL_VX,
+    INSTR_VREDSUM_VS, INSTR_VREDAND_VS, INSTR_VREDOR_VS, INSTR_VREDXOR_VS,
+    INSTR_VREDMINU_VS, INSTR_VREDMIN_VS, INSTR_VREDMAXU_VS, INSTR_VREDMAX_VS,
+    INSTR_VMV_V_V, INSTR_VMV_V_X, INSTR_VMV_V_I, INSTR_VMV_X_S, INSTR_VMV_S_X
+};
+
+static const uint8_t INSTR_FLAG_RV64 = 1 << 0; // Decoded only by the RV64 simulator build
+static const uint8_t INSTR_FLAG_RM   = 1 << 1; // funct3 is a rounding mode (table holds 7 = dynamic)
+static const uint8_t INSTR_FLAG_FRD  = 1 << 2; // rd is an FP register
+static const uint8_t INSTR_FLAG_FRS1 = 1 << 3; // rs1 is an FP register
+static const uint8_t INSTR_FLAG_FRS2 = 1 << 4; // rs2 is an FP register (rs3 always is)
+static const uint8_t INSTR_FLAG_V    = 1 << 5; // Vector instruction (see vector.h)
+static const uint8_t INSTR_FLAG_RV32 = 1 << 6; // Decoded only by the RV32 build (encoding differs on RV64)
+
+static const uint8_t FP_RRR = INSTR_FLAG_FRD | INSTR_FLAG_FRS1 | INSTR_FLAG_FRS2;
+static const uint8_t FP_RR  = INSTR_FLAG_FRD | INSTR_FLAG_FRS1;
+static const uint8_t FP_CMP = INSTR_FLAG_FRS1 | INSTR_FLAG_FRS2; // Integer rd
+
+struct OpcodeInfo {
+    InstrId id;
+    const char *mnemonic; // Upper case, as matched by the assembler
+    InstrFormat format;
+    uint8_t opcode;
+    uint8_t funct3;
+    uint8_t funct7;       // FMT_R and FMT_I_SHIFT; fmt for FMT_R4; funct6 or mop for vectors
+    uint16_t funct12;     // FMT_SYSTEM, FMT_FP_UNARY and FMT_I_UNARY only
+    uint8_t flags;
+};
+
+static const OpcodeInfo opcodeTable[] = {
+    {INSTR_LUI,    "LUI",    FMT_U,       0x37, 0, 0, 0, 0},
+    {INSTR_AUIPC,  "AUIPC",  FMT_U,       0x17, 0, 0, 0, 0},
+    {INSTR_JAL,    "JAL",    FMT_UJ,      0x6F, 0, 0, 0, 0},
+    {INSTR_JALR,   "JALR",   FMT_JALR,    0x67, 0, 0, 0, 0},
+
+    {INSTR_BEQ,    "BEQ",    FMT_SB,      0x63, 0, 0, 0, 0},
+    {INSTR_BNE,    "BNE",    FMT_SB,      0x63, 1, 0, 0, 0},
+    {INSTR_BLT,    "BLT",    FMT_SB,      0x63, 4, 0, 0, 0},
+    {INSTR_BGE,    "BGE",    FMT_SB,      0x63, 5, 0, 0, 0},
+    {INSTR_BLTU,   "BLTU",   FMT_SB,      0x63, 6, 0, 0, 0},
+    {INSTR_BGEU,   "BGEU",   FMT_SB,      0x63, 7, 0, 0, 0},
+
+    {INSTR_LB,     "LB",     FMT_LOAD,    0x03, 0, 0, 0, 0},
+    {INSTR_LH,     "LH",     FMT_LOAD,    0x03, 1, 0, 0, 0},
+    {INSTR_LW,     "LW",     FMT_LOAD,    0x03, 2, 0, 0, 0},
+    {INSTR_LBU,    "LBU",    FMT_LOAD,    0x03, 4, 0, 0, 0},
+    {INSTR_LHU,    "LHU",    FMT_LOAD,    0x03, 5, 0, 0, 0},
+    {INSTR_SB,     "SB",     FMT_S,       0x23, 0, 0, 0, 0},
+    {INSTR_SH,     "SH",     FMT_S,       0x23, 1, 0, 0, 0},
+    {INSTR_SW,     "SW",     FMT_S,       0x23, 2, 0, 0, 0},
+
+    {INSTR_ADDI,   "ADDI",   FMT_I,       0x13, 0, 0, 0, 0},
+    {INSTR_SLTI,   "SLTI",   FMT_I,       0x13, 2, 0, 0, 0},
+    {INSTR_SLTIU,  "SLTIU",  FMT_I,       0x13, 3, 0, 0, 0},
+    {INSTR_XORI,   "XORI",   FMT_I,       0x13, 4, 0, 0, 0},
+    {INSTR_ORI,    "ORI",    FMT_I,       0x13, 6, 0, 0, 0},
+    {INSTR_ANDI,   "ANDI",   FMT_I,       0x13, 7, 0, 0, 0},
+    {INSTR_SLLI,   "SLLI",   FMT_I_SHIFT, 0x13, 1, 0x00, 0, 0},
+    {INSTR_SRLI,   "SRLI",   FMT_I_SHIFT, 0x13, 5, 0x00, 0, 0},
+    {INSTR_SRAI,   "SRAI",   FMT_I_SHIFT, 0x13, 5, 0x20, 0, 0},
+
+    {INSTR_ADD,    "ADD",    FMT_R,       0x33, 0, 0x00, 0, 0},
+    {INSTR_SUB,    "SUB",    FMT_R,       0x33, 0, 0x20, 0, 0},
+    {INSTR_SLL,    "SLL",    FMT_R,       0x33, 1, 0x00, 0, 0},
+    {INSTR_SLT,    "SLT",    FMT_R,       0x33, 2, 0x00, 0, 0},
+    {INSTR_SLTU,   "SLTU",   FMT_R,       0x33, 3, 0x00, 0, 0},
+    {INSTR_XOR,    "XOR",    FMT_R,       0x33, 4, 0x00, 0, 0},
+    {INSTR_SRL,    "SRL",    FMT_R,       0x33, 5, 0x00, 0, 0},
+    {INSTR_SRA,    "SRA",    FMT_R,       0x33, 5, 0x20, 0, 0},
+    {INSTR_OR,     "OR",     FMT_R,       0x33, 6, 0x00, 0, 0},
+    {INSTR_AND,    "AND",    FMT_R,       0x33, 7, 0x00, 0, 0},
+
+    {INSTR_MUL,    "MUL",    FMT_R,       0x33, 0, 0x01, 0, 0},
+    {INSTR_MULH,   "MULH",   FMT_R,       0x33, 1, 0x01, 0, 0},
+    {INSTR_MULHSU, "MULHSU", FMT_R,       0x33, 2, 0x01, 0, 0},
+    {INSTR_MULHU,  "MULHU",  FMT_R,       0x33, 3, 0x01, 0, 0},
+    {INSTR_DIV,    "DIV",    FMT_R,       0x33, 4, 0x01, 0, 0},
+    {INSTR_DIVU,   "DIVU",   FMT_R,       0x33, 5, 0x01, 0, 0},
+    {INSTR_REM,    "REM",    FMT_R,       0x33, 6, 0x01, 0, 0},
+    {INSTR_REMU,   "REMU",   FMT_R,       0x33, 7, 0x01, 0, 0},
+
+    {INSTR_FENCE,  "FENCE",  FMT_FENCE,   0x0F, 0, 0, 0, 0},
+    {INSTR_FENCE_I, "FENCE.I", FMT_FENCE, 0x0F, 1, 0, 0, 0},
+    {INSTR_ECALL,  "ECALL",  FMT_SYSTEM,  0x73, 0, 0, 0x000, 0},
+    {INSTR_EBREAK, "EBREAK", FMT_SYSTEM,  0x73, 0, 0, 0x001, 0},
+    {INSTR_MRET,   "MRET",   FMT_SYSTEM,  0x73, 0, 0, 0x302, 0},
+    {INSTR_WFI,    "WFI",    FMT_SYSTEM,  0x73, 0, 0, 0x105, 0},
+    {INSTR_SFENCE_VMA, "SFENCE.VMA", FMT_SFENCE, 0x73, 0, 0x09, 0, 0},
+    {INSTR_CSRRW,  "CSRRW",  FMT_CSR,     0x73, 1, 0, 0, 0},
+    {INSTR_CSRRS,  "CSRRS",  FMT_CSR,     0x73, 2, 0, 0, 0},
+    {INSTR_CSRRC,  "CSRRC",  FMT_CSR,     0x73, 3, 0, 0, 0},
+    {INSTR_CSRRWI, "CSRRWI", FMT_CSRI,    0x73, 5, 0, 0, 0},
+    {INSTR_CSRRSI, "CSRRSI", FMT_CSRI,    0x73, 6, 0, 0, 0},
+    {INSTR_CSRRCI, "CSRRCI", FMT_CSRI,    0x73, 7, 0, 0, 0},
+
+    {INSTR_LWU,    "LWU",    FMT_LOAD,    0x03, 6, 0, 0, INSTR_FLAG_RV64},
+    {INSTR_LD,     "LD",     FMT_LOAD,    0x03, 3, 0, 0, INSTR_FLAG_RV64},
+    {INSTR_SD,     "SD",     FMT_S,       0x23, 3, 0, 0, INSTR_FLAG_RV64},
+    {INSTR_ADDIW,  "ADDIW",  FMT_I,       0x1B, 0, 0, 0, INSTR_FLAG_RV64},
+    {INSTR_SLLIW,  "SLLIW",  FMT_I_SHIFT, 0x1B, 1, 0x00, 0, INSTR_FLAG_RV64},
+    {INSTR_SRLIW,  "SRLIW",  FMT_I_SHIFT, 0x1B, 5, 0x00, 0, INSTR_FLAG_RV64},
+    {INSTR_SRAIW,  "SRAIW",  FMT_I_SHIFT, 0x1B, 5, 0x20, 0, INSTR_FLAG_RV64},
+    {INSTR_ADDW,   "ADDW",   FMT_R,       0x3B, 0, 0x00, 0, INSTR_FLAG_RV64},
+    {INSTR_SUBW,   "SUBW",   FMT_R,       0x3B, 0, 0x20, 0, INSTR_FLAG_RV64},
+    {INSTR_SLLW,   "SLLW",   FMT_R,       0x3B, 1, 0x00, 0, INSTR_FLAG_RV64},
+    {INSTR_SRLW,   "SRLW",   FMT_R,       0x3B, 5, 0x00, 0, INSTR_FLAG_RV64},
+    {INSTR_SRAW,   "SRAW",   FMT_R,       0x3B, 5, 0x20, 0, INSTR_FLAG_RV64},
+    {INSTR_MULW,   "MULW",   FMT_R,       0x3B, 0, 0x01, 0, INSTR_FLAG_RV64},
+    {INSTR_DIVW,   "DIVW",   FMT_R,       0x3B, 4, 0x01, 0, INSTR_FLAG_RV64},
+    {INSTR_DIVUW,  "DIVUW",  FMT_R,       0x3B, 5, 0x01, 0, INSTR_FLAG_RV64},
+    {INSTR_REMW,   "REMW",   FMT_R,       0x3B, 6, 0x01, 0, INSTR_FLAG_RV64},
+    {INSTR_REMUW,  "REMUW",  FMT_R,       0x3B, 7, 0x01, 0, INSTR_FLAG_RV64},
+
+    {INSTR_SH1ADD, "SH1ADD", FMT_R,       0x33, 2, 0x10, 0, 0},
+    {INSTR_SH2ADD, "SH2ADD", FMT_R,       0x33, 4, 0x10, 0, 0},
+    {INSTR_SH3ADD, "SH3ADD", FMT_R,       0x33, 6, 0x10, 0, 0},
+    {INSTR_ANDN,   "ANDN",   FMT_R,       0x33, 7, 0x20, 0, 0},
+    {INSTR_ORN,    "ORN",    FMT_R,       0x33, 6, 0x20, 0, 0},
+    {INSTR_XNOR,   "XNOR",   FMT_R,       0x33, 4, 0x20, 0, 0},
+    {INSTR_MIN,    "MIN",    FMT_R,       0x33, 4, 0x05, 0, 0},
+    {INSTR_MINU,   "MINU",   FMT_R,       0x33, 5, 0x05, 0, 0},
+    {INSTR_MAX,    "MAX",    FMT_R,       0x33, 6, 0x05, 0, 0},
+    {INSTR_MAXU,   "MAXU",   FMT_R,       0x33, 7, 0x05, 0, 0},
+    {INSTR_ROL,    "ROL",    FMT_R,       0x33, 1, 0x30, 0, 0},
+    {INSTR_ROR,    "ROR",    FMT_R,       0x33, 5, 0x30, 0, 0},
+    {INSTR_RORI,   "RORI",   FMT_I_SHIFT, 0x13, 5, 0x30, 0, 0},
+    {INSTR_CLZ,    "CLZ",    FMT_I_UNARY, 0x13, 1, 0, 0x600, 0},
+    {INSTR_CTZ,    "CTZ",    FMT_I_UNARY, 0x13, 1, 0, 0x601, 0},
+    {INSTR_CPOP,   "CPOP",   FMT_I_UNARY, 0x13, 1, 0, 0x602, 0},
+    {INSTR_SEXT_B, "SEXT.B", FMT_I_UNARY, 0x13, 1, 0, 0x604, 0},
+    {INSTR_SEXT_H, "SEXT.H", FMT_I_UNARY, 0x13, 1, 0, 0x605, 0},
+    {INSTR_REV8,   "REV8",   FMT_I_UNARY, 0x13, 5, 0, 0x698, INSTR_FLAG_RV32},
+    {INSTR_REV8,   "REV8",   FMT_I_UNARY, 0x13, 5, 0, 0x6B8, INSTR_FLAG_RV64},
+    {INSTR_ORC_B,  "ORC.B",  FMT_I_UNARY, 0x13, 5, 0, 0x287, 0},
+    {INSTR_ROLW,   "ROLW",   FMT_R,       0x3B, 1, 0x30, 0, INSTR_FLAG_RV64},
+    {INSTR_RORW,   "RORW",   FMT_R,       0x3B, 5, 0x30, 0, INSTR_FLAG_RV64},
+    {INSTR_RORIW,  "RORIW",  FMT_I_SHIFT, 0x1B, 5, 0x30, 0, INSTR_FLAG_RV64},
+    {INSTR_CLZW,   "CLZW",   FMT_I_UNARY, 0x1B, 1, 0, 0x600, INSTR_FLAG_RV64},
+    {INSTR_CTZW,   "CTZW",   FMT_I_UNARY, 0x1B, 1, 0, 0x601, INSTR_FLAG_RV64},
+    {INSTR_CPOPW,  "CPOPW",  FMT_I_UNARY, 0x1B, 1, 0, 0x602, INSTR_FLAG_RV64},
+
+    {INSTR_FLW,      "FLW",      FMT_LOAD,     0x07, 2, 0, 0, INSTR_FLAG_FRD},
+    {INSTR_FSW,      "FSW",      FMT_S,        0x27, 2, 0, 0, INSTR_FLAG_FRS2},
+    {INSTR_FMADD_S,  "FMADD.S",  FMT_R4,       0x43, 7, 0, 0, FP_RRR | INSTR_FLAG_RM},
+    {INSTR_FMSUB_S,  "FMSUB.S",  FMT_R4,       0x47, 7, 0, 0, FP_RRR | INSTR_FLAG_RM},
+    {INSTR_FNMSUB_S, "FNMSUB.S", FMT_R4,       0x4B, 7, 0, 0, FP_RRR | INSTR_FLAG_RM},
+    {INSTR_FNMADD_S, "FNMADD.S", FMT_R4,       0x4F, 7, 0, 0, FP_RRR | INSTR_FLAG_RM},
+    {INSTR_FADD_S,   "FADD.S",   FMT_R,        0x53, 7, 0x00, 0, FP_RRR | INSTR_FLAG_RM},
+    {INSTR_FSUB_S,   "FSUB.S",   FMT_R,        0x53, 7, 0x04, 0, FP_RRR | INSTR_FLAG_RM},
+    {INSTR_FMUL_S,   "FMUL.S",   FMT_R,        0x53, 7, 0x08, 0, FP_RRR | INSTR_FLAG_RM},
+    {INSTR_FDIV_S,   "FDIV.S",   FMT_R,        0x53, 7, 0x0C, 0, FP_RRR | INSTR_FLAG_RM},
+    {INSTR_FSQRT_S,  "FSQRT.S",  FMT_FP_UNARY, 0x53, 7, 0, 0x580, FP_RR | INSTR_FLAG_RM},
+    {INSTR_FSGNJ_S,  "FSGNJ.S",  FMT_R,        0x53, 0, 0x10, 0, FP_RRR},
+    {INSTR_FSGNJN_S, "FSGNJN.S", FMT_R,        0x53, 1, 0x10, 0, FP_RRR},
+    {INSTR_FSGNJX_S, "FSGNJX.S", FMT_R,        0x53, 2, 0x10, 0, FP_RRR},
+    {INSTR_FMIN_S,   "FMIN.S",   FMT_R,        0x53, 0, 0x14, 0, FP_RRR},
+    {INSTR_FMAX_S,   "FMAX.S",   FMT_R,        0x53, 1, 0x14, 0, FP_RRR},
+    {INSTR_FCVT_W_S, "FCVT.W.S", FMT_FP_UNARY, 0x53, 7, 0, 0xC00, INSTR_FLAG_FRS1 | INSTR_FLAG_RM},
+    {INSTR_FCVT_WU_S,"FCVT.WU.S",FMT_FP_UNARY, 0x53, 7, 0, 0xC01, INSTR_FLAG_FRS1 | INSTR_FLAG_RM},
+    {INSTR_FMV_X_W,  "FMV.X.W",  FMT_FP_UNARY, 0x53, 0, 0, 0xE00, INSTR_FLAG_FRS1},
+    {INSTR_FEQ_S,    "FEQ.S",    FMT_R,        0x53, 2, 0x50, 0, FP_CMP},
+    {INSTR_FLT_S,    "FLT.S",    FMT_R,        0x53, 1, 0x50, 0, FP_CMP},
+    {INSTR_FLE_S,    "FLE.S",    FMT_R,        0x53, 0, 0x50, 0, FP_CMP},
+    {INSTR_FCLASS_S, "FCLASS.S", FMT_FP_UNARY, 0x53, 1, 0, 0xE00, INSTR_FLAG_FRS1},
+    {INSTR_FCVT_S_W, "FCVT.S.W", FMT_FP_UNARY, 0x53, 7, 0, 0xD00, INSTR_FLAG_FRD | INSTR_FLAG_RM},
+    {INSTR_FCVT_S_WU,"FCVT.S.WU",FMT_FP_UNARY, 0x53, 7, 0, 0xD01, INSTR_FLAG_FRD | INSTR_FLAG_RM},
+    {INSTR_FMV_W_X,  "FMV.W.X",  FMT_FP_UNARY, 0x53, 0, 0, 0xF00, INSTR_FLAG_FRD},
+
+    {INSTR_FLD,      "FLD",      FMT_LOAD,     0x07, 3, 0, 0, INSTR_FLAG_FRD},
+    {INSTR_FSD,      "FSD",      FMT_S,        0x27, 3, 0, 0, INSTR_FLAG_FRS2},
+    {INSTR_FMADD_D,  "FMADD.D",  FMT_R4,       0x43, 7, 1, 0, FP_RRR | INSTR_FLAG_RM},
+    {INSTR_FMSUB_D,  "FMSUB.D",  FMT_R4,       0x47, 7, 1, 0, FP_RRR | INSTR_FLAG_RM},
+    {INSTR_FNMSUB_D, "FNMSUB.D", FMT_R4,       0x4B, 7, 1, 0, FP_RRR | INSTR_FLAG_RM},
+    {INSTR_FNMADD_D, "FNMADD.D", FMT_R4,       0x4F, 7, 1, 0, FP_RRR | INSTR_FLAG_RM},
+    {INSTR_FADD_D,   "FADD.D",   FMT_R,        0x53, 7, 0x01, 0, FP_RRR | INSTR_FLAG_RM},
+    {INSTR_FSUB_D,   "FSUB.D",   FMT_R,        0x53, 7, 0x05, 0, FP_RRR | INSTR_FLAG_RM},
+    {INSTR_FMUL_D,   "FMUL.D",   FMT_R,        0x53, 7, 0x09, 0, FP_RRR | INSTR_FLAG_RM},
+    {INSTR_FDIV_D,   "FDIV.D",   FMT_R,        0x53, 7, 0x0D, 0, FP_RRR | INSTR_FLAG_RM},
+    {INSTR_FSQRT_D,  "FSQRT.D",  FMT_FP_UNARY, 0x53, 7, 0, 0x5A0, FP_RR | INSTR_FLAG_RM},
+    {INSTR_FSGNJ_D,  "FSGNJ.D",  FMT_R,        0x53, 0, 0x11, 0, FP_RRR},
+    {INSTR_FSGNJN_D, "FSGNJN.D", FMT_R,        0x53, 1, 0x11, 0, FP_RRR},
+    {INSTR_FSGNJX_D, "FSGNJX.D", FMT_R,        0x53, 2, 0x11, 0, FP_RRR},
+    {INSTR_FMIN_D,   "FMIN.D",   FMT_R,        0x53, 0, 0x15, 0, FP_RRR},
+    {INSTR_FMAX_D,   "FMAX.D",   FMT_R,        0x53, 1, 0x15, 0, FP_RRR},
+    {INSTR_FCVT_S_D, "FCVT.S.D", FMT_FP_UNARY, 0x53, 7, 0, 0x401, FP_RR | INSTR_FLAG_RM},
+    {INSTR_FCVT_D_S, "FCVT.D.S", FMT_FP_UNARY, 0x53, 7, 0, 0x420, FP_RR | INSTR_FLAG_RM},
+    {INSTR_FEQ_D,    "FEQ.D",    FMT_R,        0x53, 2, 0x51, 0, FP_CMP},
+    {INSTR_FLT_D,    "FLT.D",    FMT_R,        0x53, 1, 0x51, 0, FP_CMP},
+    {INSTR_FLE_D,    "FLE.D",    FMT_R,        0x53, 0, 0x51, 0, FP_CMP},
+    {INSTR_FCLASS_D, "FCLASS.D", FMT_FP_UNARY, 0x53, 1, 0, 0xE20, INSTR_FLAG_FRS1},
+    {INSTR_FCVT_W_D, "FCVT.W.D", FMT_FP_UNARY, 0x53, 7, 0, 0xC20, INSTR_FLAG_FRS1 | INSTR_FLAG_RM},
+    {INSTR_FCVT_WU_D,"FCVT.WU.D",FMT_FP_UNARY, 0x53, 7, 0, 0xC21, INSTR_FLAG_FRS1 | INSTR_FLAG_RM},
+    {INSTR_FCVT_D_W, "FCVT.D.W", FMT_FP_UNARY, 0x53, 7, 0, 0xD20, INSTR_FLAG_FRD | INSTR_FLAG_RM},
+    {INSTR_FCVT_D_WU,"FCVT.D.WU",FMT_FP_UNARY, 0x53, 7, 0, 0xD21, INSTR_FLAG_FRD | INSTR_FLAG_RM},
+
+    {INSTR_FCVT_L_S, "FCVT.L.S", FMT_FP_UNARY, 0x53, 7, 0, 0xC02, INSTR_FLAG_FRS1 | INSTR_FLAG_RM | INSTR_FLAG_RV64},
+    {INSTR_FCVT_LU_S,"FCVT.LU.S",FMT_FP_UNARY, 0x53, 7, 0, 0xC03, INSTR_FLAG_FRS1 | INSTR_FLAG_RM | INSTR_FLAG_RV64},
+    {INSTR_FCVT_S_L, "FCVT.S.L", FMT_FP_UNARY, 0x53, 7, 0, 0xD02, INSTR_FLAG_FRD | INSTR_FLAG_RM | INSTR_FLAG_RV64},
+    {INSTR_FCVT_S_LU,"FCVT.S.LU",FMT_FP_UNARY, 0x53, 7, 0, 0xD03, INSTR_FLAG_FRD | INSTR_FLAG_RM | INSTR_FLAG_RV64},
+    {INSTR_FCVT_L_D, "FCVT.L.D", FMT_FP_UNARY, 0x53, 7, 0, 0xC22, INSTR_FLAG_FRS1 | INSTR_FLAG_RM | INSTR_FLAG_RV64},
+    {INSTR_FCVT_LU_D,"FCVT.LU.D",FMT_FP_UNARY, 0x53, 7, 0, 0xC23, INSTR_FLAG_FRS1 | INSTR_FLAG_RM | INSTR_FLAG_RV64},
+    {INSTR_FMV_X_D,  "FMV.X.D",  FMT_FP_UNARY, 0x53, 0, 0, 0xE20, INSTR_FLAG_FRS1 | INSTR_FLAG_RV64},
+    {INSTR_FCVT_D_L, "FCVT.D.L", FMT_FP_UNARY, 0x53, 7, 0, 0xD22, INSTR_FLAG_FRD | INSTR_FLAG_RM | INSTR_FLAG_RV64},
+    {INSTR_FCVT_D_LU,"FCVT.D.LU",FMT_FP_UNARY, 0x53, 7, 0, 0xD23, INSTR_FLAG_FRD | INSTR_FLAG_RM | INSTR_FLAG_RV64},
+    {INSTR_FMV_D_X,  "FMV.D.X",  FMT_FP_UNARY, 0x53, 0, 0, 0xF20, INSTR_FLAG_FRD | INSTR_FLAG_RV64},
+
+    {INSTR_VSETVLI,    "VSETVLI",    FMT_VSETVLI, 0x57, 7, 0, 0, INSTR_FLAG_V},
+    {INSTR_VLE8_V,     "VLE8.V",     FMT_VLOAD,   0x07, 0, 0, 0, INSTR_FLAG_V},
+    {INSTR_VLE16_V,    "VLE16.V",    FMT_VLOAD,   0x07, 5, 0, 0, INSTR_FLAG_V},
+    {INSTR_VLE32_V,    "VLE32.V",    FMT_VLOAD,   0x07, 6, 0, 0, INSTR_FLAG_V},
+    {INSTR_VLSE8_V,    "VLSE8.V",    FMT_VLOAD,   0x07, 0, 2, 0, INSTR_FLAG_V},
+    {INSTR_VLSE16_V,   "VLSE16.V",   FMT_VLOAD,   0x07, 5, 2, 0, INSTR_FLAG_V},
+    {INSTR_VLSE32_V,   "VLSE32.V",   FMT_VLOAD,   0x07, 6, 2, 0, INSTR_FLAG_V},
+    {INSTR_VSE8_V,     "VSE8.V",     FMT_VSTORE,  0x27, 0, 0, 0, INSTR_FLAG_V},
+    {INSTR_VSE16_V,    "VSE16.V",    FMT_VSTORE,  0x27, 5, 0, 0, INSTR_FLAG_V},
+    {INSTR_VSE32_V,    "VSE32.V",    FMT_VSTORE,  0x27, 6, 0, 0, INSTR_FLAG_V},
+    {INSTR_VSSE8_V,    "VSSE8.V",    FMT_VSTORE,  0x27, 0, 2, 0, INSTR_FLAG_V},
+    {INSTR_VSSE16_V,   "VSSE16.V",   FMT_VSTORE,  0x27, 5, 2, 0, INSTR_FLAG_V},
+    {INSTR_VSSE32_V,   "VSSE32.V",   FMT_VSTORE,  0x27, 6, 2, 0, INSTR_FLAG_V},
+    {INSTR_VADD_VV,    "VADD.VV",    FMT_V_ARITH, 0x57, 0, 0x00, 0, INSTR_FLAG_V},
+    {INSTR_VADD_VX,    "VADD.VX",    FMT_V_ARITH, 0x57, 4, 0x00, 0, INSTR_FLAG_V},
+    {INSTR_VADD_VI,    "VADD.VI",    FMT_V_ARITH, 0x57, 3, 0x00, 0, INSTR_FLAG_V},
+    {INSTR_VSUB_VV,    "VSUB.VV",    FMT_V_ARITH, 0x57, 0, 0x02, 0, INSTR_FLAG_V},
+    {INSTR_VSUB_VX,    "VSUB.VX",    FMT_V_ARITH, 0x57, 4, 0x02, 0, INSTR_FLAG_V},
+    {INSTR_VAND_VV,    "VAND.VV",    FMT_V_ARITH, 0x57, 0, 0x09, 0, INSTR_FLAG_V},
+    {INSTR_VAND_VX,    "VAND.VX",    FMT_V_ARITH, 0x57, 4, 0x09, 0, INSTR_FLAG_V},
+    {INSTR_VAND_VI,    "VAND.VI",    FMT_V_ARITH, 0x57, 3, 0x09, 0, INSTR_FLAG_V},
+    {INSTR_VOR_VV,     "VOR.VV",     FMT_V_ARITH, 0x57, 0, 0x0A, 0, INSTR_FLAG_V},
+    {INSTR_VOR_VX,     "VOR.VX",     FMT_V_ARITH, 0x57, 4, 0x0A, 0, INSTR_FLAG_V},
+    {INSTR_VOR_VI,     "VOR.VI",     FMT_V_ARITH, 0x57, 3, 0x0A, 0, INSTR_FLAG_V},
+    {INSTR_VXOR_VV,    "VXOR.VV",    FMT_V_ARITH, 0x57, 0, 0x0B, 0, INSTR_FLAG_V},
+    {INSTR_VXOR_VX,    "VXOR.VX",    FMT_V_ARITH, 0x57, 4, 0x0B, 0, INSTR_FLAG_V},
+    {INSTR_VXOR_VI,    "VXOR.VI",    FMT_V_ARITH, 0x57, 3, 0x0B, 0, INSTR_FLAG_V},
+    {INSTR_VMUL_VV,    "VMUL.VV",    FMT_V_ARITH, 0x57, 2, 0x25, 0, INSTR_FLAG_V},
+    {INSTR_VMUL_VX,    "VMUL.VX",    FMT_V_ARITH, 0x57, 6, 0x25, 0, INSTR_FLAG_V},
+    {INSTR_VREDSUM_VS, "VREDSUM.VS", FMT_V_ARITH, 0x57, 2, 0x00, 0, INSTR_FLAG_V},
+    {INSTR_VREDAND_VS, "VREDAND.VS", FMT_V_ARITH, 0x57, 2, 0x01, 0, INSTR_FLAG_V},
+    {INSTR_VREDOR_VS,  "VREDOR.VS",  FMT_V_ARITH, 0x57, 2, 0x02, 0, INSTR_FLAG_V},
+    {INSTR_VREDXOR_VS, "VREDXOR.VS", FMT_V_ARITH, 0x57, 2, 0x03, 0, INSTR_FLAG_V},
+    {INSTR_VREDMINU_VS,"VREDMINU.VS",FMT_V_ARITH, 0x57, 2, 0x04, 0, INSTR_FLAG_V},
+    {INSTR_VREDMIN_VS, "VREDMIN.VS", FMT_V_ARITH, 0x57, 2, 0x05, 0, INSTR_FLAG_V},
+    {INSTR_VREDMAXU_VS,"VREDMAXU.VS",FMT_V_ARITH, 0x57, 2, 0x06, 0, INSTR_FLAG_V},
+    {INSTR_VREDMAX_VS, "VREDMAX.VS", FMT_V_ARITH, 0x57, 2, 0x07, 0, INSTR_FLAG_V},
+    {INSTR_VMV_V_V,    "VMV.V.V",    FMT_V_MOVE,  0x57, 0, 0x17, 0, INSTR_FLAG_V},
+    {INSTR_VMV_V_X,    "VMV.V.X",    FMT_V_MOVE,  0x57, 4, 0x17, 0, INSTR_FLAG_V},
+    {INSTR_VMV_V_I,    "VMV.V.I",    FMT_V_MOVE,  0x57, 3, 0x17, 0, INSTR_FLAG_V},
+    {INSTR_VMV_X_S,    "VMV.X.S",    FMT_V_TO_X,  0x57, 2, 0x10, 0, INSTR_FLAG_V},
+    {INSTR_VMV_S_X,    "VMV.S.X",    FMT_V_MOVE,  0x57, 6, 0x10, 0, INSTR_FLAG_V},
+};
+
+// Assembler side: nullptr if the mnemonic (upper case) is not in the table.
+// The first row wins, so REV8 assembles to its RV32 encoding.
+inline const OpcodeInfo *findInstrByMnemonic(const std::string &mnemonic) {
+    static const std::unordered_map<std::string, const OpcodeInfo *> byName = [] {
+        std::unordered_map<std::string, const OpcodeInfo *> m;
+        for (const OpcodeInfo &info : opcodeTable) m.emplace(info.mnemonic, &info);
+        return m;
+    }();
+    auto it = byName.find(mnemonic);
+    return (it != byName.end()) ? it->second : nullptr;
+}
+
+// Rounding-mode field: 5 and 6 are reserved, 7 defers to frm
+inline bool isValidRoundingField(uint32_t rm) {
+    return rm != 5 && rm != 6;
+}
+
+// Simulator side: nullptr if the word is not a supported instruction
+inline const OpcodeInfo *findInstrByEncoding(uint32_t instr, bool allowRV64 = false) {
+    uint32_t opcode  = instr & 0x7F;
+    uint32_t funct3  = (instr >> 12) & 0x7;
+    uint32_t funct7  = instr >> 25;
+    uint32_t funct12 = instr >> 20;
+    if ((instr & 0x3) != 0x3) return nullptr;
+    for (const OpcodeInfo &info : opcodeTable) {
+        if (info.opcode != opcode) continue;
+        if ((info.flags & INSTR_FLAG_RV64) && !allowRV64) continue;
+        if ((info.flags & INSTR_FLAG_RV32) && allowRV64) continue;
+        bool funct3Ok = (info.flags & INSTR_FLAG_RM) ? isValidRoundingField(funct3) : info.funct3 == funct3;
+        switch (info.format) {
+            case FMT_U: case FMT_UJ:
+                return &info;
+            case FMT_FENCE: // FENCE ignores its ordering fields
+                if (info.funct3 == funct3) return &info;
+                break;
+            case FMT_I_SHIFT:
+                // RV64 slli/srli/srai take a 6-bit shamt: bit 25 is part of it
+                if (info.funct3 == funct3 &&
+                    (info.funct7 == funct7 || (allowRV64 && opcode == 0x13 && info.funct7 == (funct7 & ~1u))))
+                    return &info;
+                break;
+            case FMT_R: case FMT_SFENCE:
+                if (funct3Ok && info.funct7 == funct7) return &info;
+                break;
+            case FMT_R4:
+                if (funct3Ok && info.funct7 == (funct7 & 0x3)) return &info;
+                break;
+            case FMT_FP_UNARY: case FMT_I_UNARY:
+                if (funct3Ok && info.funct12 == funct12) return &info;
+                break;
+            case FMT_SYSTEM:
+                if (funct3 == 0 && info.funct12 == funct12) return &info;
+                break;
+            case FMT_VSETVLI: // vsetvl and vsetivli (bit 31 set) are not supported
+                if (funct3 == 7 && (instr >> 31) == 0) return &info;
+                break;
+            case FMT_VLOAD: case FMT_VSTORE:
+                // nf = mew = 0; unit-stride also needs lumop/sumop = 0
+                if (info.funct3 == funct3 && (funct7 >> 3) == 0 && ((funct7 >> 1) & 0x3) == info.funct7 &&
+                    (info.funct7 != 0 || ((instr >> 20) & 0x1F) == 0))
+                    return &info;
+                break;
+            case FMT_V_ARITH:
+                if (info.funct3 == funct3 && info.funct7 == (funct7 >> 1)) return &info;
+                break;
+            case FMT_V_MOVE:
+                if (info.funct3 == funct3 && info.funct7 == (funct7 >> 1) && (funct7 & 1) &&
+                    ((instr >> 20) & 0x1F) == 0)
+                    return &info;
+                break;
+            case FMT_V_TO_X:
+                if (info.funct3 == funct3 && info.funct7 == (funct7 >> 1) && (funct7 & 1) &&
+                    ((instr >> 15) & 0x1F) == 0)
+                    return &info;
+                break;
+            default:
+                if (info.funct3 == funct3) return &info;
+                break;
+        }
+    }
+    return nullptr;
+}
+
+inline InstrId decodeInstrId(uint32_t instr, bool allowRV64 = false) {
+    const OpcodeInfo *info = findInstrByEncoding(instr, allowRV64);
+    return info ? info->id : INSTR_INVALID;
+}
+
+#endif // OPCODES_H
@@ -0,0 +1,242 @@
+#ifndef PIPETRACE_H
+#define PIPETRACE_H
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+#include <iostream>
+
+// =====================================================================
+// AsyncFileWriter: double-buffered file output. The simulator appends to
+// one buffer while a background thread writes the other, so tracing
+// never waits on the disk unless the disk falls a whole buffer behind.
+// One producer, one consumer.
+// =====================================================================
+class AsyncFileWriter {
+public:
+    ~AsyncFileWriter() { close(); }
+
+    bool open(const std::string &filename) {
+        fout = std::fopen(filename.c_str(), "wb");
+        if (!fout) {
+            std::cerr << "ERROR: Could not open/create " << filename << "\n";
+            return false;
+        }
+        current.reserve(BUFFER_BYTES);
+        stopping = false;
+        worker = std::thread([this] { run(); });
+        return true;
+    }
+
+    bool isOpen() const { return fout != nullptr; }
+
+    void write(const char *data, size_t size) {
+        current.append(data, size);
+        if (current.size() >= BUFFER_BYTES) handOff();
+    }
+    void write(const std::string &s) { write(s.data(), s.size()); }
+
+    void close() {
+        if (!fout) return;
+        handOff();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        ready.notify_one();
+        worker.join();
+        std::fclose(fout);
+        fout = nullptr;
+    }
+
+private:
+    static const size_t BUFFER_BYTES = 1 << 20;
+    std::FILE *fout = nullptr;
+    std::string current;  // Filled by the simulator
+    std::string pending;  // Being written by the worker
+    bool hasPending = false;
+    bool stopping = false;
+    std::mutex mutex;
+    std::condition_variable ready; // Worker: a block is pending or close() was called
+    std::condition_variable done;  // Producer: the worker took the pending block
+    std::thread worker;
+
+    void handOff() {
+        if (current.empty()) return;
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [this] { return !hasPending; });
+        pending.swap(current);
+        hasPending = true;
+        lock.unlock();
+        ready.notify_one();
+        current.clear();
+    }
+
+    void run() {
+        std::string block;
+        for (;;) {
+            std::unique_lock<std::mutex> lock(mutex);
+            ready.wait(lock, [this] { return hasPending || stopping; });
+            if (!hasPending) return;
+            block.swap(pending);
+            hasPending = false;
+            lock.unlock();
+            done.notify_one();
+            std::fwrite(block.data(), 1, block.size(), fout);
+            block.clear();
+        }
+    }
+};
+
+// =====================================================================
+// Pipeline trace in the Kanata log format (Konata viewer; gem5's
+// O3PipeView traces convert to it)
+//   - The pipelined model calls fetched() when IF fills IF/ID, sample()
+//     at the start of every cycle, stall() where ID holds an instruction
+//     and retired() in WB
+//   - sample() maps each valid latch to the stage that consumes it this
+//     cycle (IF/ID -> ID, ID/EX -> EX, EX/MEM -> MEM, MEM/WB -> WB); an
+//     in-flight instruction found in no latch was flushed
+//   - Only cycles in [windowStart, windowEnd) are traced. Instructions
+//     in flight when the window opens appear at their current stage;
+//     those in flight when it closes get no retire line.
+// =====================================================================
+enum PipeStage { PIPE_IF, PIPE_ID, PIPE_EX, PIPE_MEM, PIPE_WB, PIPE_STAGES };
+
+struct PipeOccupant {
+    bool valid;
+    uint64_t seq; // Dynamic instruction number assigned at fetch
+};
+
+class PipelineTracer {
+public:
+    uint64_t windowStart = 0;
+    uint64_t windowEnd = UINT64_MAX;
+
+    bool open(const std::string &filename) {
+        if (!out.open(filename)) return false;
+        out.write("Kanata\t0004\n");
+        return true;
+    }
+
+    bool enabled() const { return out.isOpen(); }
+    bool inWindow(uint64_t cycle) const { return cycle >= windowStart && cycle < windowEnd; }
+
+    void fetched(uint64_t cycle, uint64_t seq, uint64_t pc, const std::string &text) {
+        inFlight.push_back({seq, pc, text, PIPE_IF, false});
+        if (inWindow(cycle)) enterStage(cycle, inFlight.back());
+    }
+
+    // latches[s]: the instruction stage s (ID..WB) works on this cycle
+    void sample(uint64_t cycle, const PipeOccupant (&latches)[PIPE_STAGES]) {
+        bool traced = inWindow(cycle);
+        for (size_t i = 0; i < inFlight.size();) {
+            Instr &in = inFlight[i];
+            int stage = -1; // The furthest latch wins if a stalled stage left a copy behind
+            for (int s = PIPE_WB; s > PIPE_IF && stage < 0; s--)
+                if (latches[s].valid && latches[s].seq == in.seq) stage = s;
+            if (stage < 0) { // Squashed
+                if (traced && in.introduced) finish(cycle, in, true);
+                inFlight.erase(inFlight.begin() + i);
+                continue;
+            }
+            bool moved = (stage != in.stage);
+            in.stage = static_cast<PipeStage>(stage);
+            if (traced && (moved || !in.introduced)) enterStage(cycle, in);
+            i++;
+        }
+    }
+
+    void stall(uint64_t cycle, uint64_t seq, const char *why) {
+        if (!inWindow(cycle)) return;
+        for (Instr &in : inFlight) {
+            if (in.seq != seq || !in.introduced) continue;
+            advance(cycle);
+            line = "L\t" + std::to_string(in.fileId) + "\t1\tstall " + why + " @" + std::to_string(cycle) + "\n";
+            out.write(line);
+        }
+    }
+
+    void retired(uint64_t cycle, uint64_t seq) {
+        for (size_t i = 0; i < inFlight.size(); i++) {
+            if (inFlight[i].seq != seq) continue;
+            if (inWindow(cycle) && inFlight[i].introduced) finish(cycle, inFlight[i], false);
+            inFlight.erase(inFlight.begin() + i);
+            return;
+        }
+    }
+
+    void close(uint64_t cycle) {
+        if (!enabled()) return;
+        for (Instr &in : inFlight) // Fetched past the end of the program
+            if (in.introduced && inWindow(cycle)) finish(cycle, in, true);
+        inFlight.clear();
+        out.close();
+    }
+
+private:
+    struct Instr {
+        uint64_t seq;
+        uint64_t pc;
+        std::string text;
+        PipeStage stage;
+        bool introduced;   // I and L lines written
+        uint64_t fileId = 0;
+    };
+
+    AsyncFileWriter out;
+    std::vector<Instr> inFlight; // At most a few entries: one per latch plus the fetch
+    uint64_t lastCycle = 0;
+    bool started = false;
+    uint64_t nextFileId = 0;
+    uint64_t nextRetireId = 0;
+    std::string line;
+
+    static const char *stageName(PipeStage s) {
+        static const char *const names[PIPE_STAGES] = {"IF", "ID", "EX", "MEM", "WB"};
+        return names[s];
+    }
+
+    // Cycle lines: absolute at the first event, then deltas
+    void advance(uint64_t cycle) {
+        if (!started) {
+            line = "C=\t" + std::to_string(cycle) + "\n";
+            out.write(line);
+            started = true;
+        } else if (cycle > lastCycle) {
+            line = "C\t" + std::to_string(cycle - lastCycle) + "\n";
+            out.write(line);
+        }
+        lastCycle = cycle;
+    }
+
+    void enterStage(uint64_t cycle, Instr &in) {
+        advance(cycle);
+        if (!in.introduced) {
+            in.introduced = true;
+            in.fileId = nextFileId++;
+            char pcText[24];
+            std::snprintf(pcText, sizeof(pcText), "0x%llx: ", static_cast<unsigned long long>(in.pc));
+            line = "I\t" + std::to_string(in.fileId) + "\t" + std::to_string(in.seq) + "\t0\n" +
+                   "L\t" + std::to_string(in.fileId) + "\t0\t" + pcText + in.text + "\n";
+            out.write(line);
+        }
+        line = "S\t" + std::to_string(in.fileId) + "\t0\t" + stageName(in.stage) + "\n";
+        out.write(line);
+    }
+
+    // Kanata R type: 0 retired, 1 flushed
+    void finish(uint64_t cycle, Instr &in, bool flushed) {
+        advance(cycle);
+        line = "R\t" + std::to_string(in.fileId) + "\t" + std::to_string(flushed ? 0 : nextRetireId++) + "\t" +
+               (flushed ? "1" : "0") + "\n";
+        out.write(line);
+    }
+};
+
+#endif // PIPETRACE_H
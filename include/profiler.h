@@ -0,0 +1,197 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <cstdint>
+#include <cctype>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <map>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include "elf_loader.h"
+#include "opcodes.h"
+
+// =====================================================================
+// Per-PC hotspot profiler (pipelined model)
+//   - Counters for each static instruction sit in a dense array indexed
+//     by (pc - base) / 2, like the predecoded image, so profiling a cycle
+//     is a handful of array increments
+//   - Stage cycles count the cycles an instruction occupies each stage,
+//     stalls included
+//   - Attributed cycles charge every cycle to the oldest instruction in
+//     the pipeline (the one retirement waits on), or to the fetch PC
+//     while the pipeline is empty. They add up to the total cycle count
+//     and are the weights of the folded-stacks file.
+// =====================================================================
+enum ProfileStage { PROF_IF, PROF_ID, PROF_EX, PROF_MEM, PROF_WB, PROF_STAGES };
+
+struct PcCounters {
+    uint64_t executions = 0;
+    uint64_t cycles = 0;                    // Attributed cycles
+    uint64_t stageCycles[PROF_STAGES] = {0, 0, 0, 0, 0};
+    uint64_t dataStalls = 0;
+    uint64_t controlStalls = 0;
+    uint64_t mispredicts = 0;
+    uint32_t ir = 0;                        // Instruction last fetched at this PC
+};
+
+class PcProfiler {
+public:
+    bool enabled = false;
+    uint64_t outside = 0; // Events for PCs beyond MAX_SPAN of the code
+
+    // Sizes the array for code in [base, end); later PCs grow it
+    void reset(uint64_t codeBase, uint64_t codeEnd) {
+        base = codeBase & ~static_cast<uint64_t>(1);
+        counters.assign(static_cast<size_t>((std::max(codeEnd, base) - base) / 2 + 1), PcCounters());
+        outside = 0;
+    }
+
+    PcCounters *at(uint64_t pc) {
+        uint64_t offset = pc - base;
+        if (pc >= base && offset / 2 < counters.size()) return &counters[offset / 2];
+        return grow(pc);
+    }
+
+    // Events, one call each
+    void stage(uint64_t pc, ProfileStage s) {
+        if (PcCounters *c = at(pc)) c->stageCycles[s]++;
+    }
+    void cycle(uint64_t pc) {
+        if (PcCounters *c = at(pc)) c->cycles++;
+    }
+    void fetched(uint64_t pc, uint32_t ir) {
+        if (PcCounters *c = at(pc)) {
+            c->stageCycles[PROF_IF]++;
+            c->ir = ir;
+        }
+    }
+    void executed(uint64_t pc) {
+        if (PcCounters *c = at(pc)) c->executions++;
+    }
+    void dataStall(uint64_t pc) {
+        if (PcCounters *c = at(pc)) c->dataStalls++;
+    }
+    void controlStall(uint64_t pc) {
+        if (PcCounters *c = at(pc)) c->controlStalls++;
+    }
+    void mispredict(uint64_t pc) {
+        if (PcCounters *c = at(pc)) c->mispredicts++;
+    }
+
+    // Sorted report, hottest instruction first. text holds assembly per PC
+    // (from the .mc input); without it the mnemonic is shown.
+    bool writeReport(const std::string &filename, const std::map<uint64_t, std::string> &text,
+                     const std::vector<ElfSymbol> &symbols, uint64_t totalCycles, bool rv64) const {
+        std::ofstream fout(filename);
+        if (!fout.is_open()) {
+            std::cerr << "ERROR: Could not open/create " << filename << "\n";
+            return false;
+        }
+        std::vector<size_t> order = hotOrder();
+        uint64_t executions = 0;
+        for (size_t i : order) executions += counters[i].executions;
+        fout << "# Per-PC profile: " << totalCycles << " cycles, " << executions << " instructions\n"
+             << "# cycles: attributed cycles; IF..WB: cycles resident in each stage\n"
+             << std::left << std::setw(10) << "# pc" << std::right << std::setw(10) << "cycles" << std::setw(7) << "%"
+             << std::setw(10) << "execs" << std::setw(7) << "CPI" << std::setw(8) << "IF" << std::setw(8) << "ID"
+             << std::setw(8) << "EX" << std::setw(8) << "MEM" << std::setw(8) << "WB" << std::setw(8) << "data"
+             << std::setw(8) << "ctrl" << std::setw(8) << "mispr" << "  instruction\n";
+        for (size_t i : order) {
+            const PcCounters &c = counters[i];
+            uint64_t pc = base + 2 * static_cast<uint64_t>(i);
+            char pcText[24];
+            std::snprintf(pcText, sizeof(pcText), "0x%llx", static_cast<unsigned long long>(pc));
+            fout << std::left << std::setw(10) << pcText << std::right << std::setw(10) << c.cycles
+                 << std::setw(7) << std::fixed << std::setprecision(2)
+                 << (totalCycles ? 100.0 * c.cycles / totalCycles : 0.0) << std::setw(10) << c.executions
+                 << std::setw(7) << (c.executions ? static_cast<double>(c.cycles) / c.executions : 0.0);
+            for (int s = 0; s < PROF_STAGES; s++) fout << std::setw(8) << c.stageCycles[s];
+            fout << std::setw(8) << c.dataStalls << std::setw(8) << c.controlStalls << std::setw(8) << c.mispredicts
+                 << "  " << instructionText(pc, c, text, rv64);
+            std::string where = symbolize(symbols, pc);
+            if (!where.empty()) fout << "  <" << where << ">";
+            fout << "\n";
+        }
+        if (outside) fout << "# " << outside << " events outside the profiled range\n";
+        return true;
+    }
+
+    // Folded stacks ("function;0xpc instruction cycles"), the input format
+    // of flamegraph.pl and speedscope. The function frame comes from the
+    // ELF symbols; .mc programs have the single frame "program".
+    bool writeFolded(const std::string &filename, const std::map<uint64_t, std::string> &text,
+                     const std::vector<ElfSymbol> &symbols, bool rv64) const {
+        std::ofstream fout(filename);
+        if (!fout.is_open()) {
+            std::cerr << "ERROR: Could not open/create " << filename << "\n";
+            return false;
+        }
+        for (size_t i = 0; i < counters.size(); i++) {
+            const PcCounters &c = counters[i];
+            if (c.cycles == 0) continue;
+            uint64_t pc = base + 2 * static_cast<uint64_t>(i);
+            const ElfSymbol *s = findSymbol(symbols, pc);
+            char pcText[24];
+            std::snprintf(pcText, sizeof(pcText), "0x%llx ", static_cast<unsigned long long>(pc));
+            fout << frame(s ? s->name : "program") << ";" << frame(pcText + instructionText(pc, c, text, rv64))
+                 << " " << c.cycles << "\n";
+        }
+        return true;
+    }
+
+private:
+    static const uint64_t MAX_SPAN = 64u << 20; // Largest profiled code span in bytes
+    uint64_t base = 0;
+    std::vector<PcCounters> counters;
+
+    // Code written or jumped to outside the loaded range (self-modifying
+    // code, handlers): extend the array unless it would get too large
+    PcCounters *grow(uint64_t pc) {
+        pc &= ~static_cast<uint64_t>(1);
+        uint64_t end = base + 2 * static_cast<uint64_t>(counters.size());
+        uint64_t newBase = std::min(base, pc);
+        uint64_t newEnd = std::max(end, pc + 2);
+        if (counters.empty()) newBase = pc, newEnd = pc + 2;
+        if (newEnd - newBase > MAX_SPAN) {
+            outside++;
+            return nullptr;
+        }
+        if (newBase < base && !counters.empty())
+            counters.insert(counters.begin(), static_cast<size_t>((base - newBase) / 2), PcCounters());
+        base = newBase;
+        counters.resize(static_cast<size_t>((newEnd - newBase) / 2));
+        return &counters[static_cast<size_t>((pc - base) / 2)];
+    }
+
+    std::vector<size_t> hotOrder() const {
+        std::vector<size_t> order;
+        for (size_t i = 0; i < counters.size(); i++)
+            if (counters[i].cycles || counters[i].executions) order.push_back(i);
+        std::stable_sort(order.begin(), order.end(),
+                         [this](size_t a, size_t b) { return counters[a].cycles > counters[b].cycles; });
+        return order;
+    }
+
+    static std::string instructionText(uint64_t pc, const PcCounters &c, const std::map<uint64_t, std::string> &text,
+                                       bool rv64) {
+        auto it = text.find(pc);
+        if (it != text.end()) return it->second;
+        const OpcodeInfo *info = findInstrByEncoding(c.ir, rv64);
+        std::string name = info ? info->mnemonic : "?";
+        for (char &ch : name) ch = static_cast<char>(std::tolower(static_cast<unsigned char>(ch)));
+        return name;
+    }
+
+    // Frame names cannot hold the separators of the folded format
+    static std::string frame(std::string name) {
+        for (char &ch : name)
+            if (ch == ';' || ch == '\n') ch = ',';
+        return name;
+    }
+};
+
+#endif // PROFILER_H
@@ -0,0 +1,187 @@
+#ifndef RVC_H
+#define RVC_H
+
+#include <cstdint>
+
+// =====================================================================
+// C extension: expansion of 16-bit compressed instructions into the
+// 32-bit instructions they stand for. Both simulators fetch a parcel,
+// expand it here and decode the result as usual; only the instruction
+// length (2 instead of 4) travels on with it.
+// =====================================================================
+static const uint32_t RVC_ILLEGAL = 0xFFFFFFFF; // Decodes as an illegal instruction
+
+// The low two bits of every 32-bit instruction are 11
+inline bool isCompressed(uint32_t parcel) {
+    return (parcel & 0x3) != 0x3;
+}
+
+// The all-zero termination word counts as a 4-byte instruction
+inline uint32_t instrLength(uint32_t parcel) {
+    return (parcel != 0 && isCompressed(parcel)) ? 2 : 4;
+}
+
+// 32-bit instruction formats
+static inline uint32_t rvcR(uint32_t op, uint32_t rd, uint32_t f3, uint32_t rs1, uint32_t rs2, uint32_t f7) {
+    return (f7 << 25) | (rs2 << 20) | (rs1 << 15) | (f3 << 12) | (rd << 7) | op;
+}
+static inline uint32_t rvcI(uint32_t op, uint32_t rd, uint32_t f3, uint32_t rs1, int32_t imm) {
+    return ((static_cast<uint32_t>(imm) & 0xFFF) << 20) | (rs1 << 15) | (f3 << 12) | (rd << 7) | op;
+}
+static inline uint32_t rvcS(uint32_t op, uint32_t f3, uint32_t rs1, uint32_t rs2, int32_t imm) {
+    uint32_t u = static_cast<uint32_t>(imm);
+    return (((u >> 5) & 0x7F) << 25) | (rs2 << 20) | (rs1 << 15) | (f3 << 12) | ((u & 0x1F) << 7) | op;
+}
+static inline uint32_t rvcB(uint32_t f3, uint32_t rs1, uint32_t rs2, int32_t imm) {
+    uint32_t u = static_cast<uint32_t>(imm);
+    return (((u >> 12) & 1) << 31) | (((u >> 5) & 0x3F) << 25) | (rs2 << 20) | (rs1 << 15) |
+           (f3 << 12) | (((u >> 1) & 0xF) << 8) | (((u >> 11) & 1) << 7) | 0x63;
+}
+static inline uint32_t rvcJ(uint32_t rd, int32_t imm) {
+    uint32_t u = static_cast<uint32_t>(imm);
+    return (((u >> 20) & 1) << 31) | (((u >> 1) & 0x3FF) << 21) | (((u >> 11) & 1) << 20) |
+           (((u >> 12) & 0xFF) << 12) | (rd << 7) | 0x6F;
+}
+
+static inline uint32_t rvcBit(uint32_t c, int bit) { return (c >> bit) & 1; }
+static inline int32_t rvcSignExtend(uint32_t value, int bits) {
+    int shift = 32 - bits;
+    return static_cast<int32_t>(value << shift) >> shift;
+}
+
+// CI-format 6-bit immediate: imm[5] in bit 12, imm[4:0] in bits 6:2
+static inline int32_t rvcImm6(uint32_t c) {
+    return rvcSignExtend((rvcBit(c, 12) << 5) | ((c >> 2) & 0x1F), 6);
+}
+
+// CJ-format jump offset (C.J, C.JAL)
+static inline int32_t rvcJumpOffset(uint32_t c) {
+    uint32_t off = (rvcBit(c, 12) << 11) | (rvcBit(c, 11) << 4) | (((c >> 9) & 0x3) << 8) |
+                   (rvcBit(c, 8) << 10) | (rvcBit(c, 7) << 6) | (rvcBit(c, 6) << 7) |
+                   (((c >> 3) & 0x7) << 1) | (rvcBit(c, 2) << 5);
+    return rvcSignExtend(off, 12);
+}
+
+// CB-format branch offset (C.BEQZ, C.BNEZ)
+static inline int32_t rvcBranchOffset(uint32_t c) {
+    uint32_t off = (rvcBit(c, 12) << 8) | (((c >> 10) & 0x3) << 3) | (((c >> 5) & 0x3) << 6) |
+                   (((c >> 3) & 0x3) << 1) | (rvcBit(c, 2) << 5);
+    return rvcSignExtend(off, 9);
+}
+
+// Returns the equivalent 32-bit instruction, or RVC_ILLEGAL for reserved
+// encodings. rv64 selects the RV64C meaning of the slots that differ
+// (C.LD/C.SD/C.LDSP/C.SDSP, C.ADDIW instead of C.JAL, C.SUBW/C.ADDW).
+inline uint32_t expandCompressed(uint32_t parcel, bool rv64) {
+    const uint32_t c = parcel & 0xFFFF;
+    const uint32_t quadrant = c & 0x3;
+    const uint32_t funct3 = (c >> 13) & 0x7;
+    const uint32_t rd = (c >> 7) & 0x1F;     // Also rs1 in CI/CR formats
+    const uint32_t rs2 = (c >> 2) & 0x1F;
+    const uint32_t rdp = 8 + ((c >> 2) & 0x7);  // rd' / rs2'
+    const uint32_t rs1p = 8 + ((c >> 7) & 0x7); // rs1' / rd'
+    if (c == 0) return RVC_ILLEGAL;
+
+    if (quadrant == 0) {
+        uint32_t wordOff = (((c >> 10) & 0x7) << 3) | (rvcBit(c, 6) << 2) | (rvcBit(c, 5) << 6);
+        uint32_t dwordOff = (((c >> 10) & 0x7) << 3) | (((c >> 5) & 0x3) << 6);
+        switch (funct3) {
+            case 0x0: { // C.ADDI4SPN
+                uint32_t imm = (((c >> 11) & 0x3) << 4) | (((c >> 7) & 0xF) << 6) |
+                               (rvcBit(c, 6) << 2) | (rvcBit(c, 5) << 3);
+                if (imm == 0) return RVC_ILLEGAL;
+                return rvcI(0x13, rdp, 0x0, 2, imm);
+            }
+            case 0x2: return rvcI(0x03, rdp, 0x2, rs1p, wordOff);                        // C.LW
+            case 0x3: return rv64 ? rvcI(0x03, rdp, 0x3, rs1p, dwordOff) : RVC_ILLEGAL;  // C.LD
+            case 0x6: return rvcS(0x23, 0x2, rs1p, rdp, wordOff);                        // C.SW
+            case 0x7: return rv64 ? rvcS(0x23, 0x3, rs1p, rdp, dwordOff) : RVC_ILLEGAL;  // C.SD
+            default:  return RVC_ILLEGAL; // Floating-point loads/stores
+        }
+    }
+
+    if (quadrant == 1) {
+        switch (funct3) {
+            case 0x0: return rvcI(0x13, rd, 0x0, rd, rvcImm6(c)); // C.ADDI, C.NOP
+            case 0x1:
+                if (!rv64) return rvcJ(1, rvcJumpOffset(c));       // C.JAL
+                if (rd == 0) return RVC_ILLEGAL;
+                return rvcI(0x1B, rd, 0x0, rd, rvcImm6(c));        // C.ADDIW
+            case 0x2: return rvcI(0x13, rd, 0x0, 0, rvcImm6(c));   // C.LI
+            case 0x3:
+                if (rd == 2) { // C.ADDI16SP
+                    uint32_t imm = (rvcBit(c, 12) << 9) | (rvcBit(c, 6) << 4) | (rvcBit(c, 5) << 6) |
+                                   (((c >> 3) & 0x3) << 7) | (rvcBit(c, 2) << 5);
+                    if (imm == 0) return RVC_ILLEGAL;
+                    return rvcI(0x13, 2, 0x0, 2, rvcSignExtend(imm, 10));
+                }
+                if (rvcImm6(c) == 0) return RVC_ILLEGAL;
+                return (static_cast<uint32_t>(rvcImm6(c)) << 12) | (rd << 7) | 0x37; // C.LUI
+            case 0x4: {
+                uint32_t shamt = (rvcBit(c, 12) << 5) | rs2;
+                switch ((c >> 10) & 0x3) {
+                    case 0x0: return rvcI(0x13, rs1p, 0x5, rs1p, shamt);           // C.SRLI
+                    case 0x1: return rvcI(0x13, rs1p, 0x5, rs1p, 0x400 | shamt);   // C.SRAI
+                    case 0x2: return rvcI(0x13, rs1p, 0x7, rs1p, rvcImm6(c));      // C.ANDI
+                    default: break;
+                }
+                uint32_t op2 = (c >> 5) & 0x3;
+                if (rvcBit(c, 12) == 0) {
+                    static const uint32_t f3[4] = {0x0, 0x4, 0x6, 0x7};   // SUB, XOR, OR, AND
+                    return rvcR(0x33, rs1p, f3[op2], rs1p, rdp, op2 == 0 ? 0x20 : 0x00);
+                }
+                if (!rv64 || op2 > 1) return RVC_ILLEGAL;
+                return rvcR(0x3B, rs1p, 0x0, rs1p, rdp, op2 == 0 ? 0x20 : 0x00); // C.SUBW, C.ADDW
+            }
+            case 0x5: return rvcJ(0, rvcJumpOffset(c));                 // C.J
+            case 0x6: return rvcB(0x0, rs1p, 0, rvcBranchOffset(c));    // C.BEQZ
+            default:  return rvcB(0x1, rs1p, 0, rvcBranchOffset(c));    // C.BNEZ
+        }
+    }
+
+    if (quadrant == 2) {
+        switch (funct3) {
+            case 0x0: return rvcI(0x13, rd, 0x1, rd, (rvcBit(c, 12) << 5) | rs2); // C.SLLI
+            case 0x2: { // C.LWSP
+                if (rd == 0) return RVC_ILLEGAL;
+                uint32_t off = (rvcBit(c, 12) << 5) | (((c >> 4) & 0x7) << 2) | (((c >> 2) & 0x3) << 6);
+                return rvcI(0x03, rd, 0x2, 2, off);
+            }
+            case 0x3: { // C.LDSP
+                if (!rv64 || rd == 0) return RVC_ILLEGAL;
+                uint32_t off = (rvcBit(c, 12) << 5) | (((c >> 5) & 0x3) << 3) | (((c >> 2) & 0x7) << 6);
+                return rvcI(0x03, rd, 0x3, 2, off);
+            }
+            case 0x4:
+                if (rvcBit(c, 12) == 0) {
+                    if (rs2 == 0) return rd ? rvcI(0x67, 0, 0x0, rd, 0) : RVC_ILLEGAL; // C.JR
+                    return rvcR(0x33, rd, 0x0, 0, rs2, 0x00);                           // C.MV
+                }
+                if (rs2 == 0) {
+                    if (rd == 0) return 0x00100073;                                     // C.EBREAK
+                    return rvcI(0x67, 1, 0x0, rd, 0);                                   // C.JALR
+                }
+                return rvcR(0x33, rd, 0x0, rd, rs2, 0x00);                              // C.ADD
+            case 0x6: { // C.SWSP
+                uint32_t off = (((c >> 9) & 0xF) << 2) | (((c >> 7) & 0x3) << 6);
+                return rvcS(0x23, 0x2, 2, rs2, off);
+            }
+            case 0x7: { // C.SDSP
+                if (!rv64) return RVC_ILLEGAL;
+                uint32_t off = (((c >> 10) & 0x7) << 3) | (((c >> 7) & 0x7) << 6);
+                return rvcS(0x23, 0x3, 2, rs2, off);
+            }
+            default: return RVC_ILLEGAL;
+        }
+    }
+    return RVC_ILLEGAL;
+}
+
+// Fetched parcel to the 32-bit instruction that is decoded. The all-zero
+// word is passed through: the simulators treat it as the end of the program.
+inline uint32_t expandParcel(uint32_t parcel, bool rv64) {
+    if (parcel == 0 || !isCompressed(parcel)) return parcel;
+    return expandCompressed(parcel, rv64);
+}
+
+#endif // RVC_H
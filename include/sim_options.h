@@ -0,0 +1,46 @@
+#ifndef SIM_OPTIONS_H
+#define SIM_OPTIONS_H
+
+#include <string>
+#include <cstdlib>
+#include <cstdint>
+
+// =====================================================================
+// Command-line options shared by the simulators.
+// Options follow the four positional .mc arguments as --name=value.
+// =====================================================================
+static const int FIRST_OPTION_ARG = 5;
+
+// Returns true and fills value if arg has the form --name=value (or --name)
+inline bool matchOption(const char *arg, const char *name, std::string &value) {
+    std::string a(arg);
+    std::string prefix = std::string("--") + name;
+    if (a.compare(0, prefix.size(), prefix) != 0) return false;
+    if (a.size() == prefix.size()) {
+        value = "1";
+        return true;
+    }
+    if (a[prefix.size()] != '=') return false;
+    value = a.substr(prefix.size() + 1);
+    return true;
+}
+
+// Splits --name=value into its parts; a bare --name gets the value "1"
+inline bool splitOption(const char *arg, std::string &name, std::string &value) {
+    std::string a(arg);
+    if (a.compare(0, 2, "--") != 0) return false;
+    size_t eq = a.find('=');
+    name = a.substr(2, eq == std::string::npos ? std::string::npos : eq - 2);
+    value = (eq == std::string::npos) ? "1" : a.substr(eq + 1);
+    return true;
+}
+
+inline bool optionBool(const std::string &value) {
+    return !(value == "0" || value == "false" || value == "off");
+}
+
+inline uint64_t optionNumber(const std::string &value) {
+    return std::strtoull(value.c_str(), nullptr, 0);
+}
+
+#endif // SIM_OPTIONS_H
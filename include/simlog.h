@@ -0,0 +1,115 @@
+#ifndef SIMLOG_H
+#define SIMLOG_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <sstream>
+#include <iostream>
+#include "pipetrace.h"
+
+// =====================================================================
+// Leveled, per-category diagnostics of the pipeline stages
+//   - SIM_LOG(category, level, a << b << ...) formats the message only if
+//     the category is enabled at that level: a disabled message costs one
+//     compare against a table entry
+//   - Levels above SIM_LOG_MAX_LEVEL compile out; -DSIM_LOG_MAX_LEVEL=0
+//     removes every stage message from the build
+//   - --log=SPEC sets runtime levels: a level for all categories and/or
+//     category:level pairs, e.g. "info", "off,fetch:debug"
+//   - --log-file=FILE moves the messages off stdout to a file written by
+//     a background thread (AsyncFileWriter). On stdout they stay inline
+//     with the register and latch dumps.
+// =====================================================================
+enum LogLevel { LOG_OFF, LOG_ERROR, LOG_WARN, LOG_INFO, LOG_DEBUG, LOG_TRACE, LOG_LEVELS };
+
+enum LogCategory {
+    LOG_CYCLE, LOG_FETCH, LOG_DECODE, LOG_EXECUTE, LOG_MEMORY, LOG_WRITEBACK,
+    LOG_HAZARD, LOG_FORWARD, LOG_PREDICT, LOG_TRAP, LOG_CATEGORIES
+};
+
+#ifndef SIM_LOG_MAX_LEVEL
+#define SIM_LOG_MAX_LEVEL LOG_TRACE
+#endif
+
+#define SIM_LOG(category, level, message)                    \
+    do {                                                     \
+        if ((level) <= SIM_LOG_MAX_LEVEL && simLog.enabled(category, level)) { \
+            std::ostream &simLogOut = simLog.begin();        \
+            simLogOut << message;                            \
+            simLog.end();                                    \
+        }                                                    \
+    } while (0)
+
+class SimLogger {
+public:
+    SimLogger() { setAll(LOG_TRACE); }
+
+    bool enabled(LogCategory category, LogLevel level) const { return level <= levels[category]; }
+
+    void setAll(LogLevel level) {
+        for (int c = 0; c < LOG_CATEGORIES; c++) levels[c] = level;
+    }
+
+    // "level", "category:level" or a comma-separated list, applied left to right.
+    // A spec with any unknown name is rejected whole and changes nothing.
+    bool configure(const std::string &spec) {
+        LogLevel parsed[LOG_CATEGORIES];
+        std::copy(levels, levels + LOG_CATEGORIES, parsed);
+        size_t pos = 0;
+        while (pos < spec.size()) {
+            size_t comma = spec.find(',', pos);
+            std::string item = spec.substr(pos, comma == std::string::npos ? std::string::npos : comma - pos);
+            pos = (comma == std::string::npos) ? spec.size() : comma + 1;
+            size_t colon = item.find(':');
+            int level = levelIndex(colon == std::string::npos ? item : item.substr(colon + 1));
+            if (level < 0) return false;
+            if (colon == std::string::npos) {
+                std::fill(parsed, parsed + LOG_CATEGORIES, static_cast<LogLevel>(level));
+                continue;
+            }
+            int category = categoryIndex(item.substr(0, colon));
+            if (category < 0) return false;
+            parsed[category] = static_cast<LogLevel>(level);
+        }
+        std::copy(parsed, parsed + LOG_CATEGORIES, levels);
+        return true;
+    }
+
+    bool openFile(const std::string &filename) { return file.open(filename); }
+    bool toFile() const { return file.isOpen(); }
+    void close() { file.close(); }
+
+    // Stream for one message: std::cout itself, or a line buffer that end() hands to the writer
+    std::ostream &begin() {
+        if (!file.isOpen()) return std::cout;
+        line.str(std::string());
+        line.clear();
+        return line;
+    }
+    void end() {
+        if (file.isOpen()) file.write(line.str());
+    }
+
+private:
+    LogLevel levels[LOG_CATEGORIES];
+    AsyncFileWriter file;
+    std::ostringstream line;
+
+    static int levelIndex(const std::string &name) {
+        static const char *const names[LOG_LEVELS] = {"off", "error", "warn", "info", "debug", "trace"};
+        for (int l = 0; l < LOG_LEVELS; l++)
+            if (name == names[l]) return l;
+        return -1;
+    }
+    static int categoryIndex(const std::string &name) {
+        static const char *const names[LOG_CATEGORIES] = {"cycle", "fetch", "decode", "execute", "memory",
+                                                          "writeback", "hazard", "forward", "predict", "trap"};
+        for (int c = 0; c < LOG_CATEGORIES; c++)
+            if (name == names[c]) return c;
+        return -1;
+    }
+};
+
+#endif // SIMLOG_H
@@ -0,0 +1,303 @@
+#ifndef SYSCALLS_H
+#define SYSCALLS_H
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <iostream>
+#include "xlen.h"
+#include "simlog.h"
+
+// =====================================================================
+// ECALL system-call emulation (newlib / Linux RISC-V numbering)
+//   - Used when no trap handler is installed (mtvec = 0)
+//   - a7 = number, a0..a5 = arguments, result in a0 (-errno on failure)
+//   - Files open relative to a sandbox directory (--sandbox); without
+//     one, open fails with EACCES. Absolute paths and ".." are refused.
+//   - Guest stdout/stderr go through BufferedWriter
+// =====================================================================
+enum SyscallNumber : uint32_t {
+    SYS_OPENAT       = 56,
+    SYS_CLOSE        = 57,
+    SYS_READ         = 63,
+    SYS_WRITE        = 64,
+    SYS_EXIT         = 93,
+    SYS_EXIT_GROUP   = 94,
+    SYS_GETTIMEOFDAY = 169,
+    SYS_BRK          = 214,
+    SYS_OPEN         = 1024 // newlib's legacy open
+};
+
+// Linux errno values and open flags as the RISC-V ABI defines them
+static const int64_t GUEST_ENOENT = 2, GUEST_EBADF = 9, GUEST_EACCES = 13, GUEST_EFAULT = 14,
+                     GUEST_EINVAL = 22, GUEST_EMFILE = 24;
+static const uint32_t GUEST_O_ACCMODE = 0x3, GUEST_O_WRONLY = 0x1, GUEST_O_RDWR = 0x2,
+                      GUEST_O_CREAT = 0x40, GUEST_O_TRUNC = 0x200, GUEST_O_APPEND = 0x400;
+
+// =====================================================================
+// BufferedWriter: collects guest output and writes it in large blocks,
+// so printing-heavy programs do not pay one host write per call
+// =====================================================================
+class BufferedWriter {
+public:
+    explicit BufferedWriter(std::FILE *out) : out(out) {}
+    ~BufferedWriter() { flush(); }
+
+    void write(const char *data, size_t size) {
+        buffer.append(data, size);
+        if (buffer.size() >= BUFFER_BYTES) flush();
+    }
+
+    void flush() {
+        if (buffer.empty()) return;
+        std::fwrite(buffer.data(), 1, buffer.size(), out);
+        std::fflush(out);
+        buffer.clear();
+    }
+
+private:
+    static const size_t BUFFER_BYTES = 64 * 1024;
+    std::FILE *out;
+    std::string buffer;
+};
+
+// =====================================================================
+// SyscallHost: guest file descriptors, program break and exit status.
+// Memory is any type with
+//   bool readByte(uint64_t addr, uint8_t &value)
+//   bool writeByte(uint64_t addr, uint8_t value)
+// that returns false for an address the guest cannot access.
+// [Syscall] lines go to the simulator's logger in the trap category.
+// =====================================================================
+class SyscallHost {
+public:
+    std::string sandboxDir;   // Empty: no file access
+    bool exited = false;      // exit/exit_group, or an unsupported call
+    int64_t exitCode = 0;
+    uint64_t calls = 0;
+
+    explicit SyscallHost(SimLogger &log) : files(3, nullptr), log(log) {}
+    ~SyscallHost() {
+        flush();
+        for (size_t fd = 3; fd < files.size(); fd++)
+            if (files[fd]) std::fclose(files[fd]);
+    }
+
+    // The heap grows from base (end of the loaded data) up to limit
+    void setHeap(uint64_t base, uint64_t limit) {
+        brkBase = brkCurrent = (base + 15) & ~static_cast<uint64_t>(15);
+        brkLimit = limit;
+    }
+
+    void flush() {
+        guestStdout.flush();
+        guestStderr.flush();
+    }
+
+    // Runs system call num; returns the value for a0
+    template <typename Memory>
+    int64_t handle(uint64_t num, const uint64_t a[6], Memory &mem, uint64_t cycles, double clockNs) {
+        calls++;
+        int64_t result = 0;
+        switch (num) {
+            case SYS_EXIT:
+            case SYS_EXIT_GROUP:
+                exited = true;
+                exitCode = static_cast<int64_t>(a[0]);
+                flush();
+                if (std::ostream *out = logBegin(LOG_DEBUG)) {
+                    *out << "[Syscall] exit(" << std::dec << exitCode << ")\n";
+                    log.end();
+                }
+                return 0;
+            case SYS_WRITE:
+                result = sysWrite(a[0], a[1], a[2], mem);
+                break;
+            case SYS_READ:
+                result = sysRead(a[0], a[1], a[2], mem);
+                break;
+            case SYS_OPEN:
+                result = sysOpen(a[0], static_cast<uint32_t>(a[1]), mem);
+                break;
+            case SYS_OPENAT: // dirfd is ignored: every path is relative to the sandbox
+                result = sysOpen(a[1], static_cast<uint32_t>(a[2]), mem);
+                break;
+            case SYS_CLOSE:
+                result = sysClose(a[0]);
+                break;
+            case SYS_BRK:
+                if (a[0] >= brkBase && a[0] < brkLimit) brkCurrent = a[0];
+                result = static_cast<int64_t>(brkCurrent);
+                break;
+            case SYS_GETTIMEOFDAY: {
+                // struct timeval { int64_t tv_sec; long tv_usec; } from the simulated clock
+                uint64_t us = static_cast<uint64_t>(cycles * clockNs / 1000.0);
+                if (a[0] != 0 && (!storeWord(mem, a[0], us / 1000000, 8) ||
+                                  !storeWord(mem, a[0] + 8, us % 1000000, XLEN / 8)))
+                    result = -GUEST_EFAULT;
+                break;
+            }
+            default:
+                // Like a proxy kernel: an unknown call ends the program
+                flush();
+                if (std::ostream *out = logBegin(LOG_DEBUG)) {
+                    *out << "[Syscall] Unsupported system call " << std::dec << num << ". Halting.\n";
+                    log.end();
+                }
+                exited = true;
+                exitCode = -1;
+                return 0;
+        }
+        if (std::ostream *out = logBegin(LOG_DEBUG)) {
+            *out << "[Syscall] " << name(num) << "(0x" << std::hex << a[0] << ", 0x" << a[1] << ", 0x" << a[2]
+                 << ") = " << std::dec << result << "\n";
+            log.end();
+        }
+        return result;
+    }
+
+private:
+    std::vector<std::FILE *> files; // Guest fd -> host file; 0-2 are the standard streams
+    SimLogger &log;
+    BufferedWriter guestStdout{stdout};
+    BufferedWriter guestStderr{stderr};
+    uint64_t brkBase = 0, brkCurrent = 0, brkLimit = 0;
+
+    // Stream for one [Syscall] line, or null if the trap category is below level
+    std::ostream *logBegin(LogLevel level) {
+        if (level > SIM_LOG_MAX_LEVEL || !log.enabled(LOG_TRAP, level)) return nullptr;
+        return &log.begin();
+    }
+
+    static const char *name(uint64_t num) {
+        switch (num) {
+            case SYS_OPENAT: return "openat";
+            case SYS_CLOSE: return "close";
+            case SYS_READ: return "read";
+            case SYS_WRITE: return "write";
+            case SYS_GETTIMEOFDAY: return "gettimeofday";
+            case SYS_BRK: return "brk";
+            case SYS_OPEN: return "open";
+            default: return "?";
+        }
+    }
+
+    template <typename Memory>
+    static bool storeWord(Memory &mem, uint64_t addr, uint64_t value, int size) {
+        for (int i = 0; i < size; i++)
+            if (!mem.writeByte(addr + i, static_cast<uint8_t>(value >> (8 * i)))) return false;
+        return true;
+    }
+
+    // write/read copy through a bounded host buffer, whatever len the guest
+    // passes. They stop at the first byte the guest cannot access and return
+    // the bytes done so far, or -EFAULT if there are none.
+    static const uint64_t CHUNK_BYTES = 64 * 1024;
+
+    static size_t chunkSize(uint64_t remaining) {
+        return static_cast<size_t>(remaining < CHUNK_BYTES ? remaining : CHUNK_BYTES);
+    }
+    static int64_t faulted(uint64_t done) {
+        return done ? static_cast<int64_t>(done) : -GUEST_EFAULT;
+    }
+
+    template <typename Memory>
+    int64_t sysWrite(uint64_t fd, uint64_t buf, uint64_t len, Memory &mem) {
+        if (fd >= files.size() || fd == 0 || (fd >= 3 && !files[fd])) return -GUEST_EBADF;
+        std::vector<char> chunk(chunkSize(len));
+        uint64_t done = 0;
+        while (done < len) {
+            size_t want = chunkSize(len - done);
+            size_t n = 0;
+            uint8_t b;
+            while (n < want && mem.readByte(buf + done + n, b)) chunk[n++] = static_cast<char>(b);
+            if (fd == 1) {
+                guestStdout.write(chunk.data(), n);
+            } else if (fd == 2) {
+                guestStderr.write(chunk.data(), n);
+            } else {
+                size_t written = std::fwrite(chunk.data(), 1, n, files[fd]);
+                if (written < n) return static_cast<int64_t>(done + written); // Host write error
+            }
+            done += n;
+            if (n < want) return faulted(done);
+        }
+        return static_cast<int64_t>(done);
+    }
+
+    template <typename Memory>
+    int64_t sysRead(uint64_t fd, uint64_t buf, uint64_t len, Memory &mem) {
+        if (fd >= files.size() || fd == 1 || fd == 2 || (fd >= 3 && !files[fd])) return -GUEST_EBADF;
+        std::FILE *in = (fd == 0) ? stdin : files[fd];
+        if (fd == 0) flush(); // Show any prompt before blocking
+        std::vector<char> chunk(chunkSize(len));
+        uint64_t done = 0;
+        while (done < len) {
+            size_t want = chunkSize(len - done);
+            size_t n = std::fread(chunk.data(), 1, want, in);
+            size_t i = 0;
+            while (i < n && mem.writeByte(buf + done + i, static_cast<uint8_t>(chunk[i]))) i++;
+            done += i;
+            if (i < n) {
+                // Leave the bytes the guest could not take in the file
+                if (fd >= 3) std::fseek(in, -static_cast<long>(n - i), SEEK_CUR);
+                return faulted(done);
+            }
+            if (n < want) break; // End of file
+        }
+        return static_cast<int64_t>(done);
+    }
+
+    template <typename Memory>
+    int64_t sysOpen(uint64_t pathAddr, uint32_t flags, Memory &mem) {
+        std::string path;
+        for (uint64_t i = 0; i < 4096; i++) {
+            uint8_t b;
+            if (!mem.readByte(pathAddr + i, b)) return -GUEST_EFAULT;
+            if (b == 0) break;
+            path.push_back(static_cast<char>(b));
+        }
+        if (sandboxDir.empty() || path.empty() || path[0] == '/' || path[0] == '\\' ||
+            ("/" + path + "/").find("/../") != std::string::npos)
+            return -GUEST_EACCES;
+
+        // fopen modes for the O_ flags; O_CREAT without O_TRUNC keeps the contents
+        std::string host = sandboxDir + "/" + path;
+        uint32_t access = flags & GUEST_O_ACCMODE;
+        std::FILE *f = nullptr;
+        if (access == 0) {
+            f = std::fopen(host.c_str(), "rb");
+        } else if (flags & GUEST_O_APPEND) {
+            f = std::fopen(host.c_str(), access == GUEST_O_RDWR ? "a+b" : "ab");
+        } else if (flags & GUEST_O_TRUNC) {
+            f = std::fopen(host.c_str(), access == GUEST_O_RDWR ? "w+b" : "wb");
+        } else {
+            f = std::fopen(host.c_str(), "r+b");
+            if (!f && (flags & GUEST_O_CREAT)) f = std::fopen(host.c_str(), "w+b");
+        }
+        if (!f) return -GUEST_ENOENT;
+        for (size_t fd = 3; fd < files.size(); fd++) {
+            if (!files[fd]) {
+                files[fd] = f;
+                return static_cast<int64_t>(fd);
+            }
+        }
+        if (files.size() >= 1024) {
+            std::fclose(f);
+            return -GUEST_EMFILE;
+        }
+        files.push_back(f);
+        return static_cast<int64_t>(files.size() - 1);
+    }
+
+    int64_t sysClose(uint64_t fd) {
+        if (fd < 3) return 0; // The standard streams stay open
+        if (fd >= files.size() || !files[fd]) return -GUEST_EBADF;
+        std::fclose(files[fd]);
+        files[fd] = nullptr;
+        return 0;
+    }
+};
+
+#endif // SYSCALLS_H
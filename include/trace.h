@@ -0,0 +1,176 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <iostream>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// =====================================================================
+// Binary execution trace
+//   - Written by the functional (unpipelined) simulator
+//   - One fixed-size record per retired instruction
+//   - Replayed by the pipelined timing model without executing anything
+// =====================================================================
+static const uint32_t TRACE_MAGIC   = 0x52545652; // "RVTR"
+static const uint32_t TRACE_VERSION = 1;
+
+struct TraceHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t count;    // Number of records following the header
+};
+
+struct TraceRecord {
+    uint32_t pc;       // Address of the retired instruction
+    uint32_t ir;       // Instruction as fetched (16-bit parcel if compressed)
+    uint32_t memAddr;  // Effective (base) address for loads/stores, new vl for vsetvli, 0 otherwise
+    uint32_t nextPC;   // PC of the next retired instruction (branch outcome)
+};
+
+// =====================================================================
+// TraceWriter: buffers records and writes them in large blocks.
+// The record count in the header is patched in on close().
+// =====================================================================
+class TraceWriter {
+public:
+    ~TraceWriter() { close(); }
+
+    bool open(const std::string &filename) {
+        fout = std::fopen(filename.c_str(), "wb");
+        if (!fout) {
+            std::cerr << "ERROR: Could not open/create " << filename << "\n";
+            return false;
+        }
+        TraceHeader header = {TRACE_MAGIC, TRACE_VERSION, 0};
+        std::fwrite(&header, sizeof(header), 1, fout);
+        buffer.reserve(BUFFER_RECORDS);
+        count = 0;
+        return true;
+    }
+
+    bool isOpen() const { return fout != nullptr; }
+
+    void append(uint32_t pc, uint32_t ir, uint32_t memAddr, uint32_t nextPC) {
+        buffer.push_back({pc, ir, memAddr, nextPC});
+        if (buffer.size() == BUFFER_RECORDS) flush();
+    }
+
+    void close() {
+        if (!fout) return;
+        flush();
+        TraceHeader header = {TRACE_MAGIC, TRACE_VERSION, count};
+        std::fseek(fout, 0, SEEK_SET);
+        std::fwrite(&header, sizeof(header), 1, fout);
+        std::fclose(fout);
+        fout = nullptr;
+    }
+
+private:
+    static const size_t BUFFER_RECORDS = 1 << 16;
+    std::FILE *fout = nullptr;
+    std::vector<TraceRecord> buffer;
+    uint64_t count = 0;
+
+    void flush() {
+        if (buffer.empty()) return;
+        std::fwrite(buffer.data(), sizeof(TraceRecord), buffer.size(), fout);
+        count += buffer.size();
+        buffer.clear();
+    }
+};
+
+// =====================================================================
+// TraceReader: maps a trace file read-only so that traces larger than
+// RAM are paged in on demand while the timing model streams through.
+// =====================================================================
+class TraceReader {
+public:
+    ~TraceReader() { close(); }
+
+    bool open(const std::string &filename) {
+#ifndef _WIN32
+        int fd = ::open(filename.c_str(), O_RDONLY);
+        if (fd < 0) {
+            std::cerr << "ERROR: Could not open " << filename << "\n";
+            return false;
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(TraceHeader)) {
+            std::cerr << "ERROR: " << filename << " is not a trace file\n";
+            ::close(fd);
+            return false;
+        }
+        mappedSize = static_cast<size_t>(st.st_size);
+        void *p = mmap(nullptr, mappedSize, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (p == MAP_FAILED) {
+            std::cerr << "ERROR: Could not map " << filename << "\n";
+            return false;
+        }
+        madvise(p, mappedSize, MADV_SEQUENTIAL);
+        base = static_cast<const uint8_t *>(p);
+#else
+        // No mmap: fall back to reading the whole file
+        std::FILE *fin = std::fopen(filename.c_str(), "rb");
+        if (!fin) {
+            std::cerr << "ERROR: Could not open " << filename << "\n";
+            return false;
+        }
+        std::fseek(fin, 0, SEEK_END);
+        owned.resize(static_cast<size_t>(std::ftell(fin)));
+        std::fseek(fin, 0, SEEK_SET);
+        if (std::fread(owned.data(), 1, owned.size(), fin) != owned.size()) owned.clear();
+        std::fclose(fin);
+        mappedSize = owned.size();
+        base = owned.data();
+        if (mappedSize < sizeof(TraceHeader)) {
+            std::cerr << "ERROR: " << filename << " is not a trace file\n";
+            return false;
+        }
+#endif
+        std::memcpy(&header, base, sizeof(header));
+        uint64_t available = (mappedSize - sizeof(TraceHeader)) / sizeof(TraceRecord);
+        if (header.magic != TRACE_MAGIC || header.version != TRACE_VERSION || header.count > available) {
+            std::cerr << "ERROR: " << filename << " has a bad trace header\n";
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    const TraceRecord *records() const {
+        return reinterpret_cast<const TraceRecord *>(base + sizeof(TraceHeader));
+    }
+
+    uint64_t size() const { return header.count; }
+
+    void close() {
+#ifndef _WIN32
+        if (base) munmap(const_cast<uint8_t *>(base), mappedSize);
+#else
+        owned.clear();
+#endif
+        base = nullptr;
+        mappedSize = 0;
+    }
+
+private:
+    const uint8_t *base = nullptr;
+    size_t mappedSize = 0;
+    TraceHeader header = {0, 0, 0};
+#ifdef _WIN32
+    std::vector<uint8_t> owned;
+#endif
+};
+
+#endif // TRACE_H
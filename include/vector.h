@@ -0,0 +1,450 @@
+#ifndef VECTOR_H
+#define VECTOR_H
+
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include "opcodes.h"
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+// =====================================================================
+// V extension subset shared by both simulators: vsetvli, unit-stride
+// and strided loads/stores, integer add/sub/mul/and/or/xor, moves and
+// reductions for SEW = 8/16/32 with LMUL = 1/2/4/8. The register file
+// is one contiguous byte array, so a register group is simply LMUL
+// consecutive registers. Element loops run on host SIMD (AVX2, then
+// SSE2/SSE4.1) with a scalar fallback for the tail and for operations
+// the host lacks; build with -march=native to get the wide kernels.
+// Elements are stored little-endian, as on all supported hosts.
+// =====================================================================
+static const uint32_t VLEN = 256;           // Bits per vector register
+static const uint32_t VLENB = VLEN / 8;     // Bytes per vector register
+static const uint32_t NUM_VREGS = 32;
+static const uint32_t VTYPE_VILL = 1u << 31; // CSRs are 32 bits wide
+
+// funct3 of OP-V: where the second operand comes from
+enum VecOperandKind : uint32_t {
+    OPIVV = 0, // Vector, integer
+    OPMVV = 2, // Vector, multiply/reduce/move
+    OPIVI = 3, // 5-bit signed immediate in the vs1 field
+    OPIVX = 4, // x[rs1]
+    OPMVX = 6  // x[rs1], multiply/move
+};
+
+enum VecOp { VOP_ADD, VOP_SUB, VOP_AND, VOP_OR, VOP_XOR, VOP_MUL,
+             VOP_MINU, VOP_MIN, VOP_MAXU, VOP_MAX, VOP_MOVE };
+
+// vtype: vlmul[2:0], vsew[5:3], vta[6], vma[7]. Tail and mask
+// agnostic are accepted and implemented as undisturbed.
+inline uint32_t vtypeSEW(uint32_t vtype) { return 8u << ((vtype >> 3) & 0x7); }
+inline uint32_t vtypeLMUL(uint32_t vtype) { return 1u << (vtype & 0x7); }
+inline bool isSupportedVtype(uint32_t vtype) {
+    return (vtype >> 8) == 0 && (vtype & 0x7) <= 3 && ((vtype >> 3) & 0x7) <= 2;
+}
+inline uint32_t vtypeVLMAX(uint32_t vtype) {
+    return VLENB * vtypeLMUL(vtype) / (vtypeSEW(vtype) / 8);
+}
+
+// Instruction word fields
+inline bool vecMasked(uint32_t instr) { return ((instr >> 25) & 1) == 0; }
+inline bool vecMemStrided(uint32_t instr) { return ((instr >> 26) & 0x3) == 2; }
+// Loads/stores: log2 of the element width in bytes from the width field (0, 5, 6)
+inline uint8_t vecMemSize(uint32_t funct3) { return funct3 == 0 ? 0 : static_cast<uint8_t>(funct3 - 4); }
+
+// Which x registers an instruction uses (the rest of its register
+// fields name vector registers)
+inline bool vecReadsXRs1(const OpcodeInfo &info) {
+    if (info.format == FMT_V_ARITH || info.format == FMT_V_MOVE)
+        return info.funct3 == OPIVX || info.funct3 == OPMVX;
+    return info.format != FMT_V_TO_X;
+}
+inline bool vecReadsXRs2(const OpcodeInfo &info) {
+    return (info.format == FMT_VLOAD || info.format == FMT_VSTORE) && info.funct7 == 2;
+}
+inline bool vecWritesXRd(const OpcodeInfo &info) {
+    return info.format == FMT_VSETVLI || info.format == FMT_V_TO_X;
+}
+
+inline bool isVectorReduction(InstrId id) {
+    return id >= INSTR_VREDSUM_VS && id <= INSTR_VREDMAX_VS;
+}
+inline bool isVectorMemory(InstrId id) {
+    return id >= INSTR_VLE8_V && id <= INSTR_VSSE32_V;
+}
+
+inline VecOp vecOpFor(InstrId id) {
+    switch (id) {
+        case INSTR_VADD_VV: case INSTR_VADD_VX: case INSTR_VADD_VI: case INSTR_VREDSUM_VS: return VOP_ADD;
+        case INSTR_VSUB_VV: case INSTR_VSUB_VX: return VOP_SUB;
+        case INSTR_VAND_VV: case INSTR_VAND_VX: case INSTR_VAND_VI: case INSTR_VREDAND_VS: return VOP_AND;
+        case INSTR_VOR_VV:  case INSTR_VOR_VX:  case INSTR_VOR_VI:  case INSTR_VREDOR_VS:  return VOP_OR;
+        case INSTR_VXOR_VV: case INSTR_VXOR_VX: case INSTR_VXOR_VI: case INSTR_VREDXOR_VS: return VOP_XOR;
+        case INSTR_VMUL_VV: case INSTR_VMUL_VX: return VOP_MUL;
+        case INSTR_VREDMINU_VS: return VOP_MINU;
+        case INSTR_VREDMIN_VS:  return VOP_MIN;
+        case INSTR_VREDMAXU_VS: return VOP_MAXU;
+        case INSTR_VREDMAX_VS:  return VOP_MAX;
+        default: return VOP_MOVE; // vmv.v.*
+    }
+}
+
+// Element access within a register group (bytes = element width)
+inline uint64_t vecGetElement(const uint8_t *group, uint32_t i, uint32_t bytes) {
+    uint64_t value = 0;
+    for (uint32_t b = 0; b < bytes; b++) value |= static_cast<uint64_t>(group[i * bytes + b]) << (8 * b);
+    return value;
+}
+inline void vecSetElement(uint8_t *group, uint32_t i, uint32_t bytes, uint64_t value) {
+    for (uint32_t b = 0; b < bytes; b++) group[i * bytes + b] = static_cast<uint8_t>(value >> (8 * b));
+}
+inline bool vecMaskActive(const uint8_t *v0, uint32_t i) {
+    return (v0[i >> 3] >> (i & 7)) & 1;
+}
+
+// =====================================================================
+// Scalar kernels: the reference semantics, the tail of every SIMD loop
+// and the fallback for operations the host has no instruction for
+// =====================================================================
+template <typename T>
+inline T vecElementOp(VecOp op, T a, T b) {
+    typedef typename std::make_signed<T>::type S;
+    switch (op) {
+        case VOP_ADD:  return static_cast<T>(a + b);
+        case VOP_SUB:  return static_cast<T>(a - b);
+        case VOP_AND:  return a & b;
+        case VOP_OR:   return a | b;
+        case VOP_XOR:  return a ^ b;
+        case VOP_MUL:  return static_cast<T>(static_cast<uint32_t>(a) * static_cast<uint32_t>(b));
+        case VOP_MINU: return a < b ? a : b;
+        case VOP_MIN:  return static_cast<S>(a) < static_cast<S>(b) ? a : b;
+        case VOP_MAXU: return a > b ? a : b;
+        case VOP_MAX:  return static_cast<S>(a) > static_cast<S>(b) ? a : b;
+        default:       return b; // VOP_MOVE
+    }
+}
+
+template <typename T>
+inline void vecBinaryScalar(VecOp op, uint8_t *dst, const uint8_t *a, const uint8_t *b, uint32_t n) {
+    for (uint32_t i = 0; i < n; i++) {
+        T x, y;
+        std::memcpy(&x, a + i * sizeof(T), sizeof(T));
+        std::memcpy(&y, b + i * sizeof(T), sizeof(T));
+        T r = vecElementOp(op, x, y);
+        std::memcpy(dst + i * sizeof(T), &r, sizeof(T));
+    }
+}
+
+template <typename T>
+inline uint64_t vecReduceScalar(VecOp op, const uint8_t *src, uint32_t n, uint64_t init) {
+    T acc = static_cast<T>(init);
+    for (uint32_t i = 0; i < n; i++) {
+        T x;
+        std::memcpy(&x, src + i * sizeof(T), sizeof(T));
+        acc = vecElementOp(op, acc, x);
+    }
+    return acc;
+}
+
+// Value an inactive element takes so that it does not change a reduction
+inline uint64_t vecIdentity(VecOp op, uint32_t sew) {
+    uint64_t ones = (sew == 64) ? ~0ull : (1ull << sew) - 1;
+    switch (op) {
+        case VOP_AND: case VOP_MINU: return ones;
+        case VOP_MIN: return ones >> 1;        // Largest signed value
+        case VOP_MAX: return 1ull << (sew - 1); // Smallest signed value
+        default:      return 0;
+    }
+}
+
+// =====================================================================
+// SIMD kernels: one register-width chunk. They return false when the
+// host has no instruction for the operation at this SEW.
+// =====================================================================
+#if defined(__AVX2__)
+inline bool vecChunk256(VecOp op, uint32_t sew, __m256i a, __m256i b, __m256i &r) {
+    switch (op) {
+        case VOP_ADD:
+            r = sew == 8 ? _mm256_add_epi8(a, b) : sew == 16 ? _mm256_add_epi16(a, b) : _mm256_add_epi32(a, b);
+            return true;
+        case VOP_SUB:
+            r = sew == 8 ? _mm256_sub_epi8(a, b) : sew == 16 ? _mm256_sub_epi16(a, b) : _mm256_sub_epi32(a, b);
+            return true;
+        case VOP_AND: r = _mm256_and_si256(a, b); return true;
+        case VOP_OR:  r = _mm256_or_si256(a, b); return true;
+        case VOP_XOR: r = _mm256_xor_si256(a, b); return true;
+        case VOP_MUL:
+            if (sew == 8) { // No byte multiply: even and odd bytes as 16-bit lanes
+                __m256i even = _mm256_mullo_epi16(a, b);
+                __m256i odd = _mm256_mullo_epi16(_mm256_srli_epi16(a, 8), _mm256_srli_epi16(b, 8));
+                r = _mm256_or_si256(_mm256_and_si256(even, _mm256_set1_epi16(0x00FF)), _mm256_slli_epi16(odd, 8));
+            } else {
+                r = sew == 16 ? _mm256_mullo_epi16(a, b) : _mm256_mullo_epi32(a, b);
+            }
+            return true;
+        case VOP_MINU:
+            r = sew == 8 ? _mm256_min_epu8(a, b) : sew == 16 ? _mm256_min_epu16(a, b) : _mm256_min_epu32(a, b);
+            return true;
+        case VOP_MIN:
+            r = sew == 8 ? _mm256_min_epi8(a, b) : sew == 16 ? _mm256_min_epi16(a, b) : _mm256_min_epi32(a, b);
+            return true;
+        case VOP_MAXU:
+            r = sew == 8 ? _mm256_max_epu8(a, b) : sew == 16 ? _mm256_max_epu16(a, b) : _mm256_max_epu32(a, b);
+            return true;
+        case VOP_MAX:
+            r = sew == 8 ? _mm256_max_epi8(a, b) : sew == 16 ? _mm256_max_epi16(a, b) : _mm256_max_epi32(a, b);
+            return true;
+        case VOP_MOVE: r = b; return true;
+    }
+    return false;
+}
+#endif
+
+#if defined(__SSE2__)
+inline bool vecChunk128(VecOp op, uint32_t sew, __m128i a, __m128i b, __m128i &r) {
+    switch (op) {
+        case VOP_ADD:
+            r = sew == 8 ? _mm_add_epi8(a, b) : sew == 16 ? _mm_add_epi16(a, b) : _mm_add_epi32(a, b);
+            return true;
+        case VOP_SUB:
+            r = sew == 8 ? _mm_sub_epi8(a, b) : sew == 16 ? _mm_sub_epi16(a, b) : _mm_sub_epi32(a, b);
+            return true;
+        case VOP_AND: r = _mm_and_si128(a, b); return true;
+        case VOP_OR:  r = _mm_or_si128(a, b); return true;
+        case VOP_XOR: r = _mm_xor_si128(a, b); return true;
+        case VOP_MUL:
+            if (sew == 8) {
+                __m128i even = _mm_mullo_epi16(a, b);
+                __m128i odd = _mm_mullo_epi16(_mm_srli_epi16(a, 8), _mm_srli_epi16(b, 8));
+                r = _mm_or_si128(_mm_and_si128(even, _mm_set1_epi16(0x00FF)), _mm_slli_epi16(odd, 8));
+                return true;
+            }
+            if (sew == 16) { r = _mm_mullo_epi16(a, b); return true; }
+#if defined(__SSE4_1__)
+            r = _mm_mullo_epi32(a, b);
+            return true;
+#else
+            return false;
+#endif
+#if defined(__SSE4_1__)
+        case VOP_MINU:
+            r = sew == 8 ? _mm_min_epu8(a, b) : sew == 16 ? _mm_min_epu16(a, b) : _mm_min_epu32(a, b);
+            return true;
+        case VOP_MIN:
+            r = sew == 8 ? _mm_min_epi8(a, b) : sew == 16 ? _mm_min_epi16(a, b) : _mm_min_epi32(a, b);
+            return true;
+        case VOP_MAXU:
+            r = sew == 8 ? _mm_max_epu8(a, b) : sew == 16 ? _mm_max_epu16(a, b) : _mm_max_epu32(a, b);
+            return true;
+        case VOP_MAX:
+            r = sew == 8 ? _mm_max_epi8(a, b) : sew == 16 ? _mm_max_epi16(a, b) : _mm_max_epi32(a, b);
+            return true;
+#endif
+        case VOP_MOVE: r = b; return true;
+        default: return false;
+    }
+}
+#endif
+
+inline const char *vecKernelName() {
+#if defined(__AVX2__)
+    return "AVX2";
+#elif defined(__SSE4_1__)
+    return "SSE4.1";
+#elif defined(__SSE2__)
+    return "SSE2";
+#else
+    return "scalar";
+#endif
+}
+
+// dst[i] = a[i] op b[i] for i < vl. dst may alias a or b.
+inline void vecBinary(VecOp op, uint32_t sew, uint8_t *dst, const uint8_t *a, const uint8_t *b, uint32_t vl) {
+    const uint32_t bytes = vl * (sew / 8);
+    uint32_t i = 0;
+#if defined(__AVX2__)
+    for (__m256i r; i + 32 <= bytes; i += 32) {
+        if (!vecChunk256(op, sew, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(a + i)),
+                         _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b + i)), r))
+            break;
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), r);
+    }
+#endif
+#if defined(__SSE2__)
+    for (__m128i r; i + 16 <= bytes; i += 16) {
+        if (!vecChunk128(op, sew, _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i)),
+                         _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i)), r))
+            break;
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), r);
+    }
+#endif
+    const uint32_t rest = (bytes - i) / (sew / 8);
+    switch (sew) {
+        case 8:  vecBinaryScalar<uint8_t>(op, dst + i, a + i, b + i, rest); break;
+        case 16: vecBinaryScalar<uint16_t>(op, dst + i, a + i, b + i, rest); break;
+        default: vecBinaryScalar<uint32_t>(op, dst + i, a + i, b + i, rest); break;
+    }
+}
+
+// Fold src[0..vl) into init. The operations are associative and
+// commutative, so whole chunks are combined lane-wise first.
+inline uint64_t vecReduce(VecOp op, uint32_t sew, const uint8_t *src, uint32_t vl, uint64_t init) {
+    const uint32_t bytes = vl * (sew / 8);
+    uint32_t i = 0;
+    alignas(32) uint8_t lanes[32];
+    uint32_t laneBytes = 0;
+#if defined(__AVX2__)
+    __m256i probe = _mm256_setzero_si256();
+    if (bytes >= 32 && vecChunk256(op, sew, probe, probe, probe)) {
+        __m256i acc = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src));
+        for (i = 32; i + 32 <= bytes; i += 32)
+            vecChunk256(op, sew, acc, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i)), acc);
+        _mm256_store_si256(reinterpret_cast<__m256i *>(lanes), acc);
+        laneBytes = 32;
+    }
+#elif defined(__SSE2__)
+    __m128i probe = _mm_setzero_si128();
+    if (bytes >= 16 && vecChunk128(op, sew, probe, probe, probe)) {
+        __m128i acc = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src));
+        for (i = 16; i + 16 <= bytes; i += 16)
+            vecChunk128(op, sew, acc, _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i)), acc);
+        _mm_store_si128(reinterpret_cast<__m128i *>(lanes), acc);
+        laneBytes = 16;
+    }
+#endif
+    const uint32_t rest = (bytes - i) / (sew / 8);
+    switch (sew) {
+        case 8:
+            init = vecReduceScalar<uint8_t>(op, lanes, laneBytes, init);
+            return vecReduceScalar<uint8_t>(op, src + i, rest, init);
+        case 16:
+            init = vecReduceScalar<uint16_t>(op, lanes, laneBytes / 2, init);
+            return vecReduceScalar<uint16_t>(op, src + i, rest, init);
+        default:
+            init = vecReduceScalar<uint32_t>(op, lanes, laneBytes / 4, init);
+            return vecReduceScalar<uint32_t>(op, src + i, rest, init);
+    }
+}
+
+inline void vecSplat(uint32_t sew, uint8_t *dst, uint64_t value, uint32_t vl) {
+    for (uint32_t i = 0; i < vl; i++) vecSetElement(dst, i, sew / 8, value);
+}
+
+// A group of regs registers starts at a multiple of regs
+inline bool vecGroupOk(uint32_t vreg, uint32_t regs) {
+    return vreg % regs == 0 && vreg + regs <= NUM_VREGS;
+}
+
+// Pipelined timing: cycles an instruction holds EX when the vector
+// unit processes `lanes` elements per cycle
+inline uint32_t vecExecuteCycles(InstrId id, uint32_t vl, uint32_t lanes) {
+    if (id == INSTR_VSETVLI || id == INSTR_VMV_X_S || id == INSTR_VMV_S_X || vl == 0 || lanes == 0) return 1;
+    return (vl + lanes - 1) / lanes;
+}
+
+// =====================================================================
+// executeVector: everything but the memory access of loads and stores,
+// which the simulators do element by element through their own memory
+// (for those this only checks the register group). x1 is x[rs1];
+// xResult receives the x-register result of vsetvli and vmv.x.s.
+// Returns false if the instruction raises an illegal-instruction trap.
+// =====================================================================
+inline bool executeVector(InstrId id, uint32_t instr, uint64_t x1, uint8_t *vrf,
+                          uint32_t &vl, uint32_t &vtype, uint64_t &xResult) {
+    const uint32_t vd = (instr >> 7) & 0x1F;
+    const uint32_t funct3 = (instr >> 12) & 0x7;
+    const uint32_t vs1 = (instr >> 15) & 0x1F;
+    const uint32_t vs2 = (instr >> 20) & 0x1F;
+    const bool masked = vecMasked(instr);
+
+    // rs1 = x0 asks for VLMAX, unless rd is x0 too: then vl is kept
+    if (id == INSTR_VSETVLI) {
+        uint32_t vtypei = (instr >> 20) & 0x7FF;
+        if (!isSupportedVtype(vtypei)) {
+            vtype = VTYPE_VILL;
+            vl = 0;
+        } else {
+            uint32_t vlmax = vtypeVLMAX(vtypei);
+            uint64_t avl = (vs1 != 0) ? x1 : (vd != 0) ? vlmax : vl;
+            vtype = vtypei;
+            vl = static_cast<uint32_t>(avl < vlmax ? avl : vlmax);
+        }
+        xResult = vl;
+        return true;
+    }
+    if (vtype & VTYPE_VILL) return false;
+
+    const uint32_t sew = vtypeSEW(vtype);
+    const uint32_t sewBytes = sew / 8;
+    const uint32_t lmul = vtypeLMUL(vtype);
+    uint8_t *const v0 = vrf;
+    auto group = [vrf](uint32_t vreg) { return vrf + vreg * VLENB; };
+
+    if (isVectorMemory(id)) {
+        // EMUL = EEW / SEW * LMUL, at least one register
+        uint32_t eewBytes = 1u << vecMemSize(funct3);
+        uint32_t emul = eewBytes * lmul / sewBytes;
+        if (emul > 8) return false;
+        if (masked && vd == 0 && (instr & 0x7F) == 0x07) return false;
+        return vecGroupOk(vd, emul ? emul : 1);
+    }
+    if (id == INSTR_VMV_X_S) { // Sign-extended element 0, even when vl = 0
+        uint64_t e = vecGetElement(group(vs2), 0, sewBytes);
+        uint32_t shift = 64 - sew;
+        xResult = static_cast<uint64_t>(static_cast<int64_t>(e << shift) >> shift);
+        return true;
+    }
+    if (id == INSTR_VMV_S_X) {
+        if (vl > 0) vecSetElement(group(vd), 0, sewBytes, x1);
+        return true;
+    }
+
+    const VecOp op = vecOpFor(id);
+    if (isVectorReduction(id)) { // vd[0] = vs1[0] op vs2[0..vl)
+        if (!vecGroupOk(vs2, lmul)) return false;
+        if (vl == 0) return true;
+        uint64_t init = vecGetElement(group(vs1), 0, sewBytes);
+        const uint8_t *src = group(vs2);
+        alignas(32) uint8_t active[8 * VLENB];
+        if (masked) { // Inactive elements become the identity of the operation
+            uint64_t identity = vecIdentity(op, sew);
+            for (uint32_t i = 0; i < vl; i++)
+                vecSetElement(active, i, sewBytes, vecMaskActive(v0, i) ? vecGetElement(src, i, sewBytes) : identity);
+            src = active;
+        }
+        vecSetElement(group(vd), 0, sewBytes, vecReduce(op, sew, src, vl, init));
+        return true;
+    }
+
+    // Element-wise: vd[i] = vs2[i] op (vs1[i] | x[rs1] | simm5); vmv.v.* ignore vs2
+    const bool vectorOperand = (funct3 == OPIVV || funct3 == OPMVV);
+    if (!vecGroupOk(vd, lmul) || (op != VOP_MOVE && !vecGroupOk(vs2, lmul)) ||
+        (vectorOperand && !vecGroupOk(vs1, lmul)))
+        return false;
+    if (masked && vd == 0) return false; // The mask cannot be overwritten
+    if (vl == 0) return true;
+    alignas(32) uint8_t splat[8 * VLENB];
+    const uint8_t *b = group(vs1);
+    if (funct3 == OPIVI) {
+        int64_t simm5 = static_cast<int32_t>(vs1 << 27) >> 27;
+        vecSplat(sew, splat, static_cast<uint64_t>(simm5), vl);
+        b = splat;
+    } else if (!vectorOperand) {
+        vecSplat(sew, splat, x1, vl);
+        b = splat;
+    }
+    if (!masked) {
+        vecBinary(op, sew, group(vd), group(vs2), b, vl);
+        return true;
+    }
+    alignas(32) uint8_t result[8 * VLENB];
+    vecBinary(op, sew, result, group(vs2), b, vl);
+    for (uint32_t i = 0; i < vl; i++) {
+        if (vecMaskActive(v0, i)) std::memcpy(group(vd) + i * sewBytes, result + i * sewBytes, sewBytes);
+    }
+    return true;
+}
+
+#endif // VECTOR_H
@@ -0,0 +1,80 @@
+#ifndef XLEN_H
+#define XLEN_H
+
+#include <cstdint>
+#include <limits>
+
+// =====================================================================
+// Register width of the simulators. The default build is RV32; building
+// with -DRV64 gives 64-bit registers and addresses and enables the
+// RV64I instructions (LD/SD/LWU and the *W variants).
+// =====================================================================
+#ifdef RV64
+static const int XLEN = 64;
+typedef int64_t  reg_t;             // Register value
+typedef uint64_t ureg_t;            // Register value, unsigned
+typedef uint64_t addr_t;            // Address
+typedef __int128 wide_t;            // Holds a full XLEN x XLEN product
+typedef unsigned __int128 uwide_t;
+#else
+static const int XLEN = 32;
+typedef int32_t  reg_t;
+typedef uint32_t ureg_t;
+typedef uint32_t addr_t;
+typedef int64_t  wide_t;
+typedef uint64_t uwide_t;
+#endif
+
+static const reg_t REG_MIN = std::numeric_limits<reg_t>::min();
+
+// Upper XLEN bits of the product (MULH, MULHSU, MULHU)
+inline reg_t mulHighSigned(reg_t a, reg_t b) {
+    return static_cast<reg_t>((static_cast<wide_t>(a) * b) >> XLEN);
+}
+inline reg_t mulHighSignedUnsigned(reg_t a, reg_t b) {
+    return static_cast<reg_t>((static_cast<wide_t>(a) * static_cast<wide_t>(static_cast<ureg_t>(b))) >> XLEN);
+}
+inline reg_t mulHighUnsigned(reg_t a, reg_t b) {
+    return static_cast<reg_t>((static_cast<uwide_t>(static_cast<ureg_t>(a)) * static_cast<ureg_t>(b)) >> XLEN);
+}
+
+// Zbb helpers. width is XLEN, or 32 for the RV64 *W forms. The builtins
+// lower to lzcnt/tzcnt/popcnt when the host build enables them (-march).
+inline uint64_t lowBits(ureg_t v, int width) {
+    return (width >= 64) ? static_cast<uint64_t>(v) : (static_cast<uint64_t>(v) & ((1ULL << width) - 1));
+}
+inline reg_t countLeadingZeros(ureg_t v, int width) {
+    uint64_t x = lowBits(v, width);
+    return x ? __builtin_clzll(x) - (64 - width) : width;
+}
+inline reg_t countTrailingZeros(ureg_t v, int width) {
+    uint64_t x = lowBits(v, width);
+    return x ? __builtin_ctzll(x) : width;
+}
+inline reg_t countOnes(ureg_t v, int width) {
+    return __builtin_popcountll(lowBits(v, width));
+}
+inline reg_t rotateLeft(ureg_t v, unsigned shamt, int width) {
+    uint64_t x = lowBits(v, width);
+    shamt &= width - 1;
+    return static_cast<reg_t>(shamt ? lowBits(static_cast<ureg_t>((x << shamt) | (x >> (width - shamt))), width) : x);
+}
+inline reg_t rotateRight(ureg_t v, unsigned shamt, int width) {
+    return rotateLeft(v, (width - (shamt & (width - 1))) & (width - 1), width);
+}
+inline reg_t byteReverse(ureg_t v) {
+#ifdef RV64
+    return static_cast<reg_t>(__builtin_bswap64(v));
+#else
+    return static_cast<reg_t>(__builtin_bswap32(v));
+#endif
+}
+// ORC.B: each byte becomes 0xFF if any of its bits is set, else 0x00
+inline reg_t orCombineBytes(ureg_t v) {
+    ureg_t r = 0;
+    for (int i = 0; i < XLEN; i += 8)
+        if ((v >> i) & 0xFF) r |= static_cast<ureg_t>(0xFF) << i;
+    return static_cast<reg_t>(r);
+}
+
+#endif // XLEN_H
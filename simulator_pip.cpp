@@ -9,6 +9,33 @@
 #include <algorithm>  // for std::sort
 #include <set>
 #include <unordered_map> // For branch prediction table
+#include <cstring>
+#include "sim_options.h"
+#include "trace.h"
+#include "elf_loader.h"
+#include "syscalls.h"
+#include "devices.h"
+#include "profiler.h"
+#include "memprofile.h"
+#include "branchprofile.h"
+#include "pipetrace.h"
+#include "flightrec.h"
+#include "commitlog.h"
+#include "hostprof.h"
+#include "dataflow.h"
+#include "simlog.h"
+#include "csr.h"
+#include "fpu.h"
+#include "vector.h"
+#include "opcodes.h"
+#include "xlen.h"
+#include "rvc.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
 
 namespace pipelined {
 // =====================================================================
@@ -29,26 +56,74 @@ enum ALUOpType {
     ALU_SLT,
     ALU_PASS, // Pass-through for LUI/AUIPC
     ALU_EQ,   // Equality comparison (RA == RB)
-    ALU_GE    // Greater-than-or-equal comparison (RA >= RB)
+    ALU_GE,   // Greater-than-or-equal comparison (RA >= RB)
+    ALU_SLTU, // Unsigned less-than
+    ALU_GEU,  // Unsigned greater-than-or-equal
+    ALU_MULH,
+    ALU_MULHSU,
+    ALU_MULHU,
+    ALU_DIVU,
+    ALU_REMU,
+    ALU_SH1ADD, // Zba: (RA << n) + RB
+    ALU_SH2ADD,
+    ALU_SH3ADD,
+    ALU_ANDN,   // Zbb
+    ALU_ORN,
+    ALU_XNOR,
+    ALU_MIN,
+    ALU_MINU,
+    ALU_MAX,
+    ALU_MAXU,
+    ALU_ROL,
+    ALU_ROR,
+    ALU_CLZ,
+    ALU_CTZ,
+    ALU_CPOP,
+    ALU_SEXTB,
+    ALU_SEXTH,
+    ALU_REV8,
+    ALU_ORCB,
+    ALU_OP_COUNT // Number of ALU operations (not an operation)
+};
+
+// Names used by the energy table and reports, in ALUOpType order
+static const char *const aluOpNames[ALU_OP_COUNT] = {
+    "add", "sub", "mul", "div", "rem", "and", "or", "xor",
+    "sll", "srl", "sra", "slt", "pass", "eq", "ge",
+    "sltu", "geu", "mulh", "mulhsu", "mulhu", "divu", "remu",
+    "sh1add", "sh2add", "sh3add", "andn", "orn", "xnor", "min", "minu", "max", "maxu",
+    "rol", "ror", "clz", "ctz", "cpop", "sextb", "sexth", "rev8", "orcb"
 };
 
 // =====================================================================
 // Global CPU State
 // =====================================================================
 static const int NUM_REGS = 32;
-int32_t R[NUM_REGS];       // Register file
-uint32_t PC = 0;           // Program Counter
+reg_t    R[NUM_REGS];      // Register file
+uint64_t F[NUM_REGS];      // FP register file (single-precision values NaN-boxed)
+// FP registers are numbered 32-63 in decoded instructions, so the hazard
+// and forwarding checks tell them apart from the x registers
+static const uint32_t FP_REG_BASE = 32;
+// Vector registers are never renamed into the hazard checks: arithmetic
+// reads and writes them in EX and loads/stores in MEM, and MEM runs
+// before EX within a cycle, so they are always accessed in program order
+alignas(32) uint8_t V[NUM_REGS][VLENB];
+addr_t   PC = 0;           // Program Counter
 uint32_t IR = 0;           // Instruction Register
-int32_t  RA = 0;           // Operand A
-int32_t  RB = 0;           // Operand B
-int32_t  RM = 0;           // Used for store data
-int32_t  RZ = 0;           // ALU output
-int32_t  RY = 0;           // Write-back data
-int32_t  MDR= 0;           // Memory data register
-uint32_t MAR = 0;          // Memory Address Register
+reg_t    RA = 0;           // Operand A
+reg_t    RB = 0;           // Operand B
+reg_t    RM = 0;           // Used for store data
+reg_t    RZ = 0;           // ALU output
+reg_t    RY = 0;           // Write-back data
+reg_t    MDR= 0;           // Memory data register
+addr_t   MAR = 0;          // Memory Address Register
 
 uint64_t clockCycle = 0;   // Cycle counter
 
+HostProfiler hostProfiler; // Simulator's own speed (--host-profile, --progress)
+SimLogger simLog;          // Stage diagnostics (--log, --log-file)
+std::string logFile;
+
 // Global control signals
 bool regWrite = false;
 bool memRead = false;
@@ -56,14 +131,17 @@ bool memWrite = false;
 bool branch = false;
 bool jump = false;
 uint8_t memToReg = 0; // 0: ALU result, 1: Memory, 2: PC+4
-uint8_t memSize = 2;  // 0: Byte, 1: Halfword, 2: Word
+uint8_t memSize = 2;  // 0: Byte, 1: Halfword, 2: Word, 3: Doubleword
 bool memSignExtend = false;
 ALUOpType aluOp = ALU_PASS;
 
 // =====================================================================
 // Instruction Memory (< 0x10000000)
+//   The bytes live in codeSegment like any other memory; instrMemory
+//   holds the parcels fetch has seen, so a fetch is one map lookup.
+//   Stores to code invalidate it (see invalidateCode).
 // =====================================================================
-std::map<uint32_t, uint32_t> instrMemory;
+std::map<addr_t, uint32_t> instrMemory;
 
 // =====================================================================
 // DataSegment Class (handles a map of address -> byte)
@@ -72,19 +150,21 @@ std::map<uint32_t, uint32_t> instrMemory;
 class MemSegment {
 public:
     // Each address in "memory" is one byte
-    std::map<uint32_t, uint8_t> memory;
+    std::map<addr_t, uint8_t> memory;
 
-    void writeByte(uint32_t address, uint8_t value) {
+    void writeByte(addr_t address, uint8_t value) {
         memory[address] = value;
     }
 
-    void writeWord(uint32_t address, int32_t value) {
-        for (int i = 0; i < 4; i++) {
-            memory[address + i] = static_cast<uint8_t>((value >> (8 * i)) & 0xFF);
-        }
+    void writeWord(addr_t address, int32_t value) {
+        writeBytes(address, static_cast<uint32_t>(value), 4);
     }
 
-    int8_t readByte(uint32_t address) const {
+    void writeDouble(addr_t address, int64_t value) {
+        writeBytes(address, static_cast<uint64_t>(value), 8);
+    }
+
+    int8_t readByte(addr_t address) const {
         auto it = memory.find(address);
         if (it != memory.end()) {
             return static_cast<int8_t>(it->second);
@@ -92,22 +172,58 @@ public:
         return 0;
     }
 
-    int32_t readWord(uint32_t address) const {
-        int32_t result = 0;
-        for (int i = 0; i < 4; i++) {
+    int32_t readWord(addr_t address) const {
+        return static_cast<int32_t>(readBytes(address, 4));
+    }
+
+    int64_t readDouble(addr_t address) const {
+        return static_cast<int64_t>(readBytes(address, 8));
+    }
+
+    // Little-endian access of size bytes. An aligned access cannot wrap
+    // around the address space, so it finds its first byte once and walks
+    // the map from there instead of looking up every byte.
+    uint64_t readBytes(addr_t address, int size) const {
+        uint64_t result = 0;
+        if ((address & (size - 1)) == 0) {
+            for (auto it = memory.lower_bound(address);
+                 it != memory.end() && it->first - address < static_cast<addr_t>(size); ++it) {
+                result |= static_cast<uint64_t>(it->second) << (8 * (it->first - address));
+            }
+            return result;
+        }
+        for (int i = 0; i < size; i++) {
             auto it = memory.find(address + i);
             uint8_t b = (it != memory.end()) ? it->second : 0;
-            result |= (b << (8 * i));
+            result |= static_cast<uint64_t>(b) << (8 * i);
         }
         return result;
     }
+
+    void writeBytes(addr_t address, uint64_t value, int size) {
+        if ((address & (size - 1)) == 0) {
+            auto hint = memory.lower_bound(address);
+            for (int i = 0; i < size; i++) {
+                hint = memory.emplace_hint(hint, address + i, 0);
+                hint->second = static_cast<uint8_t>(value >> (8 * i));
+                ++hint;
+            }
+            return;
+        }
+        for (int i = 0; i < size; i++) {
+            memory[address + i] = static_cast<uint8_t>(value >> (8 * i));
+        }
+    }
 };
 
 // =====================================================================
 // We will have two separate MemSegments for data and stack
 // =====================================================================
+MemSegment codeSegment;   // for addresses below 0x10000000 (instructions)
 MemSegment dataSegment;   // for addresses in [0x10000000, 0x7FFFFFFF)
 MemSegment stackSegment;  // for addresses >= 0x7FFFFFFF
+MemSegment mmioSegment;   // Never holds bytes: marks the MMIO window, see devices.h
+DeviceBus devices;
 
 // =====================================================================
 // Dumping memory to an .mc file
@@ -117,9 +233,10 @@ MemSegment stackSegment;  // for addresses >= 0x7FFFFFFF
 // =====================================================================
 void dumpSegmentToFile(const std::string &filename, 
                        const MemSegment &seg,
-                       uint32_t startAddr, 
-                       uint32_t endAddr /* inclusive or exclusive? */)
+                       addr_t startAddr, 
+                       addr_t endAddr /* inclusive or exclusive? */)
 {
+    HostPhaseScope phase(hostProfiler, HOST_DUMP);
     // Open file for overwrite
     std::ofstream fout(filename);
     if (!fout.is_open()) {
@@ -128,7 +245,7 @@ void dumpSegmentToFile(const std::string &filename,
     }
 
     // Gather addresses from seg.memory
-    std::vector<uint32_t> addresses;
+    std::vector<addr_t> addresses;
     addresses.reserve(seg.memory.size());
     for (const auto &kv : seg.memory) {
         addresses.push_back(kv.first);
@@ -138,9 +255,9 @@ void dumpSegmentToFile(const std::string &filename,
     // We'll write lines only for addresses in [startAddr, endAddr]
     // For the stack region, if endAddr < startAddr, we'll interpret that accordingly.
     // But here, let's just check the range as you prefer:
-    std::set<uint32_t> visited;
+    std::set<addr_t> visited;
 
-    for (uint32_t addr : addresses) {
+    for (addr_t addr : addresses) {
         if (addr < startAddr) {
             continue;
         }
@@ -182,32 +299,27 @@ void dumpSegmentToFile(const std::string &filename,
 }
 
 // =====================================================================
-// Dumping the instruction memory (which is map<uint32_t, uint32_t>)
-// to instruction.mc
+// Dumping the instruction memory to instruction.mc: one line per
+// parcel in codeSegment, so instructions the program wrote show up too
 // =====================================================================
 void dumpInstructionMemoryToFile(const std::string &filename) {
+    HostPhaseScope phase(hostProfiler, HOST_DUMP);
     std::ofstream fout(filename);
     if (!fout.is_open()) {
         std::cerr << "ERROR: Could not open/create " << filename << "\n";
         return;
     }
 
-    // gather addresses
-    std::vector<uint32_t> addresses;
-    addresses.reserve(instrMemory.size());
-    for (auto &kv : instrMemory) {
-        addresses.push_back(kv.first);
-    }
-    std::sort(addresses.begin(), addresses.end());
-
-    // write
-    for (auto addr : addresses) {
-        // each entry is already a full 32-bit instruction
-        uint32_t word = instrMemory[addr];
+    auto it = codeSegment.memory.begin();
+    while (it != codeSegment.memory.end()) {
+        addr_t addr = it->first;
+        uint32_t word = static_cast<uint32_t>(codeSegment.readBytes(addr, 2));
+        if ((word & 0x3) == 0x3) word = static_cast<uint32_t>(codeSegment.readBytes(addr, 4));
         fout << std::hex 
              << "0x" << std::setw(8) << std::setfill('0') << addr 
              << "  0x" << std::setw(8) << std::setfill('0') << word
              << std::dec << "\n";
+        it = codeSegment.memory.lower_bound(addr + instrLength(word));
     }
     fout.close();
 }
@@ -235,9 +347,14 @@ struct DecodedInstr {
     uint32_t rs2;
     uint32_t funct3;
     uint32_t funct7;
+    uint32_t rs3;       // Fused multiply-add third source (FP, so 0 or >= FP_REG_BASE)
     int32_t  imm;
 
-    int32_t RA, RB, RM; // Operands
+    reg_t RA, RB, RM;   // Operands
+    uint64_t FA, FB, FC; // FP operands (rs1, rs2, rs3); FB is also FP store data
+    uint8_t fpFlags;    // INSTR_FLAG_FRD/FRS1/FRS2/RM from the opcode table
+    FPUnit fpUnit;      // FPU_NONE unless executed by the FPU
+    bool vector;        // V instruction; rd/rs1/rs2 hold only its x-register operands
 
     // Control signals
     bool regWrite;      // Enable register write
@@ -247,27 +364,69 @@ struct DecodedInstr {
     bool jump;          // Enable jump
     ALUOpType aluOp;    // ALU operation type
     uint8_t memToReg;   // Select memory or ALU result for write-back
-    uint8_t memSize;    // Memory access size: 0=byte, 1=halfword, 2=word
+    uint8_t memSize;    // Memory access size: 0=byte, 1=halfword, 2=word, 3=doubleword
     bool memSignExtend; // Sign-extend memory read data
+    bool word;          // RV64 *W instruction: 32-bit operation, result sign-extended
     bool zero;          // ALU zero signal (result is 0)
+    InstrId id;         // Row of the shared opcode table (INSTR_INVALID if unknown)
+    bool illegal;       // Unknown instruction: raises an illegal-instruction trap in EX
 };
 
 DecodedInstr d; // Make d a global variable to persist across states
 
 // =====================================================================
-// Pipeline registers
+// CPI stack
+//   Every cycle is charged to exactly one category. A cycle in which WB
+//   retires an instruction is base. Otherwise WB holds a bubble, and each
+//   bubble carries the cause recorded by the stage that created it down
+//   the pipeline latches. Cycles in which a unit holds the whole pipeline
+//   are structural.
+// =====================================================================
+enum CpiCategory : uint8_t {
+    CPI_BASE,
+    CPI_RAW_MEM,          // RAW without forwarding, producer in MEM
+    CPI_RAW_WB,           // RAW without forwarding, producer in WB
+    CPI_LOAD_USE,         // Forwarding on, load data not ready until MEM
+    CPI_BRANCH_STALL,     // Fetch waits for a branch to resolve
+    CPI_MISPREDICT,       // Wrong-path instruction flushed
+    CPI_JUMP_FLUSH,       // JALR fetched from a stale register, flushed
+    CPI_STRUCT_MEMORY,    // Structural: memory latency
+    CPI_STRUCT_FPU,       // Structural: multi-cycle FP operation
+    CPI_STRUCT_VECTOR,    // Structural: vector unit busy
+    CPI_STRUCT_PAGE_WALK, // Structural: page-table walk
+    CPI_DRAIN,            // Fill and drain: start, end, traps, interrupts, serializing instructions
+    CPI_CATEGORIES
+};
+static const char *const cpiCategoryNames[CPI_CATEGORIES] = {
+    "base", "RAW stall (producer in MEM)", "RAW stall (producer in WB)", "load-use",
+    "branch stall", "mispredict flush", "JAL/JALR flush", "structural: memory",
+    "structural: FPU", "structural: vector", "structural: page walk", "drain"
+};
+// Sweep CSV column of each category
+static const char *const cpiCategoryColumns[CPI_CATEGORIES] = {
+    "cpi_base", "cpi_raw_mem", "cpi_raw_wb", "cpi_load_use", "cpi_branch_stall",
+    "cpi_mispredict", "cpi_jump_flush", "cpi_struct_memory", "cpi_struct_fpu",
+    "cpi_struct_vector", "cpi_struct_page_walk", "cpi_drain"
+};
+uint64_t cpiCycles[CPI_CATEGORIES] = {0};
+
+// =====================================================================
+// Pipeline registers (bubble: the CpiCategory of an invalid latch)
 // =====================================================================
 struct IF_ID {
-    uint32_t PC;
+    addr_t PC;
     uint32_t IR;
     bool valid;
     bool isControlInstr; // New signal to indicate if the instruction is a control instruction
+    uint8_t len = 4;     // Instruction length in bytes (2 if compressed; IR holds the expansion)
+    CpiCategory bubble = CPI_DRAIN;
+    uint64_t seq = 0; // Dynamic instruction number, for the pipeline trace
 } if_id = {0, 0, false, false};
 
 struct ID_EX {
-    uint32_t PC;
+    addr_t PC;
     uint32_t IR;
-    int32_t RA, RB, RM;
+    reg_t RA, RB, RM;
     DecodedInstr d;
     bool valid;
     bool forwardRAFromEX_MEM = false; // Forward RA from EX/MEM
@@ -276,23 +435,41 @@ struct ID_EX {
     bool forwardRBFromMEM_WB = false; // Forward RB from MEM/WB
     bool forwardRMFromEX_MEM = false; // Forward RM from EX/MEM
     bool forwardRMFromMEM_WB = false; // Forward RM from MEM/WB
+    uint8_t len = 4;
+    uint64_t FA = 0, FB = 0, FC = 0;  // FP operands
+    bool forwardRCFromEX_MEM = false; // Forward FC (rs3) from EX/MEM
+    bool forwardRCFromMEM_WB = false; // Forward FC (rs3) from MEM/WB
+    CpiCategory bubble = CPI_DRAIN;
+    uint64_t seq = 0; // Dynamic instruction number, for the pipeline trace
 } id_ex = {0, 0, 0, 0, 0, {}, false};
 
 struct EX_MEM {
-    uint32_t PC;
+    addr_t PC;
     uint32_t IR;
-    int32_t RZ, RM;
+    reg_t RZ, RM;
     DecodedInstr d;
     bool valid;
     bool forwardRMFromMEM_WB = false; // Forward RM from MEM/WB
+    uint8_t len = 4;
+    uint64_t FZ = 0; // FP unit output
+    uint64_t FM = 0; // FP store data
+    uint32_t vl = 0; // Vector length when the instruction was in EX
+    CpiCategory bubble = CPI_DRAIN;
+    uint64_t seq = 0; // Dynamic instruction number, for the pipeline trace
 } ex_mem = {0, 0, 0, 0, {}, false};
 
 struct MEM_WB {
-    uint32_t PC;
+    addr_t PC;
     uint32_t IR;
-    int32_t RY;
+    reg_t RY;
     DecodedInstr d;
     bool valid;
+    uint8_t len = 4;
+    uint64_t FY = 0; // FP write-back data
+    CpiCategory bubble = CPI_DRAIN;
+    uint64_t seq = 0; // Dynamic instruction number, for the pipeline trace
+    addr_t memAddr = 0; // Load/store address, for the flight recorder
+    uint64_t memData = 0; // Store data, for the commit log
 } mem_wb = {0, 0, 0, {}, false};
 
 // Function to detect RAW hazards
@@ -300,25 +477,35 @@ bool detectRAWHazard(const DecodedInstr &decodedInstr, const EX_MEM &ex_mem, con
     // Check if source registers in decoded instruction (rs1, rs2) match destination registers in EX/MEM or MEM/WB
     if (ex_mem.valid && ex_mem.d.regWrite && ex_mem.d.rd != 0) { // Check EX/MEM only if valid
         if (decodedInstr.rs1 == ex_mem.d.rd) {
-            std::cout << "[RAW Hazard] Dependency detected with EX stage. rs1=" << decodedInstr.rs1 
-                      << " matches rd=" << ex_mem.d.rd << "\n";
+            SIM_LOG(LOG_HAZARD, LOG_DEBUG, "[RAW Hazard] Dependency detected with EX stage. rs1=" << decodedInstr.rs1
+                    << " matches rd=" << ex_mem.d.rd << "\n");
             return true; // Hazard with EX stage
         }
         if (decodedInstr.rs2 == ex_mem.d.rd) {
-            std::cout << "[RAW Hazard] Dependency detected with EX stage. rs2=" << decodedInstr.rs2 
-                      << " matches rd=" << ex_mem.d.rd << "\n";
+            SIM_LOG(LOG_HAZARD, LOG_DEBUG, "[RAW Hazard] Dependency detected with EX stage. rs2=" << decodedInstr.rs2
+                    << " matches rd=" << ex_mem.d.rd << "\n");
+            return true; // Hazard with EX stage
+        }
+        if (decodedInstr.rs3 == ex_mem.d.rd) {
+            SIM_LOG(LOG_HAZARD, LOG_DEBUG, "[RAW Hazard] Dependency detected with EX stage. rs3=" << decodedInstr.rs3
+                    << " matches rd=" << ex_mem.d.rd << "\n");
             return true; // Hazard with EX stage
         }
     }
     if (mem_wb.valid && mem_wb.d.regWrite && mem_wb.d.rd != 0) { // Check MEM/WB only if valid
         if (decodedInstr.rs1 == mem_wb.d.rd) {
-            std::cout << "[RAW Hazard] Dependency detected with MEM stage. rs1=" << decodedInstr.rs1 
-                      << " matches rd=" << mem_wb.d.rd << "\n";
+            SIM_LOG(LOG_HAZARD, LOG_DEBUG, "[RAW Hazard] Dependency detected with MEM stage. rs1=" << decodedInstr.rs1
+                    << " matches rd=" << mem_wb.d.rd << "\n");
             return true; // Hazard with MEM stage
         }
         if (decodedInstr.rs2 == mem_wb.d.rd) {
-            std::cout << "[RAW Hazard] Dependency detected with MEM stage. rs2=" << decodedInstr.rs2 
-                      << " matches rd=" << mem_wb.d.rd << "\n";
+            SIM_LOG(LOG_HAZARD, LOG_DEBUG, "[RAW Hazard] Dependency detected with MEM stage. rs2=" << decodedInstr.rs2
+                    << " matches rd=" << mem_wb.d.rd << "\n");
+            return true; // Hazard with MEM stage
+        }
+        if (decodedInstr.rs3 == mem_wb.d.rd) {
+            SIM_LOG(LOG_HAZARD, LOG_DEBUG, "[RAW Hazard] Dependency detected with MEM stage. rs3=" << decodedInstr.rs3
+                    << " matches rd=" << mem_wb.d.rd << "\n");
             return true; // Hazard with MEM stage
         }
     }
@@ -361,6 +548,64 @@ public:
 // Global CHDU instance
 ControlHazardDetectionUnit chdu;
 
+// =====================================================================
+// ALU operation for each instruction. Branches are taken when the
+// ALU result is zero, so each compares for the opposite condition.
+// =====================================================================
+ALUOpType aluOpFor(InstrId id) {
+    switch (id) {
+        case INSTR_ADD: case INSTR_ADDI: case INSTR_ADDW: case INSTR_ADDIW:
+        case INSTR_LB: case INSTR_LH: case INSTR_LW: case INSTR_LBU: case INSTR_LHU:
+        case INSTR_LWU: case INSTR_LD:
+        case INSTR_SB: case INSTR_SH: case INSTR_SW: case INSTR_SD:
+        case INSTR_FLW: case INSTR_FLD: case INSTR_FSW: case INSTR_FSD:
+        case INSTR_JALR: case INSTR_AUIPC:
+            return ALU_ADD;
+        case INSTR_SUB: case INSTR_SUBW: case INSTR_BEQ: return ALU_SUB; // BEQ: RA - RB == 0
+        case INSTR_BNE:  return ALU_EQ;                 // BNE: RA == RB
+        case INSTR_BLT:  return ALU_GE;                 // BLT: RA >= RB
+        case INSTR_BGE:  return ALU_SLT;                // BGE: RA < RB
+        case INSTR_BLTU: return ALU_GEU;                // BLTU: RA >= RB (unsigned)
+        case INSTR_BGEU: return ALU_SLTU;               // BGEU: RA < RB (unsigned)
+        case INSTR_AND: case INSTR_ANDI: return ALU_AND;
+        case INSTR_OR:  case INSTR_ORI:  return ALU_OR;
+        case INSTR_XOR: case INSTR_XORI: return ALU_XOR;
+        case INSTR_SLL: case INSTR_SLLI: case INSTR_SLLW: case INSTR_SLLIW: return ALU_SLL;
+        case INSTR_SRL: case INSTR_SRLI: case INSTR_SRLW: case INSTR_SRLIW: return ALU_SRL;
+        case INSTR_SRA: case INSTR_SRAI: case INSTR_SRAW: case INSTR_SRAIW: return ALU_SRA;
+        case INSTR_SLT: case INSTR_SLTI: return ALU_SLT;
+        case INSTR_SLTU: case INSTR_SLTIU: return ALU_SLTU;
+        case INSTR_MUL: case INSTR_MULW:   return ALU_MUL;
+        case INSTR_MULH:   return ALU_MULH;
+        case INSTR_MULHSU: return ALU_MULHSU;
+        case INSTR_MULHU:  return ALU_MULHU;
+        case INSTR_DIV: case INSTR_DIVW:   return ALU_DIV;
+        case INSTR_DIVU: case INSTR_DIVUW: return ALU_DIVU;
+        case INSTR_REM: case INSTR_REMW:   return ALU_REM;
+        case INSTR_REMU: case INSTR_REMUW: return ALU_REMU;
+        case INSTR_SH1ADD: return ALU_SH1ADD;
+        case INSTR_SH2ADD: return ALU_SH2ADD;
+        case INSTR_SH3ADD: return ALU_SH3ADD;
+        case INSTR_ANDN:   return ALU_ANDN;
+        case INSTR_ORN:    return ALU_ORN;
+        case INSTR_XNOR:   return ALU_XNOR;
+        case INSTR_MIN:    return ALU_MIN;
+        case INSTR_MINU:   return ALU_MINU;
+        case INSTR_MAX:    return ALU_MAX;
+        case INSTR_MAXU:   return ALU_MAXU;
+        case INSTR_ROL: case INSTR_ROLW: return ALU_ROL;
+        case INSTR_ROR: case INSTR_RORI: case INSTR_RORW: case INSTR_RORIW: return ALU_ROR;
+        case INSTR_CLZ: case INSTR_CLZW:   return ALU_CLZ;
+        case INSTR_CTZ: case INSTR_CTZW:   return ALU_CTZ;
+        case INSTR_CPOP: case INSTR_CPOPW: return ALU_CPOP;
+        case INSTR_SEXT_B: return ALU_SEXTB;
+        case INSTR_SEXT_H: return ALU_SEXTH;
+        case INSTR_REV8:   return ALU_REV8;
+        case INSTR_ORC_B:  return ALU_ORCB;
+        default:           return ALU_PASS; // LUI, JAL, SYSTEM, FENCE
+    }
+}
+
 // =====================================================================
 // Control circuitry function
 // =====================================================================
@@ -375,126 +620,116 @@ void controlCircuitry(const DecodedInstr &d, DecodedInstr &controlSignals) {
     controlSignals.memSize = 2; // Default to word
     controlSignals.memSignExtend = false;
     controlSignals.aluOp = ALU_PASS;
+    controlSignals.word = (d.opcode == 0x1B || d.opcode == 0x3B);
+    if (d.id == INSTR_INVALID) return; // Traps in EX
+
+    controlSignals.aluOp = aluOpFor(d.id);
+
+    // Vector instructions share the FP load/store opcodes; only vsetvli
+    // and vmv.x.s write an x register
+    if (d.vector) {
+        controlSignals.regWrite = (d.id == INSTR_VSETVLI || d.id == INSTR_VMV_X_S);
+        controlSignals.memRead = (d.opcode == 0x07);
+        controlSignals.memWrite = (d.opcode == 0x27);
+        controlSignals.memSize = vecMemSize(d.funct3);
+        return;
+    }
 
-    // Update control signals based on opcode, funct3, and funct7
+    // Update control signals based on opcode and funct3
     switch (d.opcode) {
         case 0x33: // R-type
-            controlSignals.regWrite = true;
-            switch (d.funct3) {
-                case 0x0:
-                    controlSignals.aluOp = (d.funct7 == 0x20) ? ALU_SUB : 
-                                            (d.funct7 == 0x01) ? ALU_MUL : ALU_ADD;
-                    break;
-                case 0x4:
-                    controlSignals.aluOp = (d.funct7 == 0x01) ? ALU_DIV : ALU_XOR;
-                    break;
-                case 0x6:
-                    controlSignals.aluOp = (d.funct7 == 0x01) ? ALU_REM : ALU_OR;
-                    break;
-                case 0x7:
-                    controlSignals.aluOp = ALU_AND;
-                    break;
-                case 0x1:
-                    controlSignals.aluOp = ALU_SLL;
-                    break;
-                case 0x2:
-                    controlSignals.aluOp = ALU_SLT;
-                    break;
-                case 0x5:
-                    controlSignals.aluOp = (d.funct7 == 0x20) ? ALU_SRA : ALU_SRL;
-                    break;
-                default:
-                    break;
-            }
-            break;
         case 0x13: // I-type ALU
+        case 0x3B: // R-type, 32-bit (RV64)
+        case 0x1B: // I-type ALU, 32-bit (RV64)
             controlSignals.regWrite = true;
-            switch (d.funct3) {
-                case 0x0:
-                    controlSignals.aluOp = ALU_ADD; // ADDI
-                    break;
-                case 0x7:
-                    controlSignals.aluOp = ALU_AND; // ANDI
-                    break;
-                case 0x6:
-                    controlSignals.aluOp = ALU_OR; // ORI
-                    break;
-                case 0x4:
-                    controlSignals.aluOp = ALU_XOR; // XORI
-                    break;
-                case 0x2:
-                    controlSignals.aluOp = ALU_SLT; // SLTI
-                    break;
-                case 0x1:
-                    controlSignals.aluOp = ALU_SLL; // SLLI
-                    break;
-                case 0x5:
-                    controlSignals.aluOp = ((d.funct7 & 0x20) == 0x20) ? ALU_SRA : ALU_SRL; // SRLI/SRAI
-                    break;
-                default:
-                    break;
-            }
             break;
         case 0x03: // LOAD
             controlSignals.regWrite = true;
             controlSignals.memRead = true;
-            controlSignals.aluOp = ALU_ADD; // Address calculation
             controlSignals.memToReg = 1; // Write-back from memory
             switch (d.funct3) {
                 case 0x0: controlSignals.memSize = 0; controlSignals.memSignExtend = true; break; // LB
                 case 0x1: controlSignals.memSize = 1; controlSignals.memSignExtend = true; break; // LH
-                case 0x2: controlSignals.memSize = 2; controlSignals.memSignExtend = false; break; // LW
+                case 0x2: controlSignals.memSize = 2; controlSignals.memSignExtend = true; break; // LW
+                case 0x3: controlSignals.memSize = 3; controlSignals.memSignExtend = false; break; // LD
                 case 0x4: controlSignals.memSize = 0; controlSignals.memSignExtend = false; break; // LBU
                 case 0x5: controlSignals.memSize = 1; controlSignals.memSignExtend = false; break; // LHU
+                case 0x6: controlSignals.memSize = 2; controlSignals.memSignExtend = false; break; // LWU
                 default: break;
             }
             break;
         case 0x23: // STORE
             controlSignals.memWrite = true;
-            controlSignals.aluOp = ALU_ADD; // Address calculation
             switch (d.funct3) {
                 case 0x0: controlSignals.memSize = 0; break; // SB
                 case 0x1: controlSignals.memSize = 1; break; // SH
                 case 0x2: controlSignals.memSize = 2; break; // SW
+                case 0x3: controlSignals.memSize = 3; break; // SD
                 default: break;
             }
             break;
         case 0x63: // BRANCH
             controlSignals.branch = true;
-            switch (d.funct3) {
-                case 0x0: controlSignals.aluOp = ALU_SUB; break; // BEQ: RA - RB == 0
-                case 0x1: controlSignals.aluOp = ALU_EQ; break;  // BNE: RA == RB
-                case 0x4: controlSignals.aluOp = ALU_GE; break;  // BLT: RA >= RB
-                case 0x5: controlSignals.aluOp = ALU_SLT; break; // BGE: RA < RB
-                default: break;
-            }
             break;
         case 0x6F: // JAL
             controlSignals.regWrite = true;
             controlSignals.jump = true;
             controlSignals.branch = true; // No branch for JAL
-            controlSignals.aluOp = ALU_PASS; // No ALU operation needed for JAL
             controlSignals.memToReg = 2; // Write-back PC+4 (PCtemp from IAG)
             break;
         case 0x67: // JALR
             controlSignals.regWrite = true;
             controlSignals.jump = true;
-            controlSignals.aluOp = ALU_ADD; // Calculate new PC using ALU
             controlSignals.memToReg = 2; // Write-back PC+4
             break;
-        case 0x37: // LUI
+        case 0x37: // LUI: pass-through immediate
+        case 0x17: // AUIPC: add upper immediate to PC
             controlSignals.regWrite = true;
-            controlSignals.aluOp = ALU_PASS; // Pass-through immediate
             break;
-        case 0x17: // AUIPC
+        case 0x73: // SYSTEM: CSR result (old CSR value) is produced in EX
+            controlSignals.regWrite = (d.funct3 != 0);
+            break;
+        case 0x07: // FP LOAD: FLW, FLD
+            controlSignals.regWrite = true;
+            controlSignals.memRead = true;
+            controlSignals.memToReg = 1;
+            controlSignals.memSize = d.funct3;
+            break;
+        case 0x27: // FP STORE: FSW, FSD
+            controlSignals.memWrite = true;
+            controlSignals.memSize = d.funct3;
+            break;
+        case 0x43: case 0x47: case 0x4B: case 0x4F: // Fused multiply-add
+        case 0x53: // FP arithmetic, compare, convert, move
             controlSignals.regWrite = true;
-            controlSignals.aluOp = ALU_ADD; // Add upper immediate to PC
             break;
         default:
             break;
     }
 }
 
+// =====================================================================
+// readOperands: set RA, RB, RM based on the instruction type
+// =====================================================================
+void readOperands(DecodedInstr &d) {
+    d.RA = (d.opcode == 0x17) ? PC : (d.rs1 < FP_REG_BASE ? R[d.rs1] : 0); // AUIPC uses PC
+    d.RB = (d.opcode == 0x13 || d.opcode == 0x1B || d.opcode == 0x03 || d.opcode == 0x67 || d.opcode == 0x23 || d.opcode == 0x17 ||
+            ((d.opcode == 0x07 || d.opcode == 0x27) && !d.vector)) // Vector loads/stores: RB is the stride
+            ? d.imm 
+            : (d.rs2 < FP_REG_BASE ? R[d.rs2] : 0);
+    d.RM = (d.rs2 < FP_REG_BASE) ? R[d.rs2] : 0;
+    d.FA = (d.rs1 >= FP_REG_BASE) ? F[d.rs1 - FP_REG_BASE] : 0;
+    d.FB = (d.rs2 >= FP_REG_BASE) ? F[d.rs2 - FP_REG_BASE] : 0;
+    d.FC = (d.rs3 >= FP_REG_BASE) ? F[d.rs3 - FP_REG_BASE] : 0;
+}
+
+// =====================================================================
+// isTerminationInstr
+// =====================================================================
+bool isTerminationInstr(uint32_t instr) {
+    return (instr == 0x00000000);
+}
+
 // =====================================================================
 // decode
 // =====================================================================
@@ -506,8 +741,8 @@ DecodedInstr decode(uint32_t instr) {
     d.rs1    = getBits(instr, 19, 15);
 
     // Some opcodes ignore rs2/funct7 in decode
-    if(d.opcode == 0x33) d.funct7 = getBits(instr, 31, 25);
-    if(d.opcode == 0x23 || d.opcode == 0x33 || d.opcode == 0x63) d.rs2 = getBits(instr, 24, 20);
+    if(d.opcode == 0x33 || d.opcode == 0x13 || d.opcode == 0x3B || d.opcode == 0x1B) d.funct7 = getBits(instr, 31, 25);
+    if(d.opcode == 0x23 || d.opcode == 0x33 || d.opcode == 0x63 || d.opcode == 0x3B) d.rs2 = getBits(instr, 24, 20);
 
     // Default control signals
     d.regWrite = false;
@@ -520,16 +755,34 @@ DecodedInstr decode(uint32_t instr) {
     d.memSize = 2; // Default to word
     d.memSignExtend = false;
     d.zero = false;
+    const OpcodeInfo *info = findInstrByEncoding(instr, XLEN == 64);
+    d.id = info ? info->id : INSTR_INVALID;
+    d.illegal = (d.id == INSTR_INVALID) && !isTerminationInstr(instr);
+
+    // F/D: move FP register operands to FP_REG_BASE and up
+    d.fpUnit = FPU_NONE;
+    if (info && isFPOpcode(d.opcode)) {
+        d.fpFlags = info->flags;
+        d.fpUnit = fpUnitFor(d.id);
+        if (d.opcode == 0x53) d.funct7 = getBits(instr, 31, 25);
+        if (info->flags & INSTR_FLAG_FRS2) d.rs2 = getBits(instr, 24, 20) + FP_REG_BASE;
+        if (info->flags & INSTR_FLAG_FRS1) d.rs1 += FP_REG_BASE;
+        if (info->flags & INSTR_FLAG_FRD) d.rd += FP_REG_BASE;
+        if (info->format == FMT_R4) d.rs3 = getBits(instr, 31, 27) + FP_REG_BASE;
+    }
 
     // Decode immediate
     switch(d.opcode) {
         case 0x13: // I-type ALU
+        case 0x1B: // I-type ALU, 32-bit (RV64)
         case 0x03: // I-type LOAD
+        case 0x07: // I-type FP LOAD
         case 0x67: { // I-type JALR
             uint32_t imm12 = getBits(instr, 31, 20);
             d.imm = signExtend(imm12, 12);
         } break;
-        case 0x23: { // S-type
+        case 0x23: // S-type
+        case 0x27: { // S-type FP STORE
             uint32_t immHigh = getBits(instr, 31, 25);
             uint32_t immLow  = getBits(instr, 11, 7);
             uint32_t imm12 = (immHigh << 5) | immLow;
@@ -563,30 +816,136 @@ DecodedInstr decode(uint32_t instr) {
             break;
     }
 
-    // Set RA, RB, RM based on the instruction type
-    d.RA = (d.opcode == 0x17) ? PC : R[d.rs1]; // AUIPC uses PC
-    d.RB = (d.opcode == 0x13 || d.opcode == 0x03 || d.opcode == 0x67 || d.opcode == 0x23) 
-            ? d.imm 
-            : R[d.rs2];
-    d.RM = R[d.rs2];
+    // V: only the x-register operands stay in rd/rs1/rs2; the vector
+    // register fields are read from the instruction word in EX
+    d.vector = info && (info->flags & INSTR_FLAG_V);
+    if (d.vector) {
+        d.fpFlags = info->flags;
+        d.fpUnit = FPU_NONE;
+        d.rd  = vecWritesXRd(*info) ? getBits(instr, 11, 7) : 0;
+        d.rs1 = vecReadsXRs1(*info) ? getBits(instr, 19, 15) : 0;
+        d.rs2 = vecReadsXRs2(*info) ? getBits(instr, 24, 20) : 0;
+        d.imm = 0;
+    }
 
+    readOperands(d);
     return d;
 }
 
 // =====================================================================
-// isTerminationInstr
+// Predecoded program image
+//   Field decode and control signals depend only on the instruction
+//   word, so they are computed once per static instruction at load time.
+//   The decode stage then only reads the register operands. Compressed
+//   instructions are stored expanded, so entries are 2 bytes apart.
 // =====================================================================
-bool isTerminationInstr(uint32_t instr) {
-    return (instr == 0x00000000);
+struct PredecodedEntry {
+    uint32_t ir;
+    bool valid;
+    DecodedInstr d;
+};
+std::vector<PredecodedEntry> predecodedImage; // Indexed by (PC - predecodeBase) / 2
+addr_t predecodeBase = 0;
+
+void predecodeProgram() {
+    HostPhaseScope phase(hostProfiler, HOST_LOAD);
+    predecodedImage.clear();
+    if (instrMemory.empty()) return;
+    predecodeBase = instrMemory.begin()->first;
+    addr_t last = instrMemory.rbegin()->first;
+    predecodedImage.resize((last - predecodeBase) / 2 + 1, PredecodedEntry{0, false, {}});
+    for (const auto &kv : instrMemory) {
+        if ((kv.first - predecodeBase) % 2 != 0) continue;
+        PredecodedEntry &e = predecodedImage[(kv.first - predecodeBase) / 2];
+        e.ir = expandParcel(kv.second, XLEN == 64);
+        e.d = decode(e.ir);
+        controlCircuitry(e.d, e.d);
+        e.valid = true;
+    }
+}
+
+// Returns the predecoded fields for pc, or nullptr if the image has none
+const DecodedInstr *lookupPredecoded(addr_t pc, uint32_t instr) {
+    addr_t offset = pc - predecodeBase;
+    if (offset % 2 != 0 || offset / 2 >= predecodedImage.size()) return nullptr;
+    const PredecodedEntry &e = predecodedImage[offset / 2];
+    return (e.valid && e.ir == instr) ? &e.d : nullptr;
+}
+
+// =====================================================================
+// Code memory coherence
+//   Stores reach code through codeSegment like any other memory.
+//   codePages marks the 4 KiB pages that have parcels in instrMemory or
+//   the predecoded image; a store to a marked page drops exactly the
+//   parcels it overlaps, and fetch reloads them from codeSegment. Stores
+//   to other pages, and all data and stack stores, do no extra work.
+//   Instructions already in the pipeline are only refetched by FENCE.I.
+// =====================================================================
+static const unsigned CODE_PAGE_SHIFT = 12;
+std::vector<uint8_t> codePages(0x10000000 >> CODE_PAGE_SHIFT);
+uint64_t codeStores = 0;             // Stores to pages holding fetched code
+uint64_t codeParcelsInvalidated = 0;
+uint64_t codeRefills = 0;            // Parcels fetch reloaded from codeSegment
+uint64_t fenceIFlushes = 0;
+
+// Places a parcel of size bytes at load time
+void loadCodeParcel(addr_t addr, uint32_t parcel, int size) {
+    codeSegment.writeBytes(addr, parcel, size);
+    instrMemory[addr] = parcel;
+    codePages[addr >> CODE_PAGE_SHIFT] = 1;
+}
+
+// Parcel at addr for fetch; false if no code was loaded or written there
+bool fetchParcel(addr_t addr, uint32_t &parcel) {
+    auto it = instrMemory.find(addr);
+    if (it != instrMemory.end()) {
+        parcel = it->second;
+        return true;
+    }
+    if (addr >= 0x10000000 || codeSegment.memory.find(addr) == codeSegment.memory.end()) return false;
+    parcel = static_cast<uint32_t>(codeSegment.readBytes(addr, 2));
+    if ((parcel & 0x3) == 0x3) parcel = static_cast<uint32_t>(codeSegment.readBytes(addr, 4));
+    instrMemory[addr] = parcel;
+    codePages[addr >> CODE_PAGE_SHIFT] = 1;
+    codeRefills++;
+    return true;
+}
+
+// A store of size bytes at addr went to codeSegment
+void invalidateCode(addr_t addr, unsigned size) {
+    addr_t first = (addr >= 3) ? addr - 3 : 0; // A 4-byte parcel may start 3 bytes earlier
+    addr_t last = std::min<addr_t>(addr + size - 1, 0x0FFFFFFF);
+    if (!codePages[first >> CODE_PAGE_SHIFT] && !codePages[last >> CODE_PAGE_SHIFT]) return;
+    codeStores++;
+    for (auto it = instrMemory.lower_bound(first); it != instrMemory.end() && it->first <= last; ) {
+        addr_t start = it->first;
+        if (start + ((it->second & 0x3) == 0x3 ? 4 : 2) <= addr) {
+            ++it; // Compressed parcel just before the store
+            continue;
+        }
+        addr_t offset = start - predecodeBase;
+        if (offset % 2 == 0 && offset / 2 < predecodedImage.size()) predecodedImage[offset / 2].valid = false;
+        it = instrMemory.erase(it);
+        codeParcelsInvalidated++;
+    }
+}
+
+// Store hook for the memory interfaces: one compare for data stores
+inline void noteStore(const MemSegment *seg, addr_t addr, unsigned size) {
+    if (seg == &codeSegment) invalidateCode(addr, size);
 }
 
+
+std::map<uint64_t, std::string> programText; // Assembly text per PC, from the .mc input
+
 // =====================================================================
 // parseInputMC: read addresses from input.mc and distribute them
-//   - <0x10000000 => instrMemory
+//   - <0x10000000 => codeSegment (and instrMemory)
 //   - [0x10000000, 0x7FFFFFFF) => dataSegment
 //   - >=0x7FFFFFFF => stackSegment
 // =====================================================================
 bool parseInputMC(const std::string &filename) {
+    HostPhaseScope phase(hostProfiler, HOST_LOAD);
     std::ifstream fin(filename);
     if (!fin.is_open()) {
         std::cerr << "ERROR: Could not open " << filename << "\n";
@@ -619,12 +978,17 @@ bool parseInputMC(const std::string &filename) {
         }
 
         try {
-            uint32_t address = std::stoul(addrStr, nullptr, 16);
+            addr_t   address = std::stoull(addrStr, nullptr, 16);
             uint32_t word    = std::stoul(dataStr, nullptr, 16);
 
             if (address < 0x10000000) {
-                // instructions
-                instrMemory[address] = word;
+                // instructions, and their assembly text for the profiler
+                loadCodeParcel(address, word, instrLength(word));
+                std::string text;
+                std::getline(ss, text);
+                size_t start = text.find_first_not_of(" \t,");
+                size_t end = text.find_last_not_of(" \t\r");
+                if (start != std::string::npos) programText[address] = text.substr(start, end - start + 1);
             }
             else if (address < 0x50000000) {
                 // data
@@ -648,14 +1012,104 @@ bool parseInputMC(const std::string &filename) {
 // =====================================================================
 // Forward declaration of getMemSegmentForAddress
 // =====================================================================
-MemSegment* getMemSegmentForAddress(uint32_t addr);
+MemSegment* getMemSegmentForAddress(addr_t addr);
+
+// =====================================================================
+// loadElf: place the PT_LOAD segments of an ELF executable with the
+// same address map as parseInputMC. Executable segments are split into
+// instruction parcels like the assembler output; .bss needs no bytes
+// because unwritten memory reads as zero. Code and data share one
+// memory, so a non-executable segment may sit below 0x10000000 too.
+// =====================================================================
+addr_t programEntry = 0;               // Reset PC (e_entry for ELF input)
+std::vector<ElfSymbol> programSymbols; // Sorted by address; empty for .mc input
+addr_t programBreak = 0;               // End of the ELF data segments (.bss included)
+
+bool loadElf(const std::string &filename) {
+    HostPhaseScope phase(hostProfiler, HOST_LOAD);
+    ElfFile elf;
+    if (!elf.open(filename, XLEN)) return false;
+    uint64_t codeBytes = 0, dataBytes = 0;
+    for (const ElfSegment &seg : elf.segments()) {
+        if (seg.flags & ELF_PF_X) {
+            if (seg.vaddr + seg.memSize > 0x10000000) {
+                std::cerr << "ERROR: executable segment at 0x" << std::hex << seg.vaddr << std::dec
+                          << " is outside instruction memory (< 0x10000000)\n";
+                return false;
+            }
+            for (uint64_t off = 0; off + 2 <= seg.fileSize; ) {
+                uint32_t parcel = seg.data[off] | (seg.data[off + 1] << 8);
+                if ((parcel & 0x3) == 0x3 && off + 4 <= seg.fileSize) {
+                    parcel |= (seg.data[off + 2] << 16) | (static_cast<uint32_t>(seg.data[off + 3]) << 24);
+                    loadCodeParcel(seg.vaddr + off, parcel, 4);
+                    off += 4;
+                } else {
+                    loadCodeParcel(seg.vaddr + off, parcel, 2);
+                    off += 2;
+                }
+            }
+            codeBytes += seg.fileSize;
+        } else {
+            // Read-only data may also sit below 0x10000000, next to the code
+            for (uint64_t off = 0; off < seg.fileSize; off++) {
+                MemSegment *mem = getMemSegmentForAddress(seg.vaddr + off);
+                if (mem && mem != &mmioSegment) mem->writeByte(seg.vaddr + off, seg.data[off]);
+            }
+            dataBytes += seg.fileSize;
+            if (seg.vaddr >= 0x10000000) programBreak = std::max<addr_t>(programBreak, seg.vaddr + seg.memSize);
+        }
+    }
+    programEntry = elf.entry();
+    programSymbols = elf.symbols();
+    std::cout << "[ELF] Loaded " << filename << ": " << codeBytes << " code bytes, " << dataBytes
+              << " data bytes, " << programSymbols.size() << " symbols, entry 0x" << std::hex
+              << programEntry << std::dec << "\n";
+    return true;
+}
+
+// Data-access profiling (--mem-profile): scalar loads and stores to memory
+MemoryProfiler memProfiler;
+std::string memProfileFile;
+
+// Flight recorder (--flight-records, --flight-file): dumped on halt, on an
+// invalid memory access and on SIGINT/SIGSEGV
+FlightRecorder flight;
+std::string flightFile = "flight_recorder.txt";
+uint32_t flightRecords = 4096;
+bool flightErrorDumped = false; // Keep the error dump instead of the halt dump
+
+// Commit log output, for --check-commits (empty = disabled)
+std::string commitLogFile;
+CommitLogWriter commitLog;
+
+void flightMemoryFault(addr_t pc, addr_t addr) {
+    flight.event(clockCycle, FLIGHT_MEM_FAULT, pc, 0, addr);
+    if (flightErrorDumped) return;
+    flightErrorDumped = true;
+    flight.dump("invalid memory access", clockCycle);
+}
 
 // =====================================================================
-// Updated Memory Processor Interface
+// Updated Memory Processor Interface (pc: the load/store, for profiling)
 // =====================================================================
-void memoryProcessorInterface(uint32_t &MAR, int32_t &MDR, int32_t RM, bool memRead, bool memWrite, uint8_t memSize, bool memSignExtend) {
+void memoryProcessorInterface(addr_t pc, addr_t &MAR, reg_t &MDR, reg_t RM, bool memRead, bool memWrite, uint8_t memSize, bool memSignExtend) {
     MemSegment* seg = getMemSegmentForAddress(MAR); // Use MAR as the memory address
-    if (!seg) return; // Invalid memory segment
+    if (!seg) { // Invalid memory segment
+        if (memRead || memWrite) flightMemoryFault(pc, MAR);
+        return;
+    }
+
+    if (seg == &mmioSegment) { // Device register
+        const unsigned size = 1u << memSize;
+        if (memRead) {
+            uint64_t v = devices.load(MAR, size);
+            if (memSignExtend && size < 8) v = static_cast<uint64_t>(static_cast<int64_t>(v << (64 - 8 * size)) >> (64 - 8 * size));
+            MDR = static_cast<reg_t>(v);
+        }
+        if (memWrite) devices.store(MAR, size, static_cast<ureg_t>(RM));
+        return;
+    }
+    if (memProfiler.enabled && (memRead || memWrite)) memProfiler.access(pc, MAR, memWrite);
 
     if (memRead) {
         // Perform memory read based on size and store the result in MDR
@@ -671,7 +1125,12 @@ void memoryProcessorInterface(uint32_t &MAR, int32_t &MDR, int32_t RM, bool memR
                       : static_cast<uint16_t>(seg->readByte(MAR) | (seg->readByte(MAR + 1) << 8));
                 break;
             case 2: // Word
-                MDR = seg->readWord(MAR);
+                MDR = memSignExtend
+                      ? static_cast<reg_t>(seg->readWord(MAR))
+                      : static_cast<reg_t>(static_cast<uint32_t>(seg->readWord(MAR)));
+                break;
+            case 3: // Doubleword (RV64 only)
+                MDR = static_cast<reg_t>(seg->readDouble(MAR));
                 break;
             default:
                 break;
@@ -689,29 +1148,79 @@ void memoryProcessorInterface(uint32_t &MAR, int32_t &MDR, int32_t RM, bool memR
                 seg->writeByte(MAR + 1, (RM >> 8) & 0xFF);
                 break;
             case 2: // Word
-                seg->writeWord(MAR, RM);
+                seg->writeWord(MAR, static_cast<int32_t>(RM));
+                break;
+            case 3: // Doubleword (RV64 only)
+                seg->writeDouble(MAR, RM);
                 break;
             default:
                 break;
         }
+        noteStore(seg, MAR, 1u << memSize);
+    }
+}
+
+// FP loads and stores: FLW NaN-boxes the word, FSW stores the low 32 bits
+void fpMemoryInterface(addr_t pc, addr_t MAR, uint64_t &FMDR, uint64_t FM, bool memRead, bool memWrite, uint8_t memSize) {
+    MemSegment* seg = getMemSegmentForAddress(MAR);
+    if (!seg && (memRead || memWrite)) flightMemoryFault(pc, MAR);
+    if (!seg || seg == &mmioSegment) return; // Invalid memory segment; devices take integer accesses only
+    if (memProfiler.enabled && (memRead || memWrite)) memProfiler.access(pc, MAR, memWrite);
+
+    if (memRead) {
+        FMDR = (memSize == 3) ? static_cast<uint64_t>(seg->readDouble(MAR))
+                              : boxSingle(static_cast<uint32_t>(seg->readWord(MAR)));
+    }
+    if (memWrite) {
+        if (memSize == 3) seg->writeDouble(MAR, static_cast<int64_t>(FM));
+        else seg->writeWord(MAR, static_cast<int32_t>(FM));
+        noteStore(seg, MAR, 1u << memSize);
     }
 }
 
 // =====================================================================
-// Branch Prediction Table (1-bit predictor)
+// Branch Prediction Table
+//   predictorType: 0 = static not-taken, 1 = 1-bit, 2 = 2-bit saturating
+//   predictorEntries: 0 = one entry per branch PC, otherwise a
+//   direct-mapped table of that many entries indexed by PC
 // =====================================================================
-std::unordered_map<uint32_t, bool> branchPredictionTable; // Maps PC to prediction (true = taken, false = not taken)
+int predictorType = 1;
+uint32_t predictorEntries = 0;
+
+std::unordered_map<uint32_t, uint8_t> branchPredictionTable; // Maps PC (or table index) to predictor state
 std::unordered_map<uint32_t, uint32_t> branchTargetTable; // Maps PC to target address
 
+static inline uint32_t predictorIndex(uint32_t pc) {
+    return predictorEntries ? (pc >> 2) % predictorEntries : pc;
+}
+
+static inline bool predictorStateTaken(uint8_t state) {
+    return (predictorType == 2) ? state >= 2 : state != 0;
+}
+
 // Function to predict branch outcome
 bool predictBranch(uint32_t pc) {
-    auto it = branchPredictionTable.find(pc);
-    return (it != branchPredictionTable.end()) ? it->second : false; // Default: not taken
+    if (predictorType == 0) return false;
+    auto it = branchPredictionTable.find(predictorIndex(pc));
+    return (it != branchPredictionTable.end()) ? predictorStateTaken(it->second) : false; // Default: not taken
 }
 
 // Function to update branch prediction table
 void updateBranchPrediction(uint32_t pc, bool actualOutcome) {
-    branchPredictionTable[pc] = actualOutcome; // Update prediction with actual outcome
+    if (predictorType == 0) return;
+    uint8_t &state = branchPredictionTable[predictorIndex(pc)];
+    if (predictorType == 2) {
+        if (actualOutcome && state < 3) state++;
+        else if (!actualOutcome && state > 0) state--;
+    } else {
+        state = actualOutcome ? 1 : 0; // Update prediction with actual outcome
+    }
+}
+
+// Function to make sure a branch has a predictor entry without training it
+void allocateBranchPrediction(uint32_t pc) {
+    if (predictorType == 0) return;
+    branchPredictionTable.emplace(predictorIndex(pc), 0);
 }
 
 // Function to update branch target table
@@ -724,16 +1233,16 @@ void updateBranchTarget(uint32_t pc, uint32_t target) {
 // =====================================================================
 class IAG {
 public:
-    uint32_t PCtemp; // Temporary storage for PC + 4
+    addr_t PCtemp; // Temporary storage for PC + 4
 
     // Update PC based on signals and branch prediction
-    void updatePC(bool jump, bool branch, bool zero, int32_t offset, int32_t RZ, uint32_t pc) {
+    void updatePC(bool jump, bool branch, bool zero, int32_t offset, reg_t RZ, addr_t pc) {
         PCtemp = PC + 4; // Always store PC + 4 in PCtemp
         if (jump) {
             if (branch) {
                 PC += offset; // For JAL, PC = PC + offset
             } else {
-                PC = RZ & ~1U; // For JALR, PC = RZ (aligned to even address)
+                PC = RZ & ~static_cast<reg_t>(1); // For JALR, PC = RZ (aligned to even address)
             }
         } else if (branch) {
             bool predictedTaken = predictBranch(pc); // Predict branch outcome
@@ -755,11 +1264,27 @@ IAG iag;
 // Updated Print Registers
 // =====================================================================
 void printRegisters() {
+    HostPhaseScope phase(hostProfiler, HOST_PRINT);
     std::cout << "Register File:\n";
     for (int i = 0; i < NUM_REGS; i++) {
         std::cout << "R[" << std::dec << i << "]=" << std::dec << R[i] << "   "; // Register number in decimal
         if ((i + 1) % 4 == 0) std::cout << "\n";
     }
+    // FP registers only once a program has written them
+    for (int i = 0; i < NUM_REGS; i++) {
+        if (F[i] != 0)
+            std::cout << "F[" << std::dec << i << "]=0x" << std::hex << F[i] << std::dec << "\n";
+    }
+    // Vector registers likewise, as bytes from the highest address down
+    for (int i = 0; i < NUM_REGS; i++) {
+        bool written = false;
+        for (uint32_t b = 0; b < VLENB; b++) written |= (V[i][b] != 0);
+        if (!written) continue;
+        std::cout << "V[" << std::dec << i << "]=0x" << std::hex;
+        for (int b = VLENB - 1; b >= 0; b--)
+            std::cout << std::setw(2) << std::setfill('0') << static_cast<unsigned>(V[i][b]);
+        std::cout << std::setfill(' ') << std::dec << "\n";
+    }
     std::cout << "-------------------------------------\n";
     std::cout << "PC = 0x" << std::hex << PC 
               << "  RA=0x" << RA << "  RB=0x" << RB << "  RM=0x" << RM << "\n";
@@ -772,12 +1297,12 @@ void printRegisters() {
 //   Helper to figure out which segment an address belongs to.
 //   We will read/write from the correct segment in LOAD/STORE ops.
 // =====================================================================
-MemSegment* getMemSegmentForAddress(uint32_t addr) {
-    if (addr < 0x10000000) {
-        // For simplicity, let's assume we do NOT allow loads/stores to instruction memory
-        // But if you wanted self-modifying code, you'd handle it. 
-        // We'll just return nullptr here to indicate invalid or unexpected.
-        return nullptr;
+MemSegment* getMemSegmentForAddress(addr_t addr) {
+    if (DeviceBus::contains(addr)) {
+        return &mmioSegment; // Device registers
+    }
+    else if (addr < 0x10000000) {
+        return &codeSegment; // Instructions; stores invalidate fetched copies (noteStore)
     }
     else if (addr < 0x50000000) {
         return &dataSegment;
@@ -787,6 +1312,203 @@ MemSegment* getMemSegmentForAddress(uint32_t addr) {
     }
 }
 
+// =====================================================================
+// Sv32 virtual memory
+//   When satp.MODE is set, fetch addresses and load/store addresses
+//   are translated through a two-level page table in simulated memory.
+//   Separate I-TLB and D-TLB models (set-associative, LRU) cache
+//   translations; every PTE read of a walk costs ptwLatency cycles,
+//   which hold the pipeline like any other stall.
+//   Translation applies as for a user-mode program (U bit ignored);
+//   A/D bits are not checked or updated. sfence.vma flushes both TLBs.
+// =====================================================================
+uint32_t satp = 0;             // Bit 31 = MODE (1 = Sv32), bits 21:0 = root PPN
+uint32_t ptwLatency = 10;      // Cycles per page-table memory access
+uint32_t translationStallCycles = 0; // Walk cycles still to be charged to the pipeline
+
+enum AccessType { ACCESS_FETCH, ACCESS_LOAD, ACCESS_STORE };
+
+static const uint32_t PTE_V = 1 << 0;
+static const uint32_t PTE_R = 1 << 1;
+static const uint32_t PTE_W = 1 << 2;
+static const uint32_t PTE_X = 1 << 3;
+
+class TLB {
+public:
+    uint32_t entries;
+    uint32_t ways;
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+
+    TLB(uint32_t entries, uint32_t ways) { configure(entries, ways); }
+
+    void configure(uint32_t numEntries, uint32_t numWays) {
+        entries = numEntries ? numEntries : 1;
+        ways = (numWays && numWays <= entries) ? numWays : entries;
+        sets = entries / ways;
+        table.assign(sets * ways, Entry{});
+    }
+
+    // Returns true and the physical page entry on a hit
+    bool lookup(uint32_t vpn, uint32_t &pte, bool &superpage) {
+        Entry *set = &table[(vpn % sets) * ways];
+        for (uint32_t w = 0; w < ways; w++) {
+            Entry &e = set[w];
+            if (!e.valid) continue;
+            if (e.superpage ? (e.vpn >> 10) == (vpn >> 10) : e.vpn == vpn) {
+                e.lastUse = ++useClock;
+                pte = e.pte;
+                superpage = e.superpage;
+                hits++;
+                return true;
+            }
+        }
+        misses++;
+        return false;
+    }
+
+    void insert(uint32_t vpn, uint32_t pte, bool superpage) {
+        Entry *set = &table[(vpn % sets) * ways];
+        Entry *victim = &set[0];
+        for (uint32_t w = 0; w < ways; w++) {
+            if (!set[w].valid) { victim = &set[w]; break; }
+            if (set[w].lastUse < victim->lastUse) victim = &set[w];
+        }
+        *victim = Entry{true, superpage, vpn, pte, ++useClock};
+    }
+
+    void flush() {
+        for (auto &e : table) e.valid = false;
+    }
+
+private:
+    struct Entry {
+        bool valid = false;
+        bool superpage = false;
+        uint32_t vpn = 0;
+        uint32_t pte = 0;
+        uint64_t lastUse = 0;
+    };
+    uint32_t sets = 1;
+    uint64_t useClock = 0;
+    std::vector<Entry> table;
+};
+
+TLB itlb(32, 4);
+TLB dtlb(32, 4);
+uint64_t pageWalks = 0;
+uint64_t pageWalkCycles = 0;
+uint64_t pageFaults = 0;
+
+static inline bool translationEnabled() {
+    return (satp >> 31) != 0;
+}
+
+// Sv32 page-table walk; returns false on a page fault
+bool pageTableWalk(uint32_t vpn, uint32_t &leafPTE, bool &superpage) {
+    pageWalks++;
+    uint32_t a = (satp & 0x3FFFFF) << 12;
+    for (int level = 1; level >= 0; level--) {
+        uint32_t vpnPart = (level == 1) ? (vpn >> 10) : (vpn & 0x3FF);
+        uint32_t pteAddr = a + vpnPart * 4;
+        translationStallCycles += ptwLatency;
+        pageWalkCycles += ptwLatency;
+        MemSegment *seg = getMemSegmentForAddress(pteAddr);
+        uint32_t pte = seg ? static_cast<uint32_t>(seg->readWord(pteAddr)) : 0;
+        if (!(pte & PTE_V) || (!(pte & PTE_R) && (pte & PTE_W))) return false;
+        if (pte & (PTE_R | PTE_X)) {
+            // Leaf; a superpage must be aligned to 4 MiB
+            if (level == 1 && ((pte >> 10) & 0x3FF) != 0) return false;
+            leafPTE = pte;
+            superpage = (level == 1);
+            return true;
+        }
+        if (level == 0) return false;
+        a = (pte >> 10) << 12;
+    }
+    return false;
+}
+
+// Translate a virtual address; returns false on a page fault.
+// Sv32 maps 32-bit addresses, so an RV64 build translates the low half.
+bool translateAddress(addr_t vaddr, AccessType type, addr_t &paddr) {
+    if (!translationEnabled()) {
+        paddr = vaddr;
+        return true;
+    }
+    TLB &tlb = (type == ACCESS_FETCH) ? itlb : dtlb;
+    uint32_t vpn = static_cast<uint32_t>(vaddr >> 12) & 0xFFFFF;
+    uint32_t pte = 0;
+    bool superpage = false;
+    if (!tlb.lookup(vpn, pte, superpage)) {
+        if (!pageTableWalk(vpn, pte, superpage)) {
+            pageFaults++;
+            return false;
+        }
+        tlb.insert(vpn, pte, superpage);
+    }
+    uint32_t needed = (type == ACCESS_FETCH) ? PTE_X : (type == ACCESS_LOAD) ? PTE_R : PTE_W;
+    if (!(pte & needed)) {
+        pageFaults++;
+        return false;
+    }
+    uint32_t ppn = pte >> 10;
+    paddr = superpage ? ((ppn >> 10) << 22) | (vaddr & 0x3FFFFF)
+                      : (ppn << 12) | (vaddr & 0xFFF);
+    return true;
+}
+
+void printTranslationStatistics() {
+    HostPhaseScope phase(hostProfiler, HOST_PRINT);
+    if (!translationEnabled() && itlb.hits + itlb.misses + dtlb.hits + dtlb.misses == 0) return;
+    auto rate = [](uint64_t hits, uint64_t misses) {
+        return (hits + misses) ? 100.0 * hits / (hits + misses) : 0.0;
+    };
+    std::cout << "================ Translation Statistics ===============\n";
+    std::cout << std::dec << std::fixed << std::setprecision(2);
+    std::cout << "I-TLB (" << itlb.entries << " entries, " << itlb.ways << "-way): hits = " << itlb.hits
+              << " misses = " << itlb.misses << " hit rate = " << rate(itlb.hits, itlb.misses) << "%\n";
+    std::cout << "D-TLB (" << dtlb.entries << " entries, " << dtlb.ways << "-way): hits = " << dtlb.hits
+              << " misses = " << dtlb.misses << " hit rate = " << rate(dtlb.hits, dtlb.misses) << "%\n";
+    std::cout << "Page walks = " << pageWalks << "  walk stall cycles = " << pageWalkCycles
+              << "  page faults = " << pageFaults << "\n";
+    std::cout << "=======================================================\n";
+}
+
+// =====================================================================
+// Vector loads and stores: one access per active element at base + i * stride,
+// each translated separately. Returns false with the trap cause and the
+// element's virtual address on a misaligned element or a page fault;
+// the elements before it have already been transferred.
+// =====================================================================
+bool vectorMemoryInterface(uint32_t instr, addr_t base, reg_t stride, uint32_t vl, bool memWrite,
+                           uint8_t memSize, uint32_t &cause, addr_t &faultAddr) {
+    const uint32_t bytes = 1u << memSize;
+    uint8_t *group = V[(instr >> 7) & 0x1F];
+    for (uint32_t i = 0; i < vl; i++) {
+        if (vecMasked(instr) && !vecMaskActive(V[0], i)) continue;
+        addr_t vaddr = static_cast<addr_t>(base + static_cast<ureg_t>(stride) * i);
+        addr_t paddr = vaddr;
+        if (vaddr & (bytes - 1)) {
+            cause = memWrite ? CAUSE_MISALIGNED_STORE : CAUSE_MISALIGNED_LOAD;
+        } else if (!translateAddress(vaddr, memWrite ? ACCESS_STORE : ACCESS_LOAD, paddr)) {
+            cause = memWrite ? CAUSE_STORE_PAGE_FAULT : CAUSE_LOAD_PAGE_FAULT;
+        } else {
+            MemSegment* seg = getMemSegmentForAddress(paddr);
+            if (!seg || seg == &mmioSegment) continue; // Invalid memory segment or device
+            for (uint32_t b = 0; b < bytes; b++) {
+                if (memWrite) seg->writeByte(paddr + b, group[i * bytes + b]);
+                else group[i * bytes + b] = static_cast<uint8_t>(seg->readByte(paddr + b));
+            }
+            if (memWrite) noteStore(seg, paddr, bytes);
+            continue;
+        }
+        faultAddr = vaddr;
+        return false;
+    }
+    return true;
+}
+
 // =====================================================================
 // Define states for the multi-cycle implementation
 // =====================================================================
@@ -809,11 +1531,23 @@ bool Knob4 = true; // Enable/disable printing pipeline registers at the end of e
 bool Knob5 = false; // Enable/disable tracing for a specific instruction
 int Knob5InstructionNumber = 0; // Instruction number to trace if Knob5 is enabled
 bool Knob6 = true; // Enable/disable printing branch prediction unit content
+uint32_t memLatency = 0; // Extra cycles a load/store holds the pipeline in MEM
+// FP execution latencies in cycles. A multi-cycle FP operation holds the
+// whole pipeline while it is in EX (the FPU is not pipelined).
+uint32_t fpAddLatency = 3;  // fadd, fsub
+uint32_t fpMulLatency = 4;  // fmul and the fused multiply-adds
+uint32_t fpDivLatency = 12; // fdiv, fsqrt
+uint32_t fpCvtLatency = 2;  // fcvt
+// Elements the vector unit processes per cycle. A vector instruction
+// holds EX (and the pipeline) for ceil(vl / vectorLanes) cycles.
+uint32_t vectorLanes = 4;
+bool dumpMemoryFiles = true; // Rewrite data.mc/stack.mc every cycle
 
 // =====================================================================
 // Function to print the contents of pipeline buffers
 // =====================================================================
 void printPipelineBuffers() {
+    HostPhaseScope phase(hostProfiler, HOST_PRINT);
     std::cout << "================ Pipeline Buffers ================\n";
 
     // IF/ID Buffer
@@ -866,25 +1600,34 @@ void printPipelineBuffers() {
 // Function to print unresolved dependencies
 // =====================================================================
 void printUnresolvedDependencies(const std::multiset<uint32_t> &dependencies) {
-    std::cout << "Unresolved Dependencies: ";
+    if (LOG_TRACE > SIM_LOG_MAX_LEVEL || !simLog.enabled(LOG_HAZARD, LOG_TRACE)) return;
+    std::ostream &out = simLog.begin();
+    out << "Unresolved Dependencies: ";
     if (dependencies.empty()) {
-        std::cout << "None";
+        out << "None";
     } else {
         for (const auto &dep : dependencies) {
-            std::cout << "R[" << dep << "] ";
+            out << "R[" << dep << "] ";
         }
     }
-    std::cout << "\n";
+    out << "\n";
+    simLog.end();
 }
 
 // =====================================================================
 // Function to print branch prediction unit content
 // =====================================================================
 void printBranchPredictionUnit() {
+    HostPhaseScope phase(hostProfiler, HOST_PRINT);
     std::cout << "Branch Prediction Unit:\n";
     for (const auto &entry : branchPredictionTable) {
+        if (predictorEntries) {
+            std::cout << "Entry=" << std::dec << entry.first
+                      << " Prediction=" << (predictorStateTaken(entry.second) ? "Taken" : "Not Taken") << "\n";
+            continue;
+        }
         std::cout << "PC=0x" << std::hex << entry.first 
-                  << " Prediction=" << (entry.second ? "Taken " : "Not Taken ")
+                  << " Prediction=" << (predictorStateTaken(entry.second) ? "Taken " : "Not Taken ")
                   << "Target Address=0x" << std::hex << branchTargetTable[entry.first] << "\n";
     }
     std::cout << "-------------------------------------\n";
@@ -902,96 +1645,901 @@ uint64_t controlHazards = 0;
 uint64_t branchMispredictions = 0;
 uint64_t dataHazardStalls = 0;
 uint64_t controlHazardStalls = 0;
+uint64_t compressedInstructions = 0; // Retired 16-bit instructions
+uint64_t fetchedCodeBytes = 0;       // Instruction bytes of retired instructions
+uint64_t fpInstructions = 0;         // Retired F/D instructions (including loads/stores)
+uint64_t fpStallCycles = 0;          // Cycles the pipeline waited on the FPU
+uint64_t vectorInstructions = 0;     // Retired V instructions (including vsetvli)
+uint64_t vectorElements = 0;         // Elements processed by vector instructions
+uint64_t vectorStallCycles = 0;      // Cycles the pipeline waited on the vector unit
+uint64_t syscallStallCycles = 0;     // Cycles fetch waited for an ECALL to write back
 
 // =====================================================================
-// Pre-update dependencies before any stage begins
+// Energy model
+//   Per-event activity counters (plain increments, always on) are
+//   weighted by a per-event energy table in picojoules. The defaults
+//   below can be overridden with --energy-table=FILE, one "name value"
+//   pair per line, e.g. "alu_mul 3.5" or "mem_read_word 12".
 // =====================================================================
-void preUpdateDependencies() {
-    // Update ID/EX values from EX/MEM or MEM/WB
-    if (id_ex.valid) {
-        id_ex.RA = id_ex.d.RA; // Default to original RA
-        id_ex.RB = id_ex.d.RB; // Default to original RB
-        id_ex.RM = id_ex.d.RM; // Default to original RM
+enum PipelineLatch { LATCH_IF_ID, LATCH_ID_EX, LATCH_EX_MEM, LATCH_MEM_WB, LATCH_COUNT };
+
+struct EnergyCounters {
+    uint64_t fetches = 0;                  // Instruction memory reads
+    uint64_t rfReads = 0;                  // Register file read ports used
+    uint64_t rfWrites = 0;                 // Register file writes
+    uint64_t aluOps[ALU_OP_COUNT] = {};    // ALU operations by type
+    uint64_t memReads[4] = {};             // Data memory reads by memSize
+    uint64_t memWrites[4] = {};            // Data memory writes by memSize
+    uint64_t latchWrites[LATCH_COUNT] = {};// Pipeline register writes
+    uint64_t flushes = 0;                  // Flushed (squashed) instructions
+} energyCounters;
+
+struct EnergyTable {
+    double fetch = 10.0;
+    double rfRead = 1.0;
+    double rfWrite = 1.2;
+    double aluOp[ALU_OP_COUNT] = {
+        0.5, 0.5, 3.1, 12.0, 12.0, 0.3, 0.3, 0.3,  // add sub mul div rem and or xor
+        0.6, 0.6, 0.6, 0.5, 0.1, 0.5, 0.5,         // sll srl sra slt pass eq ge
+        0.5, 0.5, 3.4, 3.4, 3.4, 12.0, 12.0,       // sltu geu mulh mulhsu mulhu divu remu
+        0.6, 0.6, 0.6, 0.3, 0.3, 0.3,              // sh1add sh2add sh3add andn orn xnor
+        0.5, 0.5, 0.5, 0.5, 0.6, 0.6,              // min minu max maxu rol ror
+        0.8, 0.8, 0.8, 0.2, 0.2, 0.3, 0.4          // clz ctz cpop sextb sexth rev8 orcb
+    };
+    double memRead[4] = {8.0, 9.0, 10.0, 12.0};    // byte half word dword
+    double memWrite[4] = {8.5, 9.5, 11.0, 13.0};
+    double latchWrite = 0.3;
+    double flush = 2.0;
+    double leakagePerCycle = 0.5;
+    double clockPeriodNs = 1.0;                    // For energy-delay product
+} energyTable;
 
-        if (id_ex.forwardRAFromMEM_WB) {
-            id_ex.RA = mem_wb.RY; // Forward RA from MEM/WB
-            std::cout << "[Forwarding] RY = " << mem_wb.RY << " to RA\n";
-        }
-        if (id_ex.forwardRAFromEX_MEM) {
-            id_ex.RA = ex_mem.RZ; // Forward RA from EX/MEM
-            std::cout << "[Forwarding] RZ = " << ex_mem.RZ << " to RA\n";
-        }
+static const char *const memSizeNames[4] = {"byte", "half", "word", "dword"};
 
-        if (id_ex.forwardRBFromMEM_WB) {
-            id_ex.RB = mem_wb.RY; // Forward RB from MEM/WB
-            std::cout << "[Forwarding] RY = " << mem_wb.RY << " to RB\n";
+bool loadEnergyTable(const std::string &filename) {
+    std::ifstream fin(filename);
+    if (!fin.is_open()) {
+        std::cerr << "ERROR: Could not open " << filename << "\n";
+        return false;
+    }
+    std::string line;
+    while (std::getline(fin, line)) {
+        size_t cpos = line.find('#');
+        if (cpos != std::string::npos) line = line.substr(0, cpos);
+        std::replace(line.begin(), line.end(), '=', ' ');
+        std::stringstream ss(line);
+        std::string name;
+        double value;
+        if (!(ss >> name >> value)) continue;
+
+        bool known = true;
+        if (name == "fetch") energyTable.fetch = value;
+        else if (name == "rf_read") energyTable.rfRead = value;
+        else if (name == "rf_write") energyTable.rfWrite = value;
+        else if (name == "latch_write") energyTable.latchWrite = value;
+        else if (name == "flush") energyTable.flush = value;
+        else if (name == "leakage_per_cycle") energyTable.leakagePerCycle = value;
+        else if (name == "clock_period_ns") energyTable.clockPeriodNs = value;
+        else {
+            known = false;
+            for (int op = 0; op < ALU_OP_COUNT; op++) {
+                if (name == std::string("alu_") + aluOpNames[op]) {
+                    energyTable.aluOp[op] = value;
+                    known = true;
+                }
+            }
+            for (int sz = 0; sz < 4; sz++) {
+                if (name == std::string("mem_read_") + memSizeNames[sz]) {
+                    energyTable.memRead[sz] = value;
+                    known = true;
+                } else if (name == std::string("mem_write_") + memSizeNames[sz]) {
+                    energyTable.memWrite[sz] = value;
+                    known = true;
+                }
+            }
         }
-        if (id_ex.forwardRBFromEX_MEM) {
-            id_ex.RB = ex_mem.RZ; // Forward RB from EX/MEM
-            std::cout << "[Forwarding] RZ = " << ex_mem.RZ << " to RB\n";
+        if (!known) {
+            std::cerr << "Unknown energy table entry: " << name << "\n";
         }
+    }
+    return true;
+}
 
-        if (id_ex.forwardRMFromMEM_WB) {
-            id_ex.RM = mem_wb.RY; // Forward RM from MEM/WB
-        }
-        if (id_ex.forwardRMFromEX_MEM) {
-            id_ex.RM = ex_mem.RZ; // Forward RM from EX/MEM
-        }  
+// Per-stage energy in picojoules: IF, ID, EX, MEM, WB, flush, leakage
+struct EnergyBreakdown {
+    double stage[5];
+    double flush;
+    double leakage;
+    double total() const {
+        return stage[0] + stage[1] + stage[2] + stage[3] + stage[4] + flush + leakage;
     }
+};
 
-    // Update EX/MEM values from MEM/WB
-    if (ex_mem.valid) {
-        if (ex_mem.forwardRMFromMEM_WB) {
-            ex_mem.RM = mem_wb.RY; // Forward RM from MEM/WB
-        }
+EnergyBreakdown computeEnergy() {
+    const EnergyCounters &c = energyCounters;
+    const EnergyTable &t = energyTable;
+    EnergyBreakdown e = {};
+    e.stage[0] = c.fetches * t.fetch + c.latchWrites[LATCH_IF_ID] * t.latchWrite;
+    e.stage[1] = c.rfReads * t.rfRead + c.latchWrites[LATCH_ID_EX] * t.latchWrite;
+    for (int op = 0; op < ALU_OP_COUNT; op++) e.stage[2] += c.aluOps[op] * t.aluOp[op];
+    e.stage[2] += c.latchWrites[LATCH_EX_MEM] * t.latchWrite;
+    for (int sz = 0; sz < 4; sz++) {
+        e.stage[3] += c.memReads[sz] * t.memRead[sz] + c.memWrites[sz] * t.memWrite[sz];
     }
+    e.stage[3] += c.latchWrites[LATCH_MEM_WB] * t.latchWrite;
+    e.stage[4] = c.rfWrites * t.rfWrite;
+    e.flush = c.flushes * t.flush;
+    e.leakage = totalCycles * t.leakagePerCycle;
+    return e;
 }
 
+// Energy-delay product in picojoule-seconds
+double energyDelayProduct(double energyPJ) {
+    return energyPJ * (totalCycles * energyTable.clockPeriodNs * 1e-9);
+}
+
+void printEnergyReport() {
+    HostPhaseScope phase(hostProfiler, HOST_PRINT);
+    static const char *const stageNames[5] = {"IF", "ID", "EX", "MEM", "WB"};
+    EnergyBreakdown e = computeEnergy();
+    double total = e.total();
+    auto line = [&](const char *name, double pj) {
+        std::cout << "  " << std::left << std::setw(8) << name << std::right
+                  << std::fixed << std::setprecision(1) << std::setw(14) << pj << " pJ  ("
+                  << std::setprecision(1) << std::setw(5) << (total > 0 ? 100.0 * pj / total : 0.0) << "%)\n";
+    };
+    std::cout << "================ Energy Estimate ======================\n";
+    for (int st = 0; st < 5; st++) line(stageNames[st], e.stage[st]);
+    line("flush", e.flush);
+    line("leakage", e.leakage);
+    std::cout << "Total energy = " << std::fixed << std::setprecision(1) << total << " pJ"
+              << "  (" << std::setprecision(2) << (totalInstructions ? total / totalInstructions : 0.0)
+              << " pJ/instruction)\n";
+    std::cout << "EDP = " << std::scientific << std::setprecision(3) << energyDelayProduct(total)
+              << " pJ*s  (clock period " << std::fixed << std::setprecision(2)
+              << energyTable.clockPeriodNs << " ns)\n";
+    std::cout << "=======================================================\n";
+}
+
+// Register file read ports used by an instruction
+static inline int registerReadsFor(const DecodedInstr &d) {
+    switch (d.opcode) {
+        case 0x33: case 0x3B: case 0x23: case 0x63: case 0x27: return 2;
+        case 0x13: case 0x1B: case 0x03: case 0x67: case 0x07: return 1;
+        case 0x43: case 0x47: case 0x4B: case 0x4F: return 3;
+        case 0x53: return d.rs2 ? 2 : 1;
+        default: return 0;
+    }
+}
 
 // =====================================================================
-// main
-// =====================================================================
-int simulate(int argc, char* argv[]) {
-    if (argc < 2) {
-        std::cerr << "Usage: " << argv[0] << " <input.mc>\n";
-        return 1;
+// Machine-mode CSRs and traps
+//   Illegal instructions, ECALL/EBREAK and CSR faults trap in EX;
+//   misaligned and page-faulting loads/stores trap in MEM; instruction
+//   page faults trap once everything older has left ID and EX. The
+//   trapping instruction and everything younger are squashed and fetch
+//   restarts at mtvec. With no handler installed (mtvec = 0) fetch
+//   stops and the simulation ends once the older instructions drain.
+// =====================================================================
+CSRFile csrFile;
+uint64_t trapsTaken = 0;
+bool fetchHalted = false; // Set by a trap with no handler
+
+// Interrupts (mip bits from devices.h) are taken at a cycle boundary:
+// IF/ID and ID/EX are squashed, fetch waits until EX/MEM and MEM/WB have
+// drained, then fetch restarts at the handler with mepc at the oldest
+// squashed instruction. A trap during the drain wins; the interrupt is
+// retried once it is enabled again.
+uint64_t interruptsTaken = 0;
+uint64_t interruptEntryCycles = 0; // Cycles from the squash to the handler fetch
+uint64_t interruptSquashed = 0;    // Instructions squashed to take interrupts
+bool interruptDraining = false;
+addr_t interruptResumePC = 0;
+
+// Counters visible to the program through cycle/instret/hpmcounterN
+void bindCSRCounters() {
+    csrFile.cycle = &clockCycle;
+    csrFile.instret = &totalInstructions;
+    csrFile.hpm[0] = &pipelineStalls;       // hpmcounter3
+    csrFile.hpm[1] = &branchMispredictions; // hpmcounter4
+    csrFile.hpm[2] = &dataHazardStalls;     // hpmcounter5
+    csrFile.hpm[3] = &controlHazardStalls;  // hpmcounter6
+    csrFile.hpm[4] = &trapsTaken;           // hpmcounter7
+    csrFile.satp = &satp;
+}
+
+// Redirect fetch to the trap handler and squash IF/ID.
+// Returns false if no handler is installed.
+bool takeTrap(uint32_t cause, uint32_t epc, uint32_t tval) {
+    trapsTaken++;
+    flight.event(clockCycle, FLIGHT_TRAP, epc, cause, tval);
+    interruptDraining = false;
+    uint32_t handler = csrFile.enterTrap(cause, epc, tval);
+    std::string where = symbolize(programSymbols, epc);
+    SIM_LOG(LOG_TRAP, LOG_INFO, "[Trap] cause=" << std::dec << cause << " at PC=0x" << std::hex << epc
+            << (where.empty() ? "" : " <" + where + ">") << " tval=0x" << tval << "\n");
+    if (if_id.valid) energyCounters.flushes++;
+    if_id.valid = false;
+    if_id.bubble = CPI_DRAIN;
+    chdu.stallPipeline = false;
+    chdu.flushPipeline = false;
+    if (handler == 0) {
+        SIM_LOG(LOG_TRAP, LOG_INFO, "[Trap] No trap handler installed (mtvec=0). Draining pipeline and halting.\n");
+        fetchHalted = true;
+        return false;
     }
+    PC = handler;
+    return true;
+}
 
-    std::string inputFile = argv[1];
-    if (!parseInputMC(inputFile)) {
+// =====================================================================
+// System calls
+//   With no trap handler installed (mtvec = 0) an ECALL is emulated by
+//   SyscallHost instead of halting. ECALL is serializing: EX squashes
+//   the younger instructions and fetch waits until the ECALL reaches
+//   WB, where the call runs on the architectural registers and fetch
+//   restarts at the next instruction.
+// =====================================================================
+SyscallHost syscalls(simLog);
+bool syscallPending = false; // An ECALL is between EX and WB
+
+// Guest accesses go through Sv32 translation like loads and stores
+struct GuestMemory {
+    MemSegment *segment(uint64_t addr, AccessType type, addr_t &paddr) {
+        if (addr != static_cast<addr_t>(addr) || !translateAddress(addr, type, paddr)) return nullptr;
+        MemSegment *seg = getMemSegmentForAddress(paddr);
+        return (seg == &mmioSegment) ? nullptr : seg; // No system-call buffers in device space
+    }
+    bool readByte(uint64_t addr, uint8_t &value) {
+        addr_t paddr;
+        MemSegment *seg = segment(addr, ACCESS_LOAD, paddr);
+        if (seg) value = static_cast<uint8_t>(seg->readByte(paddr));
+        return seg != nullptr;
+    }
+    bool writeByte(uint64_t addr, uint8_t value) {
+        addr_t paddr;
+        MemSegment *seg = segment(addr, ACCESS_STORE, paddr);
+        if (seg) {
+            seg->writeByte(paddr, value);
+            noteStore(seg, paddr, 1);
+        }
+        return seg != nullptr;
+    }
+};
+
+// The heap starts after the loaded data and may grow up to the stack
+void initSyscallHeap() {
+    addr_t base = programBreak;
+    if (base == 0) base = dataSegment.memory.empty() ? 0x10000000 : dataSegment.memory.rbegin()->first + 1;
+    syscalls.setHeap(base, 0x50000000);
+}
+
+// The DMA engine copies physical memory, without translation
+bool attachDevices() {
+    devices.readMemory = [](uint64_t addr, uint8_t &value) {
+        MemSegment *seg = (addr == static_cast<addr_t>(addr)) ? getMemSegmentForAddress(addr) : nullptr;
+        if (!seg || seg == &mmioSegment) return false;
+        value = static_cast<uint8_t>(seg->readByte(addr));
+        return true;
+    };
+    devices.writeMemory = [](uint64_t addr, uint8_t value) {
+        MemSegment *seg = (addr == static_cast<addr_t>(addr)) ? getMemSegmentForAddress(addr) : nullptr;
+        if (!seg || seg == &mmioSegment) return false;
+        seg->writeByte(addr, value);
+        noteStore(seg, addr, 1);
+        return true;
+    };
+    return devices.attach(&csrFile.mip, &clockCycle);
+}
+
+// Runs the system call of the ECALL in WB; returns false once the program has exited
+bool performSyscall() {
+    uint64_t args[6];
+    for (int i = 0; i < 6; i++) args[i] = static_cast<ureg_t>(R[10 + i]);
+    GuestMemory mem;
+    int64_t result = syscalls.handle(static_cast<ureg_t>(R[17]), args, mem, clockCycle, energyTable.clockPeriodNs);
+    if (syscalls.exited) return false;
+    R[10] = static_cast<reg_t>(result);
+    energyCounters.rfWrites++;
+    SIM_LOG(LOG_WRITEBACK, LOG_DEBUG, "[Write Back] Writing R[10] = " << std::dec << R[10] << " (system call)\n");
+    return true;
+}
+
+// =====================================================================
+// Pre-update dependencies before any stage begins
+// =====================================================================
+void preUpdateDependencies() {
+    // Update ID/EX values from EX/MEM or MEM/WB
+    if (id_ex.valid) {
+        id_ex.RA = id_ex.d.RA; // Default to original RA
+        id_ex.RB = id_ex.d.RB; // Default to original RB
+        id_ex.RM = id_ex.d.RM; // Default to original RM
+        // A jump in EX/MEM writes its return address, not the ALU result
+        reg_t exMemValue = ex_mem.d.memToReg == 2 ? static_cast<reg_t>(ex_mem.PC + ex_mem.len) : ex_mem.RZ;
+
+        if (id_ex.forwardRAFromMEM_WB) {
+            id_ex.RA = mem_wb.RY; // Forward RA from MEM/WB
+            SIM_LOG(LOG_FORWARD, LOG_DEBUG, "[Forwarding] RY = " << mem_wb.RY << " to RA\n");
+        }
+        if (id_ex.forwardRAFromEX_MEM) {
+            id_ex.RA = exMemValue; // Forward RA from EX/MEM
+            SIM_LOG(LOG_FORWARD, LOG_DEBUG, "[Forwarding] RZ = " << exMemValue << " to RA\n");
+        }
+
+        if (id_ex.forwardRBFromMEM_WB) {
+            id_ex.RB = mem_wb.RY; // Forward RB from MEM/WB
+            SIM_LOG(LOG_FORWARD, LOG_DEBUG, "[Forwarding] RY = " << mem_wb.RY << " to RB\n");
+        }
+        if (id_ex.forwardRBFromEX_MEM) {
+            id_ex.RB = exMemValue; // Forward RB from EX/MEM
+            SIM_LOG(LOG_FORWARD, LOG_DEBUG, "[Forwarding] RZ = " << exMemValue << " to RB\n");
+        }
+
+        if (id_ex.forwardRMFromMEM_WB) {
+            id_ex.RM = mem_wb.RY; // Forward RM from MEM/WB
+        }
+        if (id_ex.forwardRMFromEX_MEM) {
+            id_ex.RM = exMemValue; // Forward RM from EX/MEM
+        }  
+
+        // FP sources (register numbers >= FP_REG_BASE) take FY/FZ instead
+        id_ex.FA = id_ex.d.FA;
+        id_ex.FB = id_ex.d.FB;
+        id_ex.FC = id_ex.d.FC;
+        if (id_ex.d.rs1 >= FP_REG_BASE) {
+            if (id_ex.forwardRAFromMEM_WB) id_ex.FA = mem_wb.FY;
+            if (id_ex.forwardRAFromEX_MEM) id_ex.FA = ex_mem.FZ;
+        }
+        if (id_ex.d.rs2 >= FP_REG_BASE) {
+            if (id_ex.forwardRBFromMEM_WB || id_ex.forwardRMFromMEM_WB) id_ex.FB = mem_wb.FY;
+            if (id_ex.forwardRBFromEX_MEM || id_ex.forwardRMFromEX_MEM) id_ex.FB = ex_mem.FZ;
+        }
+        if (id_ex.forwardRCFromMEM_WB) id_ex.FC = mem_wb.FY;
+        if (id_ex.forwardRCFromEX_MEM) id_ex.FC = ex_mem.FZ;
+    }
+
+    // Update EX/MEM values from MEM/WB
+    if (ex_mem.valid) {
+        if (ex_mem.forwardRMFromMEM_WB) {
+            ex_mem.RM = mem_wb.RY; // Forward RM from MEM/WB
+            if (ex_mem.d.rs2 >= FP_REG_BASE) ex_mem.FM = mem_wb.FY;
+        }
+    }
+}
+
+
+// =====================================================================
+// Print the end-of-run statistics block
+// =====================================================================
+// Stacked CPI breakdown; the rows add up to Stat1. Empty for replay,
+// which does not step the latches.
+void printCpiStack() {
+    uint64_t charged = 0;
+    for (int c = 0; c < CPI_CATEGORIES; c++) charged += cpiCycles[c];
+    if (charged == 0) return;
+    const int BAR_WIDTH = 40;
+    std::cout << "CPI stack (" << totalCycles << " cycles, " << totalInstructions << " instructions):\n";
+    for (int c = 0; c < CPI_CATEGORIES; c++) {
+        if (cpiCycles[c] == 0 && c != CPI_BASE) continue;
+        double share = static_cast<double>(cpiCycles[c]) / charged;
+        std::cout << "  " << std::left << std::setw(28) << cpiCategoryNames[c] << std::right << std::setw(10)
+                  << cpiCycles[c] << std::fixed << std::setprecision(3) << std::setw(8)
+                  << (totalInstructions ? static_cast<double>(cpiCycles[c]) / totalInstructions : 0.0)
+                  << std::setprecision(1) << std::setw(7) << 100.0 * share << "%  "
+                  << std::string(static_cast<size_t>(share * BAR_WIDTH + 0.5), '#') << "\n";
+    }
+    std::cout << "  " << std::left << std::setw(28) << "total" << std::right << std::setw(10) << charged
+              << std::fixed << std::setprecision(3) << std::setw(8)
+              << (totalInstructions ? static_cast<double>(charged) / totalInstructions : 0.0) << "\n";
+}
+
+void printStatistics() {
+    HostPhaseScope phase(hostProfiler, HOST_PRINT);
+    syscalls.flush(); // Guest output before the report
+    devices.flush();
+    std::cout << "\n================ Simulation Statistics ================\n";
+    std::cout << "Stat1: Total number of cycles = " << std::dec << totalCycles << "\n";
+    std::cout << "Stat2: Total instructions executed = " << std::dec << totalInstructions << "\n";
+    std::cout << "Stat3: CPI = " << std::fixed << std::setprecision(2) 
+              << (totalCycles / static_cast<double>(totalInstructions)) << "\n";
+    std::cout << "Stat4: Number of Data-transfer instructions executed = " << std::dec << dataTransferInstructions << "\n";
+    std::cout << "Stat5: Number of ALU instructions executed = " << std::dec << aluInstructions << "\n";
+    std::cout << "Stat6: Number of Control instructions executed = " << std::dec << controlInstructions << "\n";
+    std::cout << "Stat7: Number of stalls/bubbles in the pipeline = " << std::dec << pipelineStalls << "\n";
+    std::cout << "Stat8: Number of data hazards = " << std::dec << dataHazards << "\n";
+    std::cout << "Stat9: Number of control hazards = " << std::dec << controlHazards << "\n";
+    std::cout << "Stat10: Number of branch mispredictions = " << std::dec << branchMispredictions << "\n";
+    std::cout << "Stat11: Number of stalls due to data hazards = " << std::dec << dataHazardStalls << "\n";
+    std::cout << "Stat12: Number of stalls due to control hazards = " << std::dec << controlHazardStalls << "\n";
+    std::cout << "=======================================================\n";
+    printCpiStack();
+    if (trapsTaken > 0) {
+        std::cout << "Traps taken = " << trapsTaken << " (last mcause=" << csrFile.mcause
+                  << ", mepc=0x" << std::hex << csrFile.mepc << std::dec << ")\n";
+    }
+    if (compressedInstructions > 0) {
+        std::cout << "Compressed instructions = " << compressedInstructions << " of " << totalInstructions
+                  << ", dynamic code size = " << fetchedCodeBytes << " bytes ("
+                  << std::fixed << std::setprecision(1)
+                  << 100.0 * (4.0 * totalInstructions - fetchedCodeBytes) / (4.0 * totalInstructions)
+                  << "% smaller than 4-byte encodings)\n";
+    }
+    if (fpInstructions > 0) {
+        std::cout << "FP instructions = " << fpInstructions << ", FPU stall cycles = " << fpStallCycles
+                  << ", fflags = 0x" << std::hex << csrFile.fflags << std::dec << "\n";
+    }
+    if (vectorInstructions > 0) {
+        std::cout << "Vector instructions = " << vectorInstructions << " (" << vectorElements
+                  << " elements), vector unit stall cycles = " << vectorStallCycles
+                  << ", VLEN = " << VLEN << ", host kernels = " << vecKernelName() << "\n";
+    }
+    if (interruptsTaken > 0) {
+        std::cout << "Interrupts taken = " << interruptsTaken << ", entry cycles = " << interruptEntryCycles
+                  << " (" << std::fixed << std::setprecision(1)
+                  << static_cast<double>(interruptEntryCycles) / interruptsTaken
+                  << " per interrupt), squashed instructions = " << interruptSquashed << "\n";
+    }
+    devices.printStatistics();
+    if (codeStores > 0 || fenceIFlushes > 0) {
+        std::cout << "Self-modifying code: stores to fetched code = " << codeStores
+                  << ", parcels invalidated = " << codeParcelsInvalidated << ", refetched = " << codeRefills
+                  << ", FENCE.I = " << fenceIFlushes << "\n";
+    }
+    if (syscalls.calls > 0 || syscallStallCycles > 0) {
+        std::cout << "System calls = " << syscalls.calls << ", serialization stall cycles = " << syscallStallCycles;
+        if (syscalls.exited) std::cout << " (exit code " << syscalls.exitCode << ")";
+        std::cout << "\n";
+    }
+}
+
+// =====================================================================
+// Per-PC profiling (--profile, --profile-folded): stage occupancy and
+// attributed cycles are sampled at the start of every cycle; executions,
+// stalls and mispredictions are counted where they happen
+// =====================================================================
+PcProfiler profiler;
+std::string profileFile;       // Sorted per-PC report
+std::string profileFoldedFile; // Folded stacks for flamegraph tools
+
+void profileCycle() {
+    if (if_id.valid) profiler.stage(if_id.PC, PROF_ID);
+    if (id_ex.valid) profiler.stage(id_ex.PC, PROF_EX);
+    if (ex_mem.valid) profiler.stage(ex_mem.PC, PROF_MEM);
+    if (mem_wb.valid) profiler.stage(mem_wb.PC, PROF_WB);
+    profiler.cycle(mem_wb.valid ? mem_wb.PC : ex_mem.valid ? ex_mem.PC : id_ex.valid ? id_ex.PC
+                   : if_id.valid ? if_id.PC : PC);
+}
+
+// Per-branch analytics (--branch-report), recorded where branches resolve
+BranchProfiler branchProfiler;
+std::string branchReportFile;
+
+void writeBranchReport() {
+    if (branchProfiler.writeReport(branchReportFile, programText, programSymbols))
+        std::cout << "Branch report written to " << branchReportFile << "\n";
+}
+
+// Dataflow critical path (--dataflow, --dataflow-latency) of a replayed trace
+DataflowAnalyzer dataflow;
+std::string dataflowFile;
+
+DataflowClass dataflowClass(uint32_t ir, const OpcodeInfo *info) {
+    uint32_t opcode = getBits(ir, 6, 0);
+    if (info && (info->flags & INSTR_FLAG_V)) return DF_VECTOR;
+    if (opcode == 0x03 || opcode == 0x07) return DF_LOAD;
+    if (opcode == 0x23 || opcode == 0x27) return DF_STORE;
+    if (opcode == 0x63 || opcode == 0x6F || opcode == 0x67) return DF_BRANCH;
+    if ((opcode == 0x33 || opcode == 0x3B) && getBits(ir, 31, 25) == 1)
+        return getBits(ir, 14, 12) < 4 ? DF_MUL : DF_DIV;
+    if (info) {
+        switch (fpUnitFor(info->id)) {
+            case FPU_ADD: return DF_FP_ADD;
+            case FPU_MUL: case FPU_FMA: return DF_FP_MUL;
+            case FPU_DIV: case FPU_SQRT: return DF_FP_DIV;
+            case FPU_CVT: return DF_FP_CVT;
+            default: break;
+        }
+    }
+    return DF_ALU;
+}
+
+// =====================================================================
+// Pipeline trace (--pipe-trace, --pipe-trace-window): Kanata log for
+// pipeline viewers, written by a background thread
+// =====================================================================
+PipelineTracer pipeTracer;
+std::string pipeTraceFile;
+uint64_t fetchSequence = 0; // Last dynamic instruction number handed out by IF
+
+std::string pipeTraceText(uint64_t pc, uint32_t ir) {
+    auto it = programText.find(pc);
+    if (it != programText.end()) return it->second;
+    const OpcodeInfo *info = findInstrByEncoding(ir, XLEN == 64);
+    std::string name = info ? info->mnemonic : "?";
+    for (char &ch : name) ch = static_cast<char>(std::tolower(static_cast<unsigned char>(ch)));
+    return name;
+}
+
+void pipeTraceCycle() {
+    const PipeOccupant latches[PIPE_STAGES] = {
+        {false, 0}, {if_id.valid, if_id.seq}, {id_ex.valid, id_ex.seq}, {ex_mem.valid, ex_mem.seq},
+        {mem_wb.valid, mem_wb.seq}};
+    pipeTracer.sample(clockCycle, latches);
+}
+
+// "START:END" or "START:" in cycles; END is exclusive
+bool parseCycleWindow(const std::string &value, uint64_t &start, uint64_t &end) {
+    size_t colon = value.find(':');
+    if (colon == std::string::npos) return false;
+    start = optionNumber(value.substr(0, colon));
+    end = (colon + 1 < value.size()) ? optionNumber(value.substr(colon + 1)) : UINT64_MAX;
+    return start < end;
+}
+
+void writeProfile() {
+    if (!profileFile.empty() &&
+        profiler.writeReport(profileFile, programText, programSymbols, totalCycles, XLEN == 64))
+        std::cout << "Profile written to " << profileFile << "\n";
+    if (!profileFoldedFile.empty() && profiler.writeFolded(profileFoldedFile, programText, programSymbols, XLEN == 64))
+        std::cout << "Folded stacks written to " << profileFoldedFile << "\n";
+}
+
+// =====================================================================
+// applyOption / parseKnobArgs: --name=value options after the .mc
+// arguments. applyOption returns false for names it does not know.
+// =====================================================================
+std::string replayTraceFile; // Non-empty: run the timing model from this trace
+std::string sweepGridFile;   // Non-empty: run a design-space sweep
+std::string sweepOutFile = "sweep.csv";
+unsigned sweepJobs = 0;      // 0 = one per online core
+
+bool applyOption(const std::string &name, const std::string &value) {
+    if (name == "knob2") Knob2 = optionBool(value);
+    else if (name == "knob3") Knob3 = optionBool(value);
+    else if (name == "knob4") Knob4 = optionBool(value);
+    else if (name == "knob5") {
+        Knob5 = true;
+        Knob5InstructionNumber = static_cast<int>(optionNumber(value));
+    }
+    else if (name == "knob6") Knob6 = optionBool(value);
+    else if (name == "predictor") {
+        if (value == "static" || value == "0") predictorType = 0;
+        else if (value == "1bit" || value == "1") predictorType = 1;
+        else if (value == "2bit" || value == "2") predictorType = 2;
+        else return false;
+    }
+    else if (name == "predictor-entries") predictorEntries = static_cast<uint32_t>(optionNumber(value));
+    else if (name == "mem-latency") memLatency = static_cast<uint32_t>(optionNumber(value));
+    else if (name == "fp-add-latency") fpAddLatency = static_cast<uint32_t>(optionNumber(value));
+    else if (name == "fp-mul-latency") fpMulLatency = static_cast<uint32_t>(optionNumber(value));
+    else if (name == "fp-div-latency") fpDivLatency = static_cast<uint32_t>(optionNumber(value));
+    else if (name == "fp-cvt-latency") fpCvtLatency = static_cast<uint32_t>(optionNumber(value));
+    else if (name == "vector-lanes") vectorLanes = std::max<uint32_t>(1, static_cast<uint32_t>(optionNumber(value)));
+    else if (name == "energy-table") return loadEnergyTable(value);
+    else if (name == "clock-ns") energyTable.clockPeriodNs = std::strtod(value.c_str(), nullptr);
+    else if (name == "satp") satp = static_cast<uint32_t>(optionNumber(value));
+    else if (name == "itlb-entries") itlb.configure(static_cast<uint32_t>(optionNumber(value)), itlb.ways);
+    else if (name == "itlb-ways") itlb.configure(itlb.entries, static_cast<uint32_t>(optionNumber(value)));
+    else if (name == "dtlb-entries") dtlb.configure(static_cast<uint32_t>(optionNumber(value)), dtlb.ways);
+    else if (name == "dtlb-ways") dtlb.configure(dtlb.entries, static_cast<uint32_t>(optionNumber(value)));
+    else if (name == "ptw-latency") ptwLatency = static_cast<uint32_t>(optionNumber(value));
+    else if (name == "replay") replayTraceFile = value;
+    else if (name == "sweep") sweepGridFile = value;
+    else if (name == "sweep-out") sweepOutFile = value;
+    else if (name == "sandbox") syscalls.sandboxDir = value;
+    else if (name == "uart-in") devices.uartInputFile = value;
+    else if (name == "uart-tx-cycles") devices.uartTxCycles = static_cast<uint32_t>(optionNumber(value));
+    else if (name == "dma-bytes-per-cycle") devices.dmaBytesPerCycle = static_cast<uint32_t>(optionNumber(value));
+    else if (name == "jobs") sweepJobs = static_cast<unsigned>(optionNumber(value));
+    else if (name == "profile") profileFile = value;
+    else if (name == "profile-folded") profileFoldedFile = value;
+    else if (name == "mem-profile") memProfileFile = value;
+    else if (name == "branch-report") branchReportFile = value;
+    else if (name == "dataflow") dataflowFile = value;
+    else if (name == "dataflow-latency") return dataflow.setLatencies(value);
+    else if (name == "log") return simLog.configure(value);
+    else if (name == "log-file") logFile = value;
+    else if (name == "pipe-trace") pipeTraceFile = value;
+    else if (name == "flight-records") flightRecords = static_cast<uint32_t>(optionNumber(value));
+    else if (name == "flight-file") flightFile = value;
+    else if (name == "commit-log") commitLogFile = value;
+    else if (name == "host-profile") hostProfiler.enabled = optionBool(value);
+    else if (name == "host-counters") hostProfiler.enabled |= (hostProfiler.counters = optionBool(value));
+    else if (name == "progress") hostProfiler.progressSeconds = std::strtod(value.c_str(), nullptr);
+    else if (name == "pipe-trace-window") return parseCycleWindow(value, pipeTracer.windowStart, pipeTracer.windowEnd);
+    else return false;
+    return true;
+}
+
+// Returns false after reporting the first option that applyOption rejects
+bool parseKnobArgs(int argc, char* argv[]) {
+    for (int i = FIRST_OPTION_ARG; i < argc; i++) {
+        std::string name, value;
+        if (!splitOption(argv[i], name, value)) continue;
+        if (name == "knob1") continue; // Read by the wrapper
+        if (name == "trace-out") {
+            std::cerr << "WARNING: --trace-out is written by the unpipelined model (--knob1=0); ignored\n";
+            continue;
+        }
+        if (!applyOption(name, value)) {
+            std::cerr << "ERROR: Invalid option " << argv[i] << "\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+// =====================================================================
+// Trace-driven timing model
+//   Replays a trace written by the functional simulator through the
+//   five-stage pipeline timing rules. Nothing is executed: register
+//   numbers come straight from the IR, branch outcomes and effective
+//   addresses come from the trace record.
+//   - Knob2 on : ALU results forward to the next EX, loads stall one cycle
+//   - Knob2 off: consumers wait until the producer has written back
+//   - Conditional branches use the branch prediction table; a
+//     misprediction is resolved in EX and refetches the next cycle. A
+//     branch's decode stall costs a cycle unless WB retires an
+//     instruction in the branch's EX cycle (see runPipeline)
+//   - JAL/JALR are redirected in fetch, as in the cycle model; a JALR
+//     whose base register was still in flight at fetch, with a different
+//     old value, is flushed in EX (one bubble)
+//   - Traps, interrupts and MRET are not modeled
+// =====================================================================
+int simulateFromTrace(const std::string &traceFile) {
+    TraceReader reader;
+    if (!reader.open(traceFile)) {
         return 1;
     }
+    const TraceRecord *records = reader.records();
+    const uint64_t count = reader.size();
+    std::cout << "Replaying " << std::dec << count << " trace records from " << traceFile << "\n";
+
+    // x registers at 0-31, FP registers at FP_REG_BASE and up
+    uint64_t regProducerEX[2 * NUM_REGS] = {0}; // EX cycle of the last writer of each register
+    bool regProducerIsLoad[2 * NUM_REGS] = {false};
+    bool regInFlight[2 * NUM_REGS] = {false};
+    // x register values the trace reveals (JAL/JALR links, JALR bases), for
+    // the target a JALR computes in IF from a not yet written-back register
+    uint32_t regValue[NUM_REGS] = {0}, regPrevValue[NUM_REGS] = {0};
+    bool regValueKnown[NUM_REGS] = {false}, regPrevKnown[NUM_REGS] = {false};
+    uint64_t prevEX = 1;      // So that the first instruction reaches EX in cycle 2
+    uint64_t prevPrevEX = 0;  // EX cycle of the instruction before that
+    uint64_t redirectEX = 0;  // Earliest EX cycle after a misprediction refetch
+    uint32_t vl = 0;          // Vector length, from the vsetvli records
+
+    hostProfiler.beginRun();
+    for (uint64_t i = 0; i < count; i++) {
+        const TraceRecord &rec = records[i];
+        hostProfiler.progress(prevEX, i);
+        uint32_t ir = expandParcel(rec.ir, XLEN == 64);
+        uint32_t len = instrLength(rec.ir);
+        uint32_t opcode = getBits(ir, 6, 0);
+        uint32_t rd  = getBits(ir, 11, 7);
+        uint32_t rs1 = getBits(ir, 19, 15);
+        uint32_t rs2 = getBits(ir, 24, 20);
+        uint32_t rs3 = 0;
+        bool usesRs1 = !(opcode == 0x37 || opcode == 0x17 || opcode == 0x6F);
+        bool usesRs2 = (opcode == 0x33 || opcode == 0x3B || opcode == 0x23 || opcode == 0x63);
+        bool writesRd = !(opcode == 0x23 || opcode == 0x63 || opcode == 0x27) && rd != 0;
+        bool isLoad = (opcode == 0x03 || opcode == 0x07);
+        bool isMem = isLoad || opcode == 0x23 || opcode == 0x27;
+        uint32_t fpLatency = 1;
+        uint32_t vectorCycles = 1;
+        const OpcodeInfo *info = (isFPOpcode(opcode) || opcode == 0x57) ? findInstrByEncoding(ir, XLEN == 64) : nullptr;
+        if (info && (info->flags & INSTR_FLAG_V)) {
+            // Vector register operands are not tracked (see V)
+            usesRs1 = vecReadsXRs1(*info);
+            usesRs2 = vecReadsXRs2(*info);
+            writesRd = vecWritesXRd(*info) && rd != 0;
+            if (info->id == INSTR_VSETVLI) vl = rec.memAddr;
+            vectorCycles = vecExecuteCycles(info->id, vl, vectorLanes);
+            vectorInstructions++;
+            if (info->id != INSTR_VSETVLI) vectorElements += vl;
+        } else if (info) {
+            usesRs2 = (info->flags & INSTR_FLAG_FRS2) != 0;
+            if (info->flags & INSTR_FLAG_FRS1) rs1 += FP_REG_BASE;
+            if (info->flags & INSTR_FLAG_FRS2) rs2 += FP_REG_BASE;
+            if (info->flags & INSTR_FLAG_FRD) rd += FP_REG_BASE;
+            if (info->format == FMT_R4) rs3 = getBits(ir, 31, 27) + FP_REG_BASE;
+            writesRd = (opcode != 0x27) && rd != 0;
+            switch (fpUnitFor(info->id)) {
+                case FPU_ADD: fpLatency = fpAddLatency; break;
+                case FPU_MUL: case FPU_FMA: fpLatency = fpMulLatency; break;
+                case FPU_DIV: case FPU_SQRT: fpLatency = fpDivLatency; break;
+                case FPU_CVT: fpLatency = fpCvtLatency; break;
+                default: break;
+            }
+        }
+
+        uint64_t ex = std::max(prevEX + 1, redirectEX);
+        uint64_t issue = ex;
+        uint64_t fetchCycle = ex - 2;
+
+        // Operand readiness
+        bool hazard = false;
+        uint32_t sources[3] = {usesRs1 ? rs1 : 0, usesRs2 ? rs2 : 0, rs3};
+        for (uint32_t src : sources) {
+            if (src == 0 || !regInFlight[src]) continue;
+            uint64_t producer = regProducerEX[src];
+            if (producer + 3 <= ex) continue; // Already written back
+            hazard = true;
+            uint64_t ready = Knob2 ? producer + (regProducerIsLoad[src] ? 2 : 1) : producer + 3;
+            issue = std::max(issue, ready);
+        }
+        if (hazard) dataHazards++;
+        dataHazardStalls += issue - ex;
+        pipelineStalls += issue - ex;
+        ex = issue;
+
+        // Control flow
+        if (opcode == 0x63) {
+            controlHazards++;
+            bool actualOutcome = (rec.nextPC != rec.pc + len);
+            updateBranchTarget(rec.pc, rec.pc + decode(ir).imm);
+            bool mispredicted = predictBranch(rec.pc) != actualOutcome;
+            if (branchProfiler.enabled) branchProfiler.record(rec.pc, actualOutcome, mispredicted);
+            if (mispredicted) {
+                branchMispredictions++;
+                controlHazardStalls += 1;
+                pipelineStalls += 1;
+                redirectEX = ex + 2; // Refetch in EX (IF runs after EX), decode EX+1, execute EX+2
+            }
+            // A branch that leaves ID without a RAW hazard (always, with Knob2
+            // off) stalls ID and IF; WB releases the stall in the branch's EX
+            // cycle only if it retires an instruction, i.e. one was in EX at EX-2
+            bool forwarded = false;
+            for (uint32_t src : sources) {
+                if (Knob2 && src != 0 && regInFlight[src] && regProducerEX[src] + 1 == ex) forwarded = true;
+            }
+            if (!forwarded && prevEX != ex - 2 && prevPrevEX != ex - 2) {
+                controlHazardStalls += 1;
+                pipelineStalls += 1;
+                redirectEX = std::max(redirectEX, ex + 1) + 1;
+            }
+            updateBranchPrediction(rec.pc, actualOutcome);
+        } else if (opcode == 0x6F || opcode == 0x67) {
+            controlHazards++;
+            updateBranchPrediction(rec.pc, true);
+            updateBranchTarget(rec.pc, rec.nextPC);
+            if (opcode == 0x67 && rs1 != 0) {
+                // IF read rs1 from the register file: the value before the last
+                // write if that write was still in flight (WB = its EX + 2)
+                uint32_t imm = static_cast<uint32_t>(decode(ir).imm);
+                bool stale = regInFlight[rs1] && regProducerEX[rs1] + 2 > fetchCycle;
+                bool sameTarget = regPrevKnown[rs1] && ((regPrevValue[rs1] + imm) & ~1u) == rec.nextPC;
+                if (stale && !sameTarget) {
+                    controlHazardStalls += 1;
+                    pipelineStalls += 1;
+                    redirectEX = ex + 2; // Flushed in EX, refetched from the target
+                }
+                regValue[rs1] = rec.nextPC - imm;
+                regValueKnown[rs1] = true;
+            }
+        } else if (ir == 0x00000073) {
+            // ECALL serializes: the next instruction is fetched in its WB cycle
+            pipelineStalls += 2;
+            syscallStallCycles += 2;
+            redirectEX = ex + 4;
+        } else if (opcode == 0x0F && getBits(ir, 14, 12) == 1) {
+            // FENCE.I refetches the next instruction in its EX cycle
+            pipelineStalls += 1;
+            fenceIFlushes++;
+            redirectEX = ex + 2;
+        }
+
+        // A load/store holds the pipeline in MEM for memLatency extra cycles
+        if (isMem && memLatency) {
+            pipelineStalls += memLatency;
+            ex += memLatency;
+        }
+
+        // A multi-cycle FP operation holds the pipeline in EX
+        if (fpLatency > 1) {
+            pipelineStalls += fpLatency - 1;
+            fpStallCycles += fpLatency - 1;
+            ex += fpLatency - 1;
+        }
+        if (isFPOpcode(opcode) && !(info && (info->flags & INSTR_FLAG_V))) fpInstructions++;
+
+        // A vector instruction holds EX for ceil(vl / vectorLanes) cycles
+        if (vectorCycles > 1) {
+            pipelineStalls += vectorCycles - 1;
+            vectorStallCycles += vectorCycles - 1;
+            ex += vectorCycles - 1;
+        }
+
+        if (writesRd) {
+            regProducerEX[rd] = ex;
+            regProducerIsLoad[rd] = isLoad;
+            regInFlight[rd] = true;
+        }
+        if (writesRd && rd < NUM_REGS) {
+            regPrevValue[rd] = regValue[rd];
+            regPrevKnown[rd] = regValueKnown[rd];
+            regValue[rd] = rec.pc + len; // Link address; other results are unknown
+            regValueKnown[rd] = (opcode == 0x6F || opcode == 0x67);
+        }
+
+        // Dataflow graph: the model's forwarding latencies (a load feeds its
+        // consumer one cycle later than an ALU result)
+        if (dataflow.enabled) {
+            DataflowClass cls = dataflowClass(ir, info);
+            uint32_t memBytes = (isMem && cls != DF_VECTOR) ? 1u << (getBits(ir, 14, 12) & 3) : 0;
+            uint32_t cycles = (cls == DF_VECTOR) ? vectorCycles : isLoad ? 2 + memLatency : fpLatency;
+            dataflow.instruction(rec.pc, sources, writesRd ? rd : 0, cls, rec.memAddr, memBytes, cycles);
+        }
+
+        totalInstructions++;
+        fetchedCodeBytes += len;
+        if (len == 2) compressedInstructions++;
+        if (isMem) {
+            dataTransferInstructions++;
+        } else if (opcode == 0x63 || opcode == 0x6F || opcode == 0x67) {
+            controlInstructions++;
+        } else {
+            aluInstructions++;
+        }
+        prevPrevEX = prevEX;
+        prevEX = ex;
+    }
 
-    // Initialize registers and memory
+    // The last instruction still needs MEM and WB
+    totalCycles = (count == 0) ? 0 : prevEX + 3;
+    clockCycle = totalCycles;
+    hostProfiler.endRun(count, clockCycle);
+
+    if (Knob6) {
+        printBranchPredictionUnit();
+    }
+    printStatistics();
+    if (branchProfiler.enabled) writeBranchReport();
+    if (dataflow.enabled) {
+        dataflow.printSummary(std::cout, totalCycles);
+        if (dataflow.writeReport(dataflowFile, programText, programSymbols))
+            std::cout << "Dataflow report written to " << dataflowFile << "\n";
+    }
+    hostProfiler.printReport(std::cout);
+    std::cout << "Replay finished after " << std::dec << clockCycle << " cycles.\n";
+    return 0;
+}
+
+// =====================================================================
+// main
+// =====================================================================
+// =====================================================================
+// resetMachineState: registers and PC as at program start; false if
+// a device cannot be set up
+// =====================================================================
+bool resetMachineState() {
     for (int i = 0; i < NUM_REGS; i++) {
         R[i] = 0;
+        F[i] = 0;
+        std::fill(V[i], V[i] + VLENB, 0);
     }
     R[2] = 0x7FFFFFFC; // stack pointer
-    PC = 0;
+    PC = programEntry;
     clockCycle = 0;
+    csrFile = CSRFile();
+    bindCSRCounters();
+    fetchHalted = false;
+    syscallPending = false;
+    interruptDraining = false;
+    initSyscallHeap();
+    return attachDevices();
+}
 
-    // Dump initial contents to files
-    dumpInstructionMemoryToFile("instruction.mc");
-    dumpSegmentToFile("data.mc", dataSegment, 0x10000000, 0x50000000);
-    dumpSegmentToFile("stack.mc", stackSegment, 0x50000000, 0x7FFFFFFF);
-
-    // Print initial register state
-    std::cout << "Initial state (before cycle 0):\n";
-    printRegisters();
-
-    // Prompt user for control
+// =====================================================================
+// runPipeline: the cycle loop, until HALT or the user exits
+// =====================================================================
+void runPipeline(bool runAllRemaining) {
     char userInput;
-    std::cout << "Enter N for next, R for remainder, E to exit: ";
-    std::cin >> userInput;
-    if (userInput == 'E' || userInput == 'e') {
-        std::cout << "Exiting at user request.\n";
-        return 0;
-    }
-    bool runAllRemaining = (userInput == 'R' || userInput == 'r');
-
-    std::cout << "Starting simulation...\n";
 
     bool stallSignal = false; // Initialize stall signal
+    CpiCategory stallCause = CPI_DRAIN; // Why stallSignal was set, for the bubble it creates
+    uint32_t memWaitCycles = 0; // Cycles the current MEM access has waited
+    uint32_t fpBusyCycles = 0;  // Cycles the FP operation in EX still needs
+    uint32_t vecBusyCycles = 0; // Cycles the vector instruction in EX still needs
 
     // Track dependencies for RAW hazards
     std::multiset<uint32_t> unresolvedDependencies;
@@ -1001,11 +2549,100 @@ int simulate(int argc, char* argv[]) {
         return unresolvedDependencies.empty();
     };
 
+    // Take a trap: the squashed instructions no longer hold the pipeline
+    auto trap = [&](uint32_t cause, uint32_t epc, uint32_t tval) {
+        takeTrap(cause, epc, tval);
+        unresolvedDependencies.clear();
+        stallSignal = false;
+    };
+
     while (currentState != HALT) {
-        std::cout << "Clock Cycle: " << std::dec << clockCycle << "\n"; // Cycle number in decimal
+        SIM_LOG(LOG_CYCLE, LOG_DEBUG, "Clock Cycle: " << std::dec << clockCycle << "\n"); // Cycle number in decimal
 
         // Increment total cycles
         totalCycles++;
+        devices.tick(clockCycle);
+        if (profiler.enabled) profileCycle();
+        hostProfiler.progress(clockCycle, totalInstructions);
+        if (pipeTracer.enabled()) pipeTraceCycle();
+
+        // Page-table walks hold the whole pipeline until they complete
+        if (translationStallCycles > 0) {
+            translationStallCycles--;
+            pipelineStalls++;
+            cpiCycles[CPI_STRUCT_PAGE_WALK]++;
+            SIM_LOG(LOG_MEMORY, LOG_TRACE, "[Translation] Page-table walk in progress.\n");
+            clockCycle++;
+            continue;
+        }
+
+        // Memory latency: a load/store in MEM holds the whole pipeline
+        if (ex_mem.valid && (ex_mem.d.memRead || ex_mem.d.memWrite) && memWaitCycles < memLatency) {
+            memWaitCycles++;
+            pipelineStalls++;
+            cpiCycles[CPI_STRUCT_MEMORY]++;
+            SIM_LOG(LOG_MEMORY, LOG_TRACE, "[Memory Access] Waiting on memory (" << std::dec << memWaitCycles
+                    << "/" << memLatency << ").\n");
+            clockCycle++;
+            continue;
+        }
+        memWaitCycles = 0;
+
+        // FP latency: a multi-cycle FP operation holds the whole pipeline
+        if (fpBusyCycles > 0) {
+            fpBusyCycles--;
+            pipelineStalls++;
+            fpStallCycles++;
+            cpiCycles[CPI_STRUCT_FPU]++;
+            SIM_LOG(LOG_EXECUTE, LOG_TRACE, "[Execute] Waiting on the FPU (" << std::dec << fpBusyCycles << " cycles left).\n");
+            clockCycle++;
+            continue;
+        }
+
+        // Vector length: the vector unit holds the whole pipeline likewise
+        if (vecBusyCycles > 0) {
+            vecBusyCycles--;
+            pipelineStalls++;
+            vectorStallCycles++;
+            cpiCycles[CPI_STRUCT_VECTOR]++;
+            SIM_LOG(LOG_EXECUTE, LOG_TRACE, "[Execute] Waiting on the vector unit (" << std::dec << vecBusyCycles << " cycles left).\n");
+            clockCycle++;
+            continue;
+        }
+
+        // Interrupt entry: squash the instructions not yet executed and
+        // drain the older ones (see interruptDraining)
+        if (!interruptDraining && !syscallPending && !fetchHalted && csrFile.pendingInterrupt()) {
+            interruptDraining = true;
+            interruptResumePC = id_ex.valid ? id_ex.PC : if_id.valid ? if_id.PC : PC;
+            uint32_t squashed = (if_id.valid ? 1 : 0) + (id_ex.valid ? 1 : 0);
+            interruptSquashed += squashed;
+            energyCounters.flushes += squashed;
+            if_id.valid = false;
+            id_ex.valid = false;
+            if_id.bubble = id_ex.bubble = CPI_DRAIN;
+            stallSignal = false;
+            chdu.stallPipeline = false;
+            chdu.flushPipeline = false;
+            SIM_LOG(LOG_TRAP, LOG_INFO, "[Interrupt] Pending: squashed " << squashed << " instructions, resuming at 0x"
+                    << std::hex << interruptResumePC << std::dec << " after the handler.\n");
+        }
+        if (interruptDraining) {
+            interruptEntryCycles++;
+            if (!ex_mem.valid && !mem_wb.valid) {
+                interruptDraining = false;
+                uint32_t irq = csrFile.pendingInterrupt();
+                if (irq) {
+                    interruptsTaken++;
+                    flight.event(clockCycle, FLIGHT_INTERRUPT, interruptResumePC, irq);
+                    PC = csrFile.enterTrap(irq, interruptResumePC, 0);
+                    SIM_LOG(LOG_TRAP, LOG_INFO, "[Interrupt] Cause " << (irq & ~CAUSE_INTERRUPT) << ": entering handler at 0x"
+                            << std::hex << PC << std::dec << "\n");
+                } else {
+                    PC = interruptResumePC; // Withdrawn while draining
+                }
+            }
+        }
 
         // Pre-update dependencies before any stage begins
         preUpdateDependencies();
@@ -1018,9 +2655,18 @@ int simulate(int argc, char* argv[]) {
         // Print unresolved dependencies
         printUnresolvedDependencies(unresolvedDependencies);
 
+        // CPI stack: this cycle retires an instruction or a bubble
+        cpiCycles[mem_wb.valid ? CPI_BASE : mem_wb.bubble]++;
+
         // Write Back (MEM_WB)
         if (mem_wb.valid) { // Write Back only if MEM_WB is valid
             totalInstructions++; // Increment total instructions executed
+            if (profiler.enabled) profiler.executed(mem_wb.PC);
+            if (pipeTracer.enabled()) pipeTracer.retired(clockCycle, mem_wb.seq);
+            flight.retire(clockCycle, mem_wb.PC, mem_wb.IR, mem_wb.d.regWrite && mem_wb.d.rd != 0 ? mem_wb.d.rd : FLIGHT_NO_RD,
+                          mem_wb.d.rd >= FP_REG_BASE ? mem_wb.FY : static_cast<ureg_t>(mem_wb.RY), mem_wb.memAddr);
+            fetchedCodeBytes += mem_wb.len;
+            if (mem_wb.len == 2) compressedInstructions++;
             if (mem_wb.d.memRead || mem_wb.d.memWrite) {
                 dataTransferInstructions++; // Increment data-transfer instructions
             } else if (mem_wb.d.branch || mem_wb.d.jump) {
@@ -1029,25 +2675,56 @@ int simulate(int argc, char* argv[]) {
                 aluInstructions++; // Increment ALU instructions
             }
 
-            if (mem_wb.d.regWrite) {
-                std::cout << "[Write Back] Writing R[" << std::dec << mem_wb.d.rd << "] = " << mem_wb.RY << "\n"; // Register number in decimal
+            if (mem_wb.d.vector) vectorInstructions++;
+            else if (isFPOpcode(mem_wb.d.opcode)) fpInstructions++;
+
+            if (mem_wb.d.regWrite && mem_wb.d.rd >= FP_REG_BASE) {
+                uint32_t fd = mem_wb.d.rd - FP_REG_BASE;
+                SIM_LOG(LOG_WRITEBACK, LOG_DEBUG, "[Write Back] Writing F[" << std::dec << fd << "] = 0x" << std::hex << mem_wb.FY << std::dec << "\n");
+                F[fd] = mem_wb.FY;
+                energyCounters.rfWrites++;
+                unresolvedDependencies.erase(mem_wb.d.rd);
+            } else if (mem_wb.d.regWrite) {
+                SIM_LOG(LOG_WRITEBACK, LOG_DEBUG, "[Write Back] Writing R[" << std::dec << mem_wb.d.rd << "] = " << mem_wb.RY << "\n"); // Register number in decimal
                 R[mem_wb.d.rd] = mem_wb.RY;
+                if (mem_wb.d.rd != 0) energyCounters.rfWrites++;
                 R[0] = 0; // Ensure x0 is always 0
 
                 // Remove resolved dependency
                 unresolvedDependencies.erase(mem_wb.d.rd);
             }
+            bool syscallResult = false; // a0 written by the system call
+            if (syscallPending && mem_wb.d.id == INSTR_ECALL) {
+                syscallPending = false;
+                flight.event(clockCycle, FLIGHT_SYSCALL, mem_wb.PC, static_cast<ureg_t>(R[17]));
+                if (performSyscall()) {
+                    PC = mem_wb.PC + 4;
+                    syscallResult = true;
+                } else {
+                    fetchHalted = true; // exit: drain and stop
+                }
+            }
+            if (commitLog.isOpen()) {
+                bool fpRd = mem_wb.d.rd >= FP_REG_BASE;
+                bool store = mem_wb.d.memWrite && !mem_wb.d.vector;
+                uint8_t rd = syscallResult ? 10 : mem_wb.d.regWrite ? mem_wb.d.rd : COMMIT_NO_RD;
+                uint64_t value = syscallResult ? static_cast<ureg_t>(R[10])
+                               : fpRd          ? mem_wb.FY
+                                               : static_cast<ureg_t>(mem_wb.RY);
+                commitLog.append(mem_wb.PC, mem_wb.IR, rd, value, mem_wb.memAddr, store ? 1u << mem_wb.d.memSize : 0,
+                                 mem_wb.memData);
+            }
             printUnresolvedDependencies(unresolvedDependencies); // Print unresolved dependencies after write-back
 
-            std::cout << "[Write Back] PC=0x" << std::hex << mem_wb.PC << " IR=0x" << mem_wb.IR << "\n";
+            SIM_LOG(LOG_WRITEBACK, LOG_DEBUG, "[Write Back] PC=0x" << std::hex << mem_wb.PC << " IR=0x" << mem_wb.IR << "\n");
 
             // Check if all dependencies are resolved
             if (stallSignal && areDependenciesResolved()) {
                 stallSignal = false; // Clear stall signal
-                std::cout << "[Write Back] All dependencies resolved. Resuming pipeline.\n";
+                SIM_LOG(LOG_WRITEBACK, LOG_TRACE, "[Write Back] All dependencies resolved. Resuming pipeline.\n");
             }
         } else if (mem_wb.IR == 0 && !mem_wb.valid) {
-            std::cout << "[Write Back] Bubble detected in MEM/WB.\n";
+            SIM_LOG(LOG_WRITEBACK, LOG_TRACE, "[Write Back] Bubble detected in MEM/WB.\n");
         }
 
         bool finalStallSignal = false;
@@ -1056,32 +2733,86 @@ int simulate(int argc, char* argv[]) {
         if (ex_mem.valid) { // Memory Access only if EX_MEM is valid
             mem_wb.PC = ex_mem.PC;
             mem_wb.IR = ex_mem.IR;
+            mem_wb.seq = ex_mem.seq;
+            mem_wb.len = ex_mem.len;
             mem_wb.d = ex_mem.d;
             mem_wb.valid = true;
 
             // Set MAR to the address calculated by the ALU (RZ)
             MAR = ex_mem.RZ;
+            mem_wb.memAddr = (ex_mem.d.memRead || ex_mem.d.memWrite) ? MAR : 0;
+            mem_wb.memData = (ex_mem.d.opcode == 0x27) ? ex_mem.FM : static_cast<ureg_t>(ex_mem.RM);
+
+            // Misaligned accesses and page faults trap before touching memory
+            if ((ex_mem.d.memRead || ex_mem.d.memWrite) && !ex_mem.d.vector) {
+                uint32_t cause = 0;
+                bool fault = false;
+                if (MAR & ((1u << ex_mem.d.memSize) - 1)) {
+                    cause = ex_mem.d.memWrite ? CAUSE_MISALIGNED_STORE : CAUSE_MISALIGNED_LOAD;
+                    fault = true;
+                } else if (!translateAddress(MAR, ex_mem.d.memWrite ? ACCESS_STORE : ACCESS_LOAD, MAR)) {
+                    cause = ex_mem.d.memWrite ? CAUSE_STORE_PAGE_FAULT : CAUSE_LOAD_PAGE_FAULT;
+                    fault = true;
+                }
+                if (fault) {
+                    SIM_LOG(LOG_MEMORY, LOG_INFO, "[Memory Access] Faulting access at address 0x" << std::hex << ex_mem.RZ
+                            << " (PC=0x" << ex_mem.PC << ").\n");
+                    ex_mem.d.memRead = ex_mem.d.memWrite = false;
+                    ex_mem.d.regWrite = false;
+                    mem_wb.d = ex_mem.d;
+                    mem_wb.valid = false;
+                    id_ex.valid = false;
+                    mem_wb.bubble = id_ex.bubble = CPI_DRAIN;
+                    trap(cause, ex_mem.PC, static_cast<uint32_t>(ex_mem.RZ));
+                }
+            }
 
             // Use memoryProcessorInterface to handle LOAD/STORE
-            memoryProcessorInterface(MAR, MDR, ex_mem.RM, ex_mem.d.memRead, ex_mem.d.memWrite, ex_mem.d.memSize, ex_mem.d.memSignExtend);
+            uint64_t fpMDR = 0;
+            if (ex_mem.d.vector) {
+                // Vector loads/stores trap on their first faulting element
+                uint32_t cause = 0;
+                addr_t faultAddr = 0;
+                if ((ex_mem.d.memRead || ex_mem.d.memWrite) &&
+                    !vectorMemoryInterface(ex_mem.IR, static_cast<addr_t>(ex_mem.RZ), ex_mem.RM, ex_mem.vl,
+                                           ex_mem.d.memWrite, ex_mem.d.memSize, cause, faultAddr)) {
+                    SIM_LOG(LOG_MEMORY, LOG_INFO, "[Memory Access] Faulting vector element at address 0x" << std::hex << faultAddr
+                            << " (PC=0x" << ex_mem.PC << ").\n");
+                    ex_mem.d.memRead = ex_mem.d.memWrite = false;
+                    mem_wb.d = ex_mem.d;
+                    mem_wb.valid = false;
+                    id_ex.valid = false;
+                    mem_wb.bubble = id_ex.bubble = CPI_DRAIN;
+                    trap(cause, ex_mem.PC, static_cast<uint32_t>(faultAddr));
+                }
+            } else if (ex_mem.d.opcode == 0x07 || ex_mem.d.opcode == 0x27) {
+                fpMemoryInterface(ex_mem.PC, MAR, fpMDR, ex_mem.FM, ex_mem.d.memRead, ex_mem.d.memWrite, ex_mem.d.memSize);
+            } else {
+                memoryProcessorInterface(ex_mem.PC, MAR, MDR, ex_mem.RM, ex_mem.d.memRead, ex_mem.d.memWrite, ex_mem.d.memSize, ex_mem.d.memSignExtend);
+            }
+            energyCounters.latchWrites[LATCH_MEM_WB]++;
+            if (ex_mem.d.memRead) energyCounters.memReads[ex_mem.d.memSize & 3]++;
+            if (ex_mem.d.memWrite) energyCounters.memWrites[ex_mem.d.memSize & 3]++;
 
             // Ensure memRead is correctly used
             if (ex_mem.d.memRead) {
-                std::cout << "[Memory Access] LOAD instruction: Reading data into MDR.\n";
+                SIM_LOG(LOG_MEMORY, LOG_TRACE, "[Memory Access] LOAD instruction: Reading data into MDR.\n");
             }
 
             // Determine the value of RY based on control signals
             if (ex_mem.d.memToReg == 1) {
                 mem_wb.RY = MDR; // Load: Use data from memory
             } else if (ex_mem.d.memToReg == 2) {
-                mem_wb.RY = ex_mem.PC + 4; // JAL/JALR: Use return address
+                mem_wb.RY = ex_mem.PC + ex_mem.len; // JAL/JALR: Use return address
             } else {
                 mem_wb.RY = ex_mem.RZ; // Default: Use ALU result
             }
+            mem_wb.FY = (ex_mem.d.memToReg == 1) ? fpMDR : ex_mem.FZ;
 
-            std::cout << "[Memory Access] MAR=0x" << std::hex << MAR << " MDR=" << MDR << " RY=" << mem_wb.RY << "\n";
+            SIM_LOG(LOG_MEMORY, LOG_DEBUG, "[Memory Access] MAR=0x" << std::hex << MAR << " MDR=" << MDR << " RY=" << mem_wb.RY << "\n");
         } else {
             mem_wb.valid = false; // No valid instruction to access memory
+            mem_wb.bubble = ex_mem.bubble;
         }
 
         bool updatePC_ex_mem = false; // Flag to indicate if PC should be updated
@@ -1091,29 +2822,192 @@ int simulate(int argc, char* argv[]) {
         if (id_ex.valid) { // Execute only if ID_EX is valid
             ex_mem.PC = id_ex.PC;
             ex_mem.IR = id_ex.IR;
+            ex_mem.seq = id_ex.seq;
+            ex_mem.len = id_ex.len;
             ex_mem.d = id_ex.d;
             ex_mem.valid = true;
 
-            // Perform ALU operation
-            switch (id_ex.d.aluOp) {
-                case ALU_ADD: ex_mem.RZ = id_ex.RA + id_ex.RB; break;
-                case ALU_SUB: ex_mem.RZ = id_ex.RA - id_ex.RB; break;
-                case ALU_MUL: ex_mem.RZ = id_ex.RA * id_ex.RB; break;
-                case ALU_DIV: ex_mem.RZ = (id_ex.RB != 0) ? id_ex.RA / id_ex.RB : 0; break;
-                case ALU_REM: ex_mem.RZ = (id_ex.RB != 0) ? id_ex.RA % id_ex.RB : 0; break;
-                case ALU_AND: ex_mem.RZ = id_ex.RA & id_ex.RB; break;
-                case ALU_OR: ex_mem.RZ = id_ex.RA | id_ex.RB; break;
-                case ALU_XOR: ex_mem.RZ = id_ex.RA ^ id_ex.RB; break;
-                case ALU_SLL: ex_mem.RZ = id_ex.RA << (id_ex.RB & 0x1F); break;
-                case ALU_SRL: ex_mem.RZ = static_cast<int32_t>(static_cast<uint32_t>(id_ex.RA) >> (id_ex.RB & 0x1F)); break;
-                case ALU_SRA: ex_mem.RZ = id_ex.RA >> (id_ex.RB & 0x1F); break;
-                case ALU_SLT: ex_mem.RZ = (id_ex.RA < id_ex.RB) ? 1 : 0; break;
-                case ALU_EQ: ex_mem.RZ = (id_ex.RA == id_ex.RB) ? 1 : 0; break;
-                case ALU_GE: ex_mem.RZ = (id_ex.RA >= id_ex.RB) ? 1 : 0; break;
+            energyCounters.latchWrites[LATCH_EX_MEM]++;
+            energyCounters.aluOps[id_ex.d.aluOp]++;
+
+            // sfence.vma: drop all cached translations
+            if (id_ex.d.id == INSTR_SFENCE_VMA) {
+                itlb.flush();
+                dtlb.flush();
+            }
+
+            // Illegal instructions, ECALL, EBREAK and CSR accesses
+            bool trapped = false;
+            uint32_t csrValue = 0;
+            if (id_ex.d.illegal) {
+                trapped = true;
+                trap(CAUSE_ILLEGAL_INSTRUCTION, id_ex.PC, id_ex.IR);
+            } else if (id_ex.d.id == INSTR_ECALL && csrFile.mtvec == 0) {
+                SIM_LOG(LOG_EXECUTE, LOG_INFO, "[Execute] ECALL: serializing, squashing younger instructions.\n");
+                if (if_id.valid) energyCounters.flushes++;
+                if_id.valid = false;
+                if_id.bubble = CPI_DRAIN;
+                chdu.stallPipeline = false;
+                chdu.flushPipeline = false;
+                stallSignal = false; // Only the squashed instruction could be waiting in ID
+                syscallPending = true;
+            } else if (id_ex.d.id == INSTR_ECALL || id_ex.d.id == INSTR_EBREAK) {
+                trapped = true;
+                if (id_ex.d.id == INSTR_ECALL) trap(CAUSE_ECALL_M, id_ex.PC, 0);
+                else trap(CAUSE_BREAKPOINT, id_ex.PC, id_ex.PC);
+            } else if (id_ex.d.id == INSTR_MRET) {
+                SIM_LOG(LOG_EXECUTE, LOG_INFO, "[Execute] MRET: returning to 0x" << std::hex << csrFile.mepc << "\n");
+                PC = csrFile.returnFromTrap();
+                if (if_id.valid) energyCounters.flushes++;
+                if_id.valid = false;
+                if_id.bubble = CPI_DRAIN;
+            } else if (id_ex.d.id == INSTR_FENCE_I) {
+                // Older stores are done with MEM by now; refetch what follows
+                SIM_LOG(LOG_EXECUTE, LOG_INFO, "[Execute] FENCE.I: refetching from 0x" << std::hex << id_ex.PC + id_ex.len << "\n");
+                PC = id_ex.PC + id_ex.len;
+                if (if_id.valid) energyCounters.flushes++;
+                if_id.valid = false;
+                if_id.bubble = CPI_DRAIN;
+                chdu.stallPipeline = false;
+                chdu.flushPipeline = false;
+                stallSignal = false;
+                fenceIFlushes++;
+                flight.event(clockCycle, FLIGHT_FENCE_I, id_ex.PC);
+            } else if (id_ex.d.opcode == 0x73 && id_ex.d.funct3 != 0 &&
+                       !executeCSROp(csrFile, id_ex.d.funct3, getBits(id_ex.IR, 31, 20), id_ex.d.rs1,
+                                     static_cast<uint32_t>(id_ex.RA), csrValue)) {
+                trapped = true;
+                trap(CAUSE_ILLEGAL_INSTRUCTION, id_ex.PC, id_ex.IR);
+            }
+            if (trapped) {
+                ex_mem.valid = false;
+                ex_mem.d.regWrite = false;
+                ex_mem.bubble = CPI_DRAIN;
+            }
+
+            // Perform ALU operation. RV64 *W instructions work on the low
+            // 32 bits (zero-extended for the unsigned ops) and sign-extend.
+            // Unary Zbb ops ignore RB (it holds their fixed imm).
+            reg_t a = id_ex.RA;
+            reg_t b = id_ex.RB;
+            ALUOpType op = id_ex.d.aluOp;
+            if (id_ex.d.word) {
+                bool isUnsigned = (op == ALU_SRL || op == ALU_DIVU || op == ALU_REMU);
+                a = isUnsigned ? static_cast<reg_t>(static_cast<uint32_t>(a)) : static_cast<reg_t>(static_cast<int32_t>(a));
+                b = isUnsigned ? static_cast<reg_t>(static_cast<uint32_t>(b)) : static_cast<reg_t>(static_cast<int32_t>(b));
+            }
+            ureg_t ua = static_cast<ureg_t>(a);
+            ureg_t ub = static_cast<ureg_t>(b);
+            int width = id_ex.d.word ? 32 : XLEN;
+            unsigned shamt = static_cast<unsigned>(ub & (width - 1));
+            switch (op) {
+                case ALU_ADD: ex_mem.RZ = static_cast<reg_t>(ua + ub); break;
+                case ALU_SUB: ex_mem.RZ = static_cast<reg_t>(ua - ub); break;
+                case ALU_MUL: ex_mem.RZ = static_cast<reg_t>(ua * ub); break;
+                case ALU_MULH: ex_mem.RZ = mulHighSigned(a, b); break;
+                case ALU_MULHSU: ex_mem.RZ = mulHighSignedUnsigned(a, b); break;
+                case ALU_MULHU: ex_mem.RZ = mulHighUnsigned(a, b); break;
+                // Division by zero and overflow follow the RISC-V results instead of trapping
+                case ALU_DIV:
+                    ex_mem.RZ = (b == 0) ? -1
+                              : (a == REG_MIN && b == -1) ? REG_MIN
+                              : a / b;
+                    break;
+                case ALU_REM:
+                    ex_mem.RZ = (b == 0) ? a
+                              : (a == REG_MIN && b == -1) ? 0
+                              : a % b;
+                    break;
+                case ALU_DIVU: ex_mem.RZ = static_cast<reg_t>(ub == 0 ? ~static_cast<ureg_t>(0) : ua / ub); break;
+                case ALU_REMU: ex_mem.RZ = static_cast<reg_t>(ub == 0 ? ua : ua % ub); break;
+                case ALU_AND: ex_mem.RZ = a & b; break;
+                case ALU_OR: ex_mem.RZ = a | b; break;
+                case ALU_XOR: ex_mem.RZ = a ^ b; break;
+                case ALU_SLL: ex_mem.RZ = static_cast<reg_t>(ua << shamt); break;
+                case ALU_SRL: ex_mem.RZ = static_cast<reg_t>(ua >> shamt); break;
+                case ALU_SRA: ex_mem.RZ = a >> shamt; break;
+                case ALU_SLT: ex_mem.RZ = (a < b) ? 1 : 0; break;
+                case ALU_EQ: ex_mem.RZ = (a == b) ? 1 : 0; break;
+                case ALU_GE: ex_mem.RZ = (a >= b) ? 1 : 0; break;
+                case ALU_SLTU: ex_mem.RZ = (ua < ub) ? 1 : 0; break;
+                case ALU_GEU: ex_mem.RZ = (ua >= ub) ? 1 : 0; break;
                 case ALU_PASS: ex_mem.RZ = id_ex.d.imm; break;
+                case ALU_SH1ADD: ex_mem.RZ = static_cast<reg_t>((ua << 1) + ub); break;
+                case ALU_SH2ADD: ex_mem.RZ = static_cast<reg_t>((ua << 2) + ub); break;
+                case ALU_SH3ADD: ex_mem.RZ = static_cast<reg_t>((ua << 3) + ub); break;
+                case ALU_ANDN: ex_mem.RZ = a & ~b; break;
+                case ALU_ORN: ex_mem.RZ = a | ~b; break;
+                case ALU_XNOR: ex_mem.RZ = ~(a ^ b); break;
+                case ALU_MIN: ex_mem.RZ = (a < b) ? a : b; break;
+                case ALU_MINU: ex_mem.RZ = static_cast<reg_t>((ua < ub) ? ua : ub); break;
+                case ALU_MAX: ex_mem.RZ = (a > b) ? a : b; break;
+                case ALU_MAXU: ex_mem.RZ = static_cast<reg_t>((ua > ub) ? ua : ub); break;
+                case ALU_ROL: ex_mem.RZ = rotateLeft(ua, shamt, width); break;
+                case ALU_ROR: ex_mem.RZ = rotateRight(ua, shamt, width); break;
+                case ALU_CLZ: ex_mem.RZ = countLeadingZeros(ua, width); break;
+                case ALU_CTZ: ex_mem.RZ = countTrailingZeros(ua, width); break;
+                case ALU_CPOP: ex_mem.RZ = countOnes(ua, width); break;
+                case ALU_SEXTB: ex_mem.RZ = static_cast<int8_t>(a); break;
+                case ALU_SEXTH: ex_mem.RZ = static_cast<int16_t>(a); break;
+                case ALU_REV8: ex_mem.RZ = byteReverse(ua); break;
+                case ALU_ORCB: ex_mem.RZ = orCombineBytes(ua); break;
                 default: ex_mem.RZ = 0; break;
             }
+            if (id_ex.d.word) ex_mem.RZ = static_cast<int32_t>(ex_mem.RZ);
+            if (id_ex.d.opcode == 0x73) ex_mem.RZ = static_cast<reg_t>(csrValue);
             ex_mem.RM = id_ex.RM;
+            ex_mem.FM = id_ex.FB;
+
+            // F/D computational instructions run on the host FPU. Integer
+            // sources come from RA, integer results replace RZ.
+            if (id_ex.d.fpUnit != FPU_NONE && !trapped) {
+                uint64_t a = (id_ex.d.rs1 >= FP_REG_BASE) ? id_ex.FA
+                                                          : static_cast<uint64_t>(static_cast<int64_t>(id_ex.RA));
+                uint32_t rm = (id_ex.d.fpFlags & INSTR_FLAG_RM) ? id_ex.d.funct3 : static_cast<uint32_t>(RM_RNE);
+                if (!executeFP(id_ex.d.id, rm, csrFile.frm, a, id_ex.FB, id_ex.FC, ex_mem.FZ, csrFile.fflags)) {
+                    trap(CAUSE_ILLEGAL_INSTRUCTION, id_ex.PC, id_ex.IR); // Reserved dynamic rounding mode
+                    ex_mem.valid = false;
+                    ex_mem.d.regWrite = false;
+                    ex_mem.bubble = CPI_DRAIN;
+                } else {
+                    if (id_ex.d.rd < FP_REG_BASE) ex_mem.RZ = static_cast<reg_t>(ex_mem.FZ);
+                    uint32_t latency = 1;
+                    switch (id_ex.d.fpUnit) {
+                        case FPU_ADD: latency = fpAddLatency; break;
+                        case FPU_MUL: case FPU_FMA: latency = fpMulLatency; break;
+                        case FPU_DIV: case FPU_SQRT: latency = fpDivLatency; break;
+                        case FPU_CVT: latency = fpCvtLatency; break;
+                        default: break;
+                    }
+                    fpBusyCycles = (latency > 1) ? latency - 1 : 0;
+                    SIM_LOG(LOG_EXECUTE, LOG_DEBUG, "[Execute] FPU result=0x" << std::hex << ex_mem.FZ << " fflags=0x"
+                            << csrFile.fflags << std::dec << " latency=" << latency << "\n");
+                }
+            }
+
+            // V instructions: arithmetic runs here on V; loads/stores only
+            // check their register group and take the base address (RZ),
+            // byte stride (RM) and vl to MEM
+            if (id_ex.d.vector && !trapped) {
+                uint64_t xResult = 0;
+                if (!executeVector(id_ex.d.id, id_ex.IR, static_cast<uint64_t>(id_ex.RA), &V[0][0],
+                                   csrFile.vl, csrFile.vtype, xResult)) {
+                    trap(CAUSE_ILLEGAL_INSTRUCTION, id_ex.PC, id_ex.IR);
+                    ex_mem.valid = false;
+                    ex_mem.d.regWrite = false;
+                    ex_mem.bubble = CPI_DRAIN;
+                } else {
+                    ex_mem.RZ = id_ex.d.regWrite ? static_cast<reg_t>(xResult) : id_ex.RA;
+                    ex_mem.RM = !vecMemStrided(id_ex.IR) ? static_cast<reg_t>(1u << id_ex.d.memSize)
+                              : id_ex.d.memWrite ? id_ex.RM : id_ex.RB;
+                    ex_mem.vl = csrFile.vl;
+                    uint32_t cycles = vecExecuteCycles(id_ex.d.id, csrFile.vl, vectorLanes);
+                    if (id_ex.d.id != INSTR_VSETVLI) vectorElements += csrFile.vl;
+                    vecBusyCycles = cycles - 1;
+                    SIM_LOG(LOG_EXECUTE, LOG_DEBUG, "[Execute] Vector unit (" << vecKernelName() << "): vl=" << std::dec << csrFile.vl
+                            << " vtype=0x" << std::hex << csrFile.vtype << std::dec << " cycles=" << cycles << "\n");
+                }
+            }
 
             // Restore zero signal functionality
             id_ex.d.zero = (ex_mem.RZ == 0); // Set zero signal if ALU result is zero
@@ -1123,43 +3017,72 @@ int simulate(int argc, char* argv[]) {
                 chdu.resolveBranch(id_ex.d.zero, id_ex.d); // Use zero signal for branch resolution
                 bool actualOutcome = chdu.branchTaken; // Actual branch outcome
                 bool predictedOutcome = predictBranch(id_ex.PC); // Predicted branch outcome
+                if (branchProfiler.enabled) branchProfiler.record(id_ex.PC, actualOutcome, actualOutcome != predictedOutcome);
 
                 if (actualOutcome == predictedOutcome) {
-                    std::cout << "[Execute] Branch prediction was correct. Continuing pipeline.\n";
+                    SIM_LOG(LOG_PREDICT, LOG_DEBUG, "[Execute] Branch prediction was correct. Continuing pipeline.\n");
                 } else {
-                    std::cout << "[Execute] Branch prediction was incorrect. Flushing the next instruction.\n";
+                    SIM_LOG(LOG_PREDICT, LOG_DEBUG, "[Execute] Branch prediction was incorrect. Flushing the next instruction.\n");
                     branchMispredictions++; // Increment branch mispredictions
+                    if (profiler.enabled) profiler.mispredict(id_ex.PC);
+                    if (if_id.valid) energyCounters.flushes++;
                     if_id.valid = false; // Flush the instruction in IF/ID (next instruction)
-                    PC = id_ex.PC + (actualOutcome ? id_ex.d.imm : 4); // Correct PC
+                    if_id.bubble = CPI_MISPREDICT;
+                    PC = id_ex.PC + (actualOutcome ? id_ex.d.imm : id_ex.len); // Correct PC
+                    flight.event(clockCycle, FLIGHT_MISPREDICT, id_ex.PC, 0, PC);
                 }
 
                 // Update branch prediction table with the actual outcome
                 updateBranchPrediction(id_ex.PC, actualOutcome);
             }
 
-            // Handle jump instructions (JAL, JALR) without flushing the pipeline
+            // Handle jump instructions (JAL, JALR) without flushing the pipeline,
+            // unless fetch followed a JALR target read from a stale register
             if (id_ex.d.jump && !id_ex.d.branch) {
-                std::cout << "[Execute] Jump detected. Updating PC without flushing pipeline.\n";
-                PC = (id_ex.d.opcode == 0x6F) ? id_ex.PC + id_ex.d.imm : (id_ex.RA + id_ex.d.imm) & ~1U; // Update PC for JAL or JALR
+                addr_t target = (id_ex.d.opcode == 0x6F) ? id_ex.PC + id_ex.d.imm : (id_ex.RA + id_ex.d.imm) & ~static_cast<reg_t>(1);
+                addr_t fetched = if_id.valid ? if_id.PC : PC;
+                if (fetched != target) {
+                    SIM_LOG(LOG_PREDICT, LOG_DEBUG, "[Execute] Jump target 0x" << std::hex << target << " differs from fetch (0x"
+                            << fetched << "). Flushing the next instruction.\n" << std::dec);
+                    if (if_id.valid) energyCounters.flushes++;
+                    if_id.valid = false;
+                    if_id.bubble = CPI_JUMP_FLUSH;
+                    flight.event(clockCycle, FLIGHT_JUMP_FLUSH, id_ex.PC, 0, target);
+                    PC = target; // Refetch from the jump target
+                } else {
+                    // Fetch already followed the target and may be past it
+                    SIM_LOG(LOG_PREDICT, LOG_DEBUG, "[Execute] Jump detected. Updating PC without flushing pipeline.\n");
+                }
             }
 
-            std::cout << "[Execute] RZ=" << ex_mem.RZ << " RM=" << ex_mem.RM << " Zero=" << id_ex.d.zero << "\n";
+            SIM_LOG(LOG_EXECUTE, LOG_DEBUG, "[Execute] RZ=" << ex_mem.RZ << " RM=" << ex_mem.RM << " Zero=" << id_ex.d.zero << "\n");
         } else {
             ex_mem.valid = false; // No valid instruction to execute
+            ex_mem.bubble = id_ex.bubble;
         }
 
         // Decode (IF_ID -> ID_EX)
         if (!stallSignal && if_id.IR != 0 && if_id.valid) { // Decode only if no stall signal, IF_ID is valid, and IR is not empty
             id_ex.PC = if_id.PC;
             id_ex.IR = if_id.IR;
-            id_ex.d = decode(if_id.IR);
+            id_ex.len = if_id.len;
+            id_ex.seq = if_id.seq;
+            const DecodedInstr *predecoded = lookupPredecoded(if_id.PC, if_id.IR);
+            if (predecoded) {
+                id_ex.d = *predecoded;
+                readOperands(id_ex.d);
+            } else {
+                id_ex.d = decode(if_id.IR);
 
-            // Generate control signals using control circuitry
-            controlCircuitry(id_ex.d, id_ex.d);
+                // Generate control signals using control circuitry
+                controlCircuitry(id_ex.d, id_ex.d);
+            }
+            if (id_ex.d.opcode == 0x17) id_ex.d.RA = id_ex.PC; // AUIPC: its own PC, not the fetch PC
+            energyCounters.rfReads += registerReadsFor(id_ex.d);
 
             // Ensure memRead is correctly toggled for LOAD instructions
             if (id_ex.d.memRead) {
-                std::cout << "[Decode] LOAD instruction detected. memRead enabled.\n";
+                SIM_LOG(LOG_DECODE, LOG_DEBUG, "[Decode] LOAD instruction detected. memRead enabled.\n");
             }
 
             // Default forwarding control signals
@@ -1169,25 +3092,27 @@ int simulate(int argc, char* argv[]) {
             id_ex.forwardRBFromMEM_WB = false;
             id_ex.forwardRMFromEX_MEM = false;
             id_ex.forwardRMFromMEM_WB = false;
+            id_ex.forwardRCFromEX_MEM = false;
+            id_ex.forwardRCFromMEM_WB = false;
 
             // Check for RAW hazards (data dependencies)
             if (detectRAWHazard(id_ex.d, ex_mem, mem_wb)) {
                 dataHazards++; // Increment data hazards
                 if (Knob2) { // Data forwarding enabled
-                    std::cout << "dependency check\n";
-                    std::cout << "rs1: " << id_ex.d.rs1 << " rs2: " << id_ex.d.rs2 << "\n";
-                    std::cout << "ex mem rd: " << ex_mem.d.rd << " mem wb rd: " << mem_wb.d.rd << "\n";
-                    std::cout << "ex mem valid: " << ex_mem.valid << " mem wb valid: " << mem_wb.valid << "\n";
+                    SIM_LOG(LOG_HAZARD, LOG_TRACE, "dependency check\n");
+                    SIM_LOG(LOG_HAZARD, LOG_TRACE, "rs1: " << id_ex.d.rs1 << " rs2: " << id_ex.d.rs2 << "\n");
+                    SIM_LOG(LOG_HAZARD, LOG_TRACE, "ex mem rd: " << ex_mem.d.rd << " mem wb rd: " << mem_wb.d.rd << "\n");
+                    SIM_LOG(LOG_HAZARD, LOG_TRACE, "ex mem valid: " << ex_mem.valid << " mem wb valid: " << mem_wb.valid << "\n");
 
                     // Forward data from MEM/WB to ID/EX
                     if (mem_wb.valid && mem_wb.d.regWrite && mem_wb.d.rd != 0) {
                         if (id_ex.d.rs1 == mem_wb.d.rd) {
                             id_ex.forwardRAFromMEM_WB = true; // Signal to forward RA from MEM/WB
-                            std::cout << "[Forwarding] MEM/WB -> ID/EX: Forwarding RY=" << mem_wb.RY << " to RA\n";
+                            SIM_LOG(LOG_FORWARD, LOG_DEBUG, "[Forwarding] MEM/WB -> ID/EX: Forwarding RY=" << mem_wb.RY << " to RA\n");
                         }
                         if (!id_ex.d.memWrite && id_ex.d.rs2 == mem_wb.d.rd) {
                             id_ex.forwardRBFromMEM_WB = true; // Signal to forward RB from MEM/WB
-                            std::cout << "[Forwarding] MEM/WB -> ID/EX: Forwarding RY=" << mem_wb.RY << " to RB\n";
+                            SIM_LOG(LOG_FORWARD, LOG_DEBUG, "[Forwarding] MEM/WB -> ID/EX: Forwarding RY=" << mem_wb.RY << " to RB\n");
                         }
                     }
 
@@ -1195,34 +3120,46 @@ int simulate(int argc, char* argv[]) {
                     if (ex_mem.valid && ex_mem.d.regWrite && ex_mem.d.rd != 0) {
                         if (id_ex.d.rs1 == ex_mem.d.rd) {
                             id_ex.forwardRAFromEX_MEM = true; // Signal to forward RA from EX/MEM
-                            std::cout << "[Forwarding] EX/MEM -> ID/EX: Forwarding RZ=" << ex_mem.RZ << " to RA\n";
+                            SIM_LOG(LOG_FORWARD, LOG_DEBUG, "[Forwarding] EX/MEM -> ID/EX: Forwarding RZ=" << ex_mem.RZ << " to RA\n");
                         }
                         if (!id_ex.d.memWrite && id_ex.d.rs2 == ex_mem.d.rd) {
                             id_ex.forwardRBFromEX_MEM = true; // Signal to forward RB from EX/MEM
-                            std::cout << "[Forwarding] EX/MEM -> ID/EX: Forwarding RZ=" << ex_mem.RZ << " to RB\n";
+                            SIM_LOG(LOG_FORWARD, LOG_DEBUG, "[Forwarding] EX/MEM -> ID/EX: Forwarding RZ=" << ex_mem.RZ << " to RB\n");
                         }
                     }
 
+                    // Forward FC for fused multiply-adds
+                    if (id_ex.d.rs3 != 0) {
+                        if (mem_wb.valid && mem_wb.d.regWrite && id_ex.d.rs3 == mem_wb.d.rd)
+                            id_ex.forwardRCFromMEM_WB = true;
+                        if (ex_mem.valid && ex_mem.d.regWrite && id_ex.d.rs3 == ex_mem.d.rd)
+                            id_ex.forwardRCFromEX_MEM = true;
+                    }
+
                     // Forward RM for store instructions
                     if (id_ex.d.memWrite) {
                         if (mem_wb.valid && mem_wb.d.regWrite && mem_wb.d.rd != 0 && id_ex.d.rs2 == mem_wb.d.rd) {
                             id_ex.forwardRMFromMEM_WB = true; // Signal to forward RM from MEM/WB
-                            std::cout << "[Forwarding] MEM/WB -> ID/EX: Forwarding RY=" << mem_wb.RY << " to RM\n";
+                            SIM_LOG(LOG_FORWARD, LOG_DEBUG, "[Forwarding] MEM/WB -> ID/EX: Forwarding RY=" << mem_wb.RY << " to RM\n");
                         }
                         if (ex_mem.valid && ex_mem.d.regWrite && ex_mem.d.rd != 0 && id_ex.d.rs2 == ex_mem.d.rd) {
                             id_ex.forwardRMFromEX_MEM = true; // Signal to forward RM from EX/MEM
-                            std::cout << "[Forwarding] EX/MEM -> ID/EX: Forwarding RZ=" << ex_mem.RZ << " to RM\n";
+                            SIM_LOG(LOG_FORWARD, LOG_DEBUG, "[Forwarding] EX/MEM -> ID/EX: Forwarding RZ=" << ex_mem.RZ << " to RM\n");
                         }
                     }
 
                     // Handle load-use hazard (stall for one cycle)
-                    if (ex_mem.valid && ex_mem.d.memRead && (id_ex.d.rs1 == ex_mem.d.rd || id_ex.d.rs2 == ex_mem.d.rd)) {
+                    if (ex_mem.valid && ex_mem.d.memRead && (id_ex.d.rs1 == ex_mem.d.rd || id_ex.d.rs2 == ex_mem.d.rd ||
+                                                             (id_ex.d.rs3 != 0 && id_ex.d.rs3 == ex_mem.d.rd))) {
                         dataHazardStalls++; // Increment stalls due to data hazards
                         pipelineStalls++; // Increment pipeline stalls
+                        if (profiler.enabled) profiler.dataStall(id_ex.PC);
                         stallSignal = true; // Stall the pipeline for one cycle
                         finalStallSignal = true; // Set final stall signal
                         id_ex.valid = false; // Create a bubble in ID/EX
-                        std::cout << "[Stall] Load-use hazard detected. Stalling pipeline for one cycle.\n";
+                        id_ex.bubble = stallCause = CPI_LOAD_USE;
+                        if (pipeTracer.enabled()) pipeTracer.stall(clockCycle, if_id.seq, "load-use");
+                        SIM_LOG(LOG_HAZARD, LOG_DEBUG, "[Stall] Load-use hazard detected. Stalling pipeline for one cycle.\n");
                     } else {
                         id_ex.valid = true; // Mark ID_EX as valid
                     }
@@ -1230,25 +3167,32 @@ int simulate(int argc, char* argv[]) {
                     dataHazards++; // Increment data hazards
                     dataHazardStalls++; // Increment stalls due to data hazards
                     pipelineStalls++; // Increment pipeline stalls
+                    if (profiler.enabled) profiler.dataStall(id_ex.PC);
                     id_ex.valid = false; // Stall the decode stage
                     stallSignal = true; // Set stall signal
                     finalStallSignal = true; // Set final stall signal
+                    // Charged to the nearest producer: its distance sets the stall length
+                    bool producerInMEM = ex_mem.valid && ex_mem.d.regWrite && ex_mem.d.rd != 0 &&
+                                         (id_ex.d.rs1 == ex_mem.d.rd || id_ex.d.rs2 == ex_mem.d.rd ||
+                                          id_ex.d.rs3 == ex_mem.d.rd);
+                    id_ex.bubble = stallCause = producerInMEM ? CPI_RAW_MEM : CPI_RAW_WB;
+                    if (pipeTracer.enabled()) pipeTracer.stall(clockCycle, if_id.seq, producerInMEM ? "RAW (MEM)" : "RAW (WB)");
 
                     // Add unresolved dependencies
                     if (ex_mem.valid && ex_mem.d.regWrite && ex_mem.d.rd != 0) {
-                        if (id_ex.d.rs1 == ex_mem.d.rd || id_ex.d.rs2 == ex_mem.d.rd) {
+                        if (id_ex.d.rs1 == ex_mem.d.rd || id_ex.d.rs2 == ex_mem.d.rd || id_ex.d.rs3 == ex_mem.d.rd) {
                             unresolvedDependencies.insert(ex_mem.d.rd);
                         }
                     }
                     if (mem_wb.valid && mem_wb.d.regWrite && mem_wb.d.rd != 0) {
-                        if (id_ex.d.rs1 == mem_wb.d.rd || id_ex.d.rs2 == mem_wb.d.rd) {
+                        if (id_ex.d.rs1 == mem_wb.d.rd || id_ex.d.rs2 == mem_wb.d.rd || id_ex.d.rs3 == mem_wb.d.rd) {
                             unresolvedDependencies.insert(mem_wb.d.rd);
                         }
                     }
 
-                    std::cout << "[Stall] RAW hazard detected. Stalling Decode stage.\n";
+                    SIM_LOG(LOG_HAZARD, LOG_DEBUG, "[Stall] RAW hazard detected. Stalling Decode stage.\n");
                 }
-                std :: cout << "RA:" << id_ex.RA << " RB:" << id_ex.RB << " RM:" << id_ex.RM << "\n";
+                SIM_LOG(LOG_DECODE, LOG_TRACE, "RA:" << id_ex.RA << " RB:" << id_ex.RB << " RM:" << id_ex.RM << "\n");
             } else {
                 chdu.checkControlHazard(id_ex.d);
 
@@ -1256,6 +3200,7 @@ int simulate(int argc, char* argv[]) {
                     controlHazards++; // Increment control hazards
                     controlHazardStalls++; // Increment stalls due to control hazards
                     pipelineStalls++; // Increment pipeline stalls
+                    if (profiler.enabled) profiler.controlStall(id_ex.PC);
 
                     // Forward branch data to ID/EX buffer
                     id_ex.RA = id_ex.d.RA;
@@ -1264,16 +3209,22 @@ int simulate(int argc, char* argv[]) {
                     id_ex.valid = true; // Mark ID_EX as valid
                     // stallSignal = true; // Set stall signal
                     finalStallSignal = true; // Set final stall signal
-                    std::cout << "[Decode] Control hazard detected for conditional branch. Waiting for EX stage.\n";
+                    stallCause = CPI_BRANCH_STALL;
+                    if (pipeTracer.enabled()) pipeTracer.stall(clockCycle, if_id.seq, "branch");
+                    SIM_LOG(LOG_HAZARD, LOG_DEBUG, "[Decode] Control hazard detected for conditional branch. Waiting for EX stage.\n");
                 } else if (chdu.flushPipeline && !id_ex.d.jump) { // Do not flush for JAL or JALR
                     branchMispredictions++; // Increment branch mispredictions
-                    std::cout << "[Decode] Flushing pipeline due to branch misprediction.\n";
+                    if (profiler.enabled) profiler.mispredict(id_ex.PC);
+                    SIM_LOG(LOG_PREDICT, LOG_DEBUG, "[Decode] Flushing pipeline due to branch misprediction.\n");
                     id_ex.RA = id_ex.d.RA;
                     id_ex.RB = id_ex.d.RB;
                     id_ex.RM = id_ex.d.RM;
                     id_ex.valid = true; // Mark ID_EX as valid
+                    if (if_id.valid) energyCounters.flushes++;
                     if_id.valid = false; // Flush IF/ID
+                    if_id.bubble = CPI_MISPREDICT;
                     if (id_ex.d.branch) updatePC_id_ex = true; // Set flag to update PC
+                    flight.event(clockCycle, FLIGHT_MISPREDICT, id_ex.PC, 0, id_ex.PC + id_ex.d.imm);
                 } else {
                     // Forward RA, RB, RM to ID_EX buffer if no stall or flush
                     id_ex.RA = id_ex.d.RA;
@@ -1282,27 +3233,67 @@ int simulate(int argc, char* argv[]) {
                     id_ex.valid = true; // Mark ID_EX as valid
                 }
             }
+            if (id_ex.valid) energyCounters.latchWrites[LATCH_ID_EX]++;
             
         } else if (stallSignal) {
             // pipelineStalls++; // Increment pipeline stalls
             // finalStallSignal = true; // Set final stall signal
-            std::cout << "[Decode] Stalled due to stall signal. Bubble created in ID_EX.\n";
+            SIM_LOG(LOG_DECODE, LOG_TRACE, "[Decode] Stalled due to stall signal. Bubble created in ID_EX.\n");
             id_ex.valid = false; // Create a bubble in ID_EX
+            id_ex.bubble = stallCause;
         } else {
             id_ex.valid = false; // No valid instruction to decode
+            id_ex.bubble = if_id.valid ? CPI_DRAIN : if_id.bubble;
         }
 
         // Fetch (PC -> IF_ID) with Control Instruction Signal and Prediction
-        if (!stallSignal) { // Fetch only if no stall signal is detected
+        if (fetchHalted) {
+            SIM_LOG(LOG_FETCH, LOG_TRACE, "[Fetch] Halted after an unhandled trap or exit.\n");
+            if_id.IR = 0;
+            if_id.valid = false;
+            if_id.bubble = CPI_DRAIN;
+        } else if (interruptDraining) {
+            SIM_LOG(LOG_FETCH, LOG_TRACE, "[Fetch] Waiting for older instructions before the interrupt.\n");
+            if_id.valid = false;
+            if_id.bubble = CPI_DRAIN;
+            pipelineStalls++;
+        } else if (syscallPending) {
+            SIM_LOG(LOG_FETCH, LOG_TRACE, "[Fetch] Waiting for the ECALL to write back.\n");
+            if_id.valid = false;
+            if_id.bubble = CPI_DRAIN;
+            pipelineStalls++;
+            syscallStallCycles++;
+        } else if (!stallSignal) { // Fetch only if no stall signal is detected
             if(chdu.stallPipeline) {
                 stallSignal = true; // Set stall signal if control hazard detected
                 finalStallSignal = true; // Set final stall signal
+                stallCause = CPI_BRANCH_STALL;
+            }
+            addr_t fetchAddr = PC;
+            bool fetchFault = !translateAddress(PC, ACCESS_FETCH, fetchAddr);
+            if (fetchFault) {
+                // Older instructions may still redirect fetch; trap only once they are past EX
+                if_id.valid = false;
+                if_id.bubble = CPI_DRAIN;
+                if (!id_ex.valid && !ex_mem.valid) {
+                    SIM_LOG(LOG_TRAP, LOG_INFO, "[Fetch] Instruction page fault at PC=0x" << std::hex << PC << ".\n");
+                    trap(CAUSE_FETCH_PAGE_FAULT, PC, PC);
+                } else {
+                    SIM_LOG(LOG_TRAP, LOG_INFO, "[Fetch] Instruction page fault at PC=0x" << std::hex << PC
+                            << ". Waiting for older instructions.\n");
+                }
             }
-            auto it = instrMemory.find(PC);
-            if (it != instrMemory.end()) {
+            uint32_t parcel = 0;
+            if (!fetchFault && fetchParcel(fetchAddr, parcel)) {
                 if_id.PC = PC;
-                if_id.IR = it->second;
+                if_id.IR = expandParcel(parcel, XLEN == 64);
+                if_id.len = instrLength(parcel);
                 if_id.valid = true; // Mark IF_ID as valid
+                if_id.seq = ++fetchSequence;
+                if (profiler.enabled) profiler.fetched(if_id.PC, if_id.IR);
+                if (pipeTracer.enabled()) pipeTracer.fetched(clockCycle, if_id.seq, if_id.PC, pipeTraceText(if_id.PC, if_id.IR));
+                energyCounters.fetches++;
+                energyCounters.latchWrites[LATCH_IF_ID]++;
 
                 // Decode opcode to determine if the instruction is a control instruction
                 uint32_t opcode = getBits(if_id.IR, 6, 0);
@@ -1314,57 +3305,63 @@ int simulate(int argc, char* argv[]) {
 
                     if (opcode == 0x6F || opcode == 0x67) { // JAL or JALR
                         // Direct jump: Update PC immediately
-                        PC = (opcode == 0x6F) ? PC + decode(if_id.IR).imm : (R[getBits(if_id.IR, 19, 15)] + decode(if_id.IR).imm) & ~1U;
+                        PC = (opcode == 0x6F) ? PC + decode(if_id.IR).imm : (R[getBits(if_id.IR, 19, 15)] + decode(if_id.IR).imm) & ~static_cast<reg_t>(1);
                         updateBranchPrediction(curPC, true); // Update branch prediction table
                         updateBranchTarget(curPC, PC); // Update branch target prediction
-                        std::cout << "[Fetch] Jump detected. PC updated to 0x" << std::hex << PC << "\n";
+                        SIM_LOG(LOG_PREDICT, LOG_DEBUG, "[Fetch] Jump detected. PC updated to 0x" << std::hex << PC << "\n");
                     } else if (opcode == 0x63) { // Conditional branch
                         updateBranchTarget(curPC, PC+decode(if_id.IR).imm); // Update branch target prediction
-                        updateBranchPrediction(curPC, predictBranch(curPC)); // Update branch prediction table
+                        allocateBranchPrediction(curPC); // Make sure the branch has a table entry
                         // Predict branch outcome
                         if (predictBranch(PC)) {
                             PC += decode(if_id.IR).imm; // Predicted taken: Update PC with offset
-                            std::cout << "[Fetch] Branch predicted taken. PC updated to 0x" << std::hex << PC << "\n";
+                            SIM_LOG(LOG_PREDICT, LOG_DEBUG, "[Fetch] Branch predicted taken. PC updated to 0x" << std::hex << PC << "\n");
                         } else {
-                            PC += 4; // Predicted not taken: Increment PC
-                            std::cout << "[Fetch] Branch predicted not taken. PC updated to 0x" << std::hex << PC << "\n";
+                            PC += if_id.len; // Predicted not taken: Increment PC
+                            SIM_LOG(LOG_PREDICT, LOG_DEBUG, "[Fetch] Branch predicted not taken. PC updated to 0x" << std::hex << PC << "\n");
                         }
                     }
                 } else {
                     if_id.isControlInstr = false; // Not a control instruction
-                    PC += 4; // Increment PC for next instruction fetch
+                    PC += if_id.len; // Increment PC for next instruction fetch
                 }
 
-                std::cout << "[Fetch] PC=0x" << std::hex << if_id.PC << " IR=0x" << if_id.IR 
-                          << " isControlInstr=" << if_id.isControlInstr << "\n";
+                SIM_LOG(LOG_FETCH, LOG_DEBUG, "[Fetch] PC=0x" << std::hex << if_id.PC << " IR=0x" << if_id.IR
+                        << " isControlInstr=" << if_id.isControlInstr << "\n");
             } else {
-                std::cout << "[Fetch] No valid instruction to fetch. IF_ID retains its content.\n";
+                SIM_LOG(LOG_FETCH, LOG_TRACE, "[Fetch] No valid instruction to fetch. IF_ID retains its content.\n");
+                if_id.bubble = CPI_DRAIN;
             }
         } else {
-            std::cout << "[Fetch] Stalled due to stall signal. IF_ID retains its content.\n";
+            SIM_LOG(LOG_FETCH, LOG_TRACE, "[Fetch] Stalled due to stall signal. IF_ID retains its content.\n");
         }
 
         if(updatePC_ex_mem) {
             if(ex_mem.d.branch) PC = ex_mem.PC + ex_mem.d.imm; // Update PC using EX_MEM
             else PC = ex_mem.RZ; // Update PC using EX_MEM
+            if (if_id.valid) energyCounters.flushes++;
             if_id.valid = false; // Flush IF/ID
         }
         else if(updatePC_id_ex) {
             PC = id_ex.PC + id_ex.d.imm; // Update PC using ID_EX
+            if (if_id.valid) energyCounters.flushes++;
             if_id.valid = false; // Flush IF/ID
+            if_id.bubble = CPI_MISPREDICT;
         }
 
         stallSignal = finalStallSignal; // Update stall signal for the next cycle
 
         // Check for termination condition
         if (if_id.IR == 0 && !id_ex.valid && !ex_mem.valid && !mem_wb.valid) {
-            std::cout << "[Termination] All pipeline buffers are empty. Halting simulation.\n";
+            SIM_LOG(LOG_CYCLE, LOG_INFO, "[Termination] All pipeline buffers are empty. Halting simulation.\n");
             currentState = HALT;
         }
 
         // Dump memory segments to files every cycle
-        dumpSegmentToFile("data.mc", dataSegment, 0x10000000, 0x50000000);
-        dumpSegmentToFile("stack.mc", stackSegment, 0x50000000, 0x7FFFFFFF);
+        if (dumpMemoryFiles) {
+            dumpSegmentToFile("data.mc", dataSegment, 0x10000000, 0x50000000);
+            dumpSegmentToFile("stack.mc", stackSegment, 0x50000000, 0x7FFFFFFF);
+        }
 
         // Print pipeline buffers at the end of the cycle if Knob4 is enabled
         if (Knob4) {
@@ -1423,22 +3420,321 @@ int simulate(int argc, char* argv[]) {
         }
     }
 
-    // Print statistics at the end of the simulation
-    std::cout << "\n================ Simulation Statistics ================\n";
-    std::cout << "Stat1: Total number of cycles = " << std::dec << totalCycles << "\n";
-    std::cout << "Stat2: Total instructions executed = " << std::dec << totalInstructions << "\n";
-    std::cout << "Stat3: CPI = " << std::fixed << std::setprecision(2) 
-              << (totalCycles / static_cast<double>(totalInstructions)) << "\n";
-    std::cout << "Stat4: Number of Data-transfer instructions executed = " << std::dec << dataTransferInstructions << "\n";
-    std::cout << "Stat5: Number of ALU instructions executed = " << std::dec << aluInstructions << "\n";
-    std::cout << "Stat6: Number of Control instructions executed = " << std::dec << controlInstructions << "\n";
-    std::cout << "Stat7: Number of stalls/bubbles in the pipeline = " << std::dec << pipelineStalls << "\n";
-    std::cout << "Stat8: Number of data hazards = " << std::dec << dataHazards << "\n";
-    std::cout << "Stat9: Number of control hazards = " << std::dec << controlHazards << "\n";
-    std::cout << "Stat10: Number of branch mispredictions = " << std::dec << branchMispredictions << "\n";
-    std::cout << "Stat11: Number of stalls due to data hazards = " << std::dec << dataHazardStalls << "\n";
-    std::cout << "Stat12: Number of stalls due to control hazards = " << std::dec << controlHazardStalls << "\n";
-    std::cout << "=======================================================\n";
+}
+
+// =====================================================================
+// Design-space sweep
+//   The grid file lists one option per line with its candidate values:
+//       # comment
+//       knob2 = 0, 1
+//       predictor = static, 1bit, 2bit
+//       predictor-entries = 0, 64
+//       mem-latency = 0, 4
+//   Every combination is run in its own forked child. The program is
+//   loaded and predecoded once in the parent, so children share that
+//   image copy-on-write and start simulating immediately. Each child
+//   returns its statistics through a pipe; one CSV row per point.
+// =====================================================================
+struct SimStats {
+    uint64_t totalCycles;
+    uint64_t totalInstructions;
+    uint64_t dataTransferInstructions;
+    uint64_t aluInstructions;
+    uint64_t controlInstructions;
+    uint64_t pipelineStalls;
+    uint64_t dataHazards;
+    uint64_t controlHazards;
+    uint64_t branchMispredictions;
+    uint64_t dataHazardStalls;
+    uint64_t controlHazardStalls;
+    double energyPJ;
+    double edp;
+    uint64_t itlbMisses;
+    uint64_t dtlbMisses;
+    uint64_t pageWalkCycles;
+    uint64_t cpiCycles[CPI_CATEGORIES]; // CPI stack: cycles charged to each cause
+};
+
+SimStats collectStats() {
+    double energy = computeEnergy().total();
+    SimStats st{totalCycles, totalInstructions, dataTransferInstructions,
+                aluInstructions, controlInstructions, pipelineStalls,
+                dataHazards, controlHazards, branchMispredictions,
+                dataHazardStalls, controlHazardStalls,
+                energy, energyDelayProduct(energy),
+                itlb.misses, dtlb.misses, pageWalkCycles, {}};
+    std::copy(cpiCycles, cpiCycles + CPI_CATEGORIES, st.cpiCycles);
+    return st;
+}
+
+void writeStatsCSVHeader(std::ostream &out) {
+    out << "cycles,instructions,cpi,data_transfer,alu,control,stalls,data_hazards,"
+           "control_hazards,branch_mispredictions,data_hazard_stalls,control_hazard_stalls,"
+           "energy_pj,edp_pj_s,itlb_misses,dtlb_misses,page_walk_cycles";
+    for (int c = 0; c < CPI_CATEGORIES; c++) out << "," << cpiCategoryColumns[c];
+}
+
+void writeStatsCSVRow(std::ostream &out, const SimStats &st) {
+    out << st.totalCycles << "," << st.totalInstructions << ","
+        << std::fixed << std::setprecision(4)
+        << (st.totalInstructions ? st.totalCycles / static_cast<double>(st.totalInstructions) : 0.0)
+        << "," << st.dataTransferInstructions << "," << st.aluInstructions << ","
+        << st.controlInstructions << "," << st.pipelineStalls << "," << st.dataHazards << ","
+        << st.controlHazards << "," << st.branchMispredictions << ","
+        << st.dataHazardStalls << "," << st.controlHazardStalls << ","
+        << std::setprecision(1) << st.energyPJ << "," << std::scientific << std::setprecision(6)
+        << st.edp << std::defaultfloat << "," << st.itlbMisses << "," << st.dtlbMisses << ","
+        << st.pageWalkCycles;
+    for (int c = 0; c < CPI_CATEGORIES; c++) out << "," << st.cpiCycles[c];
+}
+
+bool parseSweepGrid(const std::string &filename,
+                    std::vector<std::pair<std::string, std::vector<std::string>>> &grid) {
+    std::ifstream fin(filename);
+    if (!fin.is_open()) {
+        std::cerr << "ERROR: Could not open " << filename << "\n";
+        return false;
+    }
+    std::string line;
+    while (std::getline(fin, line)) {
+        size_t cpos = line.find('#');
+        if (cpos != std::string::npos) line = line.substr(0, cpos);
+        size_t eq = line.find('=');
+        if (eq == std::string::npos) continue;
+        std::string name, token;
+        std::stringstream nameStream(line.substr(0, eq));
+        nameStream >> name;
+        std::vector<std::string> values;
+        std::stringstream valueStream(line.substr(eq + 1));
+        while (std::getline(valueStream, token, ',')) {
+            std::stringstream ts(token);
+            std::string v;
+            ts >> v;
+            if (!v.empty()) values.push_back(v);
+        }
+        if (name.empty() || values.empty()) {
+            std::cerr << "Parsing error on line: " << line << "\n";
+            return false;
+        }
+        grid.push_back({name, values});
+    }
+    return !grid.empty();
+}
+
+int runSweep(const std::string &gridFile) {
+#ifdef _WIN32
+    std::cerr << "ERROR: --sweep needs fork() and is not available on this platform\n";
+    return 1;
+#else
+    std::vector<std::pair<std::string, std::vector<std::string>>> grid;
+    if (!parseSweepGrid(gridFile, grid)) {
+        std::cerr << "ERROR: Empty or invalid sweep grid " << gridFile << "\n";
+        return 1;
+    }
+
+    // Enumerate every combination (last parameter varies fastest)
+    std::vector<std::vector<size_t>> points(1);
+    for (const auto &param : grid) {
+        std::vector<std::vector<size_t>> expanded;
+        for (const auto &p : points) {
+            for (size_t v = 0; v < param.second.size(); v++) {
+                expanded.push_back(p);
+                expanded.back().push_back(v);
+            }
+        }
+        points.swap(expanded);
+    }
+
+    unsigned jobs = sweepJobs ? sweepJobs : static_cast<unsigned>(sysconf(_SC_NPROCESSORS_ONLN));
+    if (jobs == 0) jobs = 1;
+    std::cout << "Sweeping " << points.size() << " configurations on " << jobs << " processes\n";
+    std::cout.flush(); // Children must not inherit buffered output
+
+    std::vector<SimStats> results(points.size());
+    std::vector<bool> ok(points.size(), false);
+    std::map<pid_t, std::pair<size_t, int>> running; // pid -> (point, pipe read end)
+    size_t next = 0;
+
+    while (next < points.size() || !running.empty()) {
+        while (next < points.size() && running.size() < jobs) {
+            int fds[2];
+            if (pipe(fds) != 0) {
+                std::cerr << "ERROR: pipe() failed\n";
+                return 1;
+            }
+            pid_t pid = fork();
+            if (pid == 0) {
+                close(fds[0]);
+                int devnull = open("/dev/null", O_WRONLY);
+                if (devnull >= 0) dup2(devnull, STDOUT_FILENO);
+                for (size_t k = 0; k < grid.size(); k++) {
+                    if (!applyOption(grid[k].first, grid[k].second[points[next][k]])) {
+                        std::cerr << "ERROR: Unknown sweep option " << grid[k].first << "\n";
+                        _exit(2);
+                    }
+                }
+                Knob3 = Knob4 = Knob5 = Knob6 = false;
+                simLog.setAll(LOG_OFF);
+                hostProfiler.progressSeconds = 0;
+                dumpMemoryFiles = false;
+                if (!resetMachineState()) _exit(2);
+                runPipeline(true);
+                SimStats st = collectStats();
+                ssize_t written = write(fds[1], &st, sizeof(st));
+                _exit(written == static_cast<ssize_t>(sizeof(st)) ? 0 : 1);
+            }
+            close(fds[1]);
+            if (pid < 0) {
+                close(fds[0]);
+                std::cerr << "ERROR: fork() failed\n";
+                return 1;
+            }
+            running[pid] = {next, fds[0]};
+            next++;
+        }
+
+        int status = 0;
+        pid_t done = wait(&status);
+        if (done < 0) break;
+        auto it = running.find(done);
+        if (it == running.end()) continue;
+        size_t point = it->second.first;
+        SimStats st;
+        ok[point] = WIFEXITED(status) && WEXITSTATUS(status) == 0 &&
+                    read(it->second.second, &st, sizeof(st)) == static_cast<ssize_t>(sizeof(st));
+        if (ok[point]) results[point] = st;
+        close(it->second.second);
+        running.erase(it);
+    }
+
+    std::ofstream fout(sweepOutFile);
+    if (!fout.is_open()) {
+        std::cerr << "ERROR: Could not open/create " << sweepOutFile << "\n";
+        return 1;
+    }
+    for (const auto &param : grid) fout << param.first << ",";
+    writeStatsCSVHeader(fout);
+    fout << "\n";
+    size_t failed = 0;
+    for (size_t p = 0; p < points.size(); p++) {
+        if (!ok[p]) {
+            failed++;
+            continue;
+        }
+        for (size_t k = 0; k < grid.size(); k++) fout << grid[k].second[points[p][k]] << ",";
+        writeStatsCSVRow(fout, results[p]);
+        fout << "\n";
+    }
+    fout.close();
+    std::cout << "Wrote " << (points.size() - failed) << " rows to " << sweepOutFile;
+    if (failed) std::cout << " (" << failed << " configurations failed)";
+    std::cout << "\n";
+    return failed ? 1 : 0;
+#endif
+}
+
+// =====================================================================
+// main
+// =====================================================================
+int simulate(int argc, char* argv[]) {
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <input.mc | program.elf>\n";
+        return 1;
+    }
+
+    if (!parseKnobArgs(argc, argv)) {
+        return 1;
+    }
+    branchProfiler.enabled = !branchReportFile.empty();
+    dataflow.enabled = !dataflowFile.empty();
+    if (dataflow.enabled && replayTraceFile.empty()) {
+        std::cerr << "WARNING: --dataflow analyzes a --replay trace; ignored\n";
+    }
+    if (!replayTraceFile.empty()) {
+        return simulateFromTrace(replayTraceFile);
+    }
+
+    std::string inputFile = argv[1];
+    if (isElfFile(inputFile) ? !loadElf(inputFile) : !parseInputMC(inputFile)) {
+        return 1;
+    }
+    predecodeProgram();
+
+    if (!sweepGridFile.empty()) {
+        return runSweep(sweepGridFile);
+    }
+
+    // Initialize registers and memory
+    if (!resetMachineState()) {
+        return 1;
+    }
+    if (!profileFile.empty() || !profileFoldedFile.empty()) {
+        profiler.enabled = true;
+        if (!instrMemory.empty()) profiler.reset(instrMemory.begin()->first, instrMemory.rbegin()->first + 4);
+    }
+    memProfiler.enabled = !memProfileFile.empty();
+    if (!pipeTraceFile.empty() && !pipeTracer.open(pipeTraceFile)) {
+        return 1;
+    }
+    if (!logFile.empty() && !simLog.openFile(logFile)) {
+        return 1;
+    }
+    flight.configure(flightRecords, flightFile);
+    flight.installSignalHandlers(&clockCycle);
+    if (!commitLogFile.empty() && !commitLog.open(commitLogFile)) {
+        return 1;
+    }
+
+    // Dump initial contents to files
+    dumpInstructionMemoryToFile("instruction.mc");
+    dumpSegmentToFile("data.mc", dataSegment, 0x10000000, 0x50000000);
+    dumpSegmentToFile("stack.mc", stackSegment, 0x50000000, 0x7FFFFFFF);
+
+    // Print initial register state
+    std::cout << "Initial state (before cycle 0):\n";
+    printRegisters();
+
+    // Prompt user for control
+    char userInput;
+    std::cout << "Enter N for next, R for remainder, E to exit: ";
+    std::cin >> userInput;
+    if (userInput == 'E' || userInput == 'e') {
+        std::cout << "Exiting at user request.\n";
+        return 0;
+    }
+    bool runAllRemaining = (userInput == 'R' || userInput == 'r');
+
+    std::cout << "Starting simulation...\n";
+    hostProfiler.beginRun();
+    runPipeline(runAllRemaining);
+    hostProfiler.endRun(totalInstructions, clockCycle);
+    if (pipeTracer.enabled()) {
+        pipeTracer.close(clockCycle);
+        std::cout << "Pipeline trace written to " << pipeTraceFile << "\n";
+    }
+    if (flight.enabled() && !flightFile.empty()) {
+        if (!flightErrorDumped) flight.dump("halt", clockCycle);
+        std::cout << "Flight recorder written to " << flightFile << "\n";
+    }
+    if (commitLog.isOpen()) {
+        commitLog.close();
+        std::cout << "Commit log written to " << commitLogFile << "\n";
+    }
+    if (simLog.toFile()) {
+        simLog.close();
+        std::cout << "Log written to " << logFile << "\n";
+    }
+
+    printStatistics();
+    printTranslationStatistics();
+    printEnergyReport();
+    if (profiler.enabled) writeProfile();
+    if (branchProfiler.enabled) writeBranchReport();
+    if (memProfiler.enabled) {
+        memProfiler.printSummary(std::cout);
+        if (memProfiler.writeBinary(memProfileFile)) std::cout << "Memory profile written to " << memProfileFile << "\n";
+    }
+    hostProfiler.printReport(std::cout);
 
     std::cout << "Simulation finished after " << std::dec << clockCycle << " cycles.\n";
     return 0;
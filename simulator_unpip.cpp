@@ -8,6 +8,22 @@
 #include <iomanip>
 #include <algorithm>  // for std::sort
 #include <set>
+#include "sim_options.h"
+#include "trace.h"
+#include "elf_loader.h"
+#include "syscalls.h"
+#include "devices.h"
+#include "memprofile.h"
+#include "flightrec.h"
+#include "commitlog.h"
+#include "hostprof.h"
+#include "simlog.h"
+#include "csr.h"
+#include "fpu.h"
+#include "vector.h"
+#include "opcodes.h"
+#include "xlen.h"
+#include "rvc.h"
 
 // =====================================================================
 // Add ALU operation types
@@ -28,35 +44,79 @@ enum ALUOpType {
     ALU_SLT,
     ALU_PASS, // Pass-through for LUI/AUIPC
     ALU_EQ,   // Equality comparison (RA == RB)
-    ALU_GE    // Greater-than-or-equal comparison (RA >= RB)
+    ALU_GE,   // Greater-than-or-equal comparison (RA >= RB)
+    ALU_SLTU, // Unsigned less-than
+    ALU_GEU,  // Unsigned greater-than-or-equal
+    ALU_MULH,
+    ALU_MULHSU,
+    ALU_MULHU,
+    ALU_DIVU,
+    ALU_REMU,
+    ALU_SH1ADD, // Zba: (RA << n) + RB
+    ALU_SH2ADD,
+    ALU_SH3ADD,
+    ALU_ANDN,   // Zbb
+    ALU_ORN,
+    ALU_XNOR,
+    ALU_MIN,
+    ALU_MINU,
+    ALU_MAX,
+    ALU_MAXU,
+    ALU_ROL,
+    ALU_ROR,
+    ALU_CLZ,
+    ALU_CTZ,
+    ALU_CPOP,
+    ALU_SEXTB,
+    ALU_SEXTH,
+    ALU_REV8,
+    ALU_ORCB
 };
 
 // =====================================================================
 // Global CPU State
 // =====================================================================
 static const int NUM_REGS = 32;
-int32_t R[NUM_REGS];       // Register file
-uint32_t PC = 0;           // Program Counter
-uint32_t IR = 0;           // Instruction Register
-int32_t  RA = 0;           // Operand A
-int32_t  RB = 0;           // Operand B
-int32_t  RM = 0;           // Used for store data
-int32_t  RZ = 0;           // ALU output
-int32_t  RY = 0;           // Write-back data
-int32_t  MDR= 0;           // Memory data register
-uint32_t MAR = 0;          // Memory Address Register
+reg_t    R[NUM_REGS];      // Register file
+addr_t   PC = 0;           // Program Counter
+uint32_t IR = 0;           // Instruction Register (compressed instructions expanded)
+uint32_t rawIR = 0;        // Instruction as fetched
+uint32_t instrLen = 4;     // 2 for a compressed instruction
+reg_t    RA = 0;           // Operand A
+reg_t    RB = 0;           // Operand B
+reg_t    RM = 0;           // Used for store data
+reg_t    RZ = 0;           // ALU output
+reg_t    RY = 0;           // Write-back data
+reg_t    MDR= 0;           // Memory data register
+addr_t   MAR = 0;          // Memory Address Register
+
+uint64_t F[NUM_REGS];      // FP register file (single-precision values NaN-boxed)
+uint64_t FA = 0;           // FP operand A (rs1)
+uint64_t FB = 0;           // FP operand B (rs2), also FP store data
+uint64_t FC = 0;           // FP operand C (rs3, fused multiply-add)
+uint64_t FZ = 0;           // FP unit output
+uint64_t FMDR = 0;         // FP load data
+
+alignas(32) uint8_t V[NUM_REGS][VLENB]; // Vector register file (vl and vtype live in csrFile)
 
 uint64_t clockCycle = 0;   // Cycle counter
 
+HostProfiler hostProfiler; // Simulator's own speed (--host-profile, --progress)
+SimLogger simLog;          // Stage diagnostics (--log, --log-file)
+std::string logFile;
+
 // Global control signals
 bool regWrite = false;
 bool memRead = false;
 bool memWrite = false;
 bool branch = false;
 bool jump = false;
-uint8_t memToReg = 0; // 0: ALU result, 1: Memory, 2: PC+4
-uint8_t memSize = 2;  // 0: Byte, 1: Halfword, 2: Word
+uint8_t memToReg = 0; // 0: ALU result, 1: Memory, 2: PC+4 (PC+2 if compressed)
+uint8_t memSize = 2;  // 0: Byte, 1: Halfword, 2: Word, 3: Doubleword
 bool memSignExtend = false;
+bool wordOp = false;  // RV64 *W instruction: 32-bit operation, result sign-extended
+bool fpOp = false;    // F/D computational instruction (executed by the FPU)
+bool vecOp = false;   // V-extension instruction (executed by the vector unit)
 ALUOpType aluOp = ALU_PASS;
 
 // Statistics tracking variables
@@ -65,17 +125,54 @@ uint64_t totalInstructions = 0;
 uint64_t dataTransferInstructions = 0;
 uint64_t aluInstructions = 0;
 uint64_t controlInstructions = 0;
+uint64_t compressedInstructions = 0; // Retired 16-bit instructions
+uint64_t fetchedCodeBytes = 0;       // Instruction bytes of retired instructions
 uint64_t pipelineStalls = 0;
 uint64_t dataHazards = 0;
 uint64_t controlHazards = 0;
 uint64_t branchMispredictions = 0;
 uint64_t dataHazardStalls = 0;
 uint64_t controlHazardStalls = 0;
+uint64_t trapsTaken = 0;
+uint64_t interruptsTaken = 0;
+
+// =====================================================================
+// Machine-mode CSRs and traps
+//   A trap raised in any stage is taken in WRITE_BACK: the faulting
+//   instruction does not retire and PC moves to mtvec. With no handler
+//   installed (mtvec = 0) the simulation halts as before.
+// =====================================================================
+CSRFile csrFile;
+bool trapPending = false;
+uint32_t trapCause = 0;
+uint32_t trapValue = 0;
+bool mretPending = false;
+
+void raiseTrap(uint32_t cause, uint32_t tval) {
+    if (trapPending) return; // Keep the first trap of the instruction
+    trapPending = true;
+    trapCause = cause;
+    trapValue = tval;
+}
+
+// Counters visible to the program through cycle/instret/hpmcounterN
+void bindCSRCounters() {
+    csrFile.cycle = &clockCycle;
+    csrFile.instret = &totalInstructions;
+    csrFile.hpm[0] = &pipelineStalls;       // hpmcounter3
+    csrFile.hpm[1] = &branchMispredictions; // hpmcounter4
+    csrFile.hpm[2] = &dataHazardStalls;     // hpmcounter5
+    csrFile.hpm[3] = &controlHazardStalls;  // hpmcounter6
+    csrFile.hpm[4] = &trapsTaken;           // hpmcounter7
+}
 
 // =====================================================================
 // Instruction Memory (< 0x10000000)
+//   The bytes live in codeSegment like any other memory; instrMemory
+//   holds the parcels fetch has seen, so a fetch is one map lookup.
+//   Stores to code invalidate it (see invalidateCode).
 // =====================================================================
-std::map<uint32_t, uint32_t> instrMemory;
+std::map<addr_t, uint32_t> instrMemory;
 
 // =====================================================================
 // DataSegment Class (handles a map of address -> byte)
@@ -84,19 +181,21 @@ std::map<uint32_t, uint32_t> instrMemory;
 class MemSegment {
 public:
     // Each address in "memory" is one byte
-    std::map<uint32_t, uint8_t> memory;
+    std::map<addr_t, uint8_t> memory;
 
-    void writeByte(uint32_t address, uint8_t value) {
+    void writeByte(addr_t address, uint8_t value) {
         memory[address] = value;
     }
 
-    void writeWord(uint32_t address, int32_t value) {
-        for (int i = 0; i < 4; i++) {
-            memory[address + i] = static_cast<uint8_t>((value >> (8 * i)) & 0xFF);
-        }
+    void writeWord(addr_t address, int32_t value) {
+        writeBytes(address, static_cast<uint32_t>(value), 4);
     }
 
-    int8_t readByte(uint32_t address) const {
+    void writeDouble(addr_t address, int64_t value) {
+        writeBytes(address, static_cast<uint64_t>(value), 8);
+    }
+
+    int8_t readByte(addr_t address) const {
         auto it = memory.find(address);
         if (it != memory.end()) {
             return static_cast<int8_t>(it->second);
@@ -104,22 +203,116 @@ public:
         return 0;
     }
 
-    int32_t readWord(uint32_t address) const {
-        int32_t result = 0;
-        for (int i = 0; i < 4; i++) {
+    int32_t readWord(addr_t address) const {
+        return static_cast<int32_t>(readBytes(address, 4));
+    }
+
+    int64_t readDouble(addr_t address) const {
+        return static_cast<int64_t>(readBytes(address, 8));
+    }
+
+    // Little-endian access of size bytes. An aligned access cannot wrap
+    // around the address space, so it finds its first byte once and walks
+    // the map from there instead of looking up every byte.
+    uint64_t readBytes(addr_t address, int size) const {
+        uint64_t result = 0;
+        if ((address & (size - 1)) == 0) {
+            for (auto it = memory.lower_bound(address);
+                 it != memory.end() && it->first - address < static_cast<addr_t>(size); ++it) {
+                result |= static_cast<uint64_t>(it->second) << (8 * (it->first - address));
+            }
+            return result;
+        }
+        for (int i = 0; i < size; i++) {
             auto it = memory.find(address + i);
             uint8_t b = (it != memory.end()) ? it->second : 0;
-            result |= (b << (8 * i));
+            result |= static_cast<uint64_t>(b) << (8 * i);
         }
         return result;
     }
+
+    void writeBytes(addr_t address, uint64_t value, int size) {
+        if ((address & (size - 1)) == 0) {
+            auto hint = memory.lower_bound(address);
+            for (int i = 0; i < size; i++) {
+                hint = memory.emplace_hint(hint, address + i, 0);
+                hint->second = static_cast<uint8_t>(value >> (8 * i));
+                ++hint;
+            }
+            return;
+        }
+        for (int i = 0; i < size; i++) {
+            memory[address + i] = static_cast<uint8_t>(value >> (8 * i));
+        }
+    }
 };
 
 // =====================================================================
 // We will have two separate MemSegments for data and stack
 // =====================================================================
+MemSegment codeSegment;   // for addresses below 0x10000000 (instructions)
 MemSegment dataSegment;   // for addresses in [0x10000000, 0x7FFFFFFF)
 MemSegment stackSegment;  // for addresses >= 0x7FFFFFFF
+MemSegment mmioSegment;   // Never holds bytes: marks the MMIO window, see devices.h
+DeviceBus devices;
+
+// =====================================================================
+// Code memory coherence
+//   codePages marks the 4 KiB pages that have parcels in instrMemory; a
+//   store to a marked page drops exactly the parcels it overlaps, and
+//   fetch reloads them from codeSegment. Stores to other pages, and all
+//   data and stack stores, do no extra work.
+// =====================================================================
+static const unsigned CODE_PAGE_SHIFT = 12;
+std::vector<uint8_t> codePages(0x10000000 >> CODE_PAGE_SHIFT);
+uint64_t codeStores = 0;             // Stores to pages holding fetched code
+uint64_t codeParcelsInvalidated = 0;
+uint64_t codeRefills = 0;            // Parcels fetch reloaded from codeSegment
+uint64_t fenceIInstructions = 0;
+
+// Places a parcel of size bytes at load time
+void loadCodeParcel(addr_t addr, uint32_t parcel, int size) {
+    codeSegment.writeBytes(addr, parcel, size);
+    instrMemory[addr] = parcel;
+    codePages[addr >> CODE_PAGE_SHIFT] = 1;
+}
+
+// Parcel at addr for fetch; false if no code was loaded or written there
+bool fetchParcel(addr_t addr, uint32_t &parcel) {
+    auto it = instrMemory.find(addr);
+    if (it != instrMemory.end()) {
+        parcel = it->second;
+        return true;
+    }
+    if (addr >= 0x10000000 || codeSegment.memory.find(addr) == codeSegment.memory.end()) return false;
+    parcel = static_cast<uint32_t>(codeSegment.readBytes(addr, 2));
+    if ((parcel & 0x3) == 0x3) parcel = static_cast<uint32_t>(codeSegment.readBytes(addr, 4));
+    instrMemory[addr] = parcel;
+    codePages[addr >> CODE_PAGE_SHIFT] = 1;
+    codeRefills++;
+    return true;
+}
+
+// A store of size bytes at addr went to codeSegment
+void invalidateCode(addr_t addr, unsigned size) {
+    addr_t first = (addr >= 3) ? addr - 3 : 0; // A 4-byte parcel may start 3 bytes earlier
+    addr_t last = std::min<addr_t>(addr + size - 1, 0x0FFFFFFF);
+    if (!codePages[first >> CODE_PAGE_SHIFT] && !codePages[last >> CODE_PAGE_SHIFT]) return;
+    codeStores++;
+    for (auto it = instrMemory.lower_bound(first); it != instrMemory.end() && it->first <= last; ) {
+        if (it->first + ((it->second & 0x3) == 0x3 ? 4 : 2) <= addr) {
+            ++it; // Compressed parcel just before the store
+            continue;
+        }
+        it = instrMemory.erase(it);
+        codeParcelsInvalidated++;
+    }
+}
+
+// Store hook for the memory interfaces: one compare for data stores
+inline void noteStore(const MemSegment *seg, addr_t addr, unsigned size) {
+    if (seg == &codeSegment) invalidateCode(addr, size);
+}
 
 // =====================================================================
 // Dumping memory to an .mc file
@@ -129,9 +322,10 @@ MemSegment stackSegment;  // for addresses >= 0x7FFFFFFF
 // =====================================================================
 void dumpSegmentToFile(const std::string &filename, 
                        const MemSegment &seg,
-                       uint32_t startAddr, 
-                       uint32_t endAddr /* inclusive or exclusive? */)
+                       addr_t startAddr, 
+                       addr_t endAddr /* inclusive or exclusive? */)
 {
+    HostPhaseScope phase(hostProfiler, HOST_DUMP);
     // Open file for overwrite
     std::ofstream fout(filename);
     if (!fout.is_open()) {
@@ -140,7 +334,7 @@ void dumpSegmentToFile(const std::string &filename,
     }
 
     // Gather addresses from seg.memory
-    std::vector<uint32_t> addresses;
+    std::vector<addr_t> addresses;
     addresses.reserve(seg.memory.size());
     for (const auto &kv : seg.memory) {
         addresses.push_back(kv.first);
@@ -150,9 +344,9 @@ void dumpSegmentToFile(const std::string &filename,
     // We'll write lines only for addresses in [startAddr, endAddr]
     // For the stack region, if endAddr < startAddr, we'll interpret that accordingly.
     // But here, let's just check the range as you prefer:
-    std::set<uint32_t> visited;
+    std::set<addr_t> visited;
 
-    for (uint32_t addr : addresses) {
+    for (addr_t addr : addresses) {
         if (addr < startAddr) {
             continue;
         }
@@ -194,32 +388,27 @@ void dumpSegmentToFile(const std::string &filename,
 }
 
 // =====================================================================
-// Dumping the instruction memory (which is map<uint32_t, uint32_t>)
-// to instruction.mc
+// Dumping the instruction memory to instruction.mc: one line per
+// parcel in codeSegment, so instructions the program wrote show up too
 // =====================================================================
 void dumpInstructionMemoryToFile(const std::string &filename) {
+    HostPhaseScope phase(hostProfiler, HOST_DUMP);
     std::ofstream fout(filename);
     if (!fout.is_open()) {
         std::cerr << "ERROR: Could not open/create " << filename << "\n";
         return;
     }
 
-    // gather addresses
-    std::vector<uint32_t> addresses;
-    addresses.reserve(instrMemory.size());
-    for (auto &kv : instrMemory) {
-        addresses.push_back(kv.first);
-    }
-    std::sort(addresses.begin(), addresses.end());
-
-    // write
-    for (auto addr : addresses) {
-        // each entry is already a full 32-bit instruction
-        uint32_t word = instrMemory[addr];
+    auto it = codeSegment.memory.begin();
+    while (it != codeSegment.memory.end()) {
+        addr_t addr = it->first;
+        uint32_t word = static_cast<uint32_t>(codeSegment.readBytes(addr, 2));
+        if ((word & 0x3) == 0x3) word = static_cast<uint32_t>(codeSegment.readBytes(addr, 4));
         fout << std::hex 
              << "0x" << std::setw(8) << std::setfill('0') << addr 
              << "  0x" << std::setw(8) << std::setfill('0') << word
              << std::dec << "\n";
+        it = codeSegment.memory.lower_bound(addr + instrLength(word));
     }
     fout.close();
 }
@@ -247,7 +436,9 @@ struct DecodedInstr {
     uint32_t rs2;
     uint32_t funct3;
     uint32_t funct7;
+    uint32_t rs3;       // Fused multiply-add third source
     int32_t  imm;
+    uint8_t  fpFlags;   // INSTR_FLAG_FRD/FRS1/FRS2/RM/V from the opcode table
 
     // Control signals
     bool regWrite;      // Enable register write
@@ -257,9 +448,10 @@ struct DecodedInstr {
     bool jump;          // Enable jump
     ALUOpType aluOp;    // ALU operation type
     uint8_t memToReg;   // Select memory or ALU result for write-back
-    uint8_t memSize;    // Memory access size: 0=byte, 1=halfword, 2=word
+    uint8_t memSize;    // Memory access size: 0=byte, 1=halfword, 2=word, 3=doubleword
     bool memSignExtend; // Sign-extend memory read data
     bool zero;          // ALU zero signal (result is 0)
+    InstrId id;         // Row of the shared opcode table (INSTR_INVALID if unknown)
 };
 
 DecodedInstr d; // Make d a global variable to persist across states
@@ -275,6 +467,10 @@ DecodedInstr decode(uint32_t instr) {
     d.rs1    = getBits(instr, 19, 15);
     d.rs2    = getBits(instr, 24, 20);
     d.funct7 = getBits(instr, 31, 25);
+    d.rs3    = getBits(instr, 31, 27);
+    const OpcodeInfo *info = findInstrByEncoding(instr, XLEN == 64);
+    d.id      = info ? info->id : INSTR_INVALID;
+    d.fpFlags = info ? info->flags : 0;
 
     // Default control signals
     d.regWrite = false;
@@ -291,12 +487,15 @@ DecodedInstr decode(uint32_t instr) {
     // Decode immediate
     switch(d.opcode) {
         case 0x13: // I-type ALU
+        case 0x1B: // I-type ALU, 32-bit (RV64)
         case 0x03: // I-type LOAD
+        case 0x07: // I-type FP LOAD
         case 0x67: { // I-type JALR
             uint32_t imm12 = getBits(instr, 31, 20);
             d.imm = signExtend(imm12, 12);
         } break;
-        case 0x23: { // S-type
+        case 0x23: // S-type
+        case 0x27: { // S-type FP STORE
             uint32_t immHigh = getBits(instr, 31, 25);
             uint32_t immLow  = getBits(instr, 11, 7);
             uint32_t imm12 = (immHigh << 5) | immLow;
@@ -342,11 +541,12 @@ bool isTerminationInstr(uint32_t instr) {
 
 // =====================================================================
 // parseInputMC: read addresses from input.mc and distribute them
-//   - <0x10000000 => instrMemory
+//   - <0x10000000 => codeSegment (and instrMemory)
 //   - [0x10000000, 0x7FFFFFFF) => dataSegment
 //   - >=0x7FFFFFFF => stackSegment
 // =====================================================================
 bool parseInputMC(const std::string &filename) {
+    HostPhaseScope phase(hostProfiler, HOST_LOAD);
     std::ifstream fin(filename);
     if (!fin.is_open()) {
         std::cerr << "ERROR: Could not open " << filename << "\n";
@@ -379,12 +579,12 @@ bool parseInputMC(const std::string &filename) {
         }
 
         try {
-            uint32_t address = std::stoul(addrStr, nullptr, 16);
+            addr_t   address = std::stoull(addrStr, nullptr, 16);
             uint32_t word    = std::stoul(dataStr, nullptr, 16);
 
             if (address < 0x10000000) {
                 // instructions
-                instrMemory[address] = word;
+                loadCodeParcel(address, word, instrLength(word));
             }
             else if (address < 0x7FFFFFFF) {
                 // data
@@ -409,11 +609,27 @@ bool parseInputMC(const std::string &filename) {
 // printRegisters
 // =====================================================================
 void printRegisters() {
+    HostPhaseScope phase(hostProfiler, HOST_PRINT);
     std::cout << "Register File:\n";
     for (int i = 0; i < NUM_REGS; i++) {
         std::cout << "R[" << std::setw(2) << i << "]=" << R[i] << "   ";
         if ((i+1)%4 == 0) std::cout << "\n";
     }
+    // FP registers only once a program has written them
+    for (int i = 0; i < NUM_REGS; i++) {
+        if (F[i] != 0)
+            std::cout << "F[" << std::setw(2) << i << "]=0x" << std::hex << F[i] << std::dec << "\n";
+    }
+    // Vector registers likewise, as bytes from the highest address down
+    for (int i = 0; i < NUM_REGS; i++) {
+        bool written = false;
+        for (uint32_t b = 0; b < VLENB; b++) written |= (V[i][b] != 0);
+        if (!written) continue;
+        std::cout << "V[" << std::setw(2) << i << "]=0x" << std::hex;
+        for (int b = VLENB - 1; b >= 0; b--)
+            std::cout << std::setw(2) << std::setfill('0') << static_cast<unsigned>(V[i][b]);
+        std::cout << std::setfill(' ') << std::dec << "\n";
+    }
     std::cout << "-------------------------------------\n";
     std::cout << "PC = 0x" << std::hex << PC 
               << "  IR = 0x" << IR << std::dec << "\n";
@@ -427,12 +643,12 @@ void printRegisters() {
 //   Helper to figure out which segment an address belongs to.
 //   We will read/write from the correct segment in LOAD/STORE ops.
 // =====================================================================
-MemSegment* getMemSegmentForAddress(uint32_t addr) {
-    if (addr < 0x10000000) {
-        // For simplicity, let's assume we do NOT allow loads/stores to instruction memory
-        // But if you wanted self-modifying code, you'd handle it. 
-        // We'll just return nullptr here to indicate invalid or unexpected.
-        return nullptr;
+MemSegment* getMemSegmentForAddress(addr_t addr) {
+    if (DeviceBus::contains(addr)) {
+        return &mmioSegment; // Device registers
+    }
+    else if (addr < 0x10000000) {
+        return &codeSegment; // Instructions; stores invalidate fetched copies (noteStore)
     }
     else if (addr < 0x7FFFFFFF) {
         return &dataSegment;
@@ -442,28 +658,116 @@ MemSegment* getMemSegmentForAddress(uint32_t addr) {
     }
 }
 
+// =====================================================================
+// loadElf: place the PT_LOAD segments of an ELF executable with the
+// same address map as parseInputMC. Executable segments are split into
+// instruction parcels like the assembler output; .bss needs no bytes
+// because unwritten memory reads as zero. Code and data share one
+// memory, so a non-executable segment may sit below 0x10000000 too.
+// =====================================================================
+addr_t programEntry = 0;               // Reset PC (e_entry for ELF input)
+std::vector<ElfSymbol> programSymbols; // Sorted by address; empty for .mc input
+addr_t programBreak = 0;               // End of the ELF data segments (.bss included)
+
+bool loadElf(const std::string &filename) {
+    HostPhaseScope phase(hostProfiler, HOST_LOAD);
+    ElfFile elf;
+    if (!elf.open(filename, XLEN)) return false;
+    uint64_t codeBytes = 0, dataBytes = 0;
+    for (const ElfSegment &seg : elf.segments()) {
+        if (seg.flags & ELF_PF_X) {
+            if (seg.vaddr + seg.memSize > 0x10000000) {
+                std::cerr << "ERROR: executable segment at 0x" << std::hex << seg.vaddr << std::dec
+                          << " is outside instruction memory (< 0x10000000)\n";
+                return false;
+            }
+            for (uint64_t off = 0; off + 2 <= seg.fileSize; ) {
+                uint32_t parcel = seg.data[off] | (seg.data[off + 1] << 8);
+                if ((parcel & 0x3) == 0x3 && off + 4 <= seg.fileSize) {
+                    parcel |= (seg.data[off + 2] << 16) | (static_cast<uint32_t>(seg.data[off + 3]) << 24);
+                    loadCodeParcel(seg.vaddr + off, parcel, 4);
+                    off += 4;
+                } else {
+                    loadCodeParcel(seg.vaddr + off, parcel, 2);
+                    off += 2;
+                }
+            }
+            codeBytes += seg.fileSize;
+        } else {
+            // Read-only data may also sit below 0x10000000, next to the code
+            for (uint64_t off = 0; off < seg.fileSize; off++) {
+                MemSegment *mem = getMemSegmentForAddress(seg.vaddr + off);
+                if (mem && mem != &mmioSegment) mem->writeByte(seg.vaddr + off, seg.data[off]);
+            }
+            dataBytes += seg.fileSize;
+            if (seg.vaddr >= 0x10000000) programBreak = std::max<addr_t>(programBreak, seg.vaddr + seg.memSize);
+        }
+    }
+    programEntry = elf.entry();
+    programSymbols = elf.symbols();
+    std::cout << "[ELF] Loaded " << filename << ": " << codeBytes << " code bytes, " << dataBytes
+              << " data bytes, " << programSymbols.size() << " symbols, entry 0x" << std::hex
+              << programEntry << std::dec << "\n";
+    return true;
+}
+
+// =====================================================================
+// System calls: with no trap handler installed (mtvec = 0) an ECALL is
+// emulated by SyscallHost instead of halting. The a0 result is written
+// back like any other register result.
+// =====================================================================
+SyscallHost syscalls(simLog);
+
+// Plain memory only: system calls and DMA do not reach device registers
+struct GuestMemory {
+    static MemSegment *segment(uint64_t addr) {
+        MemSegment *seg = (addr == static_cast<addr_t>(addr)) ? getMemSegmentForAddress(addr) : nullptr;
+        return (seg == &mmioSegment) ? nullptr : seg;
+    }
+    bool readByte(uint64_t addr, uint8_t &value) {
+        MemSegment *seg = segment(addr);
+        if (seg) value = static_cast<uint8_t>(seg->readByte(addr));
+        return seg != nullptr;
+    }
+    bool writeByte(uint64_t addr, uint8_t value) {
+        MemSegment *seg = segment(addr);
+        if (seg) {
+            seg->writeByte(addr, value);
+            noteStore(seg, addr, 1);
+        }
+        return seg != nullptr;
+    }
+};
+
+// The heap starts after the loaded data and may grow up to the stack
+void initSyscallHeap() {
+    addr_t base = programBreak;
+    if (base == 0) base = dataSegment.memory.empty() ? 0x10000000 : dataSegment.memory.rbegin()->first + 1;
+    syscalls.setHeap(base, 0x7FFFFFFF);
+}
+
 // =====================================================================
 // Instruction Address Generator (IAG)
 // =====================================================================
 class IAG {
 public:
-    uint32_t PCtemp; // Temporary storage for PC + 4
+    addr_t PCtemp; // Temporary storage for the next sequential PC
 
     // Update PC based on signals
-    void updatePC(bool jump, bool branch, bool zero, int32_t offset, int32_t RZ) {
-        PCtemp = PC + 4; // Always store PC + 4 in PCtemp
+    void updatePC(bool jump, bool branch, bool zero, int32_t offset, reg_t RZ) {
+        PCtemp = PC + instrLen; // PC + 4, or PC + 2 after a compressed instruction
         if (jump) {
             if (branch) {
-                std::cout << "current PC: " << std::hex << PC << std::dec << "\n";
-                std::cout << "branch offset: " << std::hex << offset << std::dec << "\n";
+                SIM_LOG(LOG_EXECUTE, LOG_TRACE, "current PC: " << std::hex << PC << std::dec << "\n");
+                SIM_LOG(LOG_EXECUTE, LOG_TRACE, "branch offset: " << std::hex << offset << std::dec << "\n");
                 PC += offset; // For JAL, PC = PC + offset
             } else {
-                PC = RZ & ~1U; // For JALR, PC = RZ (aligned to even address)
+                PC = RZ & ~static_cast<reg_t>(1); // For JALR, PC = RZ (aligned to even address)
             }
         } else if (branch && zero) {
             PC += offset; // For branch, PC = PC + offset
         } else {
-            PC = PCtemp; // Default to PC + 4
+            PC = PCtemp; // Default to the next instruction
         }
     }
 };
@@ -471,10 +775,68 @@ public:
 // Global IAG instance
 IAG iag;
 
+// =====================================================================
+// ALU operation for each instruction. Branches are taken when the
+// ALU result is zero, so each compares for the opposite condition.
+// =====================================================================
+ALUOpType aluOpFor(InstrId id) {
+    switch (id) {
+        case INSTR_ADD: case INSTR_ADDI: case INSTR_ADDW: case INSTR_ADDIW:
+        case INSTR_LB: case INSTR_LH: case INSTR_LW: case INSTR_LBU: case INSTR_LHU:
+        case INSTR_LWU: case INSTR_LD:
+        case INSTR_SB: case INSTR_SH: case INSTR_SW: case INSTR_SD:
+        case INSTR_FLW: case INSTR_FLD: case INSTR_FSW: case INSTR_FSD:
+        case INSTR_JALR: case INSTR_AUIPC:
+            return ALU_ADD;
+        case INSTR_SUB: case INSTR_SUBW: case INSTR_BEQ: return ALU_SUB; // BEQ: RA - RB == 0
+        case INSTR_BNE:  return ALU_EQ;                 // BNE: RA == RB
+        case INSTR_BLT:  return ALU_GE;                 // BLT: RA >= RB
+        case INSTR_BGE:  return ALU_SLT;                // BGE: RA < RB
+        case INSTR_BLTU: return ALU_GEU;                // BLTU: RA >= RB (unsigned)
+        case INSTR_BGEU: return ALU_SLTU;               // BGEU: RA < RB (unsigned)
+        case INSTR_AND: case INSTR_ANDI: return ALU_AND;
+        case INSTR_OR:  case INSTR_ORI:  return ALU_OR;
+        case INSTR_XOR: case INSTR_XORI: return ALU_XOR;
+        case INSTR_SLL: case INSTR_SLLI: case INSTR_SLLW: case INSTR_SLLIW: return ALU_SLL;
+        case INSTR_SRL: case INSTR_SRLI: case INSTR_SRLW: case INSTR_SRLIW: return ALU_SRL;
+        case INSTR_SRA: case INSTR_SRAI: case INSTR_SRAW: case INSTR_SRAIW: return ALU_SRA;
+        case INSTR_SLT: case INSTR_SLTI: return ALU_SLT;
+        case INSTR_SLTU: case INSTR_SLTIU: return ALU_SLTU;
+        case INSTR_MUL: case INSTR_MULW:   return ALU_MUL;
+        case INSTR_MULH:   return ALU_MULH;
+        case INSTR_MULHSU: return ALU_MULHSU;
+        case INSTR_MULHU:  return ALU_MULHU;
+        case INSTR_DIV: case INSTR_DIVW:   return ALU_DIV;
+        case INSTR_DIVU: case INSTR_DIVUW: return ALU_DIVU;
+        case INSTR_REM: case INSTR_REMW:   return ALU_REM;
+        case INSTR_REMU: case INSTR_REMUW: return ALU_REMU;
+        case INSTR_SH1ADD: return ALU_SH1ADD;
+        case INSTR_SH2ADD: return ALU_SH2ADD;
+        case INSTR_SH3ADD: return ALU_SH3ADD;
+        case INSTR_ANDN:   return ALU_ANDN;
+        case INSTR_ORN:    return ALU_ORN;
+        case INSTR_XNOR:   return ALU_XNOR;
+        case INSTR_MIN:    return ALU_MIN;
+        case INSTR_MINU:   return ALU_MINU;
+        case INSTR_MAX:    return ALU_MAX;
+        case INSTR_MAXU:   return ALU_MAXU;
+        case INSTR_ROL: case INSTR_ROLW: return ALU_ROL;
+        case INSTR_ROR: case INSTR_RORI: case INSTR_RORW: case INSTR_RORIW: return ALU_ROR;
+        case INSTR_CLZ: case INSTR_CLZW:   return ALU_CLZ;
+        case INSTR_CTZ: case INSTR_CTZW:   return ALU_CTZ;
+        case INSTR_CPOP: case INSTR_CPOPW: return ALU_CPOP;
+        case INSTR_SEXT_B: return ALU_SEXTB;
+        case INSTR_SEXT_H: return ALU_SEXTH;
+        case INSTR_REV8:   return ALU_REV8;
+        case INSTR_ORC_B:  return ALU_ORCB;
+        default:           return ALU_PASS; // LUI, JAL, SYSTEM, FENCE
+    }
+}
+
 // =====================================================================
 // Control circuitry function
 // =====================================================================
-void controlCircuitry(uint32_t opcode, uint32_t funct3, uint32_t funct7) {
+void controlCircuitry(const DecodedInstr &d) {
     // Reset all control signals
     regWrite = false;
     memRead = false;
@@ -485,132 +847,172 @@ void controlCircuitry(uint32_t opcode, uint32_t funct3, uint32_t funct7) {
     memSize = 2; // Default to word
     memSignExtend = false;
     aluOp = ALU_PASS;
+    wordOp = (d.opcode == 0x1B || d.opcode == 0x3B);
+    fpOp = false;
+    vecOp = false;
+    if (d.id == INSTR_INVALID) return; // Raises an illegal-instruction trap
+
+    aluOp = aluOpFor(d.id);
+
+    // Vector instructions share the FP load/store opcodes; only vsetvli
+    // and vmv.x.s write an x register
+    if (d.fpFlags & INSTR_FLAG_V) {
+        vecOp = true;
+        regWrite = (d.id == INSTR_VSETVLI || d.id == INSTR_VMV_X_S);
+        memRead = (d.opcode == 0x07);
+        memWrite = (d.opcode == 0x27);
+        memSize = vecMemSize(d.funct3);
+        return;
+    }
 
-    // Update control signals based on opcode, funct3, and funct7
-    switch (opcode) {
+    // Update control signals based on opcode and funct3
+    switch (d.opcode) {
         case 0x33: // R-type
-            regWrite = true;
-            switch (funct3) {
-                case 0x0:
-                    aluOp = (funct7 == 0x20) ? ALU_SUB : 
-                            (funct7 == 0x01) ? ALU_MUL : ALU_ADD;
-                    break;
-                case 0x4:
-                    aluOp = (funct7 == 0x01) ? ALU_DIV : ALU_XOR;
-                    break;
-                case 0x6:
-                    aluOp = (funct7 == 0x01) ? ALU_REM : ALU_OR;
-                    break;
-                case 0x7:
-                    aluOp = ALU_AND;
-                    break;
-                case 0x1:
-                    aluOp = ALU_SLL;
-                    break;
-                case 0x2:
-                    aluOp = ALU_SLT;
-                    break;
-                case 0x5:
-                    aluOp = (funct7 == 0x20) ? ALU_SRA : ALU_SRL;
-                    break;
-                default:
-                    break;
-            }
-            break;
         case 0x13: // I-type ALU
+        case 0x3B: // R-type, 32-bit (RV64)
+        case 0x1B: // I-type ALU, 32-bit (RV64)
             regWrite = true;
-            switch (funct3) {
-                case 0x0:
-                    aluOp = ALU_ADD; // ADDI
-                    break;
-                case 0x7:
-                    aluOp = ALU_AND; // ANDI
-                    break;
-                case 0x6:
-                    aluOp = ALU_OR; // ORI
-                    break;
-                case 0x4:
-                    aluOp = ALU_XOR; // XORI
-                    break;
-                case 0x2:
-                    aluOp = ALU_SLT; // SLTI
-                    break;
-                case 0x1:
-                    aluOp = ALU_SLL; // SLLI
-                    break;
-                case 0x5:
-                    aluOp = ((funct7 & 0x20) == 0x20) ? ALU_SRA : ALU_SRL; // SRLI/SRAI
-                    break;
-                default:
-                    break;
-            }
             break;
         case 0x03: // LOAD
             regWrite = true;
             memRead = true;
-            aluOp = ALU_ADD; // Address calculation
             memToReg = 1; // Write-back from memory
-            switch (funct3) {
+            switch (d.funct3) {
                 case 0x0: memSize = 0; memSignExtend = true; break; // LB
                 case 0x1: memSize = 1; memSignExtend = true; break; // LH
-                case 0x2: memSize = 2; memSignExtend = false; break; // LW
+                case 0x2: memSize = 2; memSignExtend = true; break; // LW
+                case 0x3: memSize = 3; memSignExtend = false; break; // LD
                 case 0x4: memSize = 0; memSignExtend = false; break; // LBU
                 case 0x5: memSize = 1; memSignExtend = false; break; // LHU
+                case 0x6: memSize = 2; memSignExtend = false; break; // LWU
                 default: break;
             }
             break;
         case 0x23: // STORE
             memWrite = true;
-            aluOp = ALU_ADD; // Address calculation
-            switch (funct3) {
+            switch (d.funct3) {
                 case 0x0: memSize = 0; break; // SB
                 case 0x1: memSize = 1; break; // SH
                 case 0x2: memSize = 2; break; // SW
+                case 0x3: memSize = 3; break; // SD
                 default: break;
             }
             break;
         case 0x63: // BRANCH
             branch = true;
-            switch (funct3) {
-                case 0x0: aluOp = ALU_SUB; break; // BEQ: RA - RB == 0
-                case 0x1: aluOp = ALU_EQ; break;  // BNE: RA == RB
-                case 0x4: aluOp = ALU_GE; break;  // BLT: RA >= RB
-                case 0x5: aluOp = ALU_SLT; break; // BGE: RA < RB
-                default: break;
-            }
             break;
         case 0x6F: // JAL
             regWrite = true;
             jump = true;
             branch = true; // No branch for JAL
-            aluOp = ALU_PASS; // No ALU operation needed for JAL
             memToReg = 2; // Write-back PC+4 (PCtemp from IAG)
             break;
         case 0x67: // JALR
             regWrite = true;
             jump = true;
-            aluOp = ALU_ADD; // Calculate new PC using ALU
             memToReg = 2; // Write-back PC+4
             break;
-        case 0x37: // LUI
+        case 0x37: // LUI: pass-through immediate
+        case 0x17: // AUIPC: add upper immediate to PC
             regWrite = true;
-            aluOp = ALU_PASS; // Pass-through immediate
             break;
-        case 0x17: // AUIPC
+        case 0x73: // SYSTEM: CSR result is the old CSR value
+            regWrite = (d.funct3 != 0);
+            break;
+        case 0x07: // FP LOAD: FLW, FLD
             regWrite = true;
-            aluOp = ALU_ADD; // Add upper immediate to PC
+            memRead = true;
+            memToReg = 1;
+            memSize = d.funct3;
+            break;
+        case 0x27: // FP STORE: FSW, FSD
+            memWrite = true;
+            memSize = d.funct3;
+            break;
+        case 0x43: case 0x47: case 0x4B: case 0x4F: // Fused multiply-add
+        case 0x53: // FP arithmetic, compare, convert, move
+            regWrite = true;
+            fpOp = true;
             break;
         default:
             break;
     }
 }
 
+// Flight recorder (--flight-records, --flight-file): dumped on halt, on a
+// missing instruction, on an invalid memory access and on SIGINT/SIGSEGV
+FlightRecorder flight;
+std::string flightFile = "flight_recorder.txt";
+uint32_t flightRecords = 4096;
+bool flightErrorDumped = false; // Keep the error dump instead of the halt dump
+
+void flightErrorDump(FlightKind kind, addr_t addr, const char *reason) {
+    flight.event(clockCycle, kind, PC, 0, addr);
+    if (flightErrorDumped) return;
+    flightErrorDumped = true;
+    flight.dump(reason, clockCycle);
+}
+
+// =====================================================================
+// executeSystem: CSR instructions, ECALL/EBREAK and MRET (opcode 0x73)
+// =====================================================================
+void executeSystem() {
+    uint32_t csrAddr = getBits(IR, 31, 20);
+    if (d.funct3 == 0) {
+        if (d.id == INSTR_ECALL && csrFile.mtvec == 0) {
+            uint64_t args[6];
+            for (int i = 0; i < 6; i++) args[i] = static_cast<ureg_t>(R[10 + i]);
+            GuestMemory mem;
+            flight.event(clockCycle, FLIGHT_SYSCALL, PC, static_cast<ureg_t>(R[17]));
+            int64_t result = syscalls.handle(static_cast<ureg_t>(R[17]), args, mem, clockCycle, 1.0);
+            if (!syscalls.exited) {
+                regWrite = true; // a0 goes through WRITE_BACK
+                d.rd = 10;
+                RZ = static_cast<reg_t>(result);
+            }
+        } else if (d.id == INSTR_ECALL) {
+            raiseTrap(CAUSE_ECALL_M, 0);
+        } else if (d.id == INSTR_EBREAK) {
+            raiseTrap(CAUSE_BREAKPOINT, PC);
+        } else if (d.id == INSTR_MRET) {
+            mretPending = true;
+        } // sfence.vma and wfi are no-ops
+        return;
+    }
+    uint32_t oldValue = 0;
+    if (!executeCSROp(csrFile, d.funct3, csrAddr, d.rs1, static_cast<uint32_t>(RA), oldValue)) {
+        raiseTrap(CAUSE_ILLEGAL_INSTRUCTION, IR);
+        return;
+    }
+    RZ = static_cast<reg_t>(oldValue);
+    SIM_LOG(LOG_EXECUTE, LOG_DEBUG, "[Execute] CSR 0x" << std::hex << csrAddr << " read 0x" << oldValue << std::dec << "\n");
+}
+
+// Data-access profiling (--mem-profile): scalar loads and stores to memory
+MemoryProfiler memProfiler;
+std::string memProfileFile;
+
 // =====================================================================
 // Memory Processor Interface
 // =====================================================================
 void memoryProcessorInterface(bool memRead, bool memWrite, uint8_t memSize) {
     MemSegment* seg = getMemSegmentForAddress(MAR);
-    if (!seg) return; // Invalid memory segment
+    if (!seg) { // Invalid memory segment
+        if (memRead || memWrite) flightErrorDump(FLIGHT_MEM_FAULT, MAR, "invalid memory access");
+        return;
+    }
+
+    if (seg == &mmioSegment) { // Device register
+        const unsigned size = 1u << memSize;
+        if (memRead) {
+            uint64_t v = devices.load(MAR, size);
+            if (memSignExtend && size < 8) v = static_cast<uint64_t>(static_cast<int64_t>(v << (64 - 8 * size)) >> (64 - 8 * size));
+            MDR = static_cast<reg_t>(v);
+        }
+        if (memWrite) devices.store(MAR, size, static_cast<ureg_t>(RM));
+        return;
+    }
+    if (memProfiler.enabled) memProfiler.access(PC, MAR, memWrite);
 
     if (memRead) {
         // Perform memory read based on size
@@ -624,7 +1026,11 @@ void memoryProcessorInterface(bool memRead, bool memWrite, uint8_t memSize) {
                                     : static_cast<uint16_t>(seg->readByte(MAR) | (seg->readByte(MAR + 1) << 8));
                 break;
             case 2: // Word
-                MDR = seg->readWord(MAR);
+                MDR = memSignExtend ? static_cast<reg_t>(seg->readWord(MAR))
+                                    : static_cast<reg_t>(static_cast<uint32_t>(seg->readWord(MAR)));
+                break;
+            case 3: // Doubleword (RV64 only)
+                MDR = static_cast<reg_t>(seg->readDouble(MAR));
                 break;
             default:
                 break;
@@ -642,14 +1048,97 @@ void memoryProcessorInterface(bool memRead, bool memWrite, uint8_t memSize) {
                 seg->writeByte(MAR + 1, (RM >> 8) & 0xFF);
                 break;
             case 2: // Word
-                seg->writeWord(MAR, RM);
+                seg->writeWord(MAR, static_cast<int32_t>(RM));
+                break;
+            case 3: // Doubleword (RV64 only)
+                seg->writeDouble(MAR, RM);
                 break;
             default:
                 break;
         }
+        noteStore(seg, MAR, 1u << memSize);
+    }
+}
+
+// =====================================================================
+// FP loads and stores: FLW NaN-boxes the word, FSW stores the low 32 bits
+// =====================================================================
+void fpMemoryInterface(bool memRead, bool memWrite, uint8_t memSize) {
+    MemSegment* seg = getMemSegmentForAddress(MAR);
+    if (!seg && (memRead || memWrite)) flightErrorDump(FLIGHT_MEM_FAULT, MAR, "invalid memory access");
+    if (!seg || seg == &mmioSegment) return; // Invalid memory segment; devices take integer accesses only
+    if (memProfiler.enabled) memProfiler.access(PC, MAR, memWrite);
+
+    if (memRead) {
+        FMDR = (memSize == 3) ? static_cast<uint64_t>(seg->readDouble(MAR))
+                              : boxSingle(static_cast<uint32_t>(seg->readWord(MAR)));
+    }
+    if (memWrite) {
+        if (memSize == 3) seg->writeDouble(MAR, static_cast<int64_t>(FB));
+        else seg->writeWord(MAR, static_cast<int32_t>(FB));
+        noteStore(seg, MAR, 1u << memSize);
+    }
+}
+
+// =====================================================================
+// Vector loads and stores: one element access per active element at
+// MAR + i * stride (RB holds the byte stride of vlse/vsse). Each element
+// must be naturally aligned; a misaligned one traps with its address.
+// =====================================================================
+void vectorMemoryInterface(bool memRead, bool memWrite, uint8_t memSize) {
+    const uint32_t bytes = 1u << memSize;
+    const ureg_t stride = vecMemStrided(IR) ? static_cast<ureg_t>(RB) : bytes;
+    uint8_t *group = V[d.rd];
+    for (uint32_t i = 0; i < csrFile.vl; i++) {
+        if (vecMasked(IR) && !vecMaskActive(V[0], i)) continue;
+        addr_t addr = static_cast<addr_t>(MAR + i * stride);
+        if (addr & (bytes - 1)) {
+            raiseTrap(memRead ? CAUSE_MISALIGNED_LOAD : CAUSE_MISALIGNED_STORE, static_cast<uint32_t>(addr));
+            SIM_LOG(LOG_MEMORY, LOG_INFO, "[Memory Access] Misaligned vector element at 0x" << std::hex << addr << std::dec << "\n");
+            return;
+        }
+        MemSegment* seg = getMemSegmentForAddress(addr);
+        if (!seg || seg == &mmioSegment) continue; // Invalid memory segment or device
+        for (uint32_t b = 0; b < bytes; b++) {
+            if (memRead) group[i * bytes + b] = static_cast<uint8_t>(seg->readByte(addr + b));
+            if (memWrite) seg->writeByte(addr + b, group[i * bytes + b]);
+        }
+        if (memWrite) noteStore(seg, addr, bytes);
     }
 }
 
+// =====================================================================
+// executeVectorInstruction: vsetvli and vector arithmetic run here, in
+// place on V; vsetvli and vmv.x.s leave their x result in RZ. Loads and
+// stores are only checked here and done in MEMORY_ACCESS.
+// =====================================================================
+void executeVectorInstruction() {
+    uint64_t xResult = 0;
+    if (!executeVector(d.id, IR, static_cast<uint64_t>(RA), &V[0][0], csrFile.vl, csrFile.vtype, xResult)) {
+        raiseTrap(CAUSE_ILLEGAL_INSTRUCTION, IR);
+        return;
+    }
+    RZ = static_cast<reg_t>(xResult);
+    MAR = static_cast<addr_t>(RA);
+    SIM_LOG(LOG_EXECUTE, LOG_DEBUG, "[Execute] Vector unit (" << vecKernelName() << "): vl=" << std::dec << csrFile.vl
+            << " vtype=0x" << std::hex << csrFile.vtype << std::dec << " RZ=" << RZ << "\n");
+}
+
+// =====================================================================
+// executeFPInstruction: F/D computational instructions. Integer sources come from
+// RA, integer results go to RZ; FP results stay in FZ.
+// =====================================================================
+void executeFPInstruction() {
+    uint64_t a = (d.fpFlags & INSTR_FLAG_FRS1) ? FA : static_cast<uint64_t>(static_cast<int64_t>(RA));
+    uint32_t rm = (d.fpFlags & INSTR_FLAG_RM) ? d.funct3 : static_cast<uint32_t>(RM_RNE);
+    if (!executeFP(d.id, rm, csrFile.frm, a, FB, FC, FZ, csrFile.fflags)) {
+        raiseTrap(CAUSE_ILLEGAL_INSTRUCTION, IR); // Reserved dynamic rounding mode
+        return;
+    }
+    if (!(d.fpFlags & INSTR_FLAG_FRD)) RZ = static_cast<reg_t>(FZ);
+    SIM_LOG(LOG_EXECUTE, LOG_DEBUG, "[Execute] FPU: result=0x" << std::hex << FZ << " fflags=0x" << csrFile.fflags << std::dec << "\n");
+}
+
 // =====================================================================
 // Define states for the multi-cycle implementation
 // =====================================================================
@@ -665,27 +1154,88 @@ enum State {
 // Initialize the state machine
 State currentState = FETCH;
 
+// Execution trace output (empty = disabled)
+std::string traceOutFile;
+TraceWriter traceWriter;
+
+// Commit log output, for --check-commits (empty = disabled)
+std::string commitLogFile;
+CommitLogWriter commitLog;
+
+// =====================================================================
+// parseKnobArgs: read --name=value options after the .mc arguments.
+// Returns false after reporting an option value it cannot use.
+// =====================================================================
+bool parseKnobArgs(int argc, char* argv[]) {
+    for (int i = FIRST_OPTION_ARG; i < argc; i++) {
+        std::string value;
+        if (matchOption(argv[i], "trace-out", value)) traceOutFile = value;
+        if (matchOption(argv[i], "mem-profile", value)) memProfileFile = value;
+        if (matchOption(argv[i], "commit-log", value)) commitLogFile = value;
+        if (matchOption(argv[i], "host-profile", value)) hostProfiler.enabled = optionBool(value);
+        if (matchOption(argv[i], "host-counters", value)) hostProfiler.enabled |= (hostProfiler.counters = optionBool(value));
+        if (matchOption(argv[i], "progress", value)) hostProfiler.progressSeconds = std::strtod(value.c_str(), nullptr);
+        if (matchOption(argv[i], "flight-records", value)) flightRecords = static_cast<uint32_t>(optionNumber(value));
+        if (matchOption(argv[i], "flight-file", value)) flightFile = value;
+        if (matchOption(argv[i], "log", value) && !simLog.configure(value)) {
+            std::cerr << "ERROR: Invalid option " << argv[i] << "\n";
+            return false;
+        }
+        if (matchOption(argv[i], "log-file", value)) logFile = value;
+        if (matchOption(argv[i], "sandbox", value)) syscalls.sandboxDir = value;
+        if (matchOption(argv[i], "uart-in", value)) devices.uartInputFile = value;
+        if (matchOption(argv[i], "uart-tx-cycles", value)) devices.uartTxCycles = static_cast<uint32_t>(optionNumber(value));
+        if (matchOption(argv[i], "dma-bytes-per-cycle", value)) devices.dmaBytesPerCycle = static_cast<uint32_t>(optionNumber(value));
+    }
+    return true;
+}
+
 // =====================================================================
 // main
 // =====================================================================
 int simulate(int argc, char* argv[]) {
     if (argc < 2) {
-        std::cerr << "Usage: " << argv[0] << " <input.mc>\n";
+        std::cerr << "Usage: " << argv[0] << " <input.mc | program.elf>\n";
         return 1;
     }
 
+    if (!parseKnobArgs(argc, argv)) {
+        return 1;
+    }
     std::string inputFile = argv[1];
-    if (!parseInputMC(inputFile)) {
+    if (isElfFile(inputFile) ? !loadElf(inputFile) : !parseInputMC(inputFile)) {
+        return 1;
+    }
+    if (!traceOutFile.empty() && !traceWriter.open(traceOutFile)) {
         return 1;
     }
+    if (!logFile.empty() && !simLog.openFile(logFile)) {
+        return 1;
+    }
+    if (!commitLogFile.empty() && !commitLog.open(commitLogFile)) {
+        return 1;
+    }
+    memProfiler.enabled = !memProfileFile.empty();
+    flight.configure(flightRecords, flightFile);
+    flight.installSignalHandlers(&clockCycle);
 
     // Initialize registers and memory
     for (int i = 0; i < NUM_REGS; i++) {
         R[i] = 0;
+        F[i] = 0;
+        std::fill(V[i], V[i] + VLENB, 0);
     }
     R[2] = 0x7FFFFFFC; // stack pointer
-    PC = 0;
+    PC = programEntry;
     clockCycle = 0;
+    bindCSRCounters();
+    initSyscallHeap();
+    GuestMemory dmaPort;
+    devices.readMemory = [dmaPort](uint64_t addr, uint8_t &value) mutable { return dmaPort.readByte(addr, value); };
+    devices.writeMemory = [dmaPort](uint64_t addr, uint8_t value) mutable { return dmaPort.writeByte(addr, value); };
+    if (!devices.attach(&csrFile.mip, &clockCycle)) {
+        return 1;
+    }
 
     // Dump initial contents to files
     dumpInstructionMemoryToFile("instruction.mc");
@@ -708,28 +1258,43 @@ int simulate(int argc, char* argv[]) {
 
     std::cout << "Starting simulation...\n";
 
+    hostProfiler.beginRun();
     while (currentState != HALT) {
-        std::cout << "Clock Cycle: " << clockCycle << "\n";
+        SIM_LOG(LOG_CYCLE, LOG_DEBUG, "Clock Cycle: " << clockCycle << "\n");
+        hostProfiler.progress(clockCycle, totalInstructions);
 
         // Increment total cycles
         totalCycles++;
+        devices.tick(clockCycle);
 
         switch (currentState) {
             case FETCH: {
-                std::cout << "[Fetch] Current PC: 0x" << std::hex << PC << std::dec << "\n";
-                auto it = instrMemory.find(PC);
-                if (it == instrMemory.end()) {
-                    std::cout << "[Fetch] No instruction at PC=0x" 
-                              << std::hex << PC << ". Exiting.\n";
+                SIM_LOG(LOG_FETCH, LOG_TRACE, "[Fetch] Current PC: 0x" << std::hex << PC << std::dec << "\n");
+                // Interrupts are taken between instructions, in place of a fetch
+                if (uint32_t irq = csrFile.pendingInterrupt()) {
+                    interruptsTaken++;
+                    flight.event(clockCycle, FLIGHT_INTERRUPT, PC, irq);
+                    PC = csrFile.enterTrap(irq, PC, 0);
+                    SIM_LOG(LOG_TRAP, LOG_INFO, "[Fetch] Interrupt " << (irq & ~CAUSE_INTERRUPT) << ": entering handler at 0x"
+                            << std::hex << PC << std::dec << "\n");
+                    break;
+                }
+                uint32_t parcel = 0;
+                if (!fetchParcel(PC, parcel)) {
+                    SIM_LOG(LOG_FETCH, LOG_ERROR, "[Fetch] No instruction at PC=0x"
+                            << std::hex << PC << ". Exiting.\n");
+                    flightErrorDump(FLIGHT_FETCH_FAULT, 0, "missing instruction");
                     currentState = HALT;
                     break;
                 }
-                IR = it->second;
-                std::cout << "[Fetch] PC=0x" << std::hex << PC 
-                          << " IR=0x" << IR << std::dec << "\n";
-
-                if (isTerminationInstr(IR)) {
-                    std::cout << "[Fetch] Encountered 0x00000000 => stop.\n";
+                rawIR = parcel;
+                instrLen = instrLength(rawIR);
+                IR = expandParcel(rawIR, XLEN == 64);
+                SIM_LOG(LOG_FETCH, LOG_DEBUG, "[Fetch] PC=0x" << std::hex << PC
+                        << " IR=0x" << IR << std::dec << "\n");
+
+                if (isTerminationInstr(rawIR)) {
+                    SIM_LOG(LOG_FETCH, LOG_DEBUG, "[Fetch] Encountered 0x00000000 => stop.\n");
                     currentState = HALT;
                 } else {
                     // PC += 4; // Increment PC by 4 unless explicitly modified
@@ -738,129 +1303,305 @@ int simulate(int argc, char* argv[]) {
             } break;
 
             case DECODE: {
-                std::cout << "[Decode] Current PC: 0x" << std::hex << PC << std::dec << "\n";
+                SIM_LOG(LOG_DECODE, LOG_TRACE, "[Decode] Current PC: 0x" << std::hex << PC << std::dec << "\n");
                 if (IR == 0) {
-                    std::cout << "[Decode] Nothing to perform.\n";
+                    SIM_LOG(LOG_DECODE, LOG_TRACE, "[Decode] Nothing to perform.\n");
                 } else {
                     d = decode(IR);
-                    std::cout << "[Decode] opcode=0x" << std::hex << d.opcode
-                              << " rd=" << d.rd << " rs1=" << d.rs1 
-                              << " rs2=" << d.rs2 
-                              << " funct3=0x" << d.funct3
-                              << " funct7=0x" << d.funct7 
-                              << " imm=" << std::dec << d.imm << "\n";
-
-                    controlCircuitry(d.opcode, d.funct3, d.funct7);
+                    SIM_LOG(LOG_DECODE, LOG_DEBUG, "[Decode] opcode=0x" << std::hex << d.opcode
+                            << " rd=" << d.rd << " rs1=" << d.rs1
+                            << " rs2=" << d.rs2
+                            << " funct3=0x" << d.funct3
+                            << " funct7=0x" << d.funct7
+                            << " imm=" << std::dec << d.imm << "\n");
+
+                    controlCircuitry(d);
+                    if (d.id == INSTR_INVALID) {
+                        raiseTrap(CAUSE_ILLEGAL_INSTRUCTION, rawIR);
+                    }
 
-                    RA = R[d.rs1];
+                    RA = (d.opcode == 0x17) ? static_cast<reg_t>(PC)     // AUIPC uses PC
+                       : (d.opcode == 0x37) ? 0 : R[d.rs1];
                     // Corrected logic for RB: Use immediate for I-type instructions, otherwise use rs2
-                    RB = (d.opcode == 0x13 || d.opcode == 0x03 || d.opcode == 0x67 || d.opcode == 0x23) ? d.imm : R[d.rs2];
+                    RB = (d.opcode == 0x13 || d.opcode == 0x1B || d.opcode == 0x03 || d.opcode == 0x67 || d.opcode == 0x23 ||
+                          d.opcode == 0x37 || d.opcode == 0x17 || d.opcode == 0x07 || d.opcode == 0x27) ? d.imm : R[d.rs2];
                     RM = R[d.rs2];
-                    std::cout << "[Decode] RA=" << RA << " RB=" << RB << " RM=" << RM << "\n";
+                    if (vecOp) RB = R[d.rs2]; // Vector stride; the vs1/simm5 field is read by the vector unit
+                    FA = F[d.rs1];
+                    FB = F[d.rs2];
+                    FC = F[d.rs3];
+                    SIM_LOG(LOG_DECODE, LOG_DEBUG, "[Decode] RA=" << RA << " RB=" << RB << " RM=" << RM << "\n");
                 }
                 currentState = EXECUTE;
             } break;
 
             case EXECUTE: {
-                std::cout << "[Execute] Current PC: 0x" << std::hex << PC << std::dec << "\n";
-                if (aluOp == ALU_PASS && !branch && !jump) {
-                    std::cout << "[Execute] Nothing to perform.\n";
+                SIM_LOG(LOG_EXECUTE, LOG_DEBUG, "[Execute] Current PC: 0x" << std::hex << PC << std::dec << "\n");
+                if (trapPending) {
+                    SIM_LOG(LOG_EXECUTE, LOG_DEBUG, "[Execute] Trap pending. Nothing to perform.\n");
+                } else if (d.opcode == 0x73) {
+                    executeSystem();
+                } else if (vecOp) {
+                    executeVectorInstruction();
+                } else if (fpOp) {
+                    executeFPInstruction();
+                } else if (d.id == INSTR_FENCE_I) {
+                    // Every fetch reads memory, so nothing fetched ahead needs discarding
+                    fenceIInstructions++;
+                    SIM_LOG(LOG_EXECUTE, LOG_INFO, "[Execute] FENCE.I: no fetched instructions to discard.\n");
+                } else if (aluOp == ALU_PASS && !regWrite && !branch && !jump) {
+                    SIM_LOG(LOG_EXECUTE, LOG_DEBUG, "[Execute] Nothing to perform.\n");
                 } else {
+                    // RV64 *W instructions work on the low 32 bits (zero-extended
+                    // for the unsigned ops) and sign-extend their result
+                    if (wordOp) {
+                        bool isUnsigned = (aluOp == ALU_SRL || aluOp == ALU_DIVU || aluOp == ALU_REMU);
+                        RA = isUnsigned ? static_cast<reg_t>(static_cast<uint32_t>(RA)) : static_cast<reg_t>(static_cast<int32_t>(RA));
+                        RB = isUnsigned ? static_cast<reg_t>(static_cast<uint32_t>(RB)) : static_cast<reg_t>(static_cast<int32_t>(RB));
+                    }
+                    const ureg_t uRA = static_cast<ureg_t>(RA);
+                    const ureg_t uRB = static_cast<ureg_t>(RB);
+                    const int width = wordOp ? 32 : XLEN;
+                    const unsigned shamt = static_cast<unsigned>(uRB & (width - 1));
                     switch (aluOp) {
                         case ALU_ADD:
-                            RZ = RA + RB;
-                            std::cout << "[Execute] ALU_ADD: " << RA << " + " << RB << " = " << RZ << "\n";
+                            RZ = static_cast<reg_t>(uRA + uRB);
+                            SIM_LOG(LOG_EXECUTE, LOG_DEBUG, "[Execute] ALU_ADD: " << RA << " + " << RB << " = " << RZ << "\n");
                             break;
                         case ALU_SUB:
-                            RZ = RA - RB;
-                            std::cout << "[Execute] ALU_SUB: " << RA << " - " << RB << " = " << RZ << "\n";
+                            RZ = static_cast<reg_t>(uRA - uRB);
+                            SIM_LOG(LOG_EXECUTE, LOG_DEBUG, "[Execute] ALU_SUB: " << RA << " - " << RB << " = " << RZ << "\n");
                             break;
                         case ALU_MUL:
-                            RZ = RA * RB;
-                            std::cout << "[Execute] ALU_MUL: " << RA << " * " << RB << " = " << RZ << "\n";
+                            RZ = static_cast<reg_t>(uRA * uRB);
+                            SIM_LOG(LOG_EXECUTE, LOG_DEBUG, "[Execute] ALU_MUL: " << RA << " * " << RB << " = " << RZ << "\n");
+                            break;
+                        case ALU_MULH:
+                            RZ = mulHighSigned(RA, RB);
+                            SIM_LOG(LOG_EXECUTE, LOG_DEBUG, "[Execute] ALU_MULH: high(" << RA << " * " << RB << ") = " << RZ << "\n");
+                            break;
+                        case ALU_MULHSU:
+                            RZ = mulHighSignedUnsigned(RA, RB);
+                            SIM_LOG(LOG_EXECUTE, LOG_DEBUG, "[Execute] ALU_MULHSU: high(" << RA << " * " << uRB << ") = " << RZ << "\n");
                             break;
+                        case ALU_MULHU:
+                            RZ = mulHighUnsigned(RA, RB);
+                            SIM_LOG(LOG_EXECUTE, LOG_DEBUG, "[Execute] ALU_MULHU: high(" << uRA << " * " << uRB << ") = " << RZ << "\n");
+                            break;
+                        // Division by zero and overflow follow the RISC-V results instead of trapping
                         case ALU_DIV:
-                            RZ = (RB != 0) ? RA / RB : 0;
-                            std::cout << "[Execute] ALU_DIV: " << RA << " / " << RB << " = " << RZ << "\n";
+                            RZ = (RB == 0) ? -1 : (RA == REG_MIN && RB == -1) ? REG_MIN : RA / RB;
+                            SIM_LOG(LOG_EXECUTE, LOG_DEBUG, "[Execute] ALU_DIV: " << RA << " / " << RB << " = " << RZ << "\n");
                             break;
                         case ALU_REM:
-                            RZ = (RB != 0) ? RA % RB : 0;
-                            std::cout << "[Execute] ALU_REM: " << RA << " % " << RB << " = " << RZ << "\n";
+                            RZ = (RB == 0) ? RA : (RA == REG_MIN && RB == -1) ? 0 : RA % RB;
+                            SIM_LOG(LOG_EXECUTE, LOG_DEBUG, "[Execute] ALU_REM: " << RA << " % " << RB << " = " << RZ << "\n");
+                            break;
+                        case ALU_DIVU:
+                            RZ = (RB == 0) ? -1 : static_cast<reg_t>(uRA / uRB);
+                            SIM_LOG(LOG_EXECUTE, LOG_DEBUG, "[Execute] ALU_DIVU: " << uRA << " / " << uRB << " = " << static_cast<ureg_t>(RZ) << "\n");
+                            break;
+                        case ALU_REMU:
+                            RZ = (RB == 0) ? RA : static_cast<reg_t>(uRA % uRB);
+                            SIM_LOG(LOG_EXECUTE, LOG_DEBUG, "[Execute] ALU_REMU: " << uRA << " % " << uRB << " = " << static_cast<ureg_t>(RZ) << "\n");
                             break;
                         case ALU_AND:
                             RZ = RA & RB;
-                            std::cout << "[Execute] ALU_AND: " << RA << " & " << RB << " = " << RZ << "\n";
+                            SIM_LOG(LOG_EXECUTE, LOG_DEBUG, "[Execute] ALU_AND: " << RA << " & " << RB << " = " << RZ << "\n");
                             break;
                         case ALU_OR:
                             RZ = RA | RB;
-                            std::cout << "[Execute] ALU_OR: " << RA << " | " << RB << " = " << RZ << "\n";
+                            SIM_LOG(LOG_EXECUTE, LOG_DEBUG, "[Execute] ALU_OR: " << RA << " | " << RB << " = " << RZ << "\n");
                             break;
                         case ALU_XOR:
                             RZ = RA ^ RB;
-                            std::cout << "[Execute] ALU_XOR: " << RA << " ^ " << RB << " = " << RZ << "\n";
+                            SIM_LOG(LOG_EXECUTE, LOG_DEBUG, "[Execute] ALU_XOR: " << RA << " ^ " << RB << " = " << RZ << "\n");
                             break;
                         case ALU_SLL:
-                            RZ = RA << (RB & 0x1F);
-                            std::cout << "[Execute] ALU_SLL: " << RA << " << " << (RB & 0x1F) << " = " << RZ << "\n";
+                            RZ = static_cast<reg_t>(uRA << shamt);
+                            SIM_LOG(LOG_EXECUTE, LOG_DEBUG, "[Execute] ALU_SLL: " << RA << " << " << shamt << " = " << RZ << "\n");
                             break;
                         case ALU_SRL:
-                            RZ = static_cast<int32_t>(static_cast<uint32_t>(RA) >> (RB & 0x1F));
-                            std::cout << "[Execute] ALU_SRL: " << RA << " >> " << (RB & 0x1F) << " = " << RZ << "\n";
+                            RZ = static_cast<reg_t>(uRA >> shamt);
+                            SIM_LOG(LOG_EXECUTE, LOG_DEBUG, "[Execute] ALU_SRL: " << RA << " >> " << shamt << " = " << RZ << "\n");
                             break;
                         case ALU_SRA:
-                            RZ = RA >> (RB & 0x1F);
-                            std::cout << "[Execute] ALU_SRA: " << RA << " >> " << (RB & 0x1F) << " (arithmetic) = " << RZ << "\n";
+                            RZ = RA >> shamt;
+                            SIM_LOG(LOG_EXECUTE, LOG_DEBUG, "[Execute] ALU_SRA: " << RA << " >> " << shamt << " (arithmetic) = " << RZ << "\n");
                             break;
                         case ALU_SLT:
                             RZ = (RA < RB) ? 1 : 0;
-                            std::cout << "[Execute] ALU_SLT: " << RA << " < " << RB << " = " << RZ << "\n";
+                            SIM_LOG(LOG_EXECUTE, LOG_DEBUG, "[Execute] ALU_SLT: " << RA << " < " << RB << " = " << RZ << "\n");
                             break;
                         case ALU_EQ:
                             RZ = (RA == RB) ? 1 : 0;
-                            std::cout << "[Execute] ALU_EQ: " << RA << " == " << RB << " = " << RZ << "\n";
+                            SIM_LOG(LOG_EXECUTE, LOG_DEBUG, "[Execute] ALU_EQ: " << RA << " == " << RB << " = " << RZ << "\n");
                             break;
                         case ALU_GE:
                             RZ = (RA >= RB) ? 1 : 0;
-                            std::cout << "[Execute] ALU_GE: " << RA << " >= " << RB << " = " << RZ << "\n";
+                            SIM_LOG(LOG_EXECUTE, LOG_DEBUG, "[Execute] ALU_GE: " << RA << " >= " << RB << " = " << RZ << "\n");
+                            break;
+                        case ALU_SLTU:
+                            RZ = (uRA < uRB) ? 1 : 0;
+                            SIM_LOG(LOG_EXECUTE, LOG_DEBUG, "[Execute] ALU_SLTU: " << uRA << " < " << uRB << " = " << RZ << "\n");
+                            break;
+                        case ALU_GEU:
+                            RZ = (uRA >= uRB) ? 1 : 0;
+                            SIM_LOG(LOG_EXECUTE, LOG_DEBUG, "[Execute] ALU_GEU: " << uRA << " >= " << uRB << " = " << RZ << "\n");
                             break;
                         case ALU_PASS:
                             RZ = RB;
-                            std::cout << "[Execute] ALU_PASS: Passing " << RB << " as RZ = " << RZ << "\n";
+                            SIM_LOG(LOG_EXECUTE, LOG_DEBUG, "[Execute] ALU_PASS: Passing " << RB << " as RZ = " << RZ << "\n");
+                            break;
+                        case ALU_SH1ADD: case ALU_SH2ADD: case ALU_SH3ADD: {
+                            unsigned n = 1 + (aluOp - ALU_SH1ADD);
+                            RZ = static_cast<reg_t>((uRA << n) + uRB);
+                            SIM_LOG(LOG_EXECUTE, LOG_DEBUG, "[Execute] ALU_SH" << n << "ADD: (" << RA << " << " << n << ") + " << RB << " = " << RZ << "\n");
+                            break;
+                        }
+                        case ALU_ANDN:
+                            RZ = RA & ~RB;
+                            SIM_LOG(LOG_EXECUTE, LOG_DEBUG, "[Execute] ALU_ANDN: " << RA << " & ~" << RB << " = " << RZ << "\n");
+                            break;
+                        case ALU_ORN:
+                            RZ = RA | ~RB;
+                            SIM_LOG(LOG_EXECUTE, LOG_DEBUG, "[Execute] ALU_ORN: " << RA << " | ~" << RB << " = " << RZ << "\n");
+                            break;
+                        case ALU_XNOR:
+                            RZ = ~(RA ^ RB);
+                            SIM_LOG(LOG_EXECUTE, LOG_DEBUG, "[Execute] ALU_XNOR: ~(" << RA << " ^ " << RB << ") = " << RZ << "\n");
+                            break;
+                        case ALU_MIN:
+                            RZ = (RA < RB) ? RA : RB;
+                            SIM_LOG(LOG_EXECUTE, LOG_DEBUG, "[Execute] ALU_MIN: min(" << RA << ", " << RB << ") = " << RZ << "\n");
+                            break;
+                        case ALU_MINU:
+                            RZ = static_cast<reg_t>((uRA < uRB) ? uRA : uRB);
+                            SIM_LOG(LOG_EXECUTE, LOG_DEBUG, "[Execute] ALU_MINU: minu(" << uRA << ", " << uRB << ") = " << static_cast<ureg_t>(RZ) << "\n");
+                            break;
+                        case ALU_MAX:
+                            RZ = (RA > RB) ? RA : RB;
+                            SIM_LOG(LOG_EXECUTE, LOG_DEBUG, "[Execute] ALU_MAX: max(" << RA << ", " << RB << ") = " << RZ << "\n");
+                            break;
+                        case ALU_MAXU:
+                            RZ = static_cast<reg_t>((uRA > uRB) ? uRA : uRB);
+                            SIM_LOG(LOG_EXECUTE, LOG_DEBUG, "[Execute] ALU_MAXU: maxu(" << uRA << ", " << uRB << ") = " << static_cast<ureg_t>(RZ) << "\n");
+                            break;
+                        case ALU_ROL:
+                            RZ = rotateLeft(uRA, shamt, width);
+                            SIM_LOG(LOG_EXECUTE, LOG_DEBUG, "[Execute] ALU_ROL: " << RA << " rol " << shamt << " = " << RZ << "\n");
+                            break;
+                        case ALU_ROR:
+                            RZ = rotateRight(uRA, shamt, width);
+                            SIM_LOG(LOG_EXECUTE, LOG_DEBUG, "[Execute] ALU_ROR: " << RA << " ror " << shamt << " = " << RZ << "\n");
+                            break;
+                        case ALU_CLZ:
+                            RZ = countLeadingZeros(uRA, width);
+                            SIM_LOG(LOG_EXECUTE, LOG_DEBUG, "[Execute] ALU_CLZ: clz(" << uRA << ") = " << RZ << "\n");
+                            break;
+                        case ALU_CTZ:
+                            RZ = countTrailingZeros(uRA, width);
+                            SIM_LOG(LOG_EXECUTE, LOG_DEBUG, "[Execute] ALU_CTZ: ctz(" << uRA << ") = " << RZ << "\n");
+                            break;
+                        case ALU_CPOP:
+                            RZ = countOnes(uRA, width);
+                            SIM_LOG(LOG_EXECUTE, LOG_DEBUG, "[Execute] ALU_CPOP: cpop(" << uRA << ") = " << RZ << "\n");
+                            break;
+                        case ALU_SEXTB:
+                            RZ = static_cast<int8_t>(RA);
+                            SIM_LOG(LOG_EXECUTE, LOG_DEBUG, "[Execute] ALU_SEXTB: sext.b(" << RA << ") = " << RZ << "\n");
+                            break;
+                        case ALU_SEXTH:
+                            RZ = static_cast<int16_t>(RA);
+                            SIM_LOG(LOG_EXECUTE, LOG_DEBUG, "[Execute] ALU_SEXTH: sext.h(" << RA << ") = " << RZ << "\n");
+                            break;
+                        case ALU_REV8:
+                            RZ = byteReverse(uRA);
+                            SIM_LOG(LOG_EXECUTE, LOG_DEBUG, "[Execute] ALU_REV8: rev8(0x" << std::hex << uRA << ") = 0x" << static_cast<ureg_t>(RZ) << std::dec << "\n");
+                            break;
+                        case ALU_ORCB:
+                            RZ = orCombineBytes(uRA);
+                            SIM_LOG(LOG_EXECUTE, LOG_DEBUG, "[Execute] ALU_ORCB: orc.b(0x" << std::hex << uRA << ") = 0x" << static_cast<ureg_t>(RZ) << std::dec << "\n");
                             break;
                         default:
-                            std::cout << "[Execute] Unknown ALU operation.\n";
+                            SIM_LOG(LOG_EXECUTE, LOG_DEBUG, "[Execute] Unknown ALU operation.\n");
                             break;
                     }
+                    if (wordOp) RZ = static_cast<int32_t>(RZ);
 
                     d.zero = (RZ == 0);
                     if (branch || jump) {
-                        std::cout << "[Execute] Branch or jump detected. Delaying PC update to WRITE_BACK stage.\n";
+                        SIM_LOG(LOG_EXECUTE, LOG_DEBUG, "[Execute] Branch or jump detected. Delaying PC update to WRITE_BACK stage.\n");
                     }
                     MAR = RZ;
-                    std::cout << "[Execute] RZ=" << RZ << "\n";
+                    SIM_LOG(LOG_EXECUTE, LOG_DEBUG, "[Execute] RZ=" << RZ << "\n");
                 }
                 currentState = MEMORY_ACCESS;
             } break;
 
             case MEMORY_ACCESS: {
-                std::cout << "[Memory Access] Current PC: 0x" << std::hex << PC << std::dec << "\n";
-                if (!memRead && !memWrite) {
-                    std::cout << "[Memory Access] Nothing to perform.\n";
+                SIM_LOG(LOG_MEMORY, LOG_TRACE, "[Memory Access] Current PC: 0x" << std::hex << PC << std::dec << "\n");
+                if (trapPending || (!memRead && !memWrite)) {
+                    SIM_LOG(LOG_MEMORY, LOG_TRACE, "[Memory Access] Nothing to perform.\n");
+                } else if (vecOp) {
+                    SIM_LOG(LOG_MEMORY, LOG_DEBUG, "[Memory Access] Vector " << (memRead ? "load" : "store") << " of " << csrFile.vl
+                            << " elements from MAR=0x" << std::hex << MAR << std::dec << "\n");
+                    vectorMemoryInterface(memRead, memWrite, memSize);
+                } else if (MAR & ((1u << memSize) - 1)) {
+                    raiseTrap(memRead ? CAUSE_MISALIGNED_LOAD : CAUSE_MISALIGNED_STORE, MAR);
+                    SIM_LOG(LOG_MEMORY, LOG_INFO, "[Memory Access] Misaligned access at MAR=0x" << std::hex << MAR << std::dec << "\n");
                 } else {
-                    std::cout << "[Memory Access] Accessing memory for load/store operations.\n";
-                    memoryProcessorInterface(memRead, memWrite, memSize);
-                    std::cout << "[Memory Access] MAR=" << MAR << " MDR=" << MDR << "\n";
+                    SIM_LOG(LOG_MEMORY, LOG_TRACE, "[Memory Access] Accessing memory for load/store operations.\n");
+                    if (d.opcode == 0x07 || d.opcode == 0x27) {
+                        fpMemoryInterface(memRead, memWrite, memSize);
+                    } else {
+                        memoryProcessorInterface(memRead, memWrite, memSize);
+                    }
+                    SIM_LOG(LOG_MEMORY, LOG_DEBUG, "[Memory Access] MAR=" << MAR << " MDR=" << MDR << "\n");
                 }
                 currentState = WRITE_BACK;
             } break;
 
             case WRITE_BACK: {
-                std::cout << "[Write Back] Current PC: 0x" << std::hex << PC << std::dec << "\n";
-                iag.updatePC(jump, branch, d.zero, d.imm, RZ);
+                SIM_LOG(LOG_WRITEBACK, LOG_TRACE, "[Write Back] Current PC: 0x" << std::hex << PC << std::dec << "\n");
+                if (trapPending) {
+                    trapPending = false;
+                    trapsTaken++;
+                    flight.event(clockCycle, FLIGHT_TRAP, PC, trapCause, trapValue);
+                    uint32_t handler = csrFile.enterTrap(trapCause, PC, trapValue);
+                    std::string where = symbolize(programSymbols, PC);
+                    SIM_LOG(LOG_TRAP, LOG_INFO, "[Write Back] Trap cause=" << trapCause << " at PC=0x" << std::hex << PC
+                            << (where.empty() ? "" : " <" + where + ">")
+                            << " tval=0x" << trapValue << std::dec << "\n");
+                    if (handler == 0) {
+                        SIM_LOG(LOG_TRAP, LOG_INFO, "[Write Back] No trap handler installed (mtvec=0). Exiting.\n");
+                        currentState = HALT;
+                    } else {
+                        PC = handler;
+                        currentState = FETCH;
+                    }
+                    break;
+                }
+                addr_t retiredPC = PC;
+                if (mretPending) {
+                    mretPending = false;
+                    jump = true; // Counted as a control instruction
+                    PC = csrFile.returnFromTrap();
+                    iag.PCtemp = retiredPC + instrLen;
+                } else {
+                    iag.updatePC(jump, branch, d.zero, d.imm, RZ);
+                }
+                if (traceWriter.isOpen()) {
+                    uint32_t memAddr = (d.id == INSTR_VSETVLI) ? csrFile.vl : (memRead || memWrite) ? MAR : 0;
+                    traceWriter.append(retiredPC, rawIR, memAddr, PC);
+                }
                 if (!regWrite) {
-                    std::cout << "[Write Back] Nothing to perform.\n";
+                    SIM_LOG(LOG_WRITEBACK, LOG_TRACE, "[Write Back] Nothing to perform.\n");
+                } else if (d.fpFlags & INSTR_FLAG_FRD) {
+                    F[d.rd] = (memToReg == 1) ? FMDR : FZ;
+                    SIM_LOG(LOG_WRITEBACK, LOG_DEBUG, "[Write Back] F[" << d.rd << "]=0x" << std::hex << F[d.rd] << std::dec << "\n");
                 } else {
-                    std::cout << "[Write Back] Writing results back to the register file.\n";
+                    SIM_LOG(LOG_WRITEBACK, LOG_TRACE, "[Write Back] Writing results back to the register file.\n");
                     if (memToReg == 1) {
                         RY = MDR;
                     } else if (memToReg == 2) {
@@ -869,11 +1610,28 @@ int simulate(int argc, char* argv[]) {
                         RY = RZ;
                     }
                     R[d.rd] = RY;
-                    std::cout << "[Write Back] RY=" << RY << "\n";
+                    SIM_LOG(LOG_WRITEBACK, LOG_DEBUG, "[Write Back] RY=" << RY << "\n");
                 }
                 R[0] = 0; // x0 always 0
+                if (flight.enabled()) {
+                    bool fpRd = (d.fpFlags & INSTR_FLAG_FRD) != 0;
+                    uint8_t rd = fpRd ? d.rd + 32 : d.rd;
+                    flight.retire(clockCycle, retiredPC, IR, (regWrite && rd != 0) ? rd : FLIGHT_NO_RD,
+                                  fpRd ? F[d.rd] : static_cast<ureg_t>(RY), (memRead || memWrite) ? MAR : 0);
+                }
+                if (commitLog.isOpen()) {
+                    bool fpRd = (d.fpFlags & INSTR_FLAG_FRD) != 0;
+                    bool store = memWrite && !vecOp;
+                    commitLog.append(retiredPC, IR, !regWrite ? COMMIT_NO_RD : fpRd ? d.rd + 32 : d.rd,
+                                     fpRd ? F[d.rd] : static_cast<ureg_t>(RY), MAR, store ? 1u << memSize : 0,
+                                     (d.opcode == 0x27) ? FB : static_cast<ureg_t>(RM));
+                }
 
                 totalInstructions++; // Increment total instructions executed
+                fetchedCodeBytes += instrLen;
+                if (instrLen == 2) {
+                    compressedInstructions++;
+                }
                 if (memRead || memWrite) {
                     dataTransferInstructions++; // Increment data-transfer instructions
                 } else if (branch || jump) {
@@ -889,7 +1647,7 @@ int simulate(int argc, char* argv[]) {
                 dumpSegmentToFile("data.mc", dataSegment, 0x10000000, 0x7FFFFFFF);
                 dumpSegmentToFile("stack.mc", stackSegment, 0x7FFFFFFF, 0xFFFFFFFF);
 
-                currentState = FETCH;
+                currentState = syscalls.exited ? HALT : FETCH;
             } break;
 
             case HALT:
@@ -910,6 +1668,10 @@ int simulate(int argc, char* argv[]) {
             }
         }
     }
+    hostProfiler.endRun(totalInstructions, clockCycle);
+    syscalls.flush(); // Guest output before the report
+    devices.flush();
+    hostProfiler.enter(HOST_PRINT);
 
     // Print statistics at the end of the simulation
     std::cout << "\n================ Simulation Statistics ================\n";
@@ -927,8 +1689,55 @@ int simulate(int argc, char* argv[]) {
     std::cout << "Stat11: Number of stalls due to data hazards = " << std::dec << dataHazardStalls << "\n";
     std::cout << "Stat12: Number of stalls due to control hazards = " << std::dec << controlHazardStalls << "\n";
     std::cout << "=======================================================\n";
+    if (trapsTaken > 0) {
+        std::cout << "Traps taken = " << trapsTaken << " (last mcause=" << csrFile.mcause
+                  << ", mepc=0x" << std::hex << csrFile.mepc << std::dec << ")\n";
+    }
+    if (interruptsTaken > 0) {
+        std::cout << "Interrupts taken = " << interruptsTaken << " (entry: 1 cycle each)\n";
+    }
+    devices.printStatistics();
+    if (codeStores > 0 || fenceIInstructions > 0) {
+        std::cout << "Self-modifying code: stores to fetched code = " << codeStores
+                  << ", parcels invalidated = " << codeParcelsInvalidated << ", refetched = " << codeRefills
+                  << ", FENCE.I = " << fenceIInstructions << "\n";
+    }
+    if (syscalls.calls > 0) {
+        std::cout << "System calls = " << syscalls.calls;
+        if (syscalls.exited) std::cout << " (exit code " << syscalls.exitCode << ")";
+        std::cout << "\n";
+    }
+
+    if (compressedInstructions > 0) {
+        std::cout << "Compressed instructions = " << compressedInstructions << " of " << totalInstructions
+                  << ", dynamic code size = " << fetchedCodeBytes << " bytes ("
+                  << std::fixed << std::setprecision(1)
+                  << 100.0 * (4.0 * totalInstructions - fetchedCodeBytes) / (4.0 * totalInstructions)
+                  << "% smaller than 4-byte encodings)\n";
+    }
 
     std::cout << "Simulation finished after " << clockCycle << " cycles.\n";
+    if (traceWriter.isOpen()) {
+        traceWriter.close();
+        std::cout << "Execution trace written to " << traceOutFile << "\n";
+    }
+    if (commitLog.isOpen()) {
+        commitLog.close();
+        std::cout << "Commit log written to " << commitLogFile << "\n";
+    }
+    if (simLog.toFile()) {
+        simLog.close();
+        std::cout << "Log written to " << logFile << "\n";
+    }
+    if (memProfiler.enabled) {
+        memProfiler.printSummary(std::cout);
+        if (memProfiler.writeBinary(memProfileFile)) std::cout << "Memory profile written to " << memProfileFile << "\n";
+    }
+    if (flight.enabled() && !flightFile.empty()) {
+        if (!flightErrorDumped) flight.dump("halt", clockCycle);
+        std::cout << "Flight recorder written to " << flightFile << "\n";
+    }
+    hostProfiler.printReport(std::cout);
     return 0;
 }
 }
\ No newline at end of file
@@ -0,0 +1,195 @@
+#include "CType.h"
+#include "Utils.h"
+#include <sstream>
+#include <utility>
+
+// x8-x15, the registers reachable from the 3-bit fields
+static bool isCReg(int r) { return r >= 8 && r <= 15; }
+
+static bool fitsSigned(int32_t v, int bits) {
+    return v >= -(1 << (bits - 1)) && v < (1 << (bits - 1));
+}
+
+static uint32_t bits(int32_t v, int hi, int lo) {
+    return ((uint32_t)v >> lo) & ((1u << (hi - lo + 1)) - 1);
+}
+
+// CI format: funct3, rd/rs1, imm[5] in bit 12, imm[4:0] in bits 6:2
+static uint16_t encodeCI(uint32_t f3, int rd, int32_t imm, uint32_t op) {
+    return (uint16_t)((f3 << 13) | (bits(imm, 5, 5) << 12) | ((uint32_t)rd << 7) |
+                      (bits(imm, 4, 0) << 2) | op);
+}
+
+// CL/CS formats with a word (scale 4) or doubleword (scale 8) offset
+static uint16_t encodeCLS(uint32_t f3, int rs1, int rdOrRs2, int32_t off, int scale) {
+    uint32_t low = (scale == 4) ? (bits(off, 2, 2) << 6) | (bits(off, 6, 6) << 5)
+                                : (bits(off, 7, 6) << 5);
+    return (uint16_t)((f3 << 13) | (bits(off, 5, 3) << 10) | ((uint32_t)(rs1 - 8) << 7) |
+                      low | ((uint32_t)(rdOrRs2 - 8) << 2));
+}
+
+// CA format: c.sub/c.xor/c.or/c.and and c.subw/c.addw
+static uint16_t encodeCA(uint32_t bit12, uint32_t op2, int rd, int rs2) {
+    return (uint16_t)((0x4 << 13) | (bit12 << 12) | (0x3 << 10) | ((uint32_t)(rd - 8) << 7) |
+                      (op2 << 5) | ((uint32_t)(rs2 - 8) << 2) | 0x1);
+}
+
+bool encodeCType(InstrId id, int rd, int rs1, int rs2, int32_t imm, uint16_t &code) {
+    switch (id) {
+        case INSTR_ADDI:
+            if (rd == 0 && rs1 == 0 && imm == 0) { code = 0x0001; return true; }           // c.nop
+            if (rd != 0 && rs1 == 0 && fitsSigned(imm, 6)) {
+                code = encodeCI(0x2, rd, imm, 0x1); return true;                            // c.li
+            }
+            if (rd != 0 && rd == rs1 && imm != 0 && fitsSigned(imm, 6)) {
+                code = encodeCI(0x0, rd, imm, 0x1); return true;                            // c.addi
+            }
+            if (rd == 2 && rs1 == 2 && imm != 0 && imm % 16 == 0 && fitsSigned(imm, 10)) { // c.addi16sp
+                code = (uint16_t)((0x3 << 13) | (bits(imm, 9, 9) << 12) | (2 << 7) | (bits(imm, 4, 4) << 6) |
+                                  (bits(imm, 6, 6) << 5) | (bits(imm, 8, 7) << 3) | (bits(imm, 5, 5) << 2) | 0x1);
+                return true;
+            }
+            if (isCReg(rd) && rs1 == 2 && imm > 0 && imm < 1024 && imm % 4 == 0) {          // c.addi4spn
+                code = (uint16_t)((bits(imm, 5, 4) << 11) | (bits(imm, 9, 6) << 7) | (bits(imm, 2, 2) << 6) |
+                                  (bits(imm, 3, 3) << 5) | ((uint32_t)(rd - 8) << 2));
+                return true;
+            }
+            if (rd != 0 && rs1 != 0 && imm == 0) {                                          // c.mv
+                code = (uint16_t)((0x4 << 13) | (rd << 7) | (rs1 << 2) | 0x2); return true;
+            }
+            return false;
+        case INSTR_ADDIW:
+            if (rd == 0 || rd != rs1 || !fitsSigned(imm, 6)) return false;
+            code = encodeCI(0x1, rd, imm, 0x1); return true;                                // c.addiw
+        case INSTR_LUI: {
+            int32_t upper = (int32_t)((uint32_t)imm << 12) >> 12; // imm is the 20-bit field
+            if (rd == 0 || rd == 2 || upper == 0 || !fitsSigned(upper, 6)) return false;
+            code = encodeCI(0x3, rd, upper, 0x1); return true;                              // c.lui
+        }
+        case INSTR_SLLI:
+            if (rd == 0 || rd != rs1 || imm <= 0 || imm > 63) return false;
+            code = encodeCI(0x0, rd, imm, 0x2); return true;                                // c.slli
+        case INSTR_SRLI: case INSTR_SRAI: case INSTR_ANDI: {
+            if (!isCReg(rd) || rd != rs1) return false;
+            uint32_t funct2 = (id == INSTR_SRLI) ? 0x0 : (id == INSTR_SRAI) ? 0x1 : 0x2;
+            if (id == INSTR_ANDI ? !fitsSigned(imm, 6) : (imm <= 0 || imm > 63)) return false;
+            code = (uint16_t)((0x4 << 13) | (bits(imm, 5, 5) << 12) | (funct2 << 10) | ((uint32_t)(rd - 8) << 7) |
+                              (bits(imm, 4, 0) << 2) | 0x1);
+            return true;                                                                    // c.srli/c.srai/c.andi
+        }
+        case INSTR_ADD:
+            if (rd == 0) return false;
+            if (rs1 == 0 && rs2 != 0) {
+                code = (uint16_t)((0x4 << 13) | (rd << 7) | (rs2 << 2) | 0x2); return true;   // c.mv
+            }
+            if (rd == rs2 && rs1 != 0) std::swap(rs1, rs2);
+            if (rd != rs1 || rs2 == 0) return false;
+            code = (uint16_t)((0x4 << 13) | (1 << 12) | (rd << 7) | (rs2 << 2) | 0x2); return true; // c.add
+        case INSTR_XOR: case INSTR_OR: case INSTR_AND: case INSTR_ADDW:
+            if (rd == rs2 && rd != rs1) std::swap(rs1, rs2); // Commutative
+            // Fall through
+        case INSTR_SUB: case INSTR_SUBW: {
+            if (!isCReg(rd) || rd != rs1 || !isCReg(rs2)) return false;
+            bool word = (id == INSTR_SUBW || id == INSTR_ADDW);
+            uint32_t op2 = (id == INSTR_SUB || id == INSTR_SUBW) ? 0x0 : (id == INSTR_XOR || id == INSTR_ADDW) ? 0x1
+                         : (id == INSTR_OR) ? 0x2 : 0x3;
+            code = encodeCA(word ? 1 : 0, op2, rd, rs2); return true;
+        }
+        case INSTR_LW: case INSTR_LD: {
+            int scale = (id == INSTR_LW) ? 4 : 8;
+            if (imm < 0 || imm % scale != 0) return false;
+            if (isCReg(rd) && isCReg(rs1) && imm < 32 * scale) {
+                code = encodeCLS(id == INSTR_LW ? 0x2 : 0x3, rs1, rd, imm, scale); return true; // c.lw/c.ld
+            }
+            if (rd != 0 && rs1 == 2 && imm < 64 * scale) {                                   // c.lwsp/c.ldsp
+                uint32_t low = (scale == 4) ? (bits(imm, 4, 2) << 4) | (bits(imm, 7, 6) << 2)
+                                            : (bits(imm, 4, 3) << 5) | (bits(imm, 8, 6) << 2);
+                code = (uint16_t)(((id == INSTR_LW ? 0x2u : 0x3u) << 13) | (bits(imm, 5, 5) << 12) | (rd << 7) | low | 0x2);
+                return true;
+            }
+            return false;
+        }
+        case INSTR_SW: case INSTR_SD: {
+            int scale = (id == INSTR_SW) ? 4 : 8;
+            if (imm < 0 || imm % scale != 0) return false;
+            if (isCReg(rs2) && isCReg(rs1) && imm < 32 * scale) {
+                code = encodeCLS(id == INSTR_SW ? 0x6 : 0x7, rs1, rs2, imm, scale); return true; // c.sw/c.sd
+            }
+            if (rs1 == 2 && imm < 64 * scale) {                                               // c.swsp/c.sdsp
+                uint32_t off = (scale == 4) ? (bits(imm, 5, 2) << 9) | (bits(imm, 7, 6) << 7)
+                                            : (bits(imm, 5, 3) << 10) | (bits(imm, 8, 6) << 7);
+                code = (uint16_t)(((id == INSTR_SW ? 0x6u : 0x7u) << 13) | off | (rs2 << 2) | 0x2);
+                return true;
+            }
+            return false;
+        }
+        case INSTR_JAL:
+            if ((rd != 0 && rd != 1) || (imm & 1) || !fitsSigned(imm, 12)) return false;
+            code = (uint16_t)(((rd == 0 ? 0x5u : 0x1u) << 13) | (bits(imm, 11, 11) << 12) | (bits(imm, 4, 4) << 11) |
+                              (bits(imm, 9, 8) << 9) | (bits(imm, 10, 10) << 8) | (bits(imm, 6, 6) << 7) |
+                              (bits(imm, 7, 7) << 6) | (bits(imm, 3, 1) << 3) | (bits(imm, 5, 5) << 2) | 0x1);
+            return true;                                                                    // c.j/c.jal (RV32)
+        case INSTR_JALR:
+            if ((rd != 0 && rd != 1) || rs1 == 0 || imm != 0) return false;
+            code = (uint16_t)((0x4 << 13) | ((rd == 1 ? 1 : 0) << 12) | (rs1 << 7) | 0x2); return true; // c.jr/c.jalr
+        case INSTR_BEQ: case INSTR_BNE:
+            if (rs2 != 0 || !isCReg(rs1) || (imm & 1) || !fitsSigned(imm, 9)) return false;
+            code = (uint16_t)(((id == INSTR_BEQ ? 0x6u : 0x7u) << 13) | (bits(imm, 8, 8) << 12) | (bits(imm, 4, 3) << 10) |
+                              ((uint32_t)(rs1 - 8) << 7) | (bits(imm, 7, 6) << 5) | (bits(imm, 2, 1) << 3) |
+                              (bits(imm, 5, 5) << 2) | 0x1);
+            return true;                                                                    // c.beqz/c.bnez
+        case INSTR_EBREAK:
+            code = 0x9002; return true;                                                     // c.ebreak
+        default:
+            return false;
+    }
+}
+
+std::string buildBitCommentC(uint16_t code) {
+    std::ostringstream oss;
+    oss << toBinary(code & 0x3, 2) << "-"
+        << toBinary(code >> 13, 3) << "-"
+        << toBinary((code >> 2) & 0x7FF, 11);
+    return oss.str();
+}
+
+bool compressInstruction(uint32_t machineCode, uint16_t &code) {
+    const OpcodeInfo *info = findInstrByEncoding(machineCode, true);
+    if (!info) return false;
+    int rd  = (machineCode >> 7) & 0x1F;
+    int rs1 = (machineCode >> 15) & 0x1F;
+    int rs2 = 0;
+    int32_t imm = 0;
+    switch (info->format) {
+        case FMT_R:
+            rs2 = (machineCode >> 20) & 0x1F;
+            break;
+        case FMT_I: case FMT_LOAD: case FMT_JALR:
+            imm = (int32_t)machineCode >> 20;
+            break;
+        case FMT_I_SHIFT:
+            imm = (machineCode >> 20) & 0x3F;
+            break;
+        case FMT_S:
+            rs2 = (machineCode >> 20) & 0x1F;
+            imm = (((int32_t)machineCode >> 25) << 5) | ((machineCode >> 7) & 0x1F);
+            break;
+        case FMT_SB:
+            rs2 = (machineCode >> 20) & 0x1F;
+            imm = (((int32_t)machineCode >> 31) << 12) | (bits(machineCode, 7, 7) << 11) |
+                  (bits(machineCode, 30, 25) << 5) | (bits(machineCode, 11, 8) << 1);
+            break;
+        case FMT_U:
+            imm = machineCode >> 12;
+            break;
+        case FMT_UJ:
+            imm = (((int32_t)machineCode >> 31) << 20) | (bits(machineCode, 19, 12) << 12) |
+                  (bits(machineCode, 20, 20) << 11) | (bits(machineCode, 30, 21) << 1);
+            break;
+        case FMT_SYSTEM:
+            break;
+        default:
+            return false;
+    }
+    return encodeCType(info->id, rd, rs1, rs2, imm, code);
+}
@@ -0,0 +1,29 @@
+#include "R4Type.h"
+#include "Utils.h"
+#include <sstream>
+
+uint32_t encodeR4Type(uint8_t opcode, uint8_t rm, uint8_t fmt,
+                      int rd, int rs1, int rs2, int rs3) {
+    uint32_t insn = 0;
+    insn = setBits(insn, 0, 7, opcode);
+    insn = setBits(insn, 7, 5, rd);
+    insn = setBits(insn, 12, 3, rm);
+    insn = setBits(insn, 15, 5, rs1);
+    insn = setBits(insn, 20, 5, rs2);
+    insn = setBits(insn, 25, 2, fmt);
+    insn = setBits(insn, 27, 5, rs3);
+    return insn;
+}
+
+std::string buildBitCommentR4(uint8_t opcode, uint8_t rm, uint8_t fmt,
+                              int rd, int rs1, int rs2, int rs3) {
+    std::ostringstream oss;
+    oss << toBinary(opcode, 7) << "-"
+        << toBinary(rm, 3) << "-"
+        << toBinary(fmt, 2) << "-"
+        << toBinary(rd, 5) << "-"
+        << toBinary(rs1, 5) << "-"
+        << toBinary(rs2, 5) << "-"
+        << toBinary(rs3, 5);
+    return oss.str();
+}
@@ -3,6 +3,9 @@
 #include <iomanip>
 #include <cctype>
 #include <iostream>
+#include <cstdlib>
+#include <unordered_map>
+#include "csr.h"
 
 std::string trim(const std::string &s) {
     auto start = s.find_first_not_of(" \t\r\n");
@@ -30,8 +33,9 @@ std::vector<std::string> splitTokens(const std::string &line) {
     return tokens;
 }
 
+// x0-x31, or f0-f31 / v0-v31 for floating-point and vector operands (same 5-bit field)
 int getRegisterNumber(const std::string &reg) {
-    if (reg.size() < 2 || reg[0] != 'x') {
+    if (reg.size() < 2 || (reg[0] != 'x' && reg[0] != 'f' && reg[0] != 'v')) {
         std::cerr << "[ERROR] Invalid register name: " << reg << std::endl;
         return 0;
     }
@@ -43,6 +47,48 @@ int getRegisterNumber(const std::string &reg) {
     return num;
 }
 
+int getCSRNumber(const std::string &csr) {
+    static const std::unordered_map<std::string, int> csrNames = {
+        {"fflags", CSR_FFLAGS},     {"frm", CSR_FRM},
+        {"fcsr", CSR_FCSR},         {"vstart", CSR_VSTART},
+        {"vl", CSR_VL},             {"vtype", CSR_VTYPE},
+        {"vlenb", CSR_VLENB},
+        {"satp", CSR_SATP},         {"mstatus", CSR_MSTATUS},
+        {"misa", CSR_MISA},         {"mie", CSR_MIE},
+        {"mtvec", CSR_MTVEC},       {"mscratch", CSR_MSCRATCH},
+        {"mepc", CSR_MEPC},         {"mcause", CSR_MCAUSE},
+        {"mtval", CSR_MTVAL},       {"mip", CSR_MIP},
+        {"mcycle", CSR_MCYCLE},     {"minstret", CSR_MINSTRET},
+        {"mcycleh", CSR_MCYCLEH},   {"minstreth", CSR_MINSTRETH},
+        {"cycle", CSR_CYCLE},       {"time", CSR_TIME},
+        {"instret", CSR_INSTRET},   {"cycleh", CSR_CYCLEH},
+        {"timeh", CSR_TIMEH},       {"instreth", CSR_INSTRETH},
+        {"mhartid", CSR_MHARTID},
+    };
+    auto it = csrNames.find(csr);
+    if (it != csrNames.end()) return it->second;
+    // hpmcounterN / hpmcounterNh
+    if (csr.compare(0, 10, "hpmcounter") == 0 && csr.size() > 10) {
+        bool high = csr.back() == 'h';
+        int n = std::atoi(csr.substr(10, csr.size() - 10 - (high ? 1 : 0)).c_str());
+        if (n >= 3 && n <= 31) return (high ? CSR_CYCLEH : CSR_CYCLE) + n;
+    }
+    if (!csr.empty() && isdigit((unsigned char)csr[0])) {
+        int num = parseImmediate(csr);
+        if (num >= 0 && num <= 0xFFF) return num;
+    }
+    std::cerr << "[ERROR] Invalid CSR: " << csr << std::endl;
+    return 0;
+}
+
+// Rounding-mode operand of F/D instructions; -1 if not a mode name
+int getRoundingMode(const std::string &rm) {
+    static const char *const names[8] = {"rne", "rtz", "rdn", "rup", "rmm", nullptr, nullptr, "dyn"};
+    for (int i = 0; i < 8; i++)
+        if (names[i] && rm == names[i]) return i;
+    return -1;
+}
+
 int32_t parseImmediate(const std::string &immStr) {
     if (immStr.size() > 2 && immStr[0] == '0' &&
        (immStr[1] == 'x' || immStr[1] == 'X')) {
@@ -52,6 +98,21 @@ int32_t parseImmediate(const std::string &immStr) {
     }
 }
 
+// Decimal or 0x-prefixed hex literal, optionally negative
+bool isImmediate(const std::string &immStr) {
+    size_t i = (!immStr.empty() && immStr[0] == '-') ? 1 : 0;
+    if (i >= immStr.size() || !isdigit((unsigned char)immStr[i])) return false;
+    if (immStr.compare(i, 2, "0x") == 0 || immStr.compare(i, 2, "0X") == 0) {
+        if (immStr.size() == i + 2) return false;
+        for (i += 2; i < immStr.size(); i++)
+            if (!isxdigit((unsigned char)immStr[i])) return false;
+        return true;
+    }
+    for (; i < immStr.size(); i++)
+        if (!isdigit((unsigned char)immStr[i])) return false;
+    return true;
+}
+
 uint32_t setBits(uint32_t value, unsigned offset, unsigned numBits, uint32_t field) {
     uint32_t mask = ((1u << numBits) - 1u) << offset;
     value &= ~mask;
@@ -75,6 +136,13 @@ std::string toHex32(uint32_t val) {
     return oss.str();
 }
 
+std::string toHex16(uint16_t val) {
+    std::ostringstream oss;
+    oss << "0x" << std::setw(4) << std::setfill('0')
+        << std::hex << std::uppercase << val;
+    return oss.str();
+}
+
 std::string toUpper(const std::string &s) {
     std::string res = s;
     for (auto &c : res) c = toupper(c);
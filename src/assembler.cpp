@@ -7,6 +7,9 @@
 #include "SBType.h"
 #include "UType.h"
 #include "UJType.h"
+#include "CType.h"
+#include "R4Type.h"
+#include "opcodes.h"
 #include <fstream>
 #include <sstream>
 #include <iostream>
@@ -25,11 +28,26 @@ Assembler::Assembler(const string &inputFile, const string &outputFile)
 //
 uint32_t encodeInstruction(const InstructionLine &inst,
                            const unordered_map<string, uint32_t> &symbolTable,
+                           const map<uint32_t, uint32_t> &instrSizes,
                            string &bitBreakdown) {
     string mnemonic = toUpper(inst.mnemonic);
-    const auto &op = inst.operands;
     uint32_t machineCode = 0;
 
+    // FP sign-injection pseudo-instructions: fneg.s rd, rs == fsgnjn.s rd, rs, rs.
+    static const unordered_map<string, string> fpSignPseudo = {
+        {"FMV.S", "FSGNJ.S"}, {"FNEG.S", "FSGNJN.S"}, {"FABS.S", "FSGNJX.S"},
+        {"FMV.D", "FSGNJ.D"}, {"FNEG.D", "FSGNJN.D"}, {"FABS.D", "FSGNJX.D"},
+    };
+    vector<string> pseudoOperands;
+    auto fpPseudo = fpSignPseudo.find(mnemonic);
+    if (fpPseudo != fpSignPseudo.end() && inst.operands.size() == 2) {
+        mnemonic = fpPseudo->second;
+        pseudoOperands = {inst.operands[0], inst.operands[1], inst.operands[1]};
+    }
+    const auto &op = pseudoOperands.empty() ? inst.operands : pseudoOperands;
+    uint16_t compressed = 0;
+    bool compressedOk = false; // Branches and JAL compress from their offset directly
+
     // For referencing labels.
     auto getLabelOffset = [&](const string &label, uint32_t currentPC) -> int32_t {
         auto it = symbolTable.find(label);
@@ -47,186 +65,402 @@ uint32_t encodeInstruction(const InstructionLine &inst,
             return parseImmediate(immstr);
     };
 
-    // R-type table.
-    static unordered_map<string, tuple<uint8_t,uint8_t,uint8_t>> rTable = {
-        {"ADD", {0x33, 0x0, 0x00}},
-        {"SUB", {0x33, 0x0, 0x20}},
-        {"AND", {0x33, 0x7, 0x00}},
-        {"OR",  {0x33, 0x6, 0x00}},
-        {"XOR", {0x33, 0x4, 0x00}},
-        {"SLL", {0x33, 0x1, 0x00}},
-        {"SRL", {0x33, 0x5, 0x00}},
-        {"SRA", {0x33, 0x5, 0x20}},
-        {"SLT", {0x33, 0x2, 0x00}},
-        {"MUL", {0x33, 0x0, 0x01}},
-        {"DIV", {0x33, 0x4, 0x01}},
-        {"REM", {0x33, 0x6, 0x01}},
+    // Branch and JAL label offsets are taken to the instruction before the
+    // label (label - 4 when every instruction is 4 bytes).
+    auto parseBranchTarget = [&](const string &target) -> int32_t {
+        auto it = symbolTable.find(target);
+        if (it == symbolTable.end())
+            return parseImmediate(target) - 4;
+        uint32_t prevAddr = it->second - INSTR_BYTES;
+        auto prev = instrSizes.lower_bound(it->second);
+        if (prev != instrSizes.begin()) {
+            --prev;
+            if (prev->first + prev->second == it->second)
+                prevAddr = prev->first;
+        }
+        return (int32_t)prevAddr - (int32_t)inst.address;
     };
 
-    // I-type for addi, andi, ori.
-    static unordered_map<string, pair<uint8_t,uint8_t>> iTable = {
-        {"ADDI", {0x13, 0x0}},
-        {"ANDI", {0x13, 0x7}},
-        {"ORI",  {0x13, 0x6}},
+    // Parse an imm(rs1) operand (loads, stores, JALR).
+    auto parseOffsetReg = [&](const string &offsetReg, int32_t &immVal, int &rs1) -> bool {
+        auto pos1 = offsetReg.find('(');
+        auto pos2 = offsetReg.find(')');
+        if (pos1 == string::npos || pos2 == string::npos || pos2 <= pos1)
+            return false;
+        string immPart = offsetReg.substr(0, pos1);
+        string regPart = offsetReg.substr(pos1+1, pos2 - (pos1+1));
+        immVal = immPart.empty() ? 0 : parseImmOrLabel(immPart, inst.address);
+        rs1 = getRegisterNumber(regPart);
+        return true;
     };
 
-    // S-type (stores): SB, SH, SW, SD.
-    static unordered_map<string, uint8_t> sTable = {
-        {"SB", 0},
-        {"SH", 1},
-        {"SW", 2},
-        {"SD", 3},
+    // Counter-read pseudo-instructions: rdcycle rd == csrrs rd, cycle, x0.
+    static unordered_map<string, uint32_t> csrReadTable = {
+        {"RDCYCLE",   0xC00},
+        {"RDTIME",    0xC01},
+        {"RDINSTRET", 0xC02},
     };
 
-    // SB-type branches: BEQ, BNE, BLT, BGE.
-    static unordered_map<string, uint8_t> sbTable = {
-        {"BEQ", 0},
-        {"BNE", 1},
-        {"BLT", 4},
-        {"BGE", 5},
+    // Opcode, funct3 and funct7 come from the table shared with the simulators.
+    const OpcodeInfo *info = findInstrByMnemonic(mnemonic);
+    InstrFormat format = info ? info->format : FMT_R;
+
+    // F/D arithmetic takes an optional trailing rounding mode (default dyn).
+    auto parseRoundingOperand = [&](size_t index) -> uint8_t {
+        if (!(info->flags & INSTR_FLAG_RM) || op.size() <= index)
+            return info->funct3;
+        int rm = getRoundingMode(op[index]);
+        if (rm < 0) {
+            cerr << "[ERROR] Invalid rounding mode: " << op[index] << endl;
+            return info->funct3;
+        }
+        return static_cast<uint8_t>(rm);
     };
+    size_t rmOperands = (info && (info->flags & INSTR_FLAG_RM)) ? 1 : 0;
 
     // R-type.
-    if (rTable.find(mnemonic) != rTable.end()) {
-        if (op.size() != 3)
+    if (info && format == FMT_R) {
+        if (op.size() != 3 && op.size() != 3 + rmOperands)
             cerr << "[ERROR] R-type expects 3 operands\n";
         int rd  = getRegisterNumber(op[0]);
         int rs1 = getRegisterNumber(op[1]);
         int rs2 = getRegisterNumber(op[2]);
-        // auto [opcode, func3, func7] = rTable[mnemonic];
-        uint8_t opcode, func3, func7;
-        tie(opcode, func3, func7) = rTable[mnemonic];
-        machineCode = encodeRType(opcode, func3, func7, rd, rs1, rs2);
-        bitBreakdown = buildBitCommentR(opcode, func3, func7, rd, rs1, rs2);
+        uint8_t func3 = parseRoundingOperand(3);
+        machineCode = encodeRType(info->opcode, func3, info->funct7, rd, rs1, rs2);
+        bitBreakdown = buildBitCommentR(info->opcode, func3, info->funct7, rd, rs1, rs2);
     }
-    // I-type loads: LB, LH, LW, LD (opcode 0x03).
-    else if (mnemonic == "LB" || mnemonic == "LH" ||
-             mnemonic == "LW" || mnemonic == "LD") {
-        if (op.size() != 2)
-            cerr << "[ERROR] Load instruction expects 2 operands\n";
-        int rd = getRegisterNumber(op[0]);
-        string offsetReg = op[1];
-        auto pos1 = offsetReg.find('(');
-        auto pos2 = offsetReg.find(')');
-        int32_t immVal = 0;
-        int rs1 = 0;
-        if (pos1 != string::npos && pos2 != string::npos && pos2 > pos1) {
-            string immPart = offsetReg.substr(0, pos1);
-            string regPart = offsetReg.substr(pos1+1, pos2 - (pos1+1));
-            immVal = parseImmOrLabel(immPart, inst.address);
-            rs1 = getRegisterNumber(regPart);
-        } else {
-            cerr << "[ERROR] Malformed load operand: " << offsetReg << endl;
-        }
-        uint8_t func3 = 0;
-        if (mnemonic=="LB") func3 = 0;
-        if (mnemonic=="LH") func3 = 1;
-        if (mnemonic=="LW") func3 = 2;
-        if (mnemonic=="LD") func3 = 3;
-        uint8_t opcode = 0x03;
-        machineCode = encodeIType(opcode, func3, rd, rs1, immVal);
-        bitBreakdown = buildBitCommentI(opcode, func3, rd, rs1, immVal);
+    // R4-type (fused multiply-add): rd, rs1, rs2, rs3[, rm].
+    else if (info && format == FMT_R4) {
+        if (op.size() != 4 && op.size() != 5)
+            cerr << "[ERROR] " << mnemonic << " expects 4 operands: rd, rs1, rs2, rs3\n";
+        int rd  = getRegisterNumber(op[0]);
+        int rs1 = getRegisterNumber(op[1]);
+        int rs2 = getRegisterNumber(op[2]);
+        int rs3 = getRegisterNumber(op[3]);
+        uint8_t rm = parseRoundingOperand(4);
+        machineCode = encodeR4Type(info->opcode, rm, info->funct7, rd, rs1, rs2, rs3);
+        bitBreakdown = buildBitCommentR4(info->opcode, rm, info->funct7, rd, rs1, rs2, rs3);
     }
-    // I-type JALR.
-    else if (mnemonic == "JALR") {
+    // Single-source with a fixed funct12 (FSQRT, FCVT, FMV, FCLASS, CLZ, REV8, ...):
+    // rd, rs1[, rm]; rs2 is part of funct12.
+    else if (info && (format == FMT_FP_UNARY || format == FMT_I_UNARY)) {
+        if (op.size() != 2 && op.size() != 2 + rmOperands)
+            cerr << "[ERROR] " << mnemonic << " expects 2 operands: rd, rs1\n";
+        int rd  = getRegisterNumber(op[0]);
+        int rs1 = getRegisterNumber(op[1]);
+        uint8_t func3 = parseRoundingOperand(2);
+        uint8_t func7 = static_cast<uint8_t>(info->funct12 >> 5);
+        int rs2 = info->funct12 & 0x1F;
+        machineCode = encodeRType(info->opcode, func3, func7, rd, rs1, rs2);
+        bitBreakdown = buildBitCommentR(info->opcode, func3, func7, rd, rs1, rs2);
+    }
+    // I-type loads (opcode 0x03) and JALR: rd, imm(rs1).
+    else if (info && (format == FMT_LOAD || format == FMT_JALR)) {
         if (op.size() != 2)
-            cerr << "[ERROR] JALR expects 2 operands\n";
+            cerr << "[ERROR] " << mnemonic << " expects 2 operands: rd, imm(rs1)\n";
         int rd = getRegisterNumber(op[0]);
-        string offsetReg = op[1];
-        auto pos1 = offsetReg.find('(');
-        auto pos2 = offsetReg.find(')');
         int32_t immVal = 0;
         int rs1 = 0;
-        if (pos1 != string::npos && pos2 != string::npos && pos2 > pos1) {
-            string immPart = offsetReg.substr(0, pos1);
-            string regPart = offsetReg.substr(pos1+1, pos2 - (pos1+1));
-            immVal = parseImmOrLabel(immPart, inst.address);
-            rs1 = getRegisterNumber(regPart);
-        } else {
-            cerr << "[ERROR] Malformed JALR operand: " << offsetReg << endl;
-        }
-        uint8_t opcode = 0x67;
-        uint8_t func3 = 0;
-        machineCode = encodeIType(opcode, func3, rd, rs1, immVal);
-        bitBreakdown = buildBitCommentI(opcode, func3, rd, rs1, immVal);
+        if (!parseOffsetReg(op[1], immVal, rs1))
+            cerr << "[ERROR] Malformed " << mnemonic << " operand: " << op[1] << endl;
+        machineCode = encodeIType(info->opcode, info->funct3, rd, rs1, immVal);
+        bitBreakdown = buildBitCommentI(info->opcode, info->funct3, rd, rs1, immVal);
     }
-    // I-type (ADDI, ANDI, ORI).
-    else if (iTable.find(mnemonic) != iTable.end()) {
+    // I-type ALU (ADDI, SLTI, SLTIU, XORI, ORI, ANDI).
+    else if (info && format == FMT_I) {
         if (op.size() != 3)
-            cerr << "[ERROR] I-type (ADDI/ANDI/ORI) expects 3 operands\n";
+            cerr << "[ERROR] I-type expects 3 operands: rd, rs1, imm\n";
         int rd = getRegisterNumber(op[0]);
         int rs1 = getRegisterNumber(op[1]);
         int32_t immVal = parseImmOrLabel(op[2], inst.address);
-        // auto [opcode, func3] = iTable[mnemonic];
-        uint8_t opcode, func3;
-        tie(opcode, func3) = iTable[mnemonic];
-        machineCode = encodeIType(opcode, func3, rd, rs1, immVal);
-        bitBreakdown = buildBitCommentI(opcode, func3, rd, rs1, immVal);
+        if (immVal < -2048 || immVal > 2047)
+            cerr << "[ERROR] Immediate out of range (-2048..2047): " << op[2] << endl;
+        machineCode = encodeIType(info->opcode, info->funct3, rd, rs1, immVal);
+        bitBreakdown = buildBitCommentI(info->opcode, info->funct3, rd, rs1, immVal);
+    }
+    // Shift-immediate (SLLI, SRLI, SRAI and the *IW forms): funct7 goes in imm[11:5].
+    // slli/srli/srai accept a 6-bit shamt for RV64; shamt >= 32 is illegal on RV32.
+    else if (info && format == FMT_I_SHIFT) {
+        if (op.size() != 3)
+            cerr << "[ERROR] Shift-immediate expects 3 operands: rd, rs1, shamt\n";
+        int rd = getRegisterNumber(op[0]);
+        int rs1 = getRegisterNumber(op[1]);
+        int32_t shamt = parseImmediate(op[2]);
+        int32_t maxShamt = (info->opcode == 0x13) ? 63 : 31;
+        if (shamt < 0 || shamt > maxShamt)
+            cerr << "[ERROR] Shift amount out of range (0-" << maxShamt << "): " << op[2] << endl;
+        int32_t immVal = (info->funct7 << 5) | (shamt & maxShamt);
+        machineCode = encodeIType(info->opcode, info->funct3, rd, rs1, immVal);
+        bitBreakdown = buildBitCommentI(info->opcode, info->funct3, rd, rs1, immVal);
     }
     // S-type (stores).
-    else if (sTable.find(mnemonic) != sTable.end()) {
+    else if (info && format == FMT_S) {
         if (op.size() != 2)
             cerr << "[ERROR] S-type expects 2 operands: rs2, imm(rs1)\n";
         int rs2 = getRegisterNumber(op[0]);
-        string offsetReg = op[1];
-        auto pos1 = offsetReg.find('(');
-        auto pos2 = offsetReg.find(')');
         int32_t immVal = 0;
         int rs1 = 0;
-        if (pos1 != string::npos && pos2 != string::npos && pos2 > pos1) {
-            string immPart = offsetReg.substr(0, pos1);
-            string regPart = offsetReg.substr(pos1+1, pos2 - (pos1+1));
-            immVal = parseImmOrLabel(immPart, inst.address);
-            rs1 = getRegisterNumber(regPart);
-        } else {
+        if (!parseOffsetReg(op[1], immVal, rs1))
             cerr << "[ERROR] Malformed S-type operand\n";
-        }
-        uint8_t func3 = sTable[mnemonic];
-        uint8_t opcode = 0x23;
-        machineCode = encodeSType(opcode, func3, rs1, rs2, immVal);
-        bitBreakdown = buildBitCommentS(opcode, func3, rs1, rs2, immVal);
+        machineCode = encodeSType(info->opcode, info->funct3, rs1, rs2, immVal);
+        bitBreakdown = buildBitCommentS(info->opcode, info->funct3, rs1, rs2, immVal);
     }
     // SB-type (branches).
-    else if (sbTable.find(mnemonic) != sbTable.end()) {
+    else if (info && format == FMT_SB) {
         if (op.size() != 3)
             cerr << "[ERROR] SB-type branch expects 3 operands: rs1, rs2, label\n";
         int rs1 = getRegisterNumber(op[0]);
         int rs2 = getRegisterNumber(op[1]);
-        int32_t offset = parseImmOrLabel(op[2], inst.address);
-        offset -= 4;  // Branch offset from next instruction.
-        uint8_t func3 = sbTable[mnemonic];
-        uint8_t opcode = 0x63;
-        machineCode = encodeSBType(opcode, func3, rs1, rs2, offset);
-        bitBreakdown = buildBitCommentSB(opcode, func3, rs1, rs2, offset);
+        int32_t offset = parseBranchTarget(op[2]);
+        if (inst.size == COMPRESSED_INSTR_BYTES)
+            compressedOk = encodeCType(info->id, 0, rs1, rs2, offset, compressed);
+        machineCode = encodeSBType(info->opcode, info->funct3, rs1, rs2, offset);
+        bitBreakdown = buildBitCommentSB(info->opcode, info->funct3, rs1, rs2, offset);
     }
     // U-type: LUI and AUIPC.
-    else if (mnemonic == "LUI" || mnemonic == "AUIPC") {
+    else if (info && format == FMT_U) {
         if (op.size() != 2)
             cerr << "[ERROR] U-type expects 2 operands: rd, imm\n";
         int rd = getRegisterNumber(op[0]);
         int32_t immVal = parseImmOrLabel(op[1], inst.address);
-        uint8_t opcode = (mnemonic == "LUI") ? 0x37 : 0x17;
-        machineCode = encodeUType(opcode, rd, immVal);
-        bitBreakdown = buildBitCommentU(opcode, rd, immVal);
+        machineCode = encodeUType(info->opcode, rd, immVal);
+        bitBreakdown = buildBitCommentU(info->opcode, rd, immVal);
     }
     // UJ-type: JAL.
-    else if (mnemonic == "JAL") {
+    else if (info && format == FMT_UJ) {
         if (op.size() != 2)
             cerr << "[ERROR] JAL expects 2 operands: rd, label/immediate\n";
         int rd = getRegisterNumber(op[0]);
-        int32_t offset = parseImmOrLabel(op[1], inst.address);
-        offset -= 4;
-        uint8_t opcode = 0x6F;
-        machineCode = encodeUJType(opcode, rd, offset);
-        bitBreakdown = buildBitCommentUJ(opcode, rd, offset);
+        int32_t offset = parseBranchTarget(op[1]);
+        if (inst.size == COMPRESSED_INSTR_BYTES)
+            compressedOk = encodeCType(info->id, rd, 0, 0, offset, compressed);
+        machineCode = encodeUJType(info->opcode, rd, offset);
+        bitBreakdown = buildBitCommentUJ(info->opcode, rd, offset);
+    }
+    // Zicsr: csrrw rd, csr, rs1 / csrrwi rd, csr, uimm5.
+    else if (info && (format == FMT_CSR || format == FMT_CSRI)) {
+        if (op.size() != 3)
+            cerr << "[ERROR] CSR instruction expects 3 operands: rd, csr, rs1/uimm\n";
+        int rd = getRegisterNumber(op[0]);
+        int csr = getCSRNumber(op[1]);
+        int rs1 = 0;
+        if (format == FMT_CSRI) {
+            rs1 = parseImmediate(op[2]);
+            if (rs1 < 0 || rs1 > 31)
+                cerr << "[ERROR] CSR immediate out of range (0-31): " << op[2] << endl;
+        } else {
+            rs1 = getRegisterNumber(op[2]);
+        }
+        machineCode = encodeIType(info->opcode, info->funct3, rd, rs1, csr);
+        bitBreakdown = buildBitCommentI(info->opcode, info->funct3, rd, rs1, csr);
+    }
+    // ECALL, EBREAK, MRET, WFI.
+    else if (info && format == FMT_SYSTEM) {
+        if (!op.empty())
+            cerr << "[ERROR] " << mnemonic << " takes no operands\n";
+        machineCode = encodeIType(info->opcode, 0, 0, 0, info->funct12);
+        bitBreakdown = buildBitCommentI(info->opcode, 0, 0, 0, info->funct12);
+    }
+    // FENCE: always encoded as fence iorw, iorw. FENCE.I has no fields.
+    else if (info && format == FMT_FENCE) {
+        int imm = (info->id == INSTR_FENCE_I) ? 0 : 0x0FF;
+        machineCode = encodeIType(info->opcode, info->funct3, 0, 0, imm);
+        bitBreakdown = buildBitCommentI(info->opcode, info->funct3, 0, 0, imm);
+    }
+    // SFENCE.VMA [rs1[, rs2]].
+    else if (info && format == FMT_SFENCE) {
+        int rs1 = op.size() > 0 ? getRegisterNumber(op[0]) : 0;
+        int rs2 = op.size() > 1 ? getRegisterNumber(op[1]) : 0;
+        machineCode = encodeRType(info->opcode, info->funct3, info->funct7, 0, rs1, rs2);
+        bitBreakdown = buildBitCommentR(info->opcode, info->funct3, info->funct7, 0, rs1, rs2);
+    }
+    // VSETVLI rd, rs1, e8|e16|e32, m1|m2|m4|m8[, ta|tu[, ma|mu]].
+    else if (info && format == FMT_VSETVLI) {
+        if (op.size() < 4 || op.size() > 6)
+            cerr << "[ERROR] VSETVLI expects rd, rs1, sew, lmul[, ta|tu, ma|mu]\n";
+        int rd = getRegisterNumber(op[0]);
+        int rs1 = getRegisterNumber(op[1]);
+        int32_t vtypei = 0;
+        for (size_t i = 2; i < op.size(); i++) {
+            string field = toUpper(op[i]);
+            if (field == "E8") vtypei |= 0 << 3;
+            else if (field == "E16") vtypei |= 1 << 3;
+            else if (field == "E32") vtypei |= 2 << 3;
+            else if (field == "M1") vtypei |= 0;
+            else if (field == "M2") vtypei |= 1;
+            else if (field == "M4") vtypei |= 2;
+            else if (field == "M8") vtypei |= 3;
+            else if (field == "TA") vtypei |= 1 << 6;
+            else if (field == "MA") vtypei |= 1 << 7;
+            else if (field != "TU" && field != "MU")
+                cerr << "[ERROR] Unsupported vtype field: " << op[i] << endl;
+        }
+        machineCode = encodeIType(info->opcode, info->funct3, rd, rs1, vtypei);
+        bitBreakdown = buildBitCommentI(info->opcode, info->funct3, rd, rs1, vtypei);
+    }
+    // Vector loads/stores: vd, (rs1)[, rs2][, v0.t]; funct7 = mop << 1 | vm.
+    else if (info && (format == FMT_VLOAD || format == FMT_VSTORE)) {
+        bool masked = !op.empty() && toUpper(op.back()) == "V0.T";
+        size_t operands = op.size() - (masked ? 1 : 0);
+        size_t expected = (info->funct7 == 2) ? 3 : 2;
+        if (operands != expected)
+            cerr << "[ERROR] " << mnemonic << " expects " << expected << " operands"
+                 << (expected == 3 ? ": vd, (rs1), rs2\n" : ": vd, (rs1)\n");
+        int vd = getRegisterNumber(op[0]);
+        int32_t offset = 0;
+        int rs1 = 0;
+        if (op.size() < 2 || !parseOffsetReg(op[1], offset, rs1) || offset != 0)
+            cerr << "[ERROR] Malformed " << mnemonic << " address operand (expects (rs1))\n";
+        int rs2 = (expected == 3 && op.size() > 2) ? getRegisterNumber(op[2]) : 0;
+        uint8_t func7 = static_cast<uint8_t>((info->funct7 << 1) | (masked ? 0 : 1));
+        machineCode = encodeRType(info->opcode, info->funct3, func7, vd, rs1, rs2);
+        bitBreakdown = buildBitCommentR(info->opcode, info->funct3, func7, vd, rs1, rs2);
+    }
+    // Vector arithmetic: vd, vs2, vs1/rs1/simm5[, v0.t]; moves: vd, vs1/rs1/simm5;
+    // vmv.x.s: rd, vs2. funct7 = funct6 << 1 | vm.
+    else if (info && (format == FMT_V_ARITH || format == FMT_V_MOVE || format == FMT_V_TO_X)) {
+        bool masked = format == FMT_V_ARITH && !op.empty() && toUpper(op.back()) == "V0.T";
+        size_t operands = op.size() - (masked ? 1 : 0);
+        size_t expected = (format == FMT_V_ARITH) ? 3 : 2;
+        if (operands != expected)
+            cerr << "[ERROR] " << mnemonic << " expects " << expected << " operands\n";
+        int rd = getRegisterNumber(op[0]);
+        int vs2 = 0, src = 0;
+        string srcOperand = (format == FMT_V_ARITH && op.size() > 2) ? op[2] : (op.size() > 1 ? op[1] : "0");
+        if (format == FMT_V_ARITH)
+            vs2 = getRegisterNumber(op[1]);
+        if (format == FMT_V_TO_X) {
+            vs2 = getRegisterNumber(op[1]);
+        } else if (info->funct3 == 3) { // .vi: 5-bit signed immediate
+            int32_t simm5 = parseImmediate(srcOperand);
+            if (simm5 < -16 || simm5 > 15)
+                cerr << "[ERROR] Vector immediate out of range (-16..15): " << srcOperand << endl;
+            src = simm5 & 0x1F;
+        } else {
+            src = getRegisterNumber(srcOperand);
+        }
+        uint8_t func7 = static_cast<uint8_t>((info->funct7 << 1) | (masked ? 0 : 1));
+        machineCode = encodeRType(info->opcode, info->funct3, func7, rd, src, vs2);
+        bitBreakdown = buildBitCommentR(info->opcode, info->funct3, func7, rd, src, vs2);
+    }
+    // CSRR rd, csr / CSRW csr, rs1 / RDCYCLE rd ...
+    else if (mnemonic == "CSRR" || mnemonic == "CSRW" ||
+             csrReadTable.find(mnemonic) != csrReadTable.end()) {
+        int rd = 0, rs1 = 0, csr = 0;
+        uint8_t func3 = 0x2; // CSRRS
+        if (mnemonic == "CSRR") {
+            if (op.size() != 2)
+                cerr << "[ERROR] CSRR expects 2 operands: rd, csr\n";
+            rd = getRegisterNumber(op[0]);
+            csr = getCSRNumber(op[1]);
+        } else if (mnemonic == "CSRW") {
+            if (op.size() != 2)
+                cerr << "[ERROR] CSRW expects 2 operands: csr, rs1\n";
+            csr = getCSRNumber(op[0]);
+            rs1 = getRegisterNumber(op[1]);
+            func3 = 0x1; // CSRRW
+        } else {
+            if (op.size() != 1)
+                cerr << "[ERROR] " << mnemonic << " expects 1 operand: rd\n";
+            rd = getRegisterNumber(op[0]);
+            csr = csrReadTable[mnemonic];
+        }
+        uint8_t opcode = 0x73;
+        machineCode = encodeIType(opcode, func3, rd, rs1, csr);
+        bitBreakdown = buildBitCommentI(opcode, func3, rd, rs1, csr);
     }
     else {
         cerr << "[ERROR] Unknown instruction: " << mnemonic << endl;
     }
 
+    // 2-byte lines are emitted in their 16-bit form.
+    if (inst.size == COMPRESSED_INSTR_BYTES) {
+        if (format != FMT_SB && format != FMT_UJ)
+            compressedOk = compressInstruction(machineCode, compressed);
+        if (!compressedOk)
+            cerr << "[ERROR] Operands do not fit a compressed encoding: " << inst.originalLine << endl;
+        bitBreakdown = buildBitCommentC(compressed);
+        return compressed;
+    }
     return machineCode;
 }
 
+// c.* mnemonics are written as the base instruction they expand to and
+// then always emitted in their 16-bit form.
+static bool expandCompressedMnemonic(InstructionLine &inst) {
+    static const unordered_map<string, string> twoAddress = {
+        {"C.ADDI", "addi"}, {"C.ADDIW", "addiw"}, {"C.SLLI", "slli"}, {"C.SRLI", "srli"},
+        {"C.SRAI", "srai"}, {"C.ANDI", "andi"}, {"C.ADD", "add"}, {"C.SUB", "sub"},
+        {"C.XOR", "xor"}, {"C.OR", "or"}, {"C.AND", "and"}, {"C.ADDW", "addw"}, {"C.SUBW", "subw"},
+    };
+    string mnemonic = toUpper(inst.mnemonic);
+    vector<string> &op = inst.operands;
+    size_t n = op.size();
+    auto twoAddr = twoAddress.find(mnemonic);
+
+    if (twoAddr != twoAddress.end() && n == 2) {          // c.addi rd, imm => addi rd, rd, imm
+        inst.mnemonic = twoAddr->second;
+        op = {op[0], op[0], op[1]};
+    } else if (mnemonic == "C.NOP" && n == 0) {
+        inst.mnemonic = "addi";
+        op = {"x0", "x0", "0"};
+    } else if (mnemonic == "C.LI" && n == 2) {
+        inst.mnemonic = "addi";
+        op = {op[0], "x0", op[1]};
+    } else if (mnemonic == "C.ADDI16SP" && n == 1) {
+        inst.mnemonic = "addi";
+        op = {"x2", "x2", op[0]};
+    } else if (mnemonic == "C.ADDI4SPN" && n == 2) {
+        inst.mnemonic = "addi";
+        op = {op[0], "x2", op[1]};
+    } else if (mnemonic == "C.MV" && n == 2) {
+        inst.mnemonic = "add";
+        op = {op[0], "x0", op[1]};
+    } else if ((mnemonic == "C.LUI" || mnemonic == "C.LW" || mnemonic == "C.LD" ||
+                mnemonic == "C.SW" || mnemonic == "C.SD") && n == 2) {
+        inst.mnemonic = inst.mnemonic.substr(2);
+    } else if ((mnemonic == "C.LWSP" || mnemonic == "C.LDSP" ||
+                mnemonic == "C.SWSP" || mnemonic == "C.SDSP") && n == 2) {
+        inst.mnemonic = inst.mnemonic.substr(2, 2);        // c.lwsp rd, 8 => lw rd, 8(x2)
+        if (op[1].find('(') == string::npos)
+            op[1] += "(x2)";
+    } else if ((mnemonic == "C.J" || mnemonic == "C.JAL") && n == 1) {
+        op = {mnemonic == "C.J" ? "x0" : "x1", op[0]};
+        inst.mnemonic = "jal";
+    } else if ((mnemonic == "C.JR" || mnemonic == "C.JALR") && n == 1) {
+        op = {mnemonic == "C.JR" ? "x0" : "x1", "0(" + op[0] + ")"};
+        inst.mnemonic = "jalr";
+    } else if ((mnemonic == "C.BEQZ" || mnemonic == "C.BNEZ") && n == 2) {
+        inst.mnemonic = (mnemonic == "C.BEQZ") ? "beq" : "bne";
+        op = {op[0], "x0", op[1]};
+    } else if (mnemonic == "C.EBREAK" && n == 0) {
+        inst.mnemonic = "ebreak";
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// .option rvc only compresses instructions whose size cannot depend on a
+// label: branches and jumps and symbolic operands keep the 4-byte form.
+static bool canAutoCompress(const InstructionLine &inst) {
+    const OpcodeInfo *info = findInstrByMnemonic(toUpper(inst.mnemonic));
+    if (!info || info->format == FMT_SB || info->format == FMT_UJ)
+        return false;
+    for (const string &operand : inst.operands) {
+        string imm = operand;
+        auto paren = operand.find('(');
+        if (paren != string::npos) {
+            imm = operand.substr(0, paren);
+            if (imm.empty()) continue;
+        } else if (operand.size() > 1 && operand[0] == 'x') {
+            continue;
+        }
+        if (!isImmediate(imm)) return false;
+    }
+    return true;
+}
+
 void Assembler::pass1() {
     ifstream fin(inputFilename);
     if (!fin.is_open()) {
@@ -270,6 +504,12 @@ void Assembler::pass1() {
             }
             if(asmLine.directive==".text")
                 currentSection = TEXT;
+            else if(asmLine.directive==".option") {
+                if(!asmLine.tokens.empty() && asmLine.tokens[0]=="rvc")
+                    autoCompress = true;
+                else if(!asmLine.tokens.empty() && asmLine.tokens[0]=="norvc")
+                    autoCompress = false;
+            }
             else if(asmLine.directive==".data")
                 currentSection = DATA;
             else if(asmLine.directive==".byte" ||
@@ -343,8 +583,19 @@ void Assembler::pass1() {
                 iLine.operands.push_back(asmLine.tokens[i]);
             }
             iLine.originalLine = asmLine.originalLine;
+            iLine.size = INSTR_BYTES;
+            if(toUpper(iLine.mnemonic).compare(0, 2, "C.") == 0) {
+                if(!expandCompressedMnemonic(iLine))
+                    cerr << "[ERROR] Unknown compressed instruction: " << rawLine << endl;
+                iLine.size = COMPRESSED_INSTR_BYTES;
+            } else if(autoCompress && canAutoCompress(iLine)) {
+                string unused;
+                uint16_t compressed;
+                if(compressInstruction(encodeInstruction(iLine, {}, {}, unused), compressed))
+                    iLine.size = COMPRESSED_INSTR_BYTES;
+            }
             textInstructions.push_back(iLine);
-            currentTextAddr += CODE_STEP;
+            currentTextAddr += iLine.size;
             lines.push_back(asmLine);
         }
     }
@@ -357,10 +608,14 @@ void Assembler::pass2() {
         cerr << "[ERROR] Cannot open " << outputFilename << " for writing\n";
         exit(1);
     }
+    map<uint32_t, uint32_t> instrSizes;
+    for(auto &inst: textInstructions)
+        instrSizes[inst.address] = inst.size;
     // Code segment.
     for(auto &inst: textInstructions){
         string bitComment;
-        uint32_t code = encodeInstruction(inst, symbolTable, bitComment);
+        uint32_t code = encodeInstruction(inst, symbolTable, instrSizes, bitComment);
+        string codeHex = (inst.size == COMPRESSED_INSTR_BYTES) ? toHex16(code) : toHex32(code);
         ostringstream assemblyStr;
         assemblyStr << inst.mnemonic;
         if(!inst.operands.empty()){
@@ -370,7 +625,7 @@ void Assembler::pass2() {
             }
         }
         fout << "0x" << std::hex << inst.address << " "
-             << toHex32(code) << " , "
+             << codeHex << " , "
              << assemblyStr.str() << " # "
              << bitComment << "\n";
     }
@@ -387,5 +642,17 @@ void Assembler::pass2() {
 void Assembler::assemble() {
     pass1();
     pass2();
+    uint32_t codeBytes = 0, compressedCount = 0;
+    for(auto &inst: textInstructions){
+        codeBytes += inst.size;
+        if(inst.size == COMPRESSED_INSTR_BYTES) compressedCount++;
+    }
+    if(compressedCount > 0){
+        uint32_t fullBytes = textInstructions.size() * INSTR_BYTES;
+        cout << "Code size: " << std::dec << codeBytes << " bytes for " << textInstructions.size()
+             << " instructions (" << compressedCount << " compressed), "
+             << std::fixed << std::setprecision(1) << 100.0 * (fullBytes - codeBytes) / fullBytes
+             << "% smaller than " << fullBytes << " bytes uncompressed\n";
+    }
     cout << "Assembly complete. See " << outputFilename << "\n";
 }
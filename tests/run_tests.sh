@@ -0,0 +1,183 @@
+#!/bin/bash
+# =====================================================================
+# Regression checks for both simulator models
+#   Usage: tests/run_tests.sh [path/to/simulator]   (default ./simulator)
+#   Each program runs in a scratch directory, since the simulators write
+#   data.mc, stack.mc and instruction.mc next to the program.
+# =====================================================================
+SIM=$(realpath "${1:-./simulator}")
+TESTS=$(cd "$(dirname "$0")" && pwd)
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+failures=0
+
+# run <program> <options...>: output in $WORK/out.txt
+run() {
+    local program=$1
+    shift
+    cp "$TESTS/$program" "$WORK/"
+    : > "$WORK/data.mc"
+    : > "$WORK/stack.mc"
+    : > "$WORK/instruction.mc"
+    (cd "$WORK" && echo R | timeout 60 "$SIM" "$program" data.mc stack.mc instruction.mc "$@" > out.txt 2>&1)
+}
+
+check() { # <name> <expected> <actual>
+    if [ "$2" == "$3" ]; then
+        echo "PASS  $1"
+    else
+        echo "FAIL  $1: expected $2, got $3"
+        failures=$((failures + 1))
+    fi
+}
+
+# Last printed value of register R[n]
+lastReg() {
+    grep -o "R\[ *$1\]=[-0-9]*" "$WORK/out.txt" | tail -1 | cut -d= -f2
+}
+
+# Last printed value of vector register V[n], as hex
+lastVec() {
+    grep -o "V\[ *$1\]=0x[0-9a-f]*" "$WORK/out.txt" | tail -1 | cut -d= -f2
+}
+
+# Byte stores to offsets +3 and +1 of instructions that were already
+# fetched; FENCE.I must make the second loop iteration run the new code
+for knob1 in 0 1; do
+    run smc_bytes.mc --knob1=$knob1
+    check "smc_bytes knob1=$knob1 byte +3" 2034 "$(lastReg 18)"
+    check "smc_bytes knob1=$knob1 byte +1" 102 "$(lastReg 19)"
+done
+
+# Value printed for a statistic, e.g. stat 1 -> "Stat1: Total number of cycles = N"
+stat() {
+    grep "^Stat$1:" "$WORK/out.txt" | tail -1 | grep -o "[0-9]*$"
+}
+
+# A loop with a data-dependent branch and a call/return through JALR whose
+# base registers are still in flight at fetch
+for knob1 in 0 1; do
+    run jump_loop.mc --knob1=$knob1
+    check "jump_loop knob1=$knob1 iterations" 40 "$(lastReg 5)"
+    check "jump_loop knob1=$knob1 calls" 40 "$(lastReg 11)"
+done
+
+# AUIPC at 0x10 adds 1 << 12 to its own PC; the JALR at 0x18 is fetched
+# while x7 still holds 0x20, but must go to 0x24 without running 0x20
+for knob1 in 0 1; do
+    run auipc_jalr.mc --knob1=$knob1
+    check "auipc_jalr knob1=$knob1 auipc" 4112 "$(lastReg 5)"
+    check "auipc_jalr knob1=$knob1 link" 28 "$(lastReg 1)"
+    check "auipc_jalr knob1=$knob1 stale target not run" 0 "$(lastReg 20)"
+    check "auipc_jalr knob1=$knob1 target" 7 "$(lastReg 21)"
+done
+
+# Trace replay must charge the same cycles as the cycle model
+for options in "--predictor=static" "--predictor=1bit" "--predictor=2bit" "--mem-latency=3" \
+               "--knob2=0 --predictor=static" "--knob2=0 --predictor=2bit" "--knob2=0 --mem-latency=3"; do
+    run jump_loop.mc --knob1=1 --knob3=0 --knob4=0 --knob6=0 $options
+    pipelined=$(stat 1)
+    run jump_loop.mc --knob1=0 --trace-out=jump_loop.trace
+    run jump_loop.mc --knob1=1 --replay=jump_loop.trace $options
+    check "jump_loop replay cycles $options" "$pipelined" "$(stat 1)"
+done
+
+# Compressed fetch: 4-byte instructions at 0xe, 0x16 and 0x22 (2 mod 4),
+# a c.bnez loop, c.jal at 0x1e (link 0x20) read at once by c.mv, c.jr
+# back, and a jal at 0x22 (link 0x26). c.jal is c.addiw on RV64
+for knob1 in 0 1; do
+    run rvc_mix.mc --knob1=$knob1
+    if [ "$(lastReg 31)" != 1 ]; then
+        echo "SKIP  rvc_mix knob1=$knob1: c.jal is RV32-only"
+        continue
+    fi
+    check "rvc_mix knob1=$knob1 addi at 2 mod 4" 105 "$(lastReg 11)"
+    check "rvc_mix knob1=$knob1 loop" 9 "$(lastReg 12)"
+    check "rvc_mix knob1=$knob1 c.jal link" 32 "$(lastReg 14)"
+    check "rvc_mix knob1=$knob1 c.jr return" 32 "$(lastReg 13)"
+    check "rvc_mix knob1=$knob1 subroutine runs once" 9 "$(lastReg 16)"
+    check "rvc_mix knob1=$knob1 jal link" 38 "$(lastReg 5)"
+    check "rvc_mix knob1=$knob1 jal target" 1 "$(lastReg 15)"
+done
+for options in "--predictor=2bit" "--knob2=0 --predictor=static"; do
+    run rvc_mix.mc --knob1=1 --knob3=0 --knob4=0 --knob6=0 $options
+    pipelined=$(stat 1)
+    run rvc_mix.mc --knob1=0 --trace-out=rvc_mix.trace
+    run rvc_mix.mc --knob1=1 --replay=rvc_mix.trace $options
+    check "rvc_mix replay cycles $options" "$pipelined" "$(stat 1)"
+done
+
+# Zba/Zbb edge cases. x31 = 1 << (32 mod XLEN) tells the builds apart;
+# rev8 uses its RV32 encoding, so an RV64 build skips the checks
+for knob1 in 0 1; do
+    run zbb_edges.mc --knob1=$knob1
+    if [ "$(lastReg 31)" != 1 ]; then
+        echo "SKIP  zbb_edges knob1=$knob1: RV32 encodings"
+        continue
+    fi
+    check "zbb_edges knob1=$knob1 rev8" 2018915346 "$(lastReg 6)"
+    check "zbb_edges knob1=$knob1 orc.b" 16776960 "$(lastReg 8)"
+    check "zbb_edges knob1=$knob1 rori" 2014458966 "$(lastReg 9)"
+    check "zbb_edges knob1=$knob1 clz 0" 32 "$(lastReg 10)"
+    check "zbb_edges knob1=$knob1 ctz 0" 32 "$(lastReg 11)"
+    check "zbb_edges knob1=$knob1 cpop 0" 0 "$(lastReg 12)"
+    check "zbb_edges knob1=$knob1 sh3add" 305419920 "$(lastReg 14)"
+done
+
+# F edge cases: fcvt saturates and raises NV (fflags 16), fmin/fmax order
+# -0 below +0, drop a quiet NaN without NV and canonicalize two NaNs, and
+# flw/fmv.w.x results are NaN-boxed while an unboxed single reads as NaN
+for knob1 in 0 1; do
+    run fp_edges.mc --knob1=$knob1
+    check "fp_edges knob1=$knob1 fcvt.w.s 2^32" 2147483647 "$(lastReg 5)"
+    check "fp_edges knob1=$knob1 fcvt.w.s 2^32 NV" 16 "$(lastReg 6)"
+    check "fp_edges knob1=$knob1 fcvt.wu.s -1" 0 "$(lastReg 7)"
+    check "fp_edges knob1=$knob1 fcvt.wu.s -1 NV" 16 "$(lastReg 8)"
+    check "fp_edges knob1=$knob1 fcvt.w.s NaN" 2147483647 "$(lastReg 9)"
+    check "fp_edges knob1=$knob1 fmin +0 -0" -2147483648 "$(lastReg 10)"
+    check "fp_edges knob1=$knob1 fmax -0 +0" 0 "$(lastReg 11)"
+    check "fp_edges knob1=$knob1 fmin qNaN x" 1333788672 "$(lastReg 12)"
+    check "fp_edges knob1=$knob1 fmax qNaN qNaN" 2143289344 "$(lastReg 13)"
+    check "fp_edges knob1=$knob1 quiet NaN no NV" 0 "$(lastReg 14)"
+    check "fp_edges knob1=$knob1 fmax sNaN -0" -2147483648 "$(lastReg 15)"
+    check "fp_edges knob1=$knob1 sNaN NV" 16 "$(lastReg 19)"
+    check "fp_edges knob1=$knob1 flw boxed" -1 "$(lastReg 16)"
+    check "fp_edges knob1=$knob1 fmv.w.x boxed" -1 "$(lastReg 17)"
+    check "fp_edges knob1=$knob1 unboxed reads NaN" 2143289344 "$(lastReg 18)"
+done
+
+# Vector: v0 = 0xb5 masks elements 1, 3 and 6 of 8. A masked vadd leaves
+# them at 7, a masked vredsum skips them (1+3+5+6+8), and vlse32 with
+# stride 8 feeds vsse32 with stride 12. Both models must agree on v3, v5, v6
+for knob1 in 0 1; do
+    run vec_mask_stride.mc --knob1=$knob1
+    check "vec_mask_stride knob1=$knob1 active element" 101 "$(lastReg 6)"
+    check "vec_mask_stride knob1=$knob1 inactive element" 7 "$(lastReg 7)"
+    check "vec_mask_stride knob1=$knob1 last element" 108 "$(lastReg 8)"
+    check "vec_mask_stride knob1=$knob1 masked vredsum" 23 "$(lastReg 9)"
+    check "vec_mask_stride knob1=$knob1 vlse/vsse element 1" 3 "$(lastReg 10)"
+    check "vec_mask_stride knob1=$knob1 vlse/vsse element 7" 15 "$(lastReg 11)"
+    check "vec_mask_stride knob1=$knob1 vsse gap untouched" 0 "$(lastReg 12)"
+    if [ "$knob1" == 0 ]; then
+        unpipelined="$(lastVec 3) $(lastVec 5) $(lastVec 6)"
+    else
+        check "vec_mask_stride models agree" "$unpipelined" "$(lastVec 3) $(lastVec 5) $(lastVec 6)"
+    fi
+done
+
+# write(1, buf, -1) stops at device space with a short count; a buffer
+# that starts there gives -EFAULT (-14)
+for knob1 in 0 1; do
+    run syscall_bounds.mc --knob1=$knob1
+    check "syscall_bounds knob1=$knob1 short write" 4 "$(lastReg 8)"
+    check "syscall_bounds knob1=$knob1 unreadable buffer" -14 "$(lastReg 9)"
+done
+
+# A --log spec with an unknown name is an error, not a partial setting
+for knob1 in 0 1; do
+    run jump_loop.mc --knob1=$knob1 --log=off,fetch:bogus
+    check "invalid --log knob1=$knob1 exit status" 1 "$?"
+done
+
+echo "$failures failure(s)"
+[ "$failures" -eq 0 ]
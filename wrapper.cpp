@@ -2,6 +2,8 @@
 
 #include <iostream>
 #include <cstdlib>
+#include "sim_options.h"
+#include "commitlog.h"
 
 // Forward‑declare the two entry points, in their namespaces:
 namespace pipelined {
@@ -12,18 +14,57 @@ namespace unpipelined {
 }
 
 int main(int argc, char** argv) {
-    // We expect exactly 5 user args + program name: 
-    //   argv[1] = input.mc
+    // --check-commits=A,B compares two commit logs instead of simulating
+    for (int i = 1; i < argc; i++) {
+        std::string value;
+        if (!matchOption(argv[i], "check-commits", value)) continue;
+        size_t comma = value.find(',');
+        if (comma == std::string::npos) {
+            std::cerr << "Error: --check-commits expects two files: A,B\n";
+            return 2;
+        }
+        return compareCommitLogs(value.substr(0, comma), value.substr(comma + 1), std::cout);
+    }
+
+    // We expect at least 4 user args + program name:
+    //   argv[1] = input.mc, or an ELF executable
     //   argv[2] = data.mc
     //   argv[3] = stack.mc
     //   argv[4] = instruction.mc
-    if (argc != 5) {
-        std::cerr 
+    //   argv[5..] = optional --name=value options
+    if (argc < FIRST_OPTION_ARG) {
+        std::cerr
             << "Usage: " << argv[0]
-            << " <mem.mc> <data.mc> <stack.mc> <instr.mc>\n";
+            << " <mem.mc|prog.elf> <data.mc> <stack.mc> <instr.mc> [options]\n"
+            << "  --knob1=0|1          unpipelined (0) or pipelined (1) model\n"
+            << "  --knobN=value        set pipelined Knob2..Knob6\n"
+            << "  --trace-out=FILE     (knob1=0) write a binary execution trace\n"
+            << "  --sandbox=DIR        directory the program's open() calls may use\n"
+            << "  --replay=FILE        (knob1=1) run the timing model from a trace\n"
+            << "  --profile=FILE       (knob1=1) per-PC hotspot report\n"
+            << "  --profile-folded=FILE (knob1=1) folded stacks for flamegraph tools\n"
+            << "  --mem-profile=FILE   data-access heat map, strides and reuse (binary)\n"
+            << "  --branch-report=FILE (knob1=1) per-branch behavior and predictability\n"
+            << "  --dataflow=FILE      (with --replay) dataflow critical path and ideal CPI\n"
+            << "  --dataflow-latency=CLASS:N,...  latencies for --dataflow, e.g. load:3\n"
+            << "  --pipe-trace=FILE    (knob1=1) pipeline trace for the Konata viewer\n"
+            << "  --pipe-trace-window=START:END  (knob1=1) trace only these cycles\n"
+            << "  --flight-records=N   last N retired instructions and events (0 = off)\n"
+            << "  --flight-file=FILE   flight recorder dump (default flight_recorder.txt)\n"
+            << "  --commit-log=FILE    binary log of every retired instruction's results\n"
+            << "  --host-profile       simulator speed and host time per phase\n"
+            << "  --host-counters      also host IPC, cache and branch misses (Linux perf)\n"
+            << "  --progress=SECONDS   progress line on stderr every SECONDS\n"
+            << "  --log=SPEC           stage message levels, e.g. off, info, off,fetch:debug\n"
+            << "  --log-file=FILE      write stage messages to FILE instead of stdout\n"
+            << "Or: " << argv[0] << " --check-commits=A,B   compare two commit logs\n";
         return 1;
     }
-     const int knob1 = 1; 
+    int knob1 = 1;
+    for (int i = FIRST_OPTION_ARG; i < argc; i++) {
+        std::string value;
+        if (matchOption(argv[i], "knob1", value)) knob1 = std::atoi(value.c_str());
+    }
 
     if (knob1 != 0 && knob1 != 1) {
         std::cerr << "Error: knob1 must be 0 or 1\n";